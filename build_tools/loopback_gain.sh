@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# Measures what the in-process loopback transport gains over TCP: runs
+# rocketbench against an embedded server with and without --loopback, and
+# reports the change in throughput and latency with benchcompare, taking the
+# TCP runs as the baseline.
+#
+# Usage: build_tools/loopback_gain.sh OUT_DIR [ROCKETBENCH_FLAGS...]
+#
+# Environment:
+#   TRIALS: number of rocketbench runs per transport (default 5).
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 OUT_DIR [ROCKETBENCH_FLAGS...]"
+  exit 1
+fi
+
+OUT_DIR=$1
+shift
+TRIALS=${TRIALS:-5}
+
+make -j$(nproc) rocketbench benchcompare
+mkdir -p $OUT_DIR/tcp $OUT_DIR/loopback
+
+for i in $(seq 1 $TRIALS); do
+  for transport in tcp loopback; do
+    echo "***** Running rocketbench over $transport, trial $i"
+    ./rocketbench --start_local_server \
+                  --loopback=$([ $transport = loopback ] && echo true || echo false) \
+                  --num_messages=50000 \
+                  --message_rate=0 \
+                  --logging=false \
+                  --json_output=$OUT_DIR/$transport/rocketbench.$i.json \
+                  "$@" > /dev/null
+  done
+done
+
+join() { ls $1/*.json | paste -s -d, -; }
+# Every significant change is labelled, and the script fails if loopback is
+# significantly worse on any metric.
+./benchcompare --baseline=$(join $OUT_DIR/tcp) \
+               --candidate=$(join $OUT_DIR/loopback) \
+               --threshold=0
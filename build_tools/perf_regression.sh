@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Runs the microbenchmarks and rocketbench against an embedded server (using
+# the mock LogDevice), writing JSON results to OUT_DIR. If BASELINE_DIR is
+# given, the results are compared against the results of a previous run in
+# that directory, and the script fails if any metric regressed significantly.
+#
+# Usage: build_tools/perf_regression.sh OUT_DIR [BASELINE_DIR]
+#
+# Environment:
+#   TRIALS: number of rocketbench runs (default 5). At least 4 trials on each
+#     side are needed for a change to be significant.
+#   THRESHOLD: percentage change to tolerate (default 5).
+#   BENCH_EPOCHS: epochs per microbenchmark (default 11).
+
+set -e
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+  echo "Usage: $0 OUT_DIR [BASELINE_DIR]"
+  exit 1
+fi
+
+OUT_DIR=$1
+BASELINE_DIR=$2
+TRIALS=${TRIALS:-5}
+THRESHOLD=${THRESHOLD:-5}
+BENCH_EPOCHS=${BENCH_EPOCHS:-11}
+BENCHMARKS=$(make -s print-benchmarks)
+
+make -j$(nproc) $BENCHMARKS rocketbench benchcompare
+mkdir -p $OUT_DIR
+
+for b in $BENCHMARKS; do
+  echo "***** Running $b"
+  ROCKETSPEED_BENCH_EPOCHS=$BENCH_EPOCHS \
+  ROCKETSPEED_BENCH_JSON=$OUT_DIR/$b.json ./$b
+done
+
+for i in $(seq 1 $TRIALS); do
+  echo "***** Running rocketbench trial $i"
+  # A fixed rate keeps latencies from being dominated by queueing.
+  ./rocketbench --start_local_server \
+                --num_messages=50000 \
+                --message_rate=10000 \
+                --logging=false \
+                --json_output=$OUT_DIR/rocketbench.$i.json > /dev/null
+done
+
+if [ -n "$BASELINE_DIR" ]; then
+  join() { ls $1/*.json | paste -s -d, -; }
+  ./benchcompare --baseline=$(join $BASELINE_DIR) \
+                 --candidate=$(join $OUT_DIR) \
+                 --threshold=$THRESHOLD
+fi
@@ -24,6 +24,7 @@
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
@@ -59,6 +60,21 @@ struct ProducerConsumerQueue {
     }
   }
 
+  // Uses records, which must have room for size elements, instead of
+  // allocating. release is called with records on destruction.
+  ProducerConsumerQueue(uint32_t size,
+                        T* records,
+                        std::function<void(T*)> release)
+    : size_(size)
+    , records_(records)
+    , release_(std::move(release))
+    , readIndex_(0)
+    , writeIndex_(0)
+  {
+    assert(size >= 2);
+    assert(records_);
+  }
+
   ~ProducerConsumerQueue() {
     // We need to destruct anything that may still exist in our queue.
     // (No real synchronization needed at destructor time: only one
@@ -72,7 +88,11 @@ struct ProducerConsumerQueue {
       }
     }
 
-    std::free(records_);
+    if (release_) {
+      release_(records_);
+    } else {
+      std::free(records_);
+    }
   }
 
   template<class ...Args>
@@ -172,6 +192,7 @@ struct ProducerConsumerQueue {
 private:
   const uint32_t size_;
   T* const records_;
+  const std::function<void(T*)> release_;
 
   std::atomic<int> readIndex_;
   std::atomic<int> writeIndex_;
@@ -9,17 +9,95 @@
 #include <cstdarg>
 #include <cstring>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 
+/**
+ * Log statements below this level are compiled out entirely. The value is
+ * the numeric value of an InfoLogLevel, e.g. -DROCKETSPEED_MIN_LOG_LEVEL=1
+ * removes all LOG_DEBUG statements from the build.
+ */
+#ifndef ROCKETSPEED_MIN_LOG_LEVEL
+#define ROCKETSPEED_MIN_LOG_LEVEL 0
+#endif
+
+/**
+ * Default interval between two entries from the same LOG_*_RATELIMITED
+ * statement, in microseconds.
+ */
+#ifndef ROCKETSPEED_LOG_RATELIMIT_MICROS
+#define ROCKETSPEED_LOG_RATELIMIT_MICROS 1000000
+#endif
+
+/**
+ * True if a statement at this level may produce an entry. Checked before the
+ * info log expression is evaluated, so that disabled statements cost a single
+ * relaxed load and never touch the logger.
+ */
+#define RS_LOG_LEVEL_ENABLED(log_level) \
+  (static_cast<int>(log_level) >= ROCKETSPEED_MIN_LOG_LEVEL && \
+   (log_level) >= ::rocketspeed::LogLevelRegistry::Default().GetMinLevel())
+
+#define RS_LOG_WRITE(log_level, info_log, ...) \
+  do { \
+    (info_log)->Log((log_level), __FILE__, __LINE__, __VA_ARGS__); \
+    if ((log_level) >= ::rocketspeed::InfoLogLevel::FATAL_LEVEL) { \
+      (info_log)->Flush(); \
+    } \
+  } while (0)
+
 #define RS_LOG(log_level_expr, info_log_expr, ...) \
   do { \
     ::rocketspeed::InfoLogLevel _log_level = (log_level_expr); \
-    const auto& _info_log = (info_log_expr); \
-    if (_info_log && _log_level >= _info_log->GetInfoLogLevel()) { \
-      _info_log->Log(_log_level, __FILE__, __LINE__, __VA_ARGS__); \
-      if (_log_level >= ::rocketspeed::InfoLogLevel::FATAL_LEVEL) { \
-        _info_log->Flush(); \
+    if (RS_LOG_LEVEL_ENABLED(_log_level)) { \
+      const auto& _info_log = (info_log_expr); \
+      if (_info_log && _log_level >= _info_log->GetInfoLogLevel()) { \
+        RS_LOG_WRITE(_log_level, _info_log, __VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
+/**
+ * Logs on the first and then every n-th time the statement is reached while
+ * its level is enabled. The counter is shared by all threads.
+ */
+#define RS_LOG_EVERY_N(log_level_expr, info_log_expr, n, ...) \
+  do { \
+    ::rocketspeed::InfoLogLevel _log_level = (log_level_expr); \
+    if (RS_LOG_LEVEL_ENABLED(_log_level)) { \
+      const auto& _info_log = (info_log_expr); \
+      if (_info_log && _log_level >= _info_log->GetInfoLogLevel()) { \
+        static std::atomic<uint64_t> _log_count(0); \
+        if (_log_count.fetch_add(1, std::memory_order_relaxed) % (n) == 0) { \
+          RS_LOG_WRITE(_log_level, _info_log, __VA_ARGS__); \
+        } \
+      } \
+    } \
+  } while (0)
+
+/**
+ * Logs at most one entry per interval_micros from this statement. The number
+ * of entries suppressed in the meantime is reported with the next entry.
+ */
+#define RS_LOG_RATELIMITED(log_level_expr, interval_micros, info_log_expr, ...) \
+  do { \
+    ::rocketspeed::InfoLogLevel _log_level = (log_level_expr); \
+    if (RS_LOG_LEVEL_ENABLED(_log_level)) { \
+      const auto& _info_log = (info_log_expr); \
+      if (_info_log && _log_level >= _info_log->GetInfoLogLevel()) { \
+        static ::rocketspeed::LogRateLimiter _log_limiter; \
+        uint64_t _suppressed; \
+        if (_log_limiter.Allow((interval_micros), &_suppressed)) { \
+          RS_LOG_WRITE(_log_level, _info_log, __VA_ARGS__); \
+          if (_suppressed) { \
+            RS_LOG_WRITE(_log_level, _info_log, \
+                "Suppressed %llu similar log entries", \
+                static_cast<unsigned long long>(_suppressed)); \
+          } \
+        } \
       } \
     } \
   } while (0)
@@ -48,6 +126,38 @@
   RS_LOG(::rocketspeed::InfoLogLevel::VITAL_LEVEL, \
       info_log_expr, __VA_ARGS__)
 
+#define LOG_DEBUG_EVERY_N(info_log_expr, n, ...) \
+  RS_LOG_EVERY_N(::rocketspeed::InfoLogLevel::DEBUG_LEVEL, \
+      info_log_expr, n, __VA_ARGS__)
+
+#define LOG_INFO_EVERY_N(info_log_expr, n, ...) \
+  RS_LOG_EVERY_N(::rocketspeed::InfoLogLevel::INFO_LEVEL, \
+      info_log_expr, n, __VA_ARGS__)
+
+#define LOG_WARN_EVERY_N(info_log_expr, n, ...) \
+  RS_LOG_EVERY_N(::rocketspeed::InfoLogLevel::WARN_LEVEL, \
+      info_log_expr, n, __VA_ARGS__)
+
+#define LOG_ERROR_EVERY_N(info_log_expr, n, ...) \
+  RS_LOG_EVERY_N(::rocketspeed::InfoLogLevel::ERROR_LEVEL, \
+      info_log_expr, n, __VA_ARGS__)
+
+#define LOG_DEBUG_RATELIMITED(info_log_expr, ...) \
+  RS_LOG_RATELIMITED(::rocketspeed::InfoLogLevel::DEBUG_LEVEL, \
+      ROCKETSPEED_LOG_RATELIMIT_MICROS, info_log_expr, __VA_ARGS__)
+
+#define LOG_INFO_RATELIMITED(info_log_expr, ...) \
+  RS_LOG_RATELIMITED(::rocketspeed::InfoLogLevel::INFO_LEVEL, \
+      ROCKETSPEED_LOG_RATELIMIT_MICROS, info_log_expr, __VA_ARGS__)
+
+#define LOG_WARN_RATELIMITED(info_log_expr, ...) \
+  RS_LOG_RATELIMITED(::rocketspeed::InfoLogLevel::WARN_LEVEL, \
+      ROCKETSPEED_LOG_RATELIMIT_MICROS, info_log_expr, __VA_ARGS__)
+
+#define LOG_ERROR_RATELIMITED(info_log_expr, ...) \
+  RS_LOG_RATELIMITED(::rocketspeed::InfoLogLevel::ERROR_LEVEL, \
+      ROCKETSPEED_LOG_RATELIMIT_MICROS, info_log_expr, __VA_ARGS__)
+
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC visibility push(default)
 #endif
@@ -113,6 +223,91 @@ inline InfoLogLevel StringToLogLevel(const char* str) {
   return WARN_LEVEL;
 }
 
+/**
+ * Keeps track of the lowest level enabled by any live Logger in the process.
+ * LOG_* statements below that level are skipped without evaluating the info
+ * log expression or calling into the logger.
+ */
+class LogLevelRegistry {
+ public:
+  static LogLevelRegistry& Default() {
+    // Constant initialised and trivially destructible, so it can be used
+    // without a guard and by loggers destroyed during static destruction.
+    static LogLevelRegistry registry;
+    return registry;
+  }
+
+  constexpr LogLevelRegistry()
+  : counts_(), min_level_(NUM_INFO_LOG_LEVELS) {}
+
+  /** Lowest level enabled by any logger, NUM_INFO_LOG_LEVELS if none. */
+  InfoLogLevel GetMinLevel() const {
+    return min_level_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Records that a logger changed its level. NUM_INFO_LOG_LEVELS stands for
+   * a logger that is being created or destroyed.
+   */
+  void Update(InfoLogLevel from, InfoLogLevel to) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (from < NUM_INFO_LOG_LEVELS) {
+      assert(counts_[from] > 0);
+      --counts_[from];
+    }
+    if (to < NUM_INFO_LOG_LEVELS) {
+      ++counts_[to];
+    }
+    int level = 0;
+    while (level < NUM_INFO_LOG_LEVELS && counts_[level] == 0) {
+      ++level;
+    }
+    min_level_.store(static_cast<InfoLogLevel>(level),
+                     std::memory_order_relaxed);
+  }
+
+ private:
+  std::mutex mutex_;
+  int counts_[NUM_INFO_LOG_LEVELS];
+  std::atomic<InfoLogLevel> min_level_;
+};
+
+/**
+ * Per call site state of the LOG_*_RATELIMITED macros. Allows one entry per
+ * interval across all threads.
+ */
+class LogRateLimiter {
+ public:
+  constexpr LogRateLimiter() : next_allowed_micros_(0), suppressed_(0) {}
+
+  /**
+   * Decides whether an entry may be logged now.
+   *
+   * @param interval_micros Minimum time between two allowed entries.
+   * @param suppressed Set to the number of entries rejected since the last
+   *                   allowed one, if the entry is allowed.
+   * @return true if the entry should be logged.
+   */
+  bool Allow(uint64_t interval_micros, uint64_t* suppressed) {
+    const uint64_t now = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    uint64_t next = next_allowed_micros_.load(std::memory_order_relaxed);
+    if (now < next ||
+        !next_allowed_micros_.compare_exchange_strong(
+          next, now + interval_micros, std::memory_order_relaxed)) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+ private:
+  std::atomic<uint64_t> next_allowed_micros_;
+  std::atomic<uint64_t> suppressed_;
+};
+
 // An interface for writing log messages. It is recommended to use the LOG
 // macro instead of directly calling methods of this class because the macro
 // makes sure the format arguments are not evaluated if the specified log level
@@ -122,9 +317,14 @@ class Logger {
   enum { DO_NOT_SUPPORT_GET_LOG_FILE_SIZE = -1 };
 
   explicit Logger(InfoLogLevel log_level = InfoLogLevel::INFO_LEVEL)
-      : log_level_(log_level) {}
+      : log_level_(log_level) {
+    LogLevelRegistry::Default().Update(NUM_INFO_LOG_LEVELS, log_level);
+  }
 
-  virtual ~Logger() {}
+  virtual ~Logger() {
+    LogLevelRegistry::Default().Update(
+      log_level_.load(std::memory_order_relaxed), NUM_INFO_LOG_LEVELS);
+  }
 
   /**
    * Write an entry to the log file with the specified log level and format.
@@ -175,6 +375,16 @@ class Logger {
   /** Write an entry to the log file with the specified format. */
   virtual void Append(const char* format, va_list ap) = 0;
 
+  /**
+   * Write an entry that has already been fully formatted, including the
+   * timestamp and thread prefix. Used by loggers that format entries away
+   * from the thread which produced them.
+   * Default implementation forwards the line to Append.
+   */
+  virtual void AppendLine(const char* line, size_t size) {
+    AppendFormat("%.*s", static_cast<int>(size), line);
+  }
+
   /** Flush to the OS buffers. */
   virtual void Flush() {}
 
@@ -183,7 +393,9 @@ class Logger {
   }
 
   virtual void SetInfoLogLevel(const InfoLogLevel log_level) {
-    log_level_.store(log_level, std::memory_order_relaxed);
+    InfoLogLevel previous =
+      log_level_.exchange(log_level, std::memory_order_relaxed);
+    LogLevelRegistry::Default().Update(previous, log_level);
   }
 
  private:
@@ -193,6 +405,17 @@ class Logger {
 
   std::atomic<InfoLogLevel> log_level_;
 
+  void AppendFormat(const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+      __attribute__((__format__(__printf__, 2, 3)))
+#endif
+  {
+    va_list ap;
+    va_start(ap, format);
+    Append(format, ap);
+    va_end(ap);
+  }
+
   const char* Basename(const char* filename) {
     const char* result = strrchr(filename, '/');
     if (result == nullptr) {
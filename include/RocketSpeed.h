@@ -116,6 +116,12 @@ class ClientOptions {
   // Default: 10s
   std::chrono::milliseconds unsubscribe_deduplication_timeout;
 
+  // Fraction of published messages whose latency is traced through every
+  // component on the way to subscribers. Traced messages carry a few extra
+  // bytes, untraced ones cost nothing.
+  // Default: 0.0
+  double trace_sample_rate;
+
   /** Creates options with default values. */
   ClientOptions();
 };
@@ -5,6 +5,7 @@
 //
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
 #include <functional>
@@ -300,6 +301,16 @@ enum Retention : char {
   Total = 3,              // number of retention classes
 };
 
+/**
+ * Codecs for message payloads.
+ */
+enum class CompressionType : uint8_t {
+  kNone = 0x00,    // payload is sent as is
+  kSnappy = 0x01,
+  kLZ4 = 0x02,
+  kZlib = 0x03,
+};
+
 /**
  * These are the options associated with publishing to a Topic.
  * These parameters can be message-specific compression type,
@@ -310,6 +321,22 @@ enum Retention : char {
 class TopicOptions {
  public:
   TopicOptions() {}
+
+  explicit TopicOptions(CompressionType _compression)
+  : compression(_compression) {}
+
+  /**
+   * Codec the payload is compressed with by the publisher. It stays
+   * compressed in the log and in server caches, and is uncompressed by the
+   * subscribing client, so MessageReceived::GetContents() is unaffected.
+   * The payload is sent as is if the codec is not built into the client or
+   * does not make the payload smaller.
+   *
+   * Pilots, control towers, copilots and clients that predate compression
+   * reject compressed messages, so only enable it once every server and
+   * every subscriber of the topic has been upgraded.
+   */
+  CompressionType compression = CompressionType::kNone;
 };
 
 /**
@@ -50,7 +50,8 @@ Status Client::Create(ClientOptions options,
 
 Status ClientImpl::Create(ClientOptions options,
                           std::unique_ptr<ClientImpl>* out_client,
-                          bool is_internal) {
+                          bool is_internal,
+                          MsgLoop::Options msg_loop_options) {
   assert(out_client);
 
   // Validate arguments.
@@ -73,7 +74,8 @@ Status ClientImpl::Create(ClientOptions options,
                 0,
                 options.num_workers,
                 options.info_log,
-                "client"));
+                "client",
+                std::move(msg_loop_options)));
 
   Status st = msg_loop_->Initialize();
   if (!st.ok()) {
@@ -104,7 +106,8 @@ ClientImpl::ClientImpl(ClientOptions options,
                  options_.config,
                  options_.info_log,
                  msg_loop_.get(),
-                 &wake_lock_)
+                 &wake_lock_,
+                 options_.trace_sample_rate)
     , next_sub_id_(0) {
   LOG_VITAL(options_.info_log, "Creating Client");
 
@@ -20,6 +20,7 @@
 #include "src/client/publisher.h"
 #include "src/client/smart_wake_lock.h"
 #include "src/messages/messages.h"
+#include "src/messages/msg_loop.h"
 #include "src/messages/stream_socket.h"
 #include "src/util/common/base_env.h"
 #include "src/util/common/statistics.h"
@@ -29,7 +30,6 @@ namespace rocketspeed {
 class ClientEnv;
 class Subscriber;
 class MessageReceived;
-class MsgLoop;
 class Logger;
 class WakeLock;
 
@@ -38,7 +38,8 @@ class ClientImpl : public Client {
  public:
   static Status Create(ClientOptions client_options,
                        std::unique_ptr<ClientImpl>* client,
-                       bool is_internal = false);
+                       bool is_internal = false,
+                       MsgLoop::Options msg_loop_options = MsgLoop::Options());
 
   ClientImpl(ClientOptions options,
              std::unique_ptr<MsgLoop> msg_loop,
@@ -15,8 +15,10 @@
 #include "src/messages/msg_loop_base.h"
 #include "src/messages/commands.h"
 #include "src/port/port.h"
+#include "src/util/common/compression.h"
 #include "src/util/common/guid_generator.h"
 #include "src/util/common/hash.h"
+#include "src/util/common/random.h"
 #include "src/util/common/thread_check.h"
 
 namespace rocketspeed {
@@ -35,6 +37,12 @@ class ClientResultStatus : public ResultStatus {
       // Failed to deserialize a message after it has been serialized?
       assert(false);
       status_ = Status::InternalError("Message corrupt.");
+    } else if (message_.GetCompression() != CompressionType::kNone &&
+               !UncompressPayload(message_.GetCompression(),
+                                  message_.GetPayload(),
+                                  &uncompressed_).ok()) {
+      assert(false);
+      status_ = Status::InternalError("Message corrupt.");
     }
   }
 
@@ -58,7 +66,10 @@ class ClientResultStatus : public ResultStatus {
   }
 
   virtual Slice GetContents() const {
-    return message_.GetPayload();
+    if (message_.GetCompression() == CompressionType::kNone) {
+      return message_.GetPayload();
+    }
+    return Slice(uncompressed_);
   }
 
   ~ClientResultStatus() {}
@@ -67,6 +78,7 @@ class ClientResultStatus : public ResultStatus {
   Status status_;
   MessageData message_;
   std::string serialized_;
+  std::string uncompressed_;  // payload, if it was compressed
   SequenceNumber seqno_;
 };
 
@@ -269,11 +281,13 @@ PublisherImpl::PublisherImpl(BaseEnv* env,
                              std::shared_ptr<Configuration> config,
                              std::shared_ptr<Logger> info_log,
                              MsgLoopBase* msg_loop,
-                             SmartWakeLock* wake_lock)
+                             SmartWakeLock* wake_lock,
+                             double trace_sample_rate)
     : config_(std::move(config))
     , info_log_(std::move(info_log))
     , msg_loop_(msg_loop)
-    , wake_lock_(wake_lock) {
+    , wake_lock_(wake_lock)
+    , trace_sample_rate_(trace_sample_rate) {
   using namespace std::placeholders;
 
   // clang complains the private member wake_lock_ is unused, but we will
@@ -307,9 +321,19 @@ PublishStatus PublisherImpl::Publish(TenantID tenant_id,
   // Find the worker ID for this topic.
   const auto worker_id = GetWorkerForTopic(topic_name);
 
+  // Compress the payload once here, it stays compressed until delivered.
+  std::string compressed;
+  const CompressionType compression =
+    CompressPayload(options.compression, data, &compressed);
+
   // Construct message.
-  MessageData message(
-      MessageType::mPublish, tenant_id, Slice(topic_name), namespace_id, data);
+  MessageData message(MessageType::mPublish,
+                      tenant_id,
+                      Slice(topic_name),
+                      namespace_id,
+                      compression == CompressionType::kNone ?
+                        data : Slice(compressed));
+  message.SetCompression(compression);
 
   // Take note of message ID before we move into the command.
   const MsgId empty_msgid = MsgId();
@@ -320,6 +344,14 @@ PublishStatus PublisherImpl::Publish(TenantID tenant_id,
   }
   const MsgId msgid = message.GetMessageId();
 
+  // Start a trace on sampled messages.
+  if (trace_sample_rate_ > 0.0) {
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    if (distribution(ThreadLocalPRNG()) < trace_sample_rate_) {
+      message.GetTrace()->AddHop(TraceStage::kPublish);
+    }
+  }
+
   std::string serialized;
   message.SerializeToString(&serialized);
 
@@ -37,12 +37,14 @@ class PublisherImpl {
    * @param info_log a logger object
    * @param wake_lock a non-owning pointer to the wake lock
    * @param msg_loop a non-owning pointer to the message loop
+   * @param trace_sample_rate fraction of messages to trace
    */
   PublisherImpl(BaseEnv* env,
                 std::shared_ptr<Configuration> config,
                 std::shared_ptr<Logger> info_log,
                 MsgLoopBase* msg_loop,
-                SmartWakeLock* wake_lock);
+                SmartWakeLock* wake_lock,
+                double trace_sample_rate = 0.0);
 
   ~PublisherImpl();
 
@@ -68,6 +70,7 @@ class PublisherImpl {
   const std::shared_ptr<Logger> info_log_;
   MsgLoopBase* const msg_loop_;
   SmartWakeLock* const wake_lock_;
+  const double trace_sample_rate_;
 
   /** State of the publisher sharded by worker threads. */
   std::vector<PublisherWorkerData> worker_data_;
@@ -29,6 +29,7 @@
 #include "src/client/smart_wake_lock.h"
 #include "src/messages/event_loop.h"
 #include "src/port/port.h"
+#include "src/util/common/compression.h"
 #include "src/util/common/random.h"
 #include "src/util/timeout_list.h"
 
@@ -71,6 +72,15 @@ class MessageReceivedImpl : public MessageReceived {
   explicit MessageReceivedImpl(std::unique_ptr<MessageDeliverData> data)
   : data_(std::move(data)) {}
 
+  /** Uncompresses the payload, if the publisher compressed it. */
+  Status Uncompress() {
+    if (data_->GetCompression() == CompressionType::kNone) {
+      return Status::OK();
+    }
+    return UncompressPayload(
+      data_->GetCompression(), data_->GetPayload(), &uncompressed_);
+  }
+
   SubscriptionHandle GetSubscriptionHandle() const override {
     return data_->GetSubID();
   }
@@ -79,10 +89,16 @@ class MessageReceivedImpl : public MessageReceived {
     return data_->GetSequenceNumber();
   }
 
-  Slice GetContents() const override { return data_->GetPayload(); }
+  Slice GetContents() const override {
+    if (data_->GetCompression() == CompressionType::kNone) {
+      return data_->GetPayload();
+    }
+    return Slice(uncompressed_);
+  }
 
  private:
   std::unique_ptr<MessageDeliverData> data_;
+  std::string uncompressed_;
 };
 
 class DataLossInfoImpl : public DataLossInfo {
@@ -136,8 +152,30 @@ void SubscriptionState::ReceiveMessage(
       if (deliver_callback_) {
         std::unique_ptr<MessageDeliverData> data(
             static_cast<MessageDeliverData*>(deliver.release()));
-        std::unique_ptr<MessageReceived> received(
+        std::unique_ptr<MessageReceivedImpl> impl(
             new MessageReceivedImpl(std::move(data)));
+        Status st = impl->Uncompress();
+        if (!st.ok()) {
+          const SubscriptionID sub_id = impl->GetSubscriptionHandle();
+          const SequenceNumber seqno = impl->GetSequenceNumber();
+          LOG_ERROR(info_log,
+                    "Failed to uncompress message on ID(%" PRIu64
+                    ")@%" PRIu64 ": %s",
+                    sub_id,
+                    seqno,
+                    st.ToString().c_str());
+          // The message is lost to the application.
+          if (data_loss_callback_) {
+            std::unique_ptr<MessageDeliverGap> gap(new MessageDeliverGap(
+                tenant_id_, sub_id, GapType::kDataLoss));
+            gap->SetSequenceNumbers(seqno, seqno);
+            std::unique_ptr<DataLossInfo> data_loss_info(
+                new DataLossInfoImpl(std::move(gap)));
+            data_loss_callback_(data_loss_info);
+          }
+          break;
+        }
+        std::unique_ptr<MessageReceived> received(std::move(impl));
         deliver_callback_(received);
       }
       break;
@@ -264,6 +302,9 @@ Status Subscriber::Start() {
 
 const Statistics& Subscriber::GetStatistics() {
   stats_.active_subscriptions->Set(subscriptions_.size());
+  stats_.memory_subscriptions->Set(
+      HeapMemoryUsage(subscriptions_) + HeapMemoryUsage(pending_subscribes_) +
+      HeapMemoryUsage(pending_terminations_));
   return stats_.all;
 }
 
@@ -580,6 +621,16 @@ void Subscriber::Receive(std::unique_ptr<MessageDeliver> deliver,
 
   consecutive_goodbyes_count_ = 0;
 
+  // Complete the trace of sampled messages.
+  if (deliver->GetMessageType() == MessageType::mDeliverData) {
+    MessageTrace* trace =
+        static_cast<MessageDeliverData*>(deliver.get())->GetTrace();
+    if (trace->IsSampled()) {
+      stats_.trace_deliver_latency->Record(trace->AddHop(TraceStage::kDeliver));
+      stats_.trace_total_latency->Record(trace->GetTotalMicros());
+    }
+  }
+
   // Find the right subscription and deliver the message to it.
   SubscriptionID sub_id = deliver->GetSubID();
   auto it = subscriptions_.find(sub_id);
@@ -17,6 +17,7 @@
 #include "src/messages/messages.h"
 #include "src/messages/stream_socket.h"
 #include "src/port/port.h"
+#include "src/util/common/memory_usage.h"
 #include "src/util/common/random.h"
 #include "src/util/common/statistics.h"
 #include "src/util/timeout_list.h"
@@ -65,6 +66,11 @@ class SubscriptionState {
 
   const Topic& GetTopicName() const { return topic_name_; }
 
+  /** Estimated heap memory used by the subscription's names. */
+  size_t GetHeapMemoryUsage() const {
+    return HeapMemoryUsage(namespace_id_) + HeapMemoryUsage(topic_name_);
+  }
+
   /** Terminates subscription and notifies the application. */
   void Terminate(const std::shared_ptr<Logger>& info_log,
                  SubscriptionID sub_id,
@@ -186,12 +192,20 @@ class alignas(CACHE_LINE_SIZE) Subscriber {
       const std::string prefix = "client.";
 
       active_subscriptions = all.AddCounter(prefix + "active_subscriptions");
+      memory_subscriptions =
+          all.AddCounter(prefix + "memory.subscriptions");
       unsubscribes_invalid_handle =
           all.AddCounter(prefix + "unsubscribes_invalid_handle");
+      trace_deliver_latency = all.AddLatency(prefix + "trace.deliver_us");
+      trace_total_latency = all.AddLatency(prefix + "trace.end_to_end_us");
     }
 
     Counter* active_subscriptions;
+    Counter* memory_subscriptions;
     Counter* unsubscribes_invalid_handle;
+    /** Latencies of sampled messages from the copilot, and from publish. */
+    Histogram* trace_deliver_latency;
+    Histogram* trace_total_latency;
     Statistics all;
   } stats_;
 
@@ -56,6 +56,7 @@ static void GenerateKey(LogID logid, SequenceNumber seqno, CacheKey* buf) {
 class CacheEntry {
  private:
   std::unique_ptr<MessageData> mcache_[BLOCK_SIZE];
+  HugePageAllocator* allocator_; // where this entry was allocated
 
 #ifndef NDEBUG
   LogID logid_;                // useful for debugging
@@ -63,7 +64,26 @@ class CacheEntry {
 #endif /* NDEBUG */
 
  public:
-  explicit CacheEntry(LogID logid, SequenceNumber seqno_block) {
+  // Creates an entry in memory from the allocator.
+  static CacheEntry* Create(HugePageAllocator* allocator,
+                            LogID logid,
+                            SequenceNumber seqno_block) {
+    void* mem = allocator->Allocate(sizeof(CacheEntry));
+    return new (mem) CacheEntry(allocator, logid, seqno_block);
+  }
+
+  // Destroys an entry from Create, as a callback of the cache.
+  static void Delete(const Slice& key, void* value) {
+    CacheEntry* entry = static_cast<CacheEntry*>(value);
+    HugePageAllocator* allocator = entry->allocator_;
+    entry->~CacheEntry();
+    allocator->Free(entry, sizeof(CacheEntry));
+  }
+
+  CacheEntry(HugePageAllocator* allocator,
+             LogID logid,
+             SequenceNumber seqno_block)
+  : allocator_(allocator) {
 #ifndef NDEBUG
     logid_ = logid;
     seqno_block_ = seqno_block;
@@ -136,16 +156,11 @@ class CacheEntry {
   }
 };
 
-// utility to release memory from the cache callback.
-template <class T>
-static void DeleteEntry(const Slice& key, void* value) {
-  T* typed_value = reinterpret_cast<T*>(value);
-  delete typed_value;
-}
-
 DataCache::DataCache(size_t size_in_bytes,
-                     bool cache_data_from_system_namespaces) :
-  rs_cache_(size_in_bytes ? NewLRUCache(size_in_bytes) : nullptr) {
+                     bool cache_data_from_system_namespaces,
+                     HugePageMode huge_pages) :
+  rs_cache_(size_in_bytes ? NewLRUCache(size_in_bytes) : nullptr),
+  allocator_(HugePageAllocator::Get(huge_pages)) {
   characteristics_ = Characteristics::StoreUserTopics |
                      Characteristics::StoreSystemTopics |
                      Characteristics::StoreDataRecords |
@@ -241,9 +256,9 @@ void DataCache::StoreData(const Slice& namespace_id, const Slice& topic,
   } else {
     // Entry does not exist in the cache.
     // Create a new entry and insert into cache.
-    entry = new CacheEntry(log_id, seqno_block);
+    entry = CacheEntry::Create(allocator_, log_id, seqno_block);
     handle = rs_cache_->Insert(cache_key, entry, entry->GetInitialCharge(),
-                               &DeleteEntry<CacheEntry>);
+                               &CacheEntry::Delete);
   }
 
   // Insert this record into the Entry
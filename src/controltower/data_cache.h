@@ -8,6 +8,7 @@
 #include "include/RocketSpeed.h"
 #include "src/messages/messages.h"
 #include "src/util/cache.h"
+#include "src/util/common/huge_page_allocator.h"
 #include "src/util/storage.h"
 
 namespace rocketspeed {
@@ -18,7 +19,10 @@ extern std::shared_ptr<Cache> NewDataCache(size_t capacity);
 
 class DataCache {
  public:
-  DataCache(size_t size_in_bytes, bool cache_data_from_system_namespaces);
+  // Cache entries are allocated on pages of the given kind.
+  DataCache(size_t size_in_bytes,
+            bool cache_data_from_system_namespaces,
+            HugePageMode huge_pages = HugePageMode::kNone);
 
   // Sets a new capacity for the cache. Evict data from cache if the
   // current usage exceeds the specified capacity.
@@ -66,6 +70,9 @@ class DataCache {
   int characteristics_;
 
   std::shared_ptr<Cache> rs_cache_;
+
+  // Allocator of cache entries
+  HugePageAllocator* allocator_;
 };
 
 }  // namespace rocketspeed
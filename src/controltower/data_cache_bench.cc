@@ -0,0 +1,117 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/controltower/data_cache.h"
+#include "src/messages/messages.h"
+#include "src/util/benchharness.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+namespace {
+
+const size_t kCacheSize = 64 << 20;
+const std::string kTopic = "benchmark.topic";
+const std::string kPayload(100, 'x');
+
+std::unique_ptr<MessageData> MakeData(SequenceNumber seqno) {
+  std::unique_ptr<MessageData> data(new MessageData(
+    MessageType::mPublish, Tenant::GuestTenant,
+    kTopic, GuestNamespace, kPayload));
+  data->SetSequenceNumbers(seqno - 1, seqno);
+  return data;
+}
+
+/** Stores n records, spread round-robin over num_logs logs. */
+void Store(size_t n,
+           size_t num_logs,
+           HugePageMode huge_pages = HugePageMode::kNone) {
+  std::unique_ptr<DataCache> cache;
+  std::vector<std::unique_ptr<MessageData>> messages;
+  {
+    BenchmarkSuspender suspender;
+    cache.reset(new DataCache(kCacheSize, false, huge_pages));
+    messages.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      messages.emplace_back(MakeData(1 + i / num_logs));
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    cache->StoreData(GuestNamespace, kTopic,
+                     static_cast<LogID>(i % num_logs),
+                     std::move(messages[i]));
+  }
+  BenchmarkSuspender teardown;
+  cache.reset();
+}
+
+}  // namespace
+
+BENCHMARK(DataCacheStoreSingleLog, n) {
+  Store(n, 1);
+}
+
+BENCHMARK_RELATIVE(DataCacheStoreManyLogs, n) {
+  Store(n, 1000);
+}
+
+BENCHMARK_RELATIVE(DataCacheStoreManyLogsHugePages, n) {
+  Store(n, 1000, HugePageMode::kTransparent);
+}
+
+BENCHMARK(DataCacheVisit, n) {
+  // Iterations count visited records, as when tailing from the cache.
+  const size_t kRecords = 10000;
+  std::unique_ptr<DataCache> cache;
+  {
+    BenchmarkSuspender suspender;
+    cache.reset(new DataCache(kCacheSize, false));
+    for (size_t i = 0; i < kRecords; ++i) {
+      cache->StoreData(GuestNamespace, kTopic, 1, MakeData(1 + i));
+    }
+  }
+  size_t visited = 0;
+  while (visited < n) {
+    SequenceNumber next = cache->VisitCache(1, 1,
+      [&](MessageData* data) {
+        DoNotOptimizeAway(data);
+        ++visited;
+      });
+    DoNotOptimizeAway(next);
+  }
+  BenchmarkSuspender teardown;
+  cache.reset();
+}
+
+BENCHMARK(DataCacheMiss, n) {
+  std::unique_ptr<DataCache> cache;
+  {
+    BenchmarkSuspender suspender;
+    cache.reset(new DataCache(kCacheSize, false));
+    for (size_t i = 0; i < 1000; ++i) {
+      cache->StoreData(GuestNamespace, kTopic, 1, MakeData(1 + i));
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    SequenceNumber next = cache->VisitCache(static_cast<LogID>(2 + i % 1000),
+                                            1,
+                                            [](MessageData*) {});
+    DoNotOptimizeAway(next);
+  }
+  BenchmarkSuspender teardown;
+  cache.reset();
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
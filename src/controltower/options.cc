@@ -20,7 +20,8 @@ ControlTowerOptions::ControlTowerOptions()
     max_subscription_lag(10000),
     readers_per_room(2),
     cache_size(0),
-    cache_data_from_system_namespaces(true) {
+    cache_data_from_system_namespaces(true),
+    cache_huge_pages(HugePageMode::kNone) {
 }
 
 }  // namespace rocketspeed
@@ -9,6 +9,7 @@
 #include <utility>
 #include "include/Types.h"
 #include "src/port/Env.h"
+#include "src/util/common/huge_page_allocator.h"
 #include "src/util/storage.h"
 
 namespace rocketspeed {
@@ -95,6 +96,10 @@ struct ControlTowerOptions {
   // Default: false
   bool cache_data_from_system_namespaces;
 
+  // Pages backing the cache entries.
+  // Default: HugePageMode::kNone
+  HugePageMode cache_huge_pages;
+
   // Create ControlTowerOptions with default values for all fields
   ControlTowerOptions();
 };
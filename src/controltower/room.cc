@@ -157,7 +157,6 @@ ControlRoom::ProcessDeliver(std::unique_ptr<Message> msg,
 
   // For each subscriber on this topic at prev_seqno, deliver the message and
   // advance the subscription to next_seqno.
-  TopicUUID uuid(request->GetNamespaceId(), request->GetTopicName());
   for (CopilotSub recipient : recipients) {
     // Send to correct worker loop.
     int* ptr = sub_worker_.Find(recipient.stream_id, recipient.sub_id);
@@ -172,29 +171,35 @@ ControlRoom::ProcessDeliver(std::unique_ptr<Message> msg,
     MessageDeliverData deliver(request->GetTenantID(),
                                recipient.sub_id,
                                request->GetMessageId(),
-                               request->GetPayload());
+                               request->GetPayload(),
+                               request->GetCompression());
     deliver.SetSequenceNumbers(prev_seqno, next_seqno);
+    if (request->GetTrace()->IsSampled()) {
+      *deliver.GetTrace() = *request->GetTrace();
+    }
     auto command =
       options.msg_loop->ResponseCommand(deliver, recipient.stream_id);
 
     if (room_to_client_queues_[worker_id]->Write(command)) {
       LOG_DEBUG(options.info_log,
-               "Sent data (%.16s)@%" PRIu64 " for %s to %s",
+               "Sent data (%.16s)@%" PRIu64 " for Topic(%s,%s) to %s",
                request->GetPayload().ToString().c_str(),
                request->GetSequenceNumber(),
-               uuid.ToString().c_str(),
+               request->GetNamespaceId().ToString().c_str(),
+               request->GetTopicName().ToString().c_str(),
                recipient.ToString().c_str());
     } else {
-      LOG_WARN(options.info_log,
-               "Unable to forward data message to %s",
-               recipient.ToString().c_str());
+      LOG_WARN_RATELIMITED(options.info_log,
+        "Unable to forward data message to %s",
+        recipient.ToString().c_str());
     }
   }
 
   if (recipients.empty()) {
-    LOG_WARN(options.info_log,
-      "No recipients for record in %s@%" PRIu64 ": no message sent.",
-      uuid.ToString().c_str(),
+    LOG_WARN_RATELIMITED(options.info_log,
+      "No recipients for record in Topic(%s,%s)@%" PRIu64 ": no message sent.",
+      request->GetNamespaceId().ToString().c_str(),
+      request->GetTopicName().ToString().c_str(),
       request->GetSequenceNumber());
   }
 }
@@ -242,14 +247,15 @@ ControlRoom::ProcessGap(std::unique_ptr<Message> msg,
                gap->GetTopicName().c_str(),
                recipient.stream_id);
     } else {
-      LOG_WARN(options.info_log,
-               "Unable to forward Gap message to subscriber %llu",
-               recipient.stream_id);
+      LOG_WARN_RATELIMITED(options.info_log,
+        "Unable to forward Gap message to subscriber %llu",
+        recipient.stream_id);
     }
   }
 
   if (recipients.empty()) {
-    LOG_WARN(options.info_log, "No recipients for gap: no message sent.");
+    LOG_WARN_RATELIMITED(options.info_log,
+      "No recipients for gap: no message sent.");
   }
 }
 
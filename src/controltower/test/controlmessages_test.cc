@@ -7,10 +7,12 @@
 #include <unistd.h>
 #include <chrono>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "src/controltower/log_tailer.h"
 #include "src/controltower/room.h"
+#include "src/controltower/topic_tailer.h"
 #include "src/controltower/tower.h"
 #include "src/port/port.h"
 #include "src/test/test_cluster.h"
@@ -170,6 +172,101 @@ TEST(ControlTowerTest, MultipleSubscribers) {
 }
 
 
+TEST(ControlTowerTest, LogRecordRetryWhenRoomQueueFull) {
+  // A worker loop with a tiny command queue, not yet running, so that the
+  // queue from this "storage" thread to the room fills up.
+  MsgLoop::Options loop_options;
+  loop_options.event_loop.command_queue_size = 1;
+  MsgLoop loop(env_, env_options_, 0, 1, info_log_, "tower", loop_options);
+  ASSERT_OK(loop.Initialize());
+
+  TopicTailer* tailer_raw;
+  ASSERT_OK(TopicTailer::CreateNewInstance(env_,
+                                           &loop,
+                                           0,
+                                           nullptr,
+                                           nullptr,
+                                           info_log_,
+                                           0,
+                                           false,
+                                           HugePageMode::kNone,
+                                           [] (std::unique_ptr<Message>,
+                                               std::vector<CopilotSub>) {},
+                                           ControlTowerOptions::TopicTailer(),
+                                           &tailer_raw));
+  std::unique_ptr<TopicTailer> tailer(tailer_raw);
+  ASSERT_OK(tailer->Initialize({0}, 100));
+
+  auto make_record = [] () {
+    return std::unique_ptr<MessageData>(
+      new MessageData(MessageType::mDeliver,
+                      Tenant::GuestTenant,
+                      "topic",
+                      GuestNamespace,
+                      "payload"));
+  };
+
+  // Send records until the queue pushes back.
+  const int kMaxRecords = 100000;
+  int sent = 0;
+  std::unique_ptr<MessageData> msg;
+  Status st;
+  while (sent < kMaxRecords) {
+    msg = make_record();
+    st = tailer->SendLogRecord(msg, 1, 0);
+    if (!st.ok()) {
+      break;
+    }
+    ASSERT_TRUE(!msg);
+    ++sent;
+  }
+  ASSERT_TRUE(st.IsNoBuffer());
+  // The record is handed back for the storage to retry.
+  ASSERT_TRUE(msg != nullptr);
+
+  // Once the room is running, the retry must succeed, and the record must
+  // only be processed once.
+  env_->StartThread(&ControlTowerTest::MsgLoopStart, &loop, "tower");
+  ASSERT_OK(loop.WaitUntilRunning());
+  while (!tailer->SendLogRecord(msg, 1, 0).ok()) {
+    ASSERT_TRUE(msg != nullptr);
+    std::this_thread::yield();
+  }
+  ASSERT_TRUE(!msg);
+  ++sent;
+
+  // Gaps go through the same queue, so once this one is processed all
+  // records sent before it have been processed too.
+  while (!tailer->SendGapRecord(1, GapType::kBenign, 1, 1, 0).ok()) {
+    std::this_thread::yield();
+  }
+  auto get_stats = [&] () {
+    Statistics stats;
+    port::Semaphore done;
+    std::unique_ptr<Command> command(MakeExecuteCommand([&] () {
+      stats = Statistics(tailer->GetStatistics());
+      done.Post();
+    }));
+    ASSERT_OK(loop.SendCommand(std::move(command), 0));
+    done.Wait();
+    return stats;
+  };
+  const std::string prefix = "tower.topic_tailer.";
+  Statistics stats;
+  const auto start = std::chrono::steady_clock::now();
+  do {
+    stats = get_stats();
+  } while (stats.GetCounterValue(prefix + "gap_records_received") == 0 &&
+           std::chrono::steady_clock::now() - start < timeout);
+  ASSERT_EQ(stats.GetCounterValue(prefix + "gap_records_received"), 1);
+  ASSERT_EQ(stats.GetCounterValue(prefix + "log_records_received"), sent);
+
+  loop.Stop();
+  env_->WaitForJoin();
+  // The tailer must be destroyed on the worker, which has stopped.
+  tailer.reset();
+}
+
 TEST(ControlTowerTest, NoLogger) {
   // Create cluster with tower only (only need this for the log storage).
   LocalTestCluster cluster(info_log_, true, false, false);
@@ -5,6 +5,7 @@
 //
 #include "src/controltower/topic.h"
 
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -44,7 +45,13 @@ TopicManager::AddSubscriber(const TopicUUID& topic,
                             SequenceNumber start,
                             CopilotSub subscriber) {
   thread_check_.Check();
-  return UpdateSubscription(topic_map_[topic], subscriber, start);
+  auto iter = topic_map_.find(TopicUUIDKey::Borrow(topic));
+  if (iter == topic_map_.end()) {
+    iter = topic_map_.emplace(std::piecewise_construct,
+                              std::forward_as_tuple(topic),
+                              std::forward_as_tuple()).first;
+  }
+  return UpdateSubscription(iter->second, subscriber, start);
 }
 
 // remove a subscriber to the topic
@@ -52,7 +59,7 @@ bool
 TopicManager::RemoveSubscriber(const TopicUUID& topic, CopilotSub subscriber) {
   thread_check_.Check();
   // find list of subscribers for this topic
-  auto iter = topic_map_.find(topic);
+  auto iter = topic_map_.find(TopicUUIDKey::Borrow(topic));
   if (iter != topic_map_.end()) {
     bool all_removed = RemoveSubscription(iter->second, subscriber);
     if (all_removed) {
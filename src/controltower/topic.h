@@ -10,6 +10,7 @@
 #include "include/Types.h"
 #include "src/util/topic_uuid.h"
 #include "src/util/common/autovector.h"
+#include "src/util/common/memory_usage.h"
 #include "src/util/common/thread_check.h"
 #include "src/controltower/tower.h"
 
@@ -82,13 +83,13 @@ class TopicManager {
    * number is not less than 'from', and not greater than 'to'. The visitation
    * order is unspecified.
    *
-   * @param topic Topic UUID.
+   * @param topic Topic key, which may be borrowed.
    * @param from Lower threshold of subscriptions.
    * @param to Upper threshold of subscriptions.
    * @param visitor Visiting function for subscriptions. Mutation is allowed.
    */
   template <typename Visitor>
-  void VisitSubscribers(const TopicUUID& topic,
+  void VisitSubscribers(const TopicUUIDKey& topic,
                         SequenceNumber from,
                         SequenceNumber to,
                         const Visitor& visitor);
@@ -101,15 +102,23 @@ class TopicManager {
   template <typename Visitor>
   void VisitTopics(const Visitor& visitor);
 
+  /**
+   * @return Estimated heap memory used by topics and their subscriptions.
+   */
+  size_t GetHeapMemoryUsage() const {
+    thread_check_.Check();
+    return HeapMemoryUsage(topic_map_);
+  }
+
  private:
   // Map a topic name to a list of TopicEntries.
-  std::unordered_map<TopicUUID, TopicList> topic_map_;
+  TopicUUIDMap<TopicList> topic_map_;
   ThreadCheck thread_check_;
 };
 
 template <typename Visitor>
 void TopicManager::VisitSubscribers(
-    const TopicUUID& topic,
+    const TopicUUIDKey& topic,
     SequenceNumber from,
     SequenceNumber to,
     const Visitor& visitor) {
@@ -130,7 +139,7 @@ void TopicManager::VisitTopics(const Visitor& visitor) {
   for (auto it = topic_map_.begin(); it != topic_map_.end(); ) {
     // We save next here to allow visitor to RemoveSubscribers on this topic.
     auto next = std::next(it);
-    visitor(it->first);
+    visitor(it->first.uuid());
     it = next;
   }
 }
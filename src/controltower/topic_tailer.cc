@@ -15,6 +15,7 @@
 #include "src/util/storage.h"
 #include "src/util/topic_uuid.h"
 #include "src/util/common/linked_map.h"
+#include "src/util/common/memory_usage.h"
 #include "src/util/common/random.h"
 #include "src/util/common/thread_check.h"
 #include "src/messages/msg_loop.h"
@@ -71,7 +72,7 @@ class LogReader {
    *
    * @param log_id Log ID of record.
    * @param seqno Sequence number of record.
-   * @param topic UUID of record topic.
+   * @param topic Key of record topic, which may be borrowed.
    * @param prev_seqno Output location for previous sequence number processed
    *                   for the topic. If this is the first record processed on
    *                   this topic then prev_seqno is set to the starting
@@ -80,7 +81,7 @@ class LogReader {
    */
   Status ProcessRecord(LogID log_id,
                        SequenceNumber seqno,
-                       const TopicUUID& topic,
+                       const TopicUUIDKey& topic,
                        SequenceNumber* prev_seqno);
 
   /**
@@ -226,6 +227,12 @@ class LogReader {
    */
   std::string GetAllLogsInfo() const;
 
+  /**
+   * Estimated heap memory used by the per-log and per-topic state.
+   */
+  size_t GetHeapMemoryUsage() const {
+    return HeapMemoryUsage(log_state_);
+  }
 
  private:
   struct TopicState {
@@ -237,7 +244,8 @@ class LogReader {
     SequenceNumber start_seqno;
 
     // State of subscriptions on each topic.
-    LinkedMap<TopicUUID, TopicState> topics;
+    LinkedMap<TopicUUIDKey, TopicState, TopicUUIDKeyHash, TopicUUIDKeyEqual>
+      topics;
 
     // Last read sequence number on this log.
     SequenceNumber last_read;
@@ -250,6 +258,10 @@ class LogReader {
     // This value can become inaccurate if a reader is receiving records
     // slower than they are produced.
     SequenceNumber tail_seqno = 0;
+
+    size_t GetHeapMemoryUsage() const {
+      return topics.GetHeapMemoryUsage();
+    }
   };
 
   ThreadCheck thread_check_;
@@ -262,7 +274,7 @@ class LogReader {
 
 Status LogReader::ProcessRecord(LogID log_id,
                                 SequenceNumber seqno,
-                                const TopicUUID& topic,
+                                const TopicUUIDKey& topic,
                                 SequenceNumber* prev_seqno) {
   thread_check_.Check();
 
@@ -346,7 +358,7 @@ void LogReader::ProcessGap(
     }
 
     // Find previous seqno for topic.
-    auto it = log_state.topics.find(topic);
+    auto it = log_state.topics.find(TopicUUIDKey::Borrow(topic));
     if (it != log_state.topics.end()) {
       *prev_seqno = it->second.next_seqno;
       assert(*prev_seqno != 0);
@@ -398,7 +410,7 @@ void LogReader::BumpLaggingSubscriptions(
       // Is it older than the trim point?
       if (tseqno + max_subscription_lag_ < seqno) {
         // Eligible for bump.
-        const TopicUUID& topic = it->first;
+        const TopicUUID& topic = it->first.uuid();
         LOG_DEBUG(info_log_,
           "Bumping %s from %" PRIu64 " to %" PRIu64 " on Log(%" PRIu64 ")",
           topic.ToString().c_str(),
@@ -434,11 +446,11 @@ Status LogReader::StartReading(const TopicUUID& topic,
   LogState& log_state = log_it->second;
 
   bool reseek = false;
-  auto it = log_state.topics.find(topic);
+  auto it = log_state.topics.find(TopicUUIDKey::Borrow(topic));
   if (it == log_state.topics.end()) {
     TopicState topic_state;
     topic_state.next_seqno = seqno;
-    it = log_state.topics.emplace_front(topic, topic_state).first;
+    it = log_state.topics.emplace_front(TopicUUIDKey(topic), topic_state).first;
     reseek = true;
   } else {
     reseek = (seqno < it->second.next_seqno);
@@ -494,7 +506,7 @@ Status LogReader::StopReading(const TopicUUID& topic, LogID log_id) {
   auto log_it = log_state_.find(log_id);
   if (log_it != log_state_.end()) {
     LogState& log_state = log_it->second;
-    auto it = log_state.topics.find(topic);
+    auto it = log_state.topics.find(TopicUUIDKey::Borrow(topic));
     if (it != log_state.topics.end()) {
       LOG_INFO(info_log_,
         "No more subscribers on %s for Log(%" PRIu64 ") %sReader(%zu)",
@@ -544,7 +556,7 @@ uint64_t LogReader::SubscriptionCost(const TopicUUID& topic,
 
     // We have already passed the subscription seqno, but we might have
     // kept track of it for a different subscriber.
-    auto it = log_state.topics.find(topic);
+    auto it = log_state.topics.find(TopicUUIDKey::Borrow(topic));
     if (it == log_state.topics.end()) {
       // Unknown topic, so rewind necessary.
       return kSubscriptionCostRewind;
@@ -619,9 +631,9 @@ void LogReader::MergeInto(LogReader* reader, LogID log_id) {
 
   // Now just merge the topic state by taking the min of next_seqno for each.
   for (auto& src_topic_entry : src.topics) {
-    const TopicUUID& topic = src_topic_entry.first;
+    const TopicUUID& topic = src_topic_entry.first.uuid();
     TopicState& src_topic = src_topic_entry.second;
-    auto it = dest.topics.find(topic);
+    auto it = dest.topics.find(TopicUUIDKey::Borrow(topic));
     if (it != dest.topics.end()) {
       // Merge TopicStates by taking the min seqno.
       TopicState& dest_topic = it->second;
@@ -632,7 +644,7 @@ void LogReader::MergeInto(LogReader* reader, LogID log_id) {
       TopicState topic_state;
       topic_state.next_seqno = src_topic.next_seqno;
       // TODO(pja) : these shouldn't emplace_back
-      dest.topics.emplace_back(topic, topic_state);
+      dest.topics.emplace_back(TopicUUIDKey(topic), topic_state);
     }
   }
 
@@ -721,6 +733,7 @@ TopicTailer::TopicTailer(
     std::shared_ptr<Logger> info_log,
     size_t cache_size_per_room,
     bool cache_data_from_system_namespaces,
+    HugePageMode cache_huge_pages,
     std::function<void(std::unique_ptr<Message>,
                        std::vector<CopilotSub>)> on_message,
     ControlTowerOptions::TopicTailer options) :
@@ -731,7 +744,9 @@ TopicTailer::TopicTailer(
   log_router_(std::move(log_router)),
   info_log_(std::move(info_log)),
   on_message_(std::move(on_message)),
-  data_cache_(cache_size_per_room, cache_data_from_system_namespaces),
+  data_cache_(cache_size_per_room,
+              cache_data_from_system_namespaces,
+              cache_huge_pages),
   prng_(ThreadLocalPRNG()),
   options_(options) {
 
@@ -757,7 +772,7 @@ Status TopicTailer::SendLogRecord(
     }
   }
 
-  bool sent = !force_failure && Forward([this, data_raw, log_id, reader_id] () {
+  bool sent = !force_failure && TryForward([this, data_raw, log_id, reader_id] () {
     // Validate.
     LogReader* reader = FindLogReader(reader_id);
     assert(reader != nullptr);
@@ -767,7 +782,11 @@ Status TopicTailer::SendLogRecord(
     stats_.log_records_received_payload_size->Add(data_raw->GetPayload().
                                                   size());
     std::unique_ptr<MessageData> data(data_raw);
-    TopicUUID uuid(data->GetNamespaceId(), data->GetTopicName());
+    data->GetTrace()->RecordHop(TraceStage::kTowerRead,
+                                stats_.trace_read_latency);
+    // Borrows from data, so must not be used once data is released.
+    const auto uuid =
+      TopicUUIDKey::Borrow(data->GetNamespaceId(), data->GetTopicName());
     SequenceNumber next_seqno = data->GetSequenceNumber();
     SequenceNumber prev_seqno = 0;
     Status st = reader->ProcessRecord(log_id,
@@ -865,7 +884,7 @@ Status TopicTailer::SendLogRecord(
           // Find subscribed hosts between bump_seqno and next_seqno.
           std::vector<CopilotSub> bumped_subscriptions;
           topic_manager.VisitSubscribers(
-            topic, bump_seqno, next_seqno,
+            TopicUUIDKey::Borrow(topic), bump_seqno, next_seqno,
             [&] (TopicSubscription* sub) {
               const CopilotSub id = sub->GetID();
               // Add host to list.
@@ -932,7 +951,7 @@ Status TopicTailer::SendGapRecord(
     SequenceNumber to,
     size_t reader_id) {
   // Send to worker loop.
-  bool sent = Forward([this, log_id, type, from, to, reader_id] () {
+  bool sent = TryForward([this, log_id, type, from, to, reader_id] () {
     // Validate.
     LogReader* reader = FindLogReader(reader_id);
     assert(reader != nullptr);
@@ -963,7 +982,7 @@ Status TopicTailer::SendGapRecord(
         // Find subscribed hosts.
         std::vector<CopilotSub> recipients;
         topic_map_[log_id].VisitSubscribers(
-          topic, prev_seqno, to,
+          TopicUUIDKey::Borrow(topic), prev_seqno, to,
           [&] (TopicSubscription* sub) {
             recipients.emplace_back(sub->GetID());
             sub->SetSequenceNumber(to + 1);
@@ -1052,6 +1071,7 @@ TopicTailer::CreateNewInstance(
     std::shared_ptr<Logger> info_log,
     size_t cache_size_per_room,
     bool cache_data_from_system_namespaces,
+    HugePageMode cache_huge_pages,
     std::function<void(std::unique_ptr<Message>,
                        std::vector<CopilotSub>)> on_message,
     ControlTowerOptions::TopicTailer options,
@@ -1064,6 +1084,7 @@ TopicTailer::CreateNewInstance(
                             std::move(info_log),
                             cache_size_per_room,
                             cache_data_from_system_namespaces,
+                            cache_huge_pages,
                             std::move(on_message),
                             options);
   return Status::OK();
@@ -1195,6 +1216,22 @@ Status TopicTailer::RemoveSubscriber(StreamID stream_id) {
   return Status::OK();
 }
 
+const Statistics& TopicTailer::GetStatistics() {
+  thread_check_.Check();
+  stats_.memory_data_cache->Set(data_cache_.GetUsage());
+
+  stats_.memory_topic_manager->Set(HeapMemoryUsage(topic_map_));
+
+  size_t log_reader_bytes = HeapMemoryUsage(log_readers_) +
+    HeapMemoryUsage(pending_reader_) +
+    HeapMemoryUsage(tail_seqno_cached_);
+  stats_.memory_log_readers->Set(log_reader_bytes);
+
+  stats_.memory_subscriptions->Set(
+    stream_subscriptions_.GetHeapMemoryUsage());
+  return stats_.all;
+}
+
 std::string TopicTailer::ClearCache() {
   thread_check_.Check();
   LOG_INFO(info_log_, "Clearing cache for worker_id %d", worker_id_);
@@ -1294,7 +1331,6 @@ SequenceNumber TopicTailer::DeliverFromCache(const TopicUUID& topic,
   auto on_message_cache =
     [&] (MessageData* data_raw) {
 
-    TopicUUID uuid(data_raw->GetNamespaceId(), data_raw->GetTopicName());
     largest_cached = data_raw->GetSequenceNumber();
     assert(largest_cached >= seqno);
 
@@ -1308,13 +1344,13 @@ SequenceNumber TopicTailer::DeliverFromCache(const TopicUUID& topic,
         logid);
 
     // If this message is for our topic, then deliver
-    if (uuid == topic) {
+    if (topic.Equals(data_raw->GetNamespaceId(), data_raw->GetTopicName())) {
       this->stats_.records_served_from_cache->Add(1);
       if (0) {
         LOG_DEBUG(info_log_,
                   "Delivering data to %s@%" PRIu64 " on Log(%" PRIu64
                   ") from cache",
-                  uuid.ToString().c_str(),
+                  topic.ToString().c_str(),
                   largest_cached,
                   logid);
       }
@@ -1322,6 +1358,8 @@ SequenceNumber TopicTailer::DeliverFromCache(const TopicUUID& topic,
       std::unique_ptr<Message> copy(Message::Copy(*data_raw));
       MessageData* d = static_cast<MessageData*>(copy.get());
       d->SetSequenceNumbers(delivered, largest_cached);
+      d->GetTrace()->RecordHop(TraceStage::kTowerCache,
+                               this->stats_.trace_cache_latency);
       delivered = largest_cached + 1;
       on_message_(std::move(copy), recipient);
     }
@@ -1506,4 +1544,11 @@ bool TopicTailer::Forward(std::unique_ptr<Command> command) {
   return storage_to_room_queues_->GetThreadLocal()->Write(command);
 }
 
+bool TopicTailer::TryForward(std::unique_ptr<Command> command) {
+  // Write() buffers the command when the queue is full, which would leave
+  // it owning a record that the storage is about to retry.
+  CommandQueue* queue = storage_to_room_queues_->GetThreadLocal();
+  return queue->FlushPending(true) && queue->TryWrite(command, true);
+}
+
 }  // namespace rocketspeed
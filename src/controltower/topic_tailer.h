@@ -44,6 +44,7 @@ class TopicTailer {
    * @param info_log For logging.
    * @param cache_size_per_room cache size in bytes
    * @param bool cache_data_from_system_namespaces
+   * @param cache_huge_pages Pages backing the cache entries.
    * @param on_message Callback for Deliver and Gap messages.
    * @param tailer Output parameter for created TopicTailer.
    * @return ok() if TopicTailer created, otherwise error.
@@ -57,6 +58,7 @@ class TopicTailer {
     std::shared_ptr<Logger> info_log,
     size_t cache_size_per_room,
     bool cache_data_from_system_namespaces,
+    HugePageMode cache_huge_pages,
     std::function<void(std::unique_ptr<Message>,
                        std::vector<CopilotSub>)> on_message,
     ControlTowerOptions::TopicTailer options,
@@ -121,9 +123,12 @@ class TopicTailer {
     SequenceNumber to,
     size_t reader_id);
 
-  const Statistics& GetStatistics() const {
-    return stats_.all;
-  }
+  /**
+   * Updates memory usage gauges and returns the statistics. Must be called
+   * on the tailer's worker thread.
+   */
+  const Statistics& GetStatistics();
+
   /**
    * Clear the cache
    */
@@ -173,6 +178,7 @@ class TopicTailer {
               std::shared_ptr<Logger> info_log,
               size_t cache_size_per_room,
               bool cache_data_from_system_namespaces,
+              HugePageMode cache_huge_pages,
               std::function<void(std::unique_ptr<Message>,
                                  std::vector<CopilotSub>)> on_message,
               ControlTowerOptions::TopicTailer options);
@@ -182,6 +188,15 @@ class TopicTailer {
 
   bool Forward(std::unique_ptr<Command> command);
 
+  /**
+   * Like Forward, but does not take the command if the queue is full, so
+   * that the caller keeps ownership of anything it captures and can retry.
+   */
+  template <typename Function>
+  bool TryForward(Function command);
+
+  bool TryForward(std::unique_ptr<Command> command);
+
   void AddTailSubscriber(const TopicUUID& topic,
                          CopilotSub id,
                          LogID logid,
@@ -325,6 +340,18 @@ class TopicTailer {
         all.AddCounter(prefix + "remove_subscriber_requests");
       records_served_from_cache =
         all.AddCounter(prefix + "records_served_from_cache");
+      memory_data_cache =
+        all.AddCounter(prefix + "memory.data_cache");
+      memory_topic_manager =
+        all.AddCounter(prefix + "memory.topic_manager");
+      memory_log_readers =
+        all.AddCounter(prefix + "memory.log_readers");
+      memory_subscriptions =
+        all.AddCounter(prefix + "memory.subscriptions");
+      trace_read_latency =
+        all.AddLatency(prefix + "trace.tower_read_us");
+      trace_cache_latency =
+        all.AddLatency(prefix + "trace.tower_cache_us");
     }
 
     Statistics all;
@@ -350,6 +377,15 @@ class TopicTailer {
     Counter* updated_subscriptions;
     Counter* remove_subscriber_requests;
     Counter* records_served_from_cache;
+    // Estimated bytes used by each subsystem, set on GetStatistics.
+    Counter* memory_data_cache;
+    Counter* memory_topic_manager;
+    Counter* memory_log_readers;
+    Counter* memory_subscriptions;
+    // Latencies of sampled messages: from the pilot until read from the log,
+    // and from then until served from the cache.
+    Histogram* trace_read_latency;
+    Histogram* trace_cache_latency;
   } stats_;
 };
 
@@ -359,4 +395,10 @@ bool TopicTailer::Forward(Function command) {
   return Forward(std::move(cmd));
 }
 
+template <typename Function>
+bool TopicTailer::TryForward(Function command) {
+  std::unique_ptr<Command> cmd(MakeExecuteCommand(std::move(command)));
+  return TryForward(std::move(cmd));
+}
+
 }  // namespace rocketspeed
@@ -64,7 +64,9 @@ ControlTower::ControlTower(const ControlTowerOptions& options):
     tower_to_room_queues_.emplace_back(
       options_.msg_loop->CreateWorkerQueues());
     find_latest_seqno_response_queues_.emplace_back(
-      options_.msg_loop->CreateThreadLocalQueues(i));
+      options_.msg_loop->CreateThreadLocalQueues(i,
+                                                 0,
+                                                 CommandPriority::kHigh));
   }
 
   sub_to_room_.resize(options_.msg_loop->GetNumWorkers());
@@ -201,6 +203,7 @@ Status ControlTower::Initialize() {
                                         opt.info_log,
                                         cache_size_per_room,
                                         opt.cache_data_from_system_namespaces,
+                                        opt.cache_huge_pages,
                                         std::move(on_message),
                                         opt.topic_tailer,
                                         &topic_tailer);
@@ -245,27 +248,25 @@ void ControlTower::ProcessSubscribe(std::unique_ptr<Message> msg,
   ControlRoom* room = rooms_[room_number].get();
   int worker_id = options_.msg_loop->GetThreadWorkerIndex();
 
+  // The room may free the message as soon as it is written to the queue, so
+  // everything needed from it must be read before.
+  auto& room_map = sub_to_room_[worker_id];
+  room_map.Insert(origin, subscribe->GetSubID(), room_number);
+  LOG_DEBUG(options_.info_log,
+      "Forwarding subscription for Topic(%s,%s)@%" PRIu64 " to rooms-%u",
+      subscribe->GetNamespace().c_str(),
+      subscribe->GetTopicName().c_str(),
+      subscribe->GetStartSequenceNumber(),
+      room_number);
+
   auto command = room->MsgCommand(std::move(msg), worker_id, origin);
   auto& queue = tower_to_room_queues_[worker_id][room_number];
   if (!queue->Write(command)) {
     LOG_WARN(options_.info_log,
-        "Unable to forward subscription for Topic(%s,%s)@%" PRIu64
-        " to rooms-%u",
-        subscribe->GetNamespace().c_str(),
-        subscribe->GetTopicName().c_str(),
-        subscribe->GetStartSequenceNumber(),
-        room_number);
-  } else {
-    LOG_DEBUG(options_.info_log,
-        "Forwarded subscription for Topic(%s,%s)@%" PRIu64 " to rooms-%u",
-        subscribe->GetNamespace().c_str(),
-        subscribe->GetTopicName().c_str(),
-        subscribe->GetStartSequenceNumber(),
+        "Unable to forward subscription on stream (%llu) to rooms-%u",
+        origin,
         room_number);
   }
-
-  auto& room_map = sub_to_room_[worker_id];
-  room_map.Insert(origin, subscribe->GetSubID(), room_number);
 }
 
 void ControlTower::ProcessUnsubscribe(std::unique_ptr<Message> msg,
@@ -9,6 +9,7 @@
 #include <memory>
 #include <functional>
 #include <limits>
+#include <utility>
 #include <vector>
 
 #include "include/Slice.h"
@@ -38,6 +39,19 @@ class ControlTowerRouter {
    */
   virtual Status GetControlTowers(LogID logID,
                                   std::vector<HostId const*>* out) const = 0;
+
+  /**
+   * Gets the fraction of logs that each control tower is expected to be the
+   * first choice for. Routers that weight towers by capacity should report
+   * shares proportional to the weights.
+   *
+   * @param out Where to place (tower host, share) pairs.
+   * @return on success OK(), NotSupported() if the router cannot tell.
+   */
+  virtual Status GetLoadShares(
+      std::vector<std::pair<HostId, double>>* out) const {
+    return Status::NotSupported("Router does not report load shares");
+  }
 };
 
 }  // namespace rocketspeed
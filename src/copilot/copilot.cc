@@ -408,6 +408,17 @@ std::string Copilot::GetInfoSync(std::vector<std::string> args) {
           worker_id,
           &result);
       return st.ok() ? result : st.ToString();
+    } else if (args[0] == "tower_load_shares" && args.size() == 1) {
+      // tower_load_shares  -- expected share of logs on each tower.
+      std::string result;
+      Status st =
+        options_.msg_loop->WorkerRequestSync(
+          [this] () {
+            return workers_[0]->GetTowerLoadShares();
+          },
+          0,
+          &result);
+      return st.ok() ? result : st.ToString();
     } else if (args[0] == "log_for_topic" && args.size() == 3) {
       // log_for_topic namespace topic_name
       LogID log_id;
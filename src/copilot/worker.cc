@@ -49,7 +49,9 @@ CopilotWorker::CopilotWorker(
   options_.info_log->Flush();
 
   client_queues_ = options_.msg_loop->CreateWorkerQueues();
-  tower_queues_ = options_.msg_loop->CreateWorkerQueues();
+  // Subscriptions and tail lookups to towers are control traffic.
+  tower_queues_ =
+    options_.msg_loop->CreateWorkerQueues(0, CommandPriority::kHigh);
 
   // Create Rollcall topic writer
   if (options_.rollcall_enabled) {
@@ -137,6 +139,10 @@ Statistics CopilotWorker::GetStatistics() {
   }
   stats_.control_tower_sockets->Set(total_sockets);
   stats_.orphaned_topics->Set(active_resubscribe_requests_by_topic_.size());
+  stats_.memory_topics->Set(HeapMemoryUsage(topics_));
+  stats_.memory_client_subscriptions->Set(
+    HeapMemoryUsage(client_subscriptions_));
+  stats_.memory_tower_subscriptions->Set(sub_to_topic_.GetHeapMemoryUsage());
 
   Statistics stats = stats_.all;
   if (options_.rollcall_enabled) {
@@ -148,15 +154,18 @@ Statistics CopilotWorker::GetStatistics() {
 void CopilotWorker::ProcessData(std::unique_ptr<Message> message,
                                 StreamID origin) {
   MessageDeliverData* msg = static_cast<MessageDeliverData*>(message.get());
+  msg->GetTrace()->RecordHop(TraceStage::kCopilotReceive,
+                             stats_.trace_receive_latency);
 
   auto ptr = sub_to_topic_.Find(origin, msg->GetSubID());
   if (!ptr) {
-    LOG_WARN(options_.info_log,
+    LOG_WARN_RATELIMITED(options_.info_log,
       "Deliver for unknown subscription StreamID(%llu) SubID(%" PRIu64 ")",
       origin, msg->GetSubID());
     return;
   }
-  const TopicUUID uuid = *ptr;
+  // Delivering does not change sub_to_topic_, so the UUID need not be copied.
+  const TopicUUID& uuid = *ptr;
 
   // Get the list of subscriptions for this topic.
   LOG_DEBUG(options_.info_log,
@@ -165,7 +174,7 @@ void CopilotWorker::ProcessData(std::unique_ptr<Message> message,
             msg->GetSequenceNumber(),
             uuid.ToString().c_str());
 
-  auto it = topics_.find(uuid);
+  auto it = topics_.find(TopicUUIDKey::Borrow(uuid));
   if (it != topics_.end()) {
     TopicState& topic = it->second;
     const auto seqno = msg->GetSequenceNumber();
@@ -223,8 +232,12 @@ void CopilotWorker::ProcessData(std::unique_ptr<Message> message,
       MessageDeliverData data(sub->tenant_id,
                               sub->sub_id,
                               msg->GetMessageID(),
-                              msg->GetPayload());
+                              msg->GetPayload(),
+                              msg->GetCompression());
       data.SetSequenceNumbers(prev_seqno, seqno);
+      if (msg->GetTrace()->IsSampled()) {
+        *data.GetTrace() = *msg->GetTrace();
+      }
       auto command = options_.msg_loop->ResponseCommand(data, recipient);
       if (client_queues_[sub->worker_id]->Write(command)) {
         sub->seqno = seqno + 1;
@@ -271,7 +284,7 @@ void CopilotWorker::ProcessGap(std::unique_ptr<Message> message,
             msg->GetFirstSequenceNumber(),
             msg->GetLastSequenceNumber(),
             uuid.ToString().c_str());
-  auto it = topics_.find(uuid);
+  auto it = topics_.find(TopicUUIDKey::Borrow(uuid));
   if (it != topics_.end()) {
     TopicState& topic = it->second;
     const auto prev_seqno = msg->GetFirstSequenceNumber();
@@ -372,13 +385,15 @@ void CopilotWorker::ProcessTailSeqno(std::unique_ptr<Message> message,
                                      StreamID origin) {
   MessageTailSeqno* msg = static_cast<MessageTailSeqno*>(message.get());
   // Get the list of subscriptions for this topic.
-  TopicUUID uuid(msg->GetNamespace(), msg->GetTopicName());
+  const auto key =
+    TopicUUIDKey::Borrow(msg->GetNamespace(), msg->GetTopicName());
   LOG_DEBUG(options_.info_log,
             "Copilot received tail senqo %" PRIu64 " for %s",
             msg->GetSequenceNumber(),
-            uuid.ToString().c_str());
-  auto it = topics_.find(uuid);
+            key.ToString().c_str());
+  auto it = topics_.find(key);
   if (it != topics_.end()) {
+    const TopicUUID& uuid = it->first.uuid();
     TopicState& topic = it->second;
     const auto next_seqno = msg->GetSequenceNumber();
 
@@ -456,9 +471,9 @@ void CopilotWorker::ProcessSubscribe(const TenantID tenant_id,
       .emplace(sub_id, TopicInfo{topic_name, namespace_id, logid});
 
   // Find/insert topic state.
-  auto topic_iter = topics_.find(uuid);
+  auto topic_iter = topics_.find(TopicUUIDKey::Borrow(uuid));
   if (topic_iter == topics_.end()) {
-    topic_iter = topics_.emplace(uuid, TopicState(logid)).first;
+    topic_iter = topics_.emplace(TopicUUIDKey(uuid), TopicState(logid)).first;
   }
   TopicState& topic = topic_iter->second;
 
@@ -535,7 +550,7 @@ void CopilotWorker::RemoveSubscription(const TenantID tenant_id,
   }
 
   TopicUUID uuid(namespace_id, topic_name);
-  auto topic_iter = topics_.find(uuid);
+  auto topic_iter = topics_.find(TopicUUIDKey::Borrow(uuid));
   if (topic_iter != topics_.end()) {
     // Find our subscription and remove it.
     TopicState& topic = topic_iter->second;
@@ -638,7 +653,8 @@ void CopilotWorker::ProcessTimerTick() {
   uint64_t count = resubscriptions_per_tick_;
   while (count-- && HasActiveResubscribeRequests()) {
     SafeResubscribeRequest resubscribe_request = PopNextResubscribeRequest();
-    auto topic_it = topics_.find(resubscribe_request->topic_uuid);
+    auto topic_it =
+      topics_.find(TopicUUIDKey::Borrow(resubscribe_request->topic_uuid));
     bool topic_valid = topic_it != topics_.end();
     assert(topic_valid);
     if (topic_valid) {
@@ -657,13 +673,14 @@ void CopilotWorker::ProcessTimerTick() {
 
   // Get a list of topics/tower subscriptions that are due a check up.
   std::vector<TopicUUID> updates;
+  const auto now = Now();
   topic_checkup_list_.GetExpired(
     options_.tower_subscriptions_check_period,
     std::back_inserter(updates),
     static_cast<int>(rebalances_per_tick_));
 
   for (TopicUUID& uuid : updates) {
-    auto it = topics_.find(uuid);
+    auto it = topics_.find(TopicUUIDKey::Borrow(uuid));
     if (it != topics_.end()) {
       if (!CorrectTopicTowers(it->second)) {
         // Remove subscriptions and resubscribe to correct towers.
@@ -672,7 +689,7 @@ void CopilotWorker::ProcessTimerTick() {
         stats_.tower_rebalances_performed->Add(1);
       }
       // Put back in the list to check again later.
-      topic_checkup_list_.Add(std::move(uuid));
+      topic_checkup_list_.Add(std::move(uuid), now);
     }
   }
   stats_.tower_rebalances_checked->Add(updates.size());
@@ -683,7 +700,7 @@ void CopilotWorker::CloseControlTowerStream(StreamID stream) {
 
   // Removes upstream connection for affected subscriptions.
   for (auto& uuid_topic : topics_) {
-    const TopicUUID& uuid = uuid_topic.first;
+    const TopicUUID& uuid = uuid_topic.first.uuid();
     TopicState& topic = uuid_topic.second;
     for (auto it = topic.towers.begin(); it != topic.towers.end(); ) {
       if (it->stream->GetStreamID() == stream) {
@@ -959,7 +976,7 @@ void CopilotWorker::UpdateTowerSubscriptions(
     if (resub_needed) {
       // We successfully resubscribed to all towers, so add to checkup list
       // (or push to the back of the queue, since subscriptions are up to date).
-      topic_checkup_list_.Add(uuid);
+      topic_checkup_list_.Add(uuid, Now());
     }
   }
 }
@@ -1110,12 +1127,28 @@ std::string CopilotWorker::GetTowersForLog(LogID log_id) const {
   return result;
 }
 
+std::string CopilotWorker::GetTowerLoadShares() const {
+  std::vector<std::pair<HostId, double>> shares;
+  Status st = control_tower_router_->GetLoadShares(&shares);
+  if (!st.ok()) {
+    return st.ToString();
+  }
+  std::string result;
+  for (const auto& share : shares) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), ": %.4f\n", share.second);
+    result += share.first.ToString();
+    result += buffer;
+  }
+  return result;
+}
+
 std::string CopilotWorker::GetSubscriptionInfo(std::string filter,
                                                int max) const {
   std::string result;
   for (const auto& entry : topics_) {
     char buffer[4096];
-    const TopicUUID& topic = entry.first;
+    const TopicUUID& topic = entry.first.uuid();
     const TopicState& state = entry.second;
     std::string topic_name = topic.ToString();
     if (!strstr(topic_name.c_str(), filter.c_str())) {
@@ -20,6 +20,7 @@
 #include "src/messages/stream_socket.h"
 #include "src/util/common/hash.h"
 #include "src/util/common/linked_map.h"
+#include "src/util/common/memory_usage.h"
 #include "src/util/subscription_map.h"
 #include "src/util/storage.h"
 #include "src/util/timeout_list.h"
@@ -71,6 +72,12 @@ class CopilotWorker {
    */
   std::string GetTowersForLog(LogID log_id) const;
 
+  /**
+   * Returns human-readable info on the expected share of logs routed to
+   * each control tower.
+   */
+  std::string GetTowerLoadShares() const;
+
   /**
    * Returns human-readable info about all subscriptions.
    *
@@ -106,6 +113,8 @@ class CopilotWorker {
   }
 
  private:
+  friend class CopilotWorkerBench;
+
   struct Subscription;
   struct TopicState;
 
@@ -143,6 +152,14 @@ class CopilotWorker {
         all.AddCounter("copilot.tower_rebalances_checked");
       tower_rebalances_performed =
         all.AddCounter("copilot.tower_rebalances_performed");
+      memory_topics =
+        all.AddCounter("copilot.memory.topics");
+      memory_client_subscriptions =
+        all.AddCounter("copilot.memory.client_subscriptions");
+      memory_tower_subscriptions =
+        all.AddCounter("copilot.memory.tower_subscriptions");
+      trace_receive_latency =
+        all.AddLatency("copilot.trace.copilot_receive_us");
     }
 
     Statistics all;
@@ -163,6 +180,12 @@ class CopilotWorker {
     Counter* orphaned_resubscribes;
     Counter* tower_rebalances_checked;
     Counter* tower_rebalances_performed;
+    // Estimated bytes used by subscription state, set on GetStatistics.
+    Counter* memory_topics;
+    Counter* memory_client_subscriptions;
+    Counter* memory_tower_subscriptions;
+    // Latency of sampled messages from the tower to this worker.
+    Histogram* trace_receive_latency;
   } stats_;
 
   // Add a subscriber to a topic.
@@ -256,6 +279,11 @@ class CopilotWorker {
    */
   Status GetControlTowers(LogID log_id, std::vector<HostId const*>* out) const;
 
+  // Time cached by this worker's EventLoop for the current callback.
+  std::chrono::steady_clock::time_point Now() const {
+    return options_.msg_loop->GetEventLoop(myid_)->GetCachedTime();
+  }
+
   // Copilot specific options.
   const CopilotOptions& options_;
 
@@ -325,6 +353,10 @@ class CopilotWorker {
     Towers towers; // Tower subscriptions.
     uint32_t records_sent = 0;
     uint32_t gaps_sent = 0;
+
+    size_t GetHeapMemoryUsage() const {
+      return HeapMemoryUsage(subscriptions) + HeapMemoryUsage(towers);
+    }
   };
 
   bool CorrectTopicTowers(TopicState& topic);
@@ -335,13 +367,17 @@ class CopilotWorker {
   void UnsubscribeControlTowers(const TopicUUID& topic_uuid, TopicState& topic);
 
   // State of subscriptions for a single topic.
-  std::unordered_map<TopicUUID, TopicState> topics_;
+  TopicUUIDMap<TopicState> topics_;
 
   // Map of client to topics subscribed to.
   struct TopicInfo {
     Topic topic_name;
     NamespaceID namespace_id;
     LogID logid;
+
+    size_t GetHeapMemoryUsage() const {
+      return HeapMemoryUsage(topic_name) + HeapMemoryUsage(namespace_id);
+    }
   };
 
   using ClientSubscriptions =
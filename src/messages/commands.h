@@ -13,6 +13,7 @@
 #include "src/messages/messages.h"
 #include "src/messages/stream_socket.h"
 #include "src/util/common/autovector.h"
+#include "src/util/common/block_pool.h"
 #include "src/util/common/host_id.h"
 
 namespace rocketspeed {
@@ -24,6 +25,15 @@ enum CommandType : uint8_t {
   kExecuteCommand = 0x03,
 };
 
+/**
+ * Lane in which an EventLoop processes a command. High priority commands are
+ * dispatched, and their messages written to sockets, ahead of normal ones.
+ */
+enum class CommandPriority : uint8_t {
+  kNormal,
+  kHigh,
+};
+
 /**
  * Interface class for sending messages from any thread to the event loop for
  * processing on the event loop thread.
@@ -36,6 +46,23 @@ class Command {
 
   /** Get type of the command. */
   virtual CommandType GetCommandType() const = 0;
+
+  /** Get the lane of the command. */
+  virtual CommandPriority GetPriority() const {
+    return CommandPriority::kNormal;
+  }
+
+  /**
+   * Commands are usually freed by the event loop they were sent to, and go
+   * back to the pool of the thread that allocated them.
+   */
+  static void* operator new(size_t size) {
+    return BlockPool::Allocate(size);
+  }
+
+  static void operator delete(void* ptr) {
+    BlockPool::Free(ptr);
+  }
 };
 
 /**
@@ -64,13 +91,16 @@ class SendCommand : public Command {
   /** Denotes streams that this message shall be sent to. */
   typedef autovector<StreamID, 1> StreamList;
 
-  explicit SendCommand(Recipients recipients)
-      : recipients_(std::move(recipients)) {}
+  explicit SendCommand(Recipients recipients,
+                       CommandPriority priority = CommandPriority::kNormal)
+      : recipients_(std::move(recipients)), priority_(priority) {}
 
   virtual ~SendCommand() {}
 
   CommandType GetCommandType() const { return kSendCommand; }
 
+  CommandPriority GetPriority() const override { return priority_; }
+
   /**
    * Writes a serialised form of a message to provided string.
    * Depending on implementation, this call might perform a move of message
@@ -86,9 +116,13 @@ class SendCommand : public Command {
 
  private:
   Recipients recipients_;
+  CommandPriority priority_;
 };
 
-/** SendCommand where message is passed in a serialized form. */
+/**
+ * SendCommand where message is passed in a serialized form.
+ * Control messages are sent with high priority.
+ */
 class SerializedSendCommand : public SendCommand {
  public:
   static std::unique_ptr<SerializedSendCommand> Request(
@@ -123,9 +157,18 @@ class SerializedSendCommand : public SendCommand {
   // Hiding, as it's not super convenient to work with this class without
   // std::make_unique.
   SerializedSendCommand(std::string message, Recipients recipients)
-      : SendCommand(std::move(recipients)), message_(std::move(message)) {
+      : SendCommand(std::move(recipients), PriorityOf(message))
+      , message_(std::move(message)) {
     assert(message_.size() > 0);
   }
+
+  // Serialized messages start with their type.
+  static CommandPriority PriorityOf(const std::string& message) {
+    return !message.empty() &&
+           IsControlMessage(static_cast<MessageType>(message[0])) ?
+      CommandPriority::kHigh : CommandPriority::kNormal;
+  }
+
   // Buffer with the message. It's content is moved away on first attempt to get
   // serialized message.
   std::string message_;
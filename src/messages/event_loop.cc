@@ -7,7 +7,9 @@
 #include "event_loop.h"
 
 #include <limits.h>
+#include <errno.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
 #include <netinet/in.h>
 #include <deque>
@@ -27,10 +29,13 @@
 #include "external/folly/move_wrapper.h"
 
 #include "src/port/port.h"
+#include "src/messages/loopback.h"
 #include "src/messages/queues.h"
 #include "src/messages/serializer.h"
+#include "src/messages/simulated_network.h"
 #include "src/messages/stream_socket.h"
 #include "src/util/common/coding.h"
+#include "src/util/common/parsing.h"
 
 static_assert(std::is_same<evutil_socket_t, int>::value,
   "EventLoop assumes evutil_socket_t is int.");
@@ -50,6 +55,41 @@ const int EventLoop::kLogSeverityErr = _EVENT_LOG_ERR;
  */
 static const size_t kMaxIovecs = 256;
 
+/**
+ * Checks whether a server is accepting on a Unix socket, by connecting to it.
+ *
+ * @param address Address of the socket.
+ * @param live Set to true if a server is accepting, or false if the socket
+ *             is left over from a process that exited.
+ * @return Error if the probe failed for another reason.
+ */
+static Status ProbeUnixSocket(const HostId& address, bool* live) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK)) {
+    const int socket_errno = errno;
+    if (fd != -1) {
+      close(fd);
+    }
+    return Status::IOError("Cannot probe unix socket " + address.ToString() +
+                           ": " + std::to_string(socket_errno));
+  }
+  int result = connect(fd, address.GetSockaddr(),
+                       static_cast<socklen_t>(address.GetSocklen()));
+  int connect_errno = errno;
+  close(fd);
+  if (result == 0 || connect_errno == EAGAIN) {
+    // Accepted, or the server's backlog is full: either way it is alive.
+    *live = true;
+    return Status::OK();
+  }
+  if (connect_errno == ECONNREFUSED || connect_errno == ENOENT) {
+    *live = false;
+    return Status::OK();
+  }
+  return Status::IOError("Cannot probe unix socket " + address.ToString() +
+                         ": " + std::to_string(connect_errno));
+}
+
 struct MessageHeader {
   /**
    * Attempts to parse slice into a MessageHeader.
@@ -89,6 +129,8 @@ struct MessageHeader {
 struct TimestampedString {
   std::string string;
   uint64_t issued_time;
+  // On frame headers, whether the frame was queued ahead of data frames.
+  bool high_priority = false;
 };
 
 class SocketEvent {
@@ -125,6 +167,29 @@ class SocketEvent {
     return sev;
   }
 
+  /**
+   * Creates a connection to another EventLoop in this process.
+   *
+   * @param event_loop The EventLoop owning the connection.
+   * @param endpoint This end of the connection.
+   * @param destination The remote host if this end initiated the connection,
+   *                    empty if it was accepted.
+   */
+  static std::unique_ptr<SocketEvent> CreateLoopback(
+      EventLoop* event_loop,
+      LoopbackTransport::Endpoint endpoint,
+      HostId destination) {
+    std::unique_ptr<SocketEvent> sev(
+      new SocketEvent(event_loop, std::move(endpoint), !!destination));
+    if (!sev->read_ev_) {
+      LOG_ERROR(event_loop->GetLog(), "Failed to create loopback event");
+      return nullptr;
+    }
+    sev->read_ev_->Enable();
+    sev->destination_ = std::move(destination);
+    return sev;
+  }
+
   ~SocketEvent() {
     event_loop_->thread_check_.Check();
     LOG_INFO(event_loop_->GetLog(),
@@ -133,28 +198,154 @@ class SocketEvent {
     event_loop_->GetLog()->Flush();
     read_ev_.reset();
     write_ev_.reset();
-    close(fd_);
+    if (write_delayed_) {
+      event_loop_->CancelDelayedWrites(this, arrival_times_.front());
+    }
+    if (loopback_.in) {
+      // The other end reads the remaining frames, then disconnects.
+      loopback_.in->Close();
+      loopback_.out->Close();
+    } else {
+      close(fd_);
+    }
+    event_loop_->send_queue_bytes_ -= send_queue_bytes_;
+  }
+
+  /**
+   * Carries data over a simulated link instead of writing it straight away.
+   * Must be set before anything is enqueued.
+   */
+  void SetLink(std::shared_ptr<SimulatedLink> link) {
+    assert(send_queue_.empty());
+    link_ = std::move(link);
+  }
+
+  /**
+   * Schedules a frame on the simulated link.
+   *
+   * @param bytes Size of the frame.
+   * @return Time the frame may be written, for Enqueue.
+   */
+  std::chrono::steady_clock::time_point ScheduleFrame(size_t bytes) {
+    if (!link_) {
+      return std::chrono::steady_clock::time_point();
+    }
+    return link_->Schedule(bytes, event_loop_->GetCachedTime());
   }
 
-  // One message to be sent out.
-  Status Enqueue(std::shared_ptr<TimestampedString> msg) {
+  /**
+   * One frame to be sent out, once arrival time is reached.
+   *
+   * High priority frames are queued ahead of data frames that have not
+   * started to go out, unless a frame on the same stream is among them, or
+   * the connection is on a simulated link, which delivers in order.
+   *
+   * @param hdr The message header.
+   * @param destinations The encoded stream.
+   * @param msg The serialized message.
+   * @param local The stream, local to the connection.
+   * @param high_priority Whether the message is a control message.
+   * @param arrival From ScheduleFrame.
+   */
+  Status Enqueue(std::shared_ptr<TimestampedString> hdr,
+                 std::shared_ptr<TimestampedString> destinations,
+                 std::shared_ptr<TimestampedString> msg,
+                 StreamID local,
+                 bool high_priority,
+                 std::chrono::steady_clock::time_point arrival) {
     event_loop_->thread_check_.Check();
 
-    send_queue_.emplace_back(std::move(msg));
+    const size_t bytes =
+      hdr->string.size() + destinations->string.size() + msg->string.size();
+    send_queue_bytes_ += bytes;
+    event_loop_->send_queue_bytes_ += bytes;
+
+    auto data_frame = data_frames_.find(local);
+    if (high_priority &&
+        !link_ &&
+        (data_frame == data_frames_.end() ||
+         data_frame->second <= data_frames_started_)) {
+      // Insert after the frame being written and earlier high priority ones.
+      const size_t first_frame_left =
+        send_queue_.empty() ? 0 : kFrameParts - front_parts_written_;
+      const size_t pos = std::max(first_frame_left, high_priority_end_);
+      hdr->high_priority = true;
+      auto it = send_queue_.begin() + pos;
+      it = send_queue_.insert(it, std::move(hdr)) + 1;
+      it = send_queue_.insert(it, std::move(destinations)) + 1;
+      send_queue_.insert(it, std::move(msg));
+      high_priority_end_ = pos + kFrameParts;
+      event_loop_->stats_.high_priority_frames->Add(1);
+    } else {
+      // Later control frames on this stream must stay behind this one. The
+      // first frame is never overtaken, so it need not be tracked.
+      const uint64_t frame = ++data_frames_queued_;
+      if (data_frame != data_frames_.end()) {
+        data_frame->second = frame;
+      } else if (!send_queue_.empty()) {
+        data_frames_.emplace(local, frame);
+      }
+      send_queue_.emplace_back(std::move(hdr));
+      send_queue_.emplace_back(std::move(destinations));
+      send_queue_.emplace_back(std::move(msg));
+      if (link_) {
+        arrival_times_.insert(arrival_times_.end(), kFrameParts, arrival);
+      }
+    }
 
     // If the write-ready event is not currently registered, add a write
     // event and wait until its ready.
-    if (!write_ev_added_) {
+    if (!write_ev_added_ && !write_delayed_) {
       write_ev_->Enable();
       write_ev_added_ = true;
     }
     return Status::OK();
   }
 
+  /** @return true iff this is a connection within the process. */
+  bool IsLoopback() const {
+    return !!loopback_.out;
+  }
+
+  /**
+   * Hands a message to the other end of a loopback connection.
+   *
+   * @param local The stream on this connection.
+   * @param msg The serialized message.
+   * @return Error if the other end has closed.
+   */
+  Status SendLoopback(StreamID local, const std::string& msg) {
+    event_loop_->thread_check_.Check();
+    assert(IsLoopback());
+
+    std::string origin;
+    EncodeOrigin(&origin, local);
+    LoopbackFrame frame;
+    frame.size = origin.size() + msg.size();
+    frame.data = AllocatePooledBuffer(frame.size);
+    memcpy(frame.data.get(), origin.data(), origin.size());
+    memcpy(frame.data.get() + origin.size(), msg.data(), msg.size());
+    if (!loopback_.out->Write(std::move(frame))) {
+      return Status::IOError("Loopback connection closed");
+    }
+    event_loop_->stats_.loopback_frames->Add(1);
+    return Status::OK();
+  }
+
   const HostId& GetDestination() const {
     return destination_;
   }
 
+  // Called by the EventLoop when the next frame on the link has arrived.
+  void ResumeWrites() {
+    assert(write_delayed_);
+    write_delayed_ = false;
+    if (!write_ev_added_) {
+      write_ev_->Enable();
+      write_ev_added_ = true;
+    }
+  }
+
   std::list<std::unique_ptr<SocketEvent>>::iterator GetListHandle() const {
     return list_handle_;
   }
@@ -201,7 +392,8 @@ class SocketEvent {
   , event_loop_(event_loop)
   , write_ev_added_(false)
   , was_initiated_(initiated)
-  , timeout_cancelled_(false) {
+  , timeout_cancelled_(false)
+  , write_delayed_(false) {
     // Can only add events from the event loop thread.
     event_loop->thread_check_.Check();
 
@@ -229,12 +421,98 @@ class SocketEvent {
       });
   }
 
+  SocketEvent(EventLoop* event_loop,
+              LoopbackTransport::Endpoint endpoint,
+              bool initiated)
+  : hdr_idx_(0)
+  , msg_idx_(0)
+  , msg_size_(0)
+  , fd_(-1)
+  , event_loop_(event_loop)
+  , write_ev_added_(false)
+  , was_initiated_(initiated)
+  , timeout_cancelled_(true)
+  , write_delayed_(false)
+  , loopback_(std::move(endpoint)) {
+    event_loop->thread_check_.Check();
+
+    // Frames are handed over whole, so there is no write event to wait for.
+    read_ev_ = EventCallback::CreateFdReadCallback(
+      event_loop,
+      loopback_.in->GetReadFd(),
+      [this] () {
+        if (!LoopbackReadCallback().ok()) {
+          Disconnect(this, false);
+        } else {
+          ProcessHeartbeats();
+        }
+      });
+  }
+
+  /**
+   * @return Number of queued messages that can be written now, at most
+   *         kMaxIovecs.
+   */
+  size_t ReadyToWrite() const {
+    if (!link_) {
+      return std::min(kMaxIovecs, send_queue_.size());
+    }
+    const auto now = event_loop_->GetCachedTime();
+    size_t ready = 0;
+    while (ready < kMaxIovecs &&
+           ready < arrival_times_.size() &&
+           arrival_times_[ready] <= now) {
+      ++ready;
+    }
+    return ready;
+  }
+
+  // Stops writing until the next message arrives over the simulated link.
+  void DelayWrites() {
+    assert(link_ && !arrival_times_.empty());
+    if (write_ev_added_) {
+      write_ev_->Disable();
+      write_ev_added_ = false;
+    }
+    write_delayed_ = true;
+    event_loop_->DelayWrites(this, arrival_times_.front());
+  }
+
+  // Removes the first part of a frame that has been written.
+  void PopFront(uint64_t latency) {
+    if (front_parts_written_ == 0) {
+      // Frame header.
+      front_high_priority_ = send_queue_.front()->high_priority;
+      if (!front_high_priority_) {
+        ++data_frames_started_;
+      }
+    }
+    if (++front_parts_written_ == kFrameParts) {
+      front_parts_written_ = 0;
+      if (front_high_priority_) {
+        event_loop_->stats_.write_latency_high_priority->Record(latency);
+      }
+    }
+    send_queue_.pop_front();
+    if (link_) {
+      arrival_times_.pop_front();
+    }
+    if (high_priority_end_ > 0) {
+      --high_priority_end_;
+    }
+    if (send_queue_.empty() && !data_frames_.empty()) {
+      // All data frames have started.
+      data_frames_.clear();
+    }
+  }
+
   void ProcessHeartbeats() {
     if (event_loop_->heartbeat_enabled_) {
       event_loop_->heartbeat_.ProcessExpired(
         event_loop_->heartbeat_timeout_,
         event_loop_->heartbeat_expired_callback_,
-        event_loop_->heartbeat_expire_batch_);
+        event_loop_->heartbeat_expire_batch_,
+        event_loop_->GetCachedTime());
     }
   }
 
@@ -257,6 +535,13 @@ class SocketEvent {
            event_loop_->stats_.write_succeed_iovec->GetNumSamples());
 
     while (send_queue_.size() > 0) {
+      // Messages on a simulated link are held back until they arrive.
+      const size_t ready = ReadyToWrite();
+      if (ready == 0) {
+        DelayWrites();
+        return Status::OK();
+      }
+
       // if there is any pending data from the previously sent
       // partial-message, then send it.
       if (partial_.size() > 0) {
@@ -265,7 +550,7 @@ class SocketEvent {
         // Prepare iovecs.
         iovec iov[kMaxIovecs];
         int iovcnt = 0;
-        int limit = static_cast<int>(std::min(kMaxIovecs, send_queue_.size()));
+        int limit = static_cast<int>(ready);
         size_t total = 0;
         for (; iovcnt < limit; ++iovcnt) {
           Slice v(iovcnt != 0 ? Slice(send_queue_[iovcnt]->string) : partial_);
@@ -319,9 +604,12 @@ class SocketEvent {
             event_loop_->stats_.write_succeed_iovec->Record(i);
             return Status::OK();
           }
-          event_loop_->stats_.write_latency->Record(
-            event_loop_->env_->NowMicros() - item->issued_time);
-          send_queue_.pop_front();
+          const uint64_t latency =
+            event_loop_->GetCachedTimeMicros() - item->issued_time;
+          event_loop_->stats_.write_latency->Record(latency);
+          send_queue_bytes_ -= item->string.size();
+          event_loop_->send_queue_bytes_ -= item->string.size();
+          PopFront(latency);
         }
         event_loop_->stats_.write_succeed_iovec->Record(iovcnt);
         assert(written == 0);
@@ -383,7 +671,7 @@ class SocketEvent {
           return st;
         }
         msg_size_ = hdr.size;
-        msg_buf_.reset(new char[msg_size_]);
+        msg_buf_ = AllocatePooledBuffer(msg_size_);
         msg_idx_ = 0;
       }
       assert(msg_idx_ < msg_size_);
@@ -410,90 +698,115 @@ class SocketEvent {
       hdr_idx_ = 0;
       msg_idx_ = 0;
       // No reader state modification shall happen after this point.
+      ProcessFrame(std::move(msg_buf_), msg_size_);
+    }
+    return Status::OK();
+  }
 
-      // Process received message.
-      Slice in(msg_buf_.get(), msg_size_);
-
-      // Decode the recipients.
-      StreamID local = 0;
-      if (!DecodeOrigin(&in, &local)) {
-        continue;
+  Status LoopbackReadCallback() {
+    event_loop_->thread_check_.Check();
+    loopback_.in->ClearReadEvent();
+    // As with sockets, read no more than 1MB to give others a chance.
+    size_t total_read = 0;
+    while (total_read < 1024 * 1024) {
+      LoopbackFrame frame;
+      bool closed;
+      if (!loopback_.in->Read(&frame, &closed)) {
+        return closed ? Status::IOError("Loopback connection closed") :
+                        Status::OK();
       }
+      total_read += frame.size;
+      ProcessFrame(std::move(frame.data), frame.size);
+    }
+    // There may be more to read.
+    loopback_.in->NotifyReader();
+    return Status::OK();
+  }
 
-      // Decode the rest of the message.
-      std::unique_ptr<Message> msg =
-          Message::CreateNewInstance(std::move(msg_buf_), in);
-      if (!msg) {
-        LOG_WARN(event_loop_->GetLog(), "Failed to decode message");
-        continue;
-      }
+  /**
+   * Decodes and dispatches one received frame, without the message header.
+   */
+  void ProcessFrame(PooledBuffer buf, size_t size) {
+    Slice in(buf.get(), size);
 
-      // We need to remap stream ID local to the connection into globally
-      // (within MsgLoop) unique stream ID.
-      StreamID global;
-      // We do not allow incoming streams on outgoing connections.
-      const bool do_insert = !was_initiated_;
-      // If this is a response on a stream initiated by this message loop, we
-      // will have the proper stream ID in a map, otherwise this is a request
-      // from the remote host and we have to remap stream ID.
-      auto remap = event_loop_->stream_router_.RemapInboundStream(
-          this, local, do_insert, &global);
-
-      // Proceed with a message only if remapping succeeded.
-      if (remap == StreamRouter::RemapStatus::kNotInserted) {
-        LOG_WARN(event_loop_->GetLog(),
-                 "Failed to remap stream ID (%llu)",
-                 local);
-        continue;
-      }
+    // Decode the recipients.
+    StreamID local = 0;
+    if (!DecodeOrigin(&in, &local)) {
+      return;
+    }
 
-      // Log a new inbound stream.
-      if (remap == StreamRouter::RemapStatus::kInserted) {
-        LOG_INFO(event_loop_->GetLog(),
-                 "New stream (%llu) was associated with socket fd(%d)",
-                 global,
-                 fd_);
-      }
+    // Decode the rest of the message.
+    std::unique_ptr<Message> msg =
+        Message::CreateNewInstance(std::move(buf), in);
+    if (!msg) {
+      LOG_WARN(event_loop_->GetLog(), "Failed to decode message");
+      return;
+    }
 
-      if (do_insert && event_loop_->heartbeat_enabled_) {
-        event_loop_->heartbeat_.Add(global);
-      }
+    // We need to remap stream ID local to the connection into globally
+    // (within MsgLoop) unique stream ID.
+    StreamID global;
+    // We do not allow incoming streams on outgoing connections.
+    const bool do_insert = !was_initiated_;
+    // If this is a response on a stream initiated by this message loop, we
+    // will have the proper stream ID in a map, otherwise this is a request
+    // from the remote host and we have to remap stream ID.
+    auto remap = event_loop_->stream_router_.RemapInboundStream(
+        this, local, do_insert, &global);
+
+    // Proceed with a message only if remapping succeeded.
+    if (remap == StreamRouter::RemapStatus::kNotInserted) {
+      LOG_WARN(event_loop_->GetLog(),
+               "Failed to remap stream ID (%llu)",
+               local);
+      return;
+    }
+
+    // Log a new inbound stream.
+    if (remap == StreamRouter::RemapStatus::kInserted) {
+      LOG_INFO(event_loop_->GetLog(),
+               "New stream (%llu) was associated with socket fd(%d)",
+               global,
+               fd_);
+    }
+
+    if (do_insert && event_loop_->heartbeat_enabled_) {
+      event_loop_->heartbeat_.Add(global, event_loop_->GetCachedTime());
+    }
 
-      const MessageType msg_type = msg->GetMessageType();
-      if (msg_type == MessageType::mGoodbye) {
-        MessageGoodbye* goodbye = static_cast<MessageGoodbye*>(msg.get());
+    const MessageType msg_type = msg->GetMessageType();
+    if (msg_type == MessageType::mGoodbye) {
+      MessageGoodbye* goodbye = static_cast<MessageGoodbye*>(msg.get());
+      LOG_INFO(event_loop_->GetLog(),
+               "Received goodbye message (code %d) for stream (%llu)",
+               static_cast<int>(goodbye->GetCode()),
+               global);
+      // Update stream router.
+      StreamRouter::RemovalStatus removed;
+      SocketEvent* sev;
+      std::tie(removed, sev, std::ignore) =
+          event_loop_->stream_router_.RemoveStream(global);
+      assert(StreamRouter::RemovalStatus::kNotRemoved != removed);
+      if (sev) {
+        assert(sev == this);
         LOG_INFO(event_loop_->GetLog(),
-                 "Received goodbye message (code %d) for stream (%llu)",
-                 static_cast<int>(goodbye->GetCode()),
-                 global);
-        // Update stream router.
-        StreamRouter::RemovalStatus removed;
-        SocketEvent* sev;
-        std::tie(removed, sev, std::ignore) =
-            event_loop_->stream_router_.RemoveStream(global);
-        assert(StreamRouter::RemovalStatus::kNotRemoved != removed);
-        if (sev) {
-          assert(sev == this);
-          LOG_INFO(event_loop_->GetLog(),
-                   "Socket fd(%d) has no more streams on it.",
-                   sev->fd_);
-        }
+                 "Socket fd(%d) has no more streams on it.",
+                 sev->fd_);
       }
+    }
 
-      assert(ValidateEnum(msg_type));
-      event_loop_->stats_.messages_received[size_t(msg_type)]->Add(1);
+    assert(ValidateEnum(msg_type));
+    event_loop_->stats_.messages_received[size_t(msg_type)]->Add(1);
 
-      // Invoke the callback for this message.
-      event_loop_->Dispatch(std::move(msg), global);
-    }
-    return Status::OK();
+    // Invoke the callback for this message.
+    event_loop_->Dispatch(std::move(msg), global);
   }
 
   size_t hdr_idx_;
   char hdr_buf_[MessageHeader::encoding_size];
   size_t msg_idx_;
   size_t msg_size_;
-  std::unique_ptr<char[]> msg_buf_;  // receive buffer
+  PooledBuffer msg_buf_;             // receive buffer
   evutil_socket_t fd_;
   std::unique_ptr<EventCallback> read_ev_;
   std::unique_ptr<EventCallback> write_ev_;
@@ -501,6 +814,7 @@ class SocketEvent {
   bool write_ev_added_;    // is the write event added?
   bool was_initiated_;   // was this connection initiated by us?
   bool timeout_cancelled_;   // have we removed from EventLoop connect_timeout_?
+  bool write_delayed_;   // waiting for the next message to arrive on link_?
 
   /**
    * A remote destination, if non-empty the socket can be reused by anyone, who
@@ -515,8 +829,35 @@ class SocketEvent {
   // partial_ records the next valid offset in the earliest message.
   std::deque<std::shared_ptr<TimestampedString>> send_queue_;
   Slice partial_;
+
+  // Simulated link the data is sent over, if any, and the arrival time of
+  // each message in send_queue_.
+  std::shared_ptr<SimulatedLink> link_;
+  std::deque<std::chrono::steady_clock::time_point> arrival_times_;
+
+  // Channels of a connection within the process, used instead of fd_.
+  LoopbackTransport::Endpoint loopback_;
+
+  // Total size of the messages in send_queue_.
+  size_t send_queue_bytes_ = 0;
+
+  // Each frame is queued as header, destinations and message.
+  static constexpr size_t kFrameParts = 3;
+  // Parts of the first frame in send_queue_ that have been written.
+  size_t front_parts_written_ = 0;
+  // Whether the first frame in send_queue_ is high priority.
+  bool front_high_priority_ = false;
+  // End of the high priority frames queued ahead of data frames.
+  size_t high_priority_end_ = 0;
+  // Data frames queued and started so far, and the last one queued on each
+  // stream, so that control frames do not overtake data on their stream.
+  uint64_t data_frames_queued_ = 0;
+  uint64_t data_frames_started_ = 0;
+  std::unordered_map<StreamID, uint64_t> data_frames_;
 };
 
+constexpr size_t SocketEvent::kFrameParts;
+
 class AcceptCommand : public Command {
  public:
   explicit AcceptCommand(int fd)
@@ -648,7 +989,9 @@ void EventLoop::HandleSendCommand(std::unique_ptr<Command> command) {
   using rocketspeed::SendCommand;
   SendCommand* send_cmd = static_cast<SendCommand*>(command.get());
 
-  auto now = env_->NowMicros();
+  auto now = GetCachedTimeMicros();
+  const bool high_priority =
+    send_cmd->GetPriority() == CommandPriority::kHigh;
   auto msg = std::make_shared<TimestampedString>();
   send_cmd->GetMessage(&msg->string);
   msg->issued_time = now;
@@ -672,26 +1015,32 @@ void EventLoop::HandleSendCommand(std::unique_ptr<Command> command) {
                   local);
       }
 
-      // Enqueue data to SocketEvent queue. This message will be sent out
-      // when the output socket is ready to write.
-      auto destinations = std::make_shared<TimestampedString>();
-      EncodeOrigin(&destinations->string, local);
-      destinations->issued_time = now;
-
-      size_t frame_size = destinations->string.size() + msg->string.size();
-      MessageHeader header { ROCKETSPEED_CURRENT_MSG_VERSION,
-                             static_cast<uint32_t>(frame_size) };
-      auto hdr = std::make_shared<TimestampedString>();
-      hdr->string = header.ToString();
-      hdr->issued_time = now;
-
-      // Add message header, destinations, and contents.
-      st = sev->Enqueue(std::move(hdr));
-      if (st.ok()) {
-        st = sev->Enqueue(std::move(destinations));
-      }
-      if (st.ok()) {
-        st = sev->Enqueue(msg);
+      if (sev->IsLoopback()) {
+        // No framing needed, nor queueing behind a socket.
+        st = sev->SendLoopback(local, msg->string);
+      } else {
+        // Enqueue data to SocketEvent queue. This message will be sent out
+        // when the output socket is ready to write.
+        auto destinations = std::make_shared<TimestampedString>();
+        EncodeOrigin(&destinations->string, local);
+        destinations->issued_time = now;
+
+        size_t frame_size = destinations->string.size() + msg->string.size();
+        MessageHeader header { ROCKETSPEED_CURRENT_MSG_VERSION,
+                               static_cast<uint32_t>(frame_size) };
+        auto hdr = std::make_shared<TimestampedString>();
+        hdr->string = header.ToString();
+        hdr->issued_time = now;
+
+        // Add message header, destinations, and contents.
+        const auto arrival =
+          sev->ScheduleFrame(MessageHeader::encoding_size + frame_size);
+        st = sev->Enqueue(std::move(hdr),
+                          std::move(destinations),
+                          msg,
+                          local,
+                          high_priority,
+                          arrival);
       }
     }
     // No else, so we catch error on adding to queue as well.
@@ -718,9 +1067,19 @@ void EventLoop::HandleAcceptCommand(std::unique_ptr<Command> command) {
   // itself during an EOF callback.
   thread_check_.Check();
   AcceptCommand* accept_cmd = static_cast<AcceptCommand*>(command.get());
-  std::unique_ptr<SocketEvent> sev = SocketEvent::Create(this,
-                                                         accept_cmd->GetFD());
+  std::unique_ptr<SocketEvent> sev;
+  LoopbackTransport::Endpoint endpoint;
+  if (options_.loopback &&
+      LoopbackTransport::Default()->TakeAccepted(accept_cmd->GetFD(),
+                                                 &endpoint)) {
+    sev = SocketEvent::CreateLoopback(this, std::move(endpoint), HostId());
+  } else {
+    sev = SocketEvent::Create(this, accept_cmd->GetFD());
+  }
   if (sev) {
+    if (options_.network) {
+      sev->SetLink(options_.network->TakeAcceptedLink(accept_cmd->GetFD()));
+    }
     all_sockets_.emplace_front(std::move(sev));
     all_sockets_.front()->SetListHandle(all_sockets_.begin());
     active_connections_.fetch_add(1, std::memory_order_acq_rel);
@@ -735,6 +1094,7 @@ void
 EventLoop::do_startevent(evutil_socket_t listener, short event, void *arg) {
   EventLoop* obj = static_cast<EventLoop *>(arg);
   obj->thread_check_.Check();
+  obj->RefreshClock();
   obj->running_ = true;
   obj->start_signal_.Post();
 }
@@ -742,9 +1102,19 @@ EventLoop::do_startevent(evutil_socket_t listener, short event, void *arg) {
 void
 EventLoop::do_timerevent(evutil_socket_t listener, short event, void *arg) {
   Timer* obj = static_cast<Timer*>(arg);
+  obj->event_loop->RefreshClock();
   obj->callback();
 }
 
+void
+EventLoop::do_delayedwriteevent(evutil_socket_t listener,
+                                short event,
+                                void *arg) {
+  EventLoop* obj = static_cast<EventLoop*>(arg);
+  obj->RefreshClock();
+  obj->ResumeDelayedWrites();
+}
+
 void
 EventLoop::do_accept(evconnlistener *listener,
                      evutil_socket_t fd,
@@ -753,8 +1123,11 @@ EventLoop::do_accept(evconnlistener *listener,
                      void *arg) {
   EventLoop* event_loop = static_cast<EventLoop *>(arg);
   event_loop->thread_check_.Check();
+  event_loop->RefreshClock();
   setup_fd(fd, event_loop);
-  event_loop->accept_callback_(fd);
+  if (!event_loop->accept_callback_(fd).ok()) {
+    close(fd);
+  }
 }
 
 //
@@ -809,6 +1182,32 @@ EventLoop::accept_error_cb(evconnlistener *listener, void *arg) {
 
 Status
 EventLoop::Initialize() {
+  if (options_.cpus.empty()) {
+    return InitializeOnCurrentThread();
+  }
+
+  // Set up on a thread pinned like the loop will be, so that everything
+  // allocated here is first touched, and so placed, on the loop's NUMA node
+  // rather than the creating thread's.
+  Status st;
+  std::thread thread([this, &st] () {
+    Status pin = env_->SetCurrentThreadAffinity(options_.cpus);
+    if (!pin.ok()) {
+      LOG_WARN(info_log_,
+               "Failed to pin initialization of EventLoop at port %d to "
+               "CPUs %s: %s",
+               port_number_,
+               FormatCpuList(options_.cpus).c_str(),
+               pin.ToString().c_str());
+    }
+    st = InitializeOnCurrentThread();
+  });
+  thread.join();
+  return st;
+}
+
+Status
+EventLoop::InitializeOnCurrentThread() {
   if (base_) {
     assert(false);
     return Status::InvalidArgument("EventLoop already initialized.");
@@ -821,7 +1220,24 @@ EventLoop::Initialize() {
   }
 
   // Port number <= 0 indicates that there is no accept loop.
-  if (port_number_ > 0) {
+  if (port_number_ > 0 && options_.network) {
+    // Connections are accepted on the connecting thread, so hand them over.
+    Status st = options_.network->Listen(port_number_, [this] (int fd) {
+      std::unique_ptr<Command> command(MakeExecuteCommand([this, fd] () {
+        setup_fd(fd, this);
+        if (!accept_callback_(fd).ok()) {
+          close(fd);
+        }
+      }));
+      if (!SendCommand(command).ok()) {
+        close(fd);
+      }
+    });
+    if (!st.ok()) {
+      return st;
+    }
+    network_listening_ = true;
+  } else if (port_number_ > 0) {
     sockaddr_in6 sin;
     memset(&sin, 0, sizeof(sin));
     sin.sin6_family = AF_INET6;
@@ -845,6 +1261,69 @@ EventLoop::Initialize() {
     }
 
     evconnlistener_set_error_cb(listener_, &EventLoop::accept_error_cb);
+
+    // Loops in this process may also connect without TCP.
+    if (options_.loopback) {
+      Status st = LoopbackTransport::Default()->Listen(port_number_,
+        [this] (int handle) {
+          return accept_callback_(handle);
+        });
+      if (!st.ok()) {
+        return st;
+      }
+      loopback_listening_ = true;
+    }
+  }
+
+  // Co-located processes may connect over a Unix domain socket instead.
+  if (!options_.unix_socket_path.empty()) {
+    HostId address;
+    Status st = HostId::CreateFromPath(options_.unix_socket_path, &address);
+    if (!st.ok()) {
+      return st;
+    }
+
+    // Remove the socket of a previous process at the same path, but never
+    // anything else that a misconfigured path may point at, nor the socket
+    // of a server that is still running.
+    struct stat path_stat;
+    const char* path = options_.unix_socket_path.c_str();
+    if (lstat(path, &path_stat) == 0) {
+      if (!S_ISSOCK(path_stat.st_mode)) {
+        return Status::InvalidArgument(
+          "Unix socket path " + options_.unix_socket_path +
+          " exists and is not a socket");
+      }
+      bool live = false;
+      st = ProbeUnixSocket(address, &live);
+      if (!st.ok()) {
+        return st;
+      }
+      if (live) {
+        return Status::IOError("Unix socket address " +
+                               options_.unix_socket_path + " in use");
+      }
+      unlink(path);
+    } else if (errno != ENOENT) {
+      return Status::IOError("Cannot stat unix socket path " +
+                             options_.unix_socket_path + ": " +
+                             std::to_string(errno));
+    }
+    unix_listener_ = evconnlistener_new_bind(
+      base_,
+      &EventLoop::do_accept,
+      reinterpret_cast<void*>(this),
+      LEV_OPT_CLOSE_ON_FREE,
+      -1,  // backlog
+      address.GetSockaddr(),
+      static_cast<int>(address.GetSocklen()));
+
+    if (unix_listener_ == nullptr) {
+      return Status::InternalError(
+        "Failed to create connection listener on " + address.ToString());
+    }
+
+    evconnlistener_set_error_cb(unix_listener_, &EventLoop::accept_error_cb);
   }
 
   // Create a non-persistent event that will run as soon as the dispatch
@@ -859,6 +1338,30 @@ EventLoop::Initialize() {
   if (startup_event_ == nullptr) {
     return Status::InternalError("Failed to create first startup event");
   }
+
+  // Writes delayed by simulated links are resumed when their time comes.
+  if (options_.clock) {
+    clock_listener_ = options_.clock->AddListener([this] () {
+      if (resume_delayed_writes_.exchange(true)) {
+        // Already pending.
+        return;
+      }
+      std::unique_ptr<Command> command(MakeExecuteCommand([this] () {
+        ResumePendingDelayedWrites();
+      }));
+      // If the queue is full, the flag stays set and is picked up when the
+      // loop reads the queue.
+      SendCommand(command);
+    });
+  } else if (options_.network) {
+    delayed_write_event_ = evtimer_new(
+      base_,
+      this->do_delayedwriteevent,
+      reinterpret_cast<void*>(this));
+    if (delayed_write_event_ == nullptr) {
+      return Status::InternalError("Failed to create delayed write event");
+    }
+  }
   timeval zero_seconds = {0, 0};
   int rv = evtimer_add(startup_event_, &zero_seconds);
   if (rv != 0) {
@@ -891,8 +1394,10 @@ EventLoop::Initialize() {
   control_command_queue_ =
     std::make_shared<CommandQueue>(info_log_,
                                    queue_stats_,
-                                   default_command_queue_size_);
-  Status st = AddIncomingQueue(control_command_queue_);
+                                   default_command_queue_size_,
+                                   options_.huge_pages);
+  Status st = AddIncomingQueue(control_command_queue_,
+                               CommandPriority::kNormal);
   if (!st.ok()) {
     LOG_FATAL(info_log_, "Failed to add control command queue");
   }
@@ -906,6 +1411,23 @@ void EventLoop::Run() {
     return;
   }
   LOG_VITAL(info_log_, "Starting EventLoop at port %d", port_number_);
+  if (!options_.cpus.empty()) {
+    // Pin before the loop allocates anything on this thread. Initialize set
+    // up the rest on a thread pinned to the same CPUs.
+    Status st = env_->SetCurrentThreadAffinity(options_.cpus);
+    if (st.ok()) {
+      LOG_INFO(info_log_,
+               "EventLoop at port %d pinned to CPUs %s",
+               port_number_,
+               FormatCpuList(options_.cpus).c_str());
+    } else {
+      LOG_WARN(info_log_,
+               "Failed to pin EventLoop at port %d to CPUs %s: %s",
+               port_number_,
+               FormatCpuList(options_.cpus).c_str(),
+               st.ToString().c_str());
+    }
+  }
   info_log_->Flush();
 
   // Register a timer for checking expired connections.
@@ -914,7 +1436,8 @@ void EventLoop::Run() {
       connect_timeout_.ProcessExpired(
         options_.connect_timeout,
         [](SocketEvent* sev) { SocketEvent::Disconnect(sev, true); },
-        -1);
+        -1,
+        GetCachedTime());
     },
     options_.connect_timeout);
 
@@ -928,15 +1451,33 @@ void EventLoop::Run() {
   if (listener_) {
     evconnlistener_free(listener_);
   }
+  if (unix_listener_) {
+    evconnlistener_free(unix_listener_);
+    unix_listener_ = nullptr;
+    unlink(options_.unix_socket_path.c_str());
+  }
+  if (network_listening_) {
+    options_.network->Unlisten(port_number_);
+    network_listening_ = false;
+  }
+  if (loopback_listening_) {
+    LoopbackTransport::Default()->Unlisten(port_number_);
+    loopback_listening_ = false;
+  }
   if (startup_event_) {
     event_free(startup_event_);
   }
   for (auto& timer : timers_) {
     event_free(timer->loop_event);
   }
+  high_priority_queues_.clear();
   incoming_queues_.clear();
   shutdown_event_.reset();
   teardown_all_connections();
+  if (delayed_write_event_) {
+    event_free(delayed_write_event_);
+    delayed_write_event_ = nullptr;
+  }
   event_base_free(base_);
 
   if (!internal_status_.ok()) {
@@ -968,7 +1509,7 @@ Status EventLoop::RegisterTimerCallback(TimerCallbackType callback,
   assert(base_);
   assert(!IsRunning());
 
-  std::unique_ptr<Timer> timer(new Timer(std::move(callback)));
+  std::unique_ptr<Timer> timer(new Timer(this, std::move(callback)));
   timer->loop_event = event_new(
     base_,
     -1,
@@ -1001,31 +1542,46 @@ StreamSocket EventLoop::CreateOutboundStream(HostId destination) {
   return StreamSocket(std::move(destination), outbound_allocator_.Next());
 }
 
-const std::shared_ptr<CommandQueue>& EventLoop::GetThreadLocalQueue() {
+const std::shared_ptr<CommandQueue>& EventLoop::GetThreadLocalQueue(
+    CommandPriority priority) {
+  ThreadLocalPtr& queues = priority == CommandPriority::kHigh ?
+    high_priority_command_queues_ : command_queues_;
+
   // Get the thread local command queue.
   std::shared_ptr<CommandQueue>* command_queue_ptr =
-    static_cast<std::shared_ptr<CommandQueue>*>(command_queues_.Get());
+    static_cast<std::shared_ptr<CommandQueue>*>(queues.Get());
 
   if (!command_queue_ptr) {
     // Doesn't exist yet, so create a new one.
     std::shared_ptr<CommandQueue> command_queue =
-      CreateCommandQueue(default_command_queue_size_);
+      CreateCommandQueue(default_command_queue_size_, priority);
 
     // Set this as the thread local queue.
     command_queue_ptr = new std::shared_ptr<CommandQueue>(command_queue);
-    command_queues_.Reset(command_queue_ptr);
+    queues.Reset(command_queue_ptr);
   }
   return *command_queue_ptr;
 }
 
-std::shared_ptr<CommandQueue> EventLoop::CreateCommandQueue(size_t size) {
+std::shared_ptr<CommandQueue> EventLoop::CreateCommandQueue(
+    size_t size,
+    CommandPriority priority) {
   if (size == 0) {
     // Use default size when size == 0.
     size = default_command_queue_size_;
   }
+  const bool high_priority = priority == CommandPriority::kHigh;
   auto command_queue =
-      std::make_shared<CommandQueue>(info_log_, queue_stats_, size);
-  Status st = AttachQueue(command_queue);
+      std::make_shared<CommandQueue>(info_log_,
+                                     high_priority ?
+                                       high_priority_queue_stats_ :
+                                       queue_stats_,
+                                     size,
+                                     options_.huge_pages);
+  if (high_priority) {
+    command_queue->SetWriteFlag(high_priority_pending_);
+  }
+  Status st = AttachQueue(command_queue, priority);
   if (!st.ok()) {
     LOG_ERROR(info_log_, "Failed to attach command queue to EventLoop");
   }
@@ -1033,10 +1589,15 @@ std::shared_ptr<CommandQueue> EventLoop::CreateCommandQueue(size_t size) {
 }
 
 Status EventLoop::AttachQueue(std::shared_ptr<CommandQueue> command_queue) {
+  return AttachQueue(std::move(command_queue), CommandPriority::kNormal);
+}
+
+Status EventLoop::AttachQueue(std::shared_ptr<CommandQueue> command_queue,
+                              CommandPriority priority) {
   // Attach the new command queue to the event loop.
   std::unique_ptr<Command> attach_command(
-    MakeExecuteCommand([this, command_queue] () mutable {
-      Status st = AddIncomingQueue(std::move(command_queue));
+    MakeExecuteCommand([this, command_queue, priority] () mutable {
+      Status st = AddIncomingQueue(std::move(command_queue), priority);
       if (!st.ok()) {
         LOG_FATAL(info_log_, "Failed to attach command queue to EventLoop: %s",
           st.ToString().c_str());
@@ -1061,26 +1622,67 @@ Status EventLoop::AttachQueue(std::shared_ptr<CommandQueue> command_queue) {
 }
 
 Status EventLoop::AddIncomingQueue(
-    std::shared_ptr<CommandQueue> command_queue) {
+    std::shared_ptr<CommandQueue> command_queue,
+    CommandPriority priority) {
   // An event that signals new commands in the command queue.
   std::unique_ptr<IncomingQueue> incoming_queue(new IncomingQueue());
   incoming_queue->queue = std::move(command_queue);
 
   CommandQueue* queue = incoming_queue->queue.get();
-  queue->RegisterReadCallback(
-    this,
-    [this] (std::unique_ptr<Command> cmd) {
-      // Call registered callback.
-      Dispatch(std::move(cmd));
-      return true;
-    });
+  if (batch_policy_) {
+    queue->SetBatchPolicy(batch_policy_);
+  }
+  if (priority == CommandPriority::kHigh) {
+    queue->RegisterReadCallback(
+      this,
+      [this] (std::unique_ptr<Command> cmd) {
+        Dispatch(std::move(cmd));
+        // Stop when a burst in between normal commands is over.
+        return high_priority_budget_ < 0 || --high_priority_budget_ > 0;
+      });
+    high_priority_queues_.push_back(queue);
+  } else {
+    queue->RegisterReadCallback(
+      this,
+      [this] (std::unique_ptr<Command> cmd) {
+        // Call registered callback.
+        Dispatch(std::move(cmd));
+        if (high_priority_pending_->load(std::memory_order_relaxed)) {
+          ProcessHighPriority();
+        }
+        return true;
+      });
+  }
   queue->SetReadEnabled(true);
 
-  LOG_INFO(info_log_, "Added new command queue to EventLoop");
+  LOG_INFO(info_log_,
+           "Added new %s command queue to EventLoop",
+           priority == CommandPriority::kHigh ? "high priority" : "normal");
   incoming_queues_.emplace_back(std::move(incoming_queue));
   return Status::OK();
 }
 
+void EventLoop::ProcessHighPriority() {
+  if (!high_priority_pending_->exchange(false, std::memory_order_acquire)) {
+    return;
+  }
+  stats_.high_priority_bursts->Add(1);
+  high_priority_budget_ = std::max(options_.high_priority_burst, 1);
+  for (size_t i = 0;
+       i < high_priority_queues_.size() && high_priority_budget_ > 0;
+       ++i) {
+    // Checking the size first saves eventfd reads on idle queues.
+    if (high_priority_queues_[i]->GetSize() > 0) {
+      high_priority_queues_[i]->Drain();
+    }
+  }
+  if (high_priority_budget_ == 0) {
+    // There may be more, come back after the next normal command.
+    high_priority_pending_->store(true, std::memory_order_relaxed);
+  }
+  high_priority_budget_ = -1;
+}
+
 static void EventShim(int fd, short what, void* event) {
   assert(event);
   if (what & (EV_READ|EV_WRITE)) {
@@ -1101,8 +1703,21 @@ event* EventLoop::CreateFdWriteEvent(int fd,
 }
 
 Status EventLoop::SendCommand(std::unique_ptr<Command>& command) {
+  // Commands from a thread are processed in order, so a command only takes
+  // its own lane if the thread has nothing queued in the other one.
+  CommandPriority priority = command->GetPriority();
+  const bool high_priority = priority == CommandPriority::kHigh;
+  ThreadLocalPtr& other_queues =
+    high_priority ? command_queues_ : high_priority_command_queues_;
+  auto other_queue =
+    static_cast<std::shared_ptr<CommandQueue>*>(other_queues.Get());
+  if (other_queue && (*other_queue)->GetSize() > 0) {
+    priority = high_priority ? CommandPriority::kNormal :
+                               CommandPriority::kHigh;
+  }
+
   // Send command using thread local queue.
-  return GetThreadLocalQueue()->TryWrite(command) ?
+  return GetThreadLocalQueue(priority)->TryWrite(command) ?
     Status::OK() : Status::NoBuffer();
 }
 
@@ -1126,10 +1741,10 @@ Status EventLoop::SendResponse(const Message& msg, StreamID stream_id) {
   return SendCommand(command);
 }
 
-void EventLoop::Accept(int fd) {
+Status EventLoop::Accept(int fd) {
   // May be called from another thread, so must add to the command queue.
   std::unique_ptr<Command> command(new AcceptCommand(fd));
-  SendCommand(command);
+  return SendCommand(command);
 }
 
 void EventLoop::Dispatch(std::unique_ptr<Message> message, StreamID origin) {
@@ -1138,6 +1753,9 @@ void EventLoop::Dispatch(std::unique_ptr<Message> message, StreamID origin) {
 
 void EventLoop::Dispatch(std::unique_ptr<Command> command) {
   stats_.commands_processed->Add(1);
+  if (resume_delayed_writes_.load(std::memory_order_relaxed)) {
+    ResumePendingDelayedWrites();
+  }
 
   // Search for callback registered for this command type.
   // Command ownership will be passed along to the callback.
@@ -1163,6 +1781,58 @@ Status EventLoop::WaitUntilRunning(std::chrono::seconds timeout) {
   return Status::OK();
 }
 
+void EventLoop::DelayWrites(SocketEvent* sev,
+                            std::chrono::steady_clock::time_point until) {
+  thread_check_.Check();
+  delayed_writes_.emplace(until, sev);
+  if (delayed_writes_.begin()->second == sev) {
+    // This is now the earliest arrival.
+    ScheduleDelayedWriteEvent();
+  }
+}
+
+void EventLoop::CancelDelayedWrites(
+    SocketEvent* sev,
+    std::chrono::steady_clock::time_point until) {
+  thread_check_.Check();
+  delayed_writes_.erase(std::make_pair(until, sev));
+}
+
+void EventLoop::ResumeDelayedWrites() {
+  thread_check_.Check();
+  const auto now = GetCachedTime();
+  while (!delayed_writes_.empty() && delayed_writes_.begin()->first <= now) {
+    SocketEvent* sev = delayed_writes_.begin()->second;
+    delayed_writes_.erase(delayed_writes_.begin());
+    sev->ResumeWrites();
+  }
+  if (!delayed_writes_.empty()) {
+    ScheduleDelayedWriteEvent();
+  }
+}
+
+void EventLoop::ResumePendingDelayedWrites() {
+  if (resume_delayed_writes_.exchange(false)) {
+    // The clock may have moved since the start of this callback.
+    RefreshClock();
+    ResumeDelayedWrites();
+  }
+}
+
+void EventLoop::ScheduleDelayedWriteEvent() {
+  if (!delayed_write_event_) {
+    // Simulated clock, writes are resumed when it is advanced.
+    return;
+  }
+  const auto delay = std::max<int64_t>(0,
+    std::chrono::duration_cast<std::chrono::microseconds>(
+      delayed_writes_.begin()->first - GetCachedTime()).count());
+  timeval tv;
+  tv.tv_sec = static_cast<time_t>(delay / 1000000);
+  tv.tv_usec = static_cast<suseconds_t>(delay % 1000000);
+  evtimer_add(delayed_write_event_, &tv);
+}
+
 // Removes an socket event created by setup_connection.
 void EventLoop::teardown_connection(SocketEvent* sev, bool timed_out) {
   thread_check_.Check();
@@ -1184,33 +1854,63 @@ void EventLoop::teardown_all_connections() {
 SocketEvent*
 EventLoop::setup_connection(const HostId& destination) {
   thread_check_.Check();
-  int fd;
-  Status status = create_connection(destination, &fd);
-  if (!status.ok()) {
-    LOG_WARN(info_log_,
-             "create_connection to %s failed: %s",
-             destination.ToString().c_str(),
-             status.ToString().c_str());
-    return nullptr;
-  }
-
   // This object is managed by the event that it creates, and will destroy
   // itself during an EOF callback.
-  std::unique_ptr<SocketEvent> sev = SocketEvent::Create(this,
-                                                         fd,
-                                                         destination);
-  if (!sev) {
-    return nullptr;
+  std::unique_ptr<SocketEvent> sev;
+  LoopbackTransport::Endpoint endpoint;
+  Status loopback_status = Status::NotFound("");
+  if (options_.loopback && !options_.network) {
+    loopback_status =
+      LoopbackTransport::Default()->Connect(destination, &endpoint);
+    if (!loopback_status.ok() && !loopback_status.IsNotFound()) {
+      // The destination is in this process, but could not take the
+      // connection.
+      LOG_WARN(info_log_,
+               "Loopback connection to %s failed: %s",
+               destination.ToString().c_str(),
+               loopback_status.ToString().c_str());
+      return nullptr;
+    }
+  }
+  if (loopback_status.ok()) {
+    // The destination is in this process, so there is nothing to wait for.
+    sev = SocketEvent::CreateLoopback(this, std::move(endpoint), destination);
+    if (!sev) {
+      return nullptr;
+    }
+    LOG_INFO(info_log_,
+             "Connected to %s within the process",
+             destination.ToString().c_str());
+  } else {
+    int fd;
+    std::shared_ptr<SimulatedLink> link;
+    Status status = options_.network ?
+      options_.network->Connect(options_.network_port, destination, &fd,
+                                &link) :
+      create_connection(destination, &fd);
+    if (!status.ok()) {
+      LOG_WARN(info_log_,
+               "create_connection to %s failed: %s",
+               destination.ToString().c_str(),
+               status.ToString().c_str());
+      return nullptr;
+    }
+
+    sev = SocketEvent::Create(this, fd, destination);
+    if (!sev) {
+      return nullptr;
+    }
+    sev->SetLink(std::move(link));
+    connect_timeout_.Add(sev.get(), GetCachedTime());
+
+    LOG_INFO(info_log_,
+             "Connect to %s scheduled on socket fd(%d)",
+             destination.ToString().c_str(),
+             fd);
   }
-  connect_timeout_.Add(sev.get());
   all_sockets_.emplace_front(std::move(sev));
   all_sockets_.front()->SetListHandle(all_sockets_.begin());
   active_connections_.fetch_add(1, std::memory_order_acq_rel);
-
-  LOG_INFO(info_log_,
-           "Connect to %s scheduled on socket fd(%d)",
-           destination.ToString().c_str(),
-           fd);
   return all_sockets_.front().get();
 }
 
@@ -1249,7 +1949,14 @@ Status EventLoop::create_connection(const HostId& host, int* fd) {
   }
 
   if (connect(sockfd, addr, host.GetSocklen()) == -1) {
-    if (errno != EINPROGRESS) {
+    if (addr->sa_family == AF_UNIX && errno == EAGAIN) {
+      // Unix sockets connect immediately or not at all, and EAGAIN means
+      // that the server's backlog is full. Waiting would block the loop, so
+      // fail this attempt and leave it to the sender to retry later, as for
+      // any other failed connection.
+      close(sockfd);
+      return Status::NoBuffer();
+    } else if (errno != EINPROGRESS) {
       goto abort_socket;
     }
     // On non-blocking socket connect might not be successful immediately.
@@ -1301,13 +2008,21 @@ EventLoop::EventLoop(BaseEnv* env,
     , listener_(nullptr)
     , shutdown_eventfd_(rocketspeed::port::Eventfd(true, true))
     , command_queues_(CommandQueueUnrefHandler)
+    , high_priority_command_queues_(CommandQueueUnrefHandler)
     , stream_router_(allocator.Split())
     , outbound_allocator_(std::move(allocator))
     , active_connections_(0)
+    , clock_(options_.use_tsc_clock, options_.clock.get())
     , stats_(options_.stats_prefix)
     , queue_stats_(std::make_shared<QueueStats>(options_.stats_prefix +
                                                 ".queues"))
-    , default_command_queue_size_(options_.command_queue_size) {
+    , high_priority_queue_stats_(std::make_shared<QueueStats>(
+        options_.stats_prefix + ".high_priority_queues"))
+    , batch_policy_(options_.command_batch_latency.count() > 0 ?
+        std::make_shared<QueueBatchPolicy>(options_.command_batch_latency) :
+        nullptr)
+    , default_command_queue_size_(options_.command_queue_size)
+    , high_priority_pending_(std::make_shared<std::atomic<bool>>(false)) {
   // Setup callbacks.
   command_callbacks_[CommandType::kAcceptCommand] = [this](
       std::unique_ptr<Command> command) {
@@ -1349,6 +2064,8 @@ EventLoop::EventLoop(BaseEnv* env,
 
 EventLoop::Stats::Stats(const std::string& prefix) {
   write_latency = all.AddLatency(prefix + ".write_latency");
+  write_latency_high_priority =
+    all.AddLatency(prefix + ".write_latency_high_priority");
   write_size_bytes =
     all.AddHistogram(prefix + ".write_size_bytes", 0, kMaxIovecs, 1, 1.1);
   write_size_iovec =
@@ -1360,9 +2077,15 @@ EventLoop::Stats::Stats(const std::string& prefix) {
   commands_processed = all.AddCounter(prefix + ".commands_processed");
   accepts = all.AddCounter(prefix + ".accepts");
   queue_count = all.AddCounter(prefix + ".queue_count");
+  memory_command_queues = all.AddCounter(prefix + ".memory.command_queues");
+  memory_send_queues = all.AddCounter(prefix + ".memory.send_queues");
   full_queue_errors = all.AddCounter(prefix + ".full_queue_errors");
   socket_writes = all.AddCounter(prefix + ".socket_writes");
   partial_socket_writes = all.AddCounter(prefix + ".partial_socket_writes");
+  loopback_frames = all.AddCounter(prefix + ".loopback_frames");
+  high_priority_frames = all.AddCounter(prefix + ".high_priority_frames");
+  high_priority_bursts = all.AddCounter(prefix + ".high_priority_bursts");
+  queues_backlogged = all.AddCounter(prefix + ".queues_backlogged");
   for (int i = 0; i < int(MessageType::max) + 1; ++i) {
     messages_received[i] = all.AddCounter(
       prefix + ".messages_received." + MessageTypeName(MessageType(i)));
@@ -1371,8 +2094,18 @@ EventLoop::Stats::Stats(const std::string& prefix) {
 
 Statistics EventLoop::GetStatistics() const {
   stats_.queue_count->Set(incoming_queues_.size());
+  size_t command_queue_bytes = 0;
+  for (const auto& incoming : incoming_queues_) {
+    command_queue_bytes += incoming->queue->GetHeapMemoryUsage();
+  }
+  stats_.memory_command_queues->Set(command_queue_bytes);
+  stats_.memory_send_queues->Set(send_queue_bytes_);
+  if (batch_policy_) {
+    stats_.queues_backlogged->Set(batch_policy_->backlogged_queues);
+  }
   Statistics stats = stats_.all;
   stats.Aggregate(queue_stats_->all);
+  stats.Aggregate(high_priority_queue_stats_->all);
   return stats;
 }
 
@@ -1380,6 +2113,15 @@ EventLoop::~EventLoop() {
   // Event loop should already be stopped by this point, and the running
   // thread should be joined.
   assert(!running_);
+  if (clock_listener_) {
+    options_.clock->RemoveListener(clock_listener_);
+  }
+  if (network_listening_) {
+    options_.network->Unlisten(port_number_);
+  }
+  if (loopback_listening_) {
+    LoopbackTransport::Default()->Unlisten(port_number_);
+  }
   shutdown_eventfd_.closefd();
 }
 
@@ -1406,7 +2148,13 @@ int EventLoop::GetNumClients() const {
 }
 
 size_t EventLoop::GetQueueSize() const {
-  return const_cast<EventLoop*>(this)->GetThreadLocalQueue()->GetSize();
+  size_t size = const_cast<EventLoop*>(this)->GetThreadLocalQueue()->GetSize();
+  auto high_priority_queue = static_cast<std::shared_ptr<CommandQueue>*>(
+    high_priority_command_queues_.Get());
+  if (high_priority_queue) {
+    size += (*high_priority_queue)->GetSize();
+  }
+  return size;
 }
 
 EventLoop::IncomingQueue::~IncomingQueue() {
@@ -1448,6 +2196,7 @@ EventCallback::~EventCallback() {
 
 void EventCallback::Invoke() {
   event_loop_->ThreadCheck();
+  event_loop_->RefreshClock();
   cb_();
 }
 
@@ -20,6 +20,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -33,6 +34,8 @@
 #include "src/messages/unique_stream_map.h"
 #include "src/port/port.h"
 #include "src/util/common/base_env.h"
+#include "src/util/common/cached_clock.h"
+#include "src/util/common/huge_page_allocator.h"
 #include "src/util/common/statistics.h"
 #include "src/util/common/thread_check.h"
 #include "src/util/common/thread_local.h"
@@ -49,7 +52,7 @@ namespace rocketspeed {
 typedef std::function<void(std::unique_ptr<Message> msg, StreamID origin)>
   EventCallbackType;
 
-typedef std::function<void(int fd)> AcceptCallbackType;
+typedef std::function<Status(int fd)> AcceptCallbackType;
 
 // Callback registered for a command type is invoked for all commands of the
 // type.
@@ -61,7 +64,10 @@ typedef std::function<void()> TimerCallbackType;
 class CommandQueue;
 class EventCallback;
 class EventLoop;
+struct QueueBatchPolicy;
 struct QueueStats;
+class SimulatedClock;
+class SimulatedNetwork;
 class SocketEvent;
 
 /**
@@ -224,6 +230,11 @@ class EventLoop {
    * source location, otherwise an error will be returned and command will
    * be left intact, in case the caller wishes to retry later.
    *
+   * High priority commands go through a separate thread-local queue, which
+   * the loop drains ahead of the others. Commands from one thread are still
+   * processed in order: while the thread has commands queued in one lane,
+   * further commands join them.
+   *
    * This call is thread-safe.
    */
   Status SendCommand(std::unique_ptr<Command>& command);
@@ -234,7 +245,9 @@ class EventLoop {
 
   // Start communicating on a fd.
   // This call is thread-safe.
-  void Accept(int fd);
+  // Returns an error if the fd could not be handed to the loop, in which
+  // case the caller still owns it.
+  Status Accept(int fd);
 
   // Dispatches a message to the event callback.
   void Dispatch(std::unique_ptr<Message> message, StreamID origin);
@@ -250,6 +263,32 @@ class EventLoop {
   // Get the info log.
   const std::shared_ptr<Logger>& GetLog() { return info_log_; }
 
+  /**
+   * Monotonic time cached at the start of the callback currently being
+   * processed. All work done in one callback sees the same time, which is
+   * accurate enough for timeouts and latency statistics, and avoids reading
+   * the clock for every message.
+   * Can only be called from the event loop thread.
+   */
+  std::chrono::steady_clock::time_point GetCachedTime() const {
+    return clock_.Now();
+  }
+
+  /** GetCachedTime in microseconds. */
+  uint64_t GetCachedTimeMicros() const {
+    return clock_.NowMicros();
+  }
+
+  /**
+   * Precise current time in microseconds, on the same scale as
+   * GetCachedTimeMicros. Uses the CPU timestamp counter when
+   * Options::use_tsc_clock is set.
+   * Can only be called from the event loop thread.
+   */
+  uint64_t GetFineTimeMicros() const {
+    return clock_.FineNowMicros();
+  }
+
   Statistics GetStatistics() const;
 
   void ThreadCheck() const {
@@ -272,7 +311,7 @@ class EventLoop {
    */
   int GetNumClients() const;
 
-  /** @return Current size of this thread's command queue. */
+  /** @return Current size of this thread's command queues. */
   size_t GetQueueSize() const;
 
   /**
@@ -280,10 +319,14 @@ class EventLoop {
    *
    * @param size Size of the queue (number of commands). Defaults to whatever
    *             the EventLoop default command queue size is.
+   * @param priority Lane of the queue. Commands in high priority queues are
+   *                 processed in between those of normal queues, up to
+   *                 Options::high_priority_burst at a time.
    * @return The created queue.
    */
-  std::shared_ptr<CommandQueue> CreateCommandQueue(size_t size = 0);
-
+  std::shared_ptr<CommandQueue> CreateCommandQueue(
+      size_t size = 0,
+      CommandPriority priority = CommandPriority::kNormal);
 
   /**
    * Attaches the command queue to the EventLoop for processing.
@@ -356,6 +399,8 @@ class EventLoop {
     std::string stats_prefix;
     // initial size of the command queue
     uint32_t command_queue_size = 50000;
+    // pages backing the ring buffers of command queues
+    HugePageMode huge_pages = HugePageMode::kNone;
     // timeout after which all inactive streams should be considered expired
     std::chrono::seconds heartbeat_timeout{900};
     // since we expire the streams in the blocking call, limit the number of
@@ -365,12 +410,44 @@ class EventLoop {
     bool heartbeat_enabled = false;
     // timeout for asynchronous ::connect calls
     std::chrono::milliseconds connect_timeout{10000};
+    // whether GetFineTimeMicros may use the CPU timestamp counter
+    bool use_tsc_clock = false;
+    // if set, listen and connect on this network instead of over TCP
+    std::shared_ptr<SimulatedNetwork> network;
+    // port identifying this loop on the simulated network, for link options
+    // of outgoing connections (0 for loops that do not accept connections)
+    int network_port = 0;
+    // if set, time is read from this clock instead of the steady clock
+    std::shared_ptr<SimulatedClock> clock;
+    // if set, connections between loops in this process that both set it
+    // hand frames over in memory instead of going through TCP
+    bool loopback = false;
+    // if set, also accept connections on a Unix domain socket at this path,
+    // which processes on the same host can connect to (see
+    // HostId::CreateFromPath)
+    std::string unix_socket_path;
+    // if not empty, the thread running the loop is restricted to these CPUs
+    // when Run starts, and Initialize sets the loop up on a thread restricted
+    // to them too, so that the event base, listeners and command queues are
+    // placed on their NUMA node along with what the loop allocates later
+    std::vector<int> cpus;
+    // maximum number of high priority commands processed in between two
+    // commands from normal queues, so that neither lane starves the other
+    int high_priority_burst = 32;
+    // target time to read one batch of commands from each backlogged command
+    // queue, which sizes the batches of each queue (0 for fixed batches of
+    // kMaxQueueBatchReadSize)
+    std::chrono::microseconds command_batch_latency{1000};
   };
 
  private:
+  friend class EventCallback;
   friend class SocketEvent;
   friend class StreamRouter;
 
+  // Does the work of Initialize on the calling thread.
+  Status InitializeOnCurrentThread();
+
   const Options options_;
 
   // Internal status of the EventLoop.
@@ -403,6 +480,15 @@ class EventLoop {
   // The connection listener
   evconnlistener* listener_ = nullptr;
 
+  // The listener on options_.unix_socket_path
+  evconnlistener* unix_listener_ = nullptr;
+
+  // Is the loop listening on options_.network?
+  bool network_listening_ = false;
+
+  // Is the loop listening on the LoopbackTransport?
+  bool loopback_listening_ = false;
+
   // Shutdown event
   std::unique_ptr<EventCallback> shutdown_event_;
   rocketspeed::port::Eventfd shutdown_eventfd_;
@@ -412,6 +498,8 @@ class EventLoop {
 
   // Each thread has its own command queue to communicate with the EventLoop.
   ThreadLocalPtr command_queues_;
+  // And another for high priority commands.
+  ThreadLocalPtr high_priority_command_queues_;
 
   // Shared command queue for sending control commands.
   // This should only be used for creating new queues.
@@ -450,8 +538,9 @@ class EventLoop {
 
   // Timer callbacks.
   struct Timer {
-    explicit Timer(TimerCallbackType _callback)
-    : callback(std::move(_callback)) {
+    Timer(EventLoop* _event_loop, TimerCallbackType _callback)
+    : event_loop(_event_loop)
+    , callback(std::move(_callback)) {
     }
 
     Timer(const Timer&) = delete;
@@ -459,6 +548,7 @@ class EventLoop {
     Timer& operator=(const Timer&) = delete;
     Timer& operator=(Timer&&) = delete;
 
+    EventLoop* event_loop;
     TimerCallbackType callback;
     event* loop_event = nullptr;
   };
@@ -467,11 +557,31 @@ class EventLoop {
   // Thread check
   rocketspeed::ThreadCheck thread_check_;
 
+  // Total size of messages queued on all sockets. A message sent to
+  // several sockets is counted once per socket.
+  size_t send_queue_bytes_ = 0;
+
+  // Time cached at the start of each callback.
+  CachedClock clock_;
+
+  // Sockets on simulated links waiting for their next frame to arrive, by
+  // arrival time.
+  std::set<std::pair<std::chrono::steady_clock::time_point, SocketEvent*>>
+    delayed_writes_;
+  // Fires at the earliest arrival, when using the steady clock.
+  event* delayed_write_event_ = nullptr;
+  // Resumes delayed writes when options_.clock is advanced.
+  uint64_t clock_listener_ = 0;
+  // Set when options_.clock has been advanced and delayed writes have not
+  // been resumed since.
+  std::atomic<bool> resume_delayed_writes_{false};
+
   struct Stats {
     explicit Stats(const std::string& prefix);
 
     Statistics all;
     Histogram* write_latency;     // time from SendCommand to socket write
+    Histogram* write_latency_high_priority; // same, for high priority frames
     Histogram* write_size_bytes;  // total bytes in write calls
     Histogram* write_size_iovec;  // total iovecs in write calls.
     Histogram* write_succeed_bytes; // successful bytes written in write calls.
@@ -479,13 +589,22 @@ class EventLoop {
     Counter* commands_processed;
     Counter* accepts;             // number of connection accepted
     Counter* queue_count;         // number of queues attached this loop
+    Counter* memory_command_queues; // bytes in command queue buffers
+    Counter* memory_send_queues;  // bytes of messages queued on sockets
     Counter* full_queue_errors;   // number of times SendCommand into full queue
     Counter* messages_received[size_t(MessageType::max) + 1];
     Counter* socket_writes;       // number of calls to write(v)
     Counter* partial_socket_writes; // number of writes that partially succeeded
+    Counter* loopback_frames;     // number of frames sent within the process
+    Counter* high_priority_frames; // frames written ahead of queued data
+    Counter* high_priority_bursts; // times normal queues were preempted
+    Counter* queues_backlogged;   // queues with items left after their batch
   } stats_;
 
   const std::shared_ptr<QueueStats> queue_stats_;
+  const std::shared_ptr<QueueStats> high_priority_queue_stats_;
+  // Sizes the read batches of all incoming queues, null for fixed batches.
+  const std::shared_ptr<QueueBatchPolicy> batch_policy_;
 
   const uint32_t default_command_queue_size_;
 
@@ -498,17 +617,47 @@ class EventLoop {
   };
   std::vector<std::unique_ptr<IncomingQueue>> incoming_queues_;
 
+  // High priority queues, also in incoming_queues_.
+  std::vector<CommandQueue*> high_priority_queues_;
+  // Set on writes to high priority queues, checked after every command from
+  // a normal queue.
+  const std::shared_ptr<std::atomic<bool>> high_priority_pending_;
+  // High priority commands left in the current burst, or -1 outside bursts.
+  int high_priority_budget_ = -1;
+
   // Send a command using a particular command queue.
   Status SendCommand(std::unique_ptr<Command>& command,
                      CommandQueue* command_queue);
 
-  const std::shared_ptr<CommandQueue>& GetThreadLocalQueue();
+  const std::shared_ptr<CommandQueue>& GetThreadLocalQueue(
+      CommandPriority priority = CommandPriority::kNormal);
 
-  Status AddIncomingQueue(std::shared_ptr<CommandQueue> command_queue);
+  Status AttachQueue(std::shared_ptr<CommandQueue> command_queue,
+                     CommandPriority priority);
+
+  Status AddIncomingQueue(std::shared_ptr<CommandQueue> command_queue,
+                          CommandPriority priority);
+
+  // Processes a burst of high priority commands in between normal ones.
+  void ProcessHighPriority();
+
+  // Updates the cached time, called before every callback.
+  void RefreshClock() {
+    clock_.Refresh();
+  }
 
   void HandleSendCommand(std::unique_ptr<Command> command);
   void HandleAcceptCommand(std::unique_ptr<Command> command);
 
+  // Simulated network support.
+  void DelayWrites(SocketEvent* sev,
+                   std::chrono::steady_clock::time_point until);
+  void CancelDelayedWrites(SocketEvent* sev,
+                           std::chrono::steady_clock::time_point until);
+  void ResumeDelayedWrites();
+  void ResumePendingDelayedWrites();
+  void ScheduleDelayedWriteEvent();
+
   // connection cache updates
   void remove_host(const HostId& host);
   SocketEvent* setup_connection(const HostId& destination);
@@ -524,6 +673,7 @@ class EventLoop {
   static void accept_error_cb(evconnlistener *listener, void *arg);
   static void do_startevent(int listener, short event, void *arg);
   static void do_timerevent(int listener, short event, void *arg);
+  static void do_delayedwriteevent(int listener, short event, void *arg);
 };
 
 class EventCallback {
@@ -0,0 +1,379 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "include/Logger.h"
+#include "src/messages/commands.h"
+#include "src/messages/event_loop.h"
+#include "src/messages/messages.h"
+#include "src/messages/stream_socket.h"
+#include "src/port/Env.h"
+#include "src/port/port.h"
+#include "src/util/benchharness.h"
+#include "src/util/common/coding.h"
+#include "src/util/common/guid_generator.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+
+namespace {
+
+// Must match the message header written by the EventLoop.
+const uint8_t kMessageVersion = 1;
+
+/** EventLoop running on its own thread. */
+class LoopRunner {
+ public:
+  explicit LoopRunner(EventCallbackType event_callback = nullptr,
+                      EventLoop::Options options = EventLoop::Options())
+  : loop_(Env::Default(),
+          EnvOptions(),
+          0,
+          std::make_shared<NullLogger>(),
+          std::move(event_callback),
+          nullptr,
+          StreamAllocator(),
+          std::move(options)) {
+    loop_.Initialize();
+    thread_ = std::thread([this]() { loop_.Run(); });
+    loop_.WaitUntilRunning();
+  }
+
+  ~LoopRunner() {
+    loop_.Stop();
+    thread_.join();
+  }
+
+  EventLoop* operator->() {
+    return &loop_;
+  }
+
+ private:
+  EventLoop loop_;
+  std::thread thread_;
+};
+
+/** Sends a command, retrying while the command queue is full. */
+void SendRetrying(LoopRunner& loop, std::unique_ptr<Command> command) {
+  while (!loop->SendCommand(command).ok()) {
+    std::this_thread::yield();
+  }
+}
+
+/** Busy waits, as a command doing some work would. */
+void Spin(std::chrono::microseconds duration) {
+  const auto until = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < until) {
+  }
+}
+
+/** @return Loop options with the given command batch latency target. */
+EventLoop::Options BatchOptions(std::chrono::microseconds batch_latency) {
+  EventLoop::Options options;
+  options.command_batch_latency = batch_latency;
+  return options;
+}
+
+/**
+ * Round trips from one producer while another floods the loop with commands
+ * that take 20us each.
+ */
+void SkewedRoundTrip(size_t n, std::chrono::microseconds batch_latency) {
+  BenchmarkSuspender suspender;
+  std::unique_ptr<LoopRunner> loop(
+    new LoopRunner(nullptr, BatchOptions(batch_latency)));
+  std::atomic<bool> stop(false);
+  std::thread flood([&]() {
+    while (!stop.load()) {
+      std::unique_ptr<Command> command(MakeExecuteCommand([]() {
+        Spin(std::chrono::microseconds(20));
+      }));
+      if (!(*loop)->SendCommand(command).ok()) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  port::Semaphore done;
+  auto post = [&]() { done.Post(); };
+  suspender.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    std::unique_ptr<Command> command(MakeExecuteCommand(post));
+    SendRetrying(*loop, std::move(command));
+    done.Wait();
+  }
+
+  BenchmarkSuspender teardown;
+  stop = true;
+  flood.join();
+  loop.reset();
+}
+
+/**
+ * Throughput of cheap commands from four producers, one of which sends
+ * 85% of them.
+ */
+void SkewedThroughput(size_t n, std::chrono::microseconds batch_latency) {
+  BenchmarkSuspender suspender;
+  std::unique_ptr<LoopRunner> loop(
+    new LoopRunner(nullptr, BatchOptions(batch_latency)));
+  std::atomic<size_t> processed(0);
+  port::Semaphore done;
+  auto count = [&]() {
+    if (++processed == n) {
+      done.Post();
+    }
+  };
+  const size_t kProducers = 4;
+  const size_t heavy = n * 85 / 100;
+  const size_t light = (n - heavy) / (kProducers - 1);
+  const size_t counts[kProducers] = {
+    heavy, light, light, n - heavy - 2 * light
+  };
+  suspender.Dismiss();
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p]() {
+      for (size_t i = 0; i < counts[p]; ++i) {
+        std::unique_ptr<Command> command(MakeExecuteCommand(count));
+        SendRetrying(*loop, std::move(command));
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  if (n > 0) {
+    done.Wait();
+  }
+
+  BenchmarkSuspender teardown;
+  loop.reset();
+}
+
+/** @return A serialized data delivery with a 100 byte payload. */
+std::string MakeSerializedMessage() {
+  MessageDeliverData data(Tenant::GuestTenant,
+                          42,
+                          GUIDGenerator().Generate(),
+                          std::string(100, 'x'));
+  data.SetSequenceNumbers(1000, 1001);
+  std::string serial;
+  data.SerializeToString(&serial);
+  return serial;
+}
+
+/** @return The message as it is framed on the wire by the EventLoop. */
+std::string MakeFrame(StreamID stream, const std::string& serial) {
+  std::string body;
+  EncodeOrigin(&body, stream);
+  body.append(serial);
+  std::string frame;
+  PutFixed8(&frame, kMessageVersion);
+  PutFixed32(&frame, static_cast<uint32_t>(body.size()));
+  frame.append(body);
+  return frame;
+}
+
+/** Aborts the benchmark on a failed system call. */
+void Fail(const char* what) {
+  fprintf(stderr, "%s failed: %s\n", what, strerror(errno));
+  abort();
+}
+
+void WriteFully(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t count = write(fd, data, size);
+    if (count > 0) {
+      data += count;
+      size -= static_cast<size_t>(count);
+    } else if (count < 0 && errno != EINTR) {
+      Fail("write");
+    }
+  }
+}
+
+void ReadFully(int fd, size_t size) {
+  char buffer[64 * 1024];
+  while (size > 0) {
+    ssize_t count = read(fd, buffer, std::min(size, sizeof(buffer)));
+    if (count > 0) {
+      size -= static_cast<size_t>(count);
+    } else if (count == 0) {
+      break;
+    } else if (errno != EINTR) {
+      Fail("read");
+    }
+  }
+}
+
+/**
+ * Socket pair where one end is owned by an EventLoop and the other is used
+ * by the benchmark to play the remote peer.
+ */
+class PeerSocket {
+ public:
+  explicit PeerSocket(LoopRunner& loop) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      Fail("socketpair");
+    }
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fd_ = fds[0];
+    loop->Accept(fds[1]);
+  }
+
+  ~PeerSocket() {
+    close(fd_);
+  }
+
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+BENCHMARK(CommandQueueThroughput, n) {
+  BenchmarkSuspender suspender;
+  std::unique_ptr<LoopRunner> loop(new LoopRunner());
+  port::Semaphore done;
+  suspender.Dismiss();
+
+  for (size_t i = 1; i < n; ++i) {
+    std::unique_ptr<Command> command(MakeExecuteCommand([]() {}));
+    SendRetrying(*loop, std::move(command));
+  }
+  std::unique_ptr<Command> command(MakeExecuteCommand([&]() { done.Post(); }));
+  SendRetrying(*loop, std::move(command));
+  done.Wait();
+
+  BenchmarkSuspender teardown;
+  loop.reset();
+}
+
+BENCHMARK(CommandQueueRoundTrip, n) {
+  BenchmarkSuspender suspender;
+  std::unique_ptr<LoopRunner> loop(new LoopRunner());
+  port::Semaphore done;
+  auto post = [&]() { done.Post(); };
+  suspender.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    std::unique_ptr<Command> command(MakeExecuteCommand(post));
+    SendRetrying(*loop, std::move(command));
+    done.Wait();
+  }
+
+  BenchmarkSuspender teardown;
+  loop.reset();
+}
+
+BENCHMARK(CommandQueueSkewedRoundTrip, n) {
+  SkewedRoundTrip(n, EventLoop::Options().command_batch_latency);
+}
+
+BENCHMARK_RELATIVE(CommandQueueSkewedRoundTripFixedBatches, n) {
+  SkewedRoundTrip(n, std::chrono::microseconds(0));
+}
+
+BENCHMARK(CommandQueueSkewedThroughput, n) {
+  SkewedThroughput(n, EventLoop::Options().command_batch_latency);
+}
+
+BENCHMARK_RELATIVE(CommandQueueSkewedThroughputFixedBatches, n) {
+  SkewedThroughput(n, std::chrono::microseconds(0));
+}
+
+BENCHMARK(SocketReadFraming, n) {
+  BenchmarkSuspender suspender;
+  std::atomic<size_t> received(0);
+  port::Semaphore done;
+  std::unique_ptr<LoopRunner> loop(new LoopRunner(
+    [&](std::unique_ptr<Message> msg, StreamID origin) {
+      if (msg->GetMessageType() == MessageType::mDeliverData &&
+          ++received == n) {
+        done.Post();
+      }
+    }));
+  std::unique_ptr<PeerSocket> peer(new PeerSocket(*loop));
+
+  // Write frames in batches, as a busy peer would.
+  const size_t kBatch = 64;
+  const std::string frame = MakeFrame(1, MakeSerializedMessage());
+  std::string batch;
+  for (size_t i = 0; i < kBatch; ++i) {
+    batch.append(frame);
+  }
+  suspender.Dismiss();
+
+  size_t i = 0;
+  for (; i + kBatch <= n; i += kBatch) {
+    WriteFully(peer->fd(), batch.data(), batch.size());
+  }
+  WriteFully(peer->fd(), batch.data(), (n - i) * frame.size());
+  done.Wait();
+
+  BenchmarkSuspender teardown;
+  peer.reset();
+  loop.reset();
+}
+
+BENCHMARK(SocketWriteFraming, n) {
+  BenchmarkSuspender suspender;
+  std::atomic<StreamID> stream(0);
+  port::Semaphore connected;
+  std::unique_ptr<LoopRunner> loop(new LoopRunner(
+    [&](std::unique_ptr<Message> msg, StreamID origin) {
+      if (msg->GetMessageType() == MessageType::mDeliverData) {
+        stream = origin;
+        connected.Post();
+      }
+    }));
+  std::unique_ptr<PeerSocket> peer(new PeerSocket(*loop));
+
+  // The loop only learns about the stream once the peer sends on it. The
+  // responses are framed exactly like the handshake frame.
+  const std::string serial = MakeSerializedMessage();
+  const std::string frame = MakeFrame(1, serial);
+  WriteFully(peer->fd(), frame.data(), frame.size());
+  connected.Wait();
+  suspender.Dismiss();
+
+  std::thread reader([&]() { ReadFully(peer->fd(), n * frame.size()); });
+  for (size_t i = 0; i < n; ++i) {
+    SendRetrying(*loop,
+                 SerializedSendCommand::Response(serial, {stream.load()}));
+  }
+  reader.join();
+
+  BenchmarkSuspender teardown;
+  peer.reset();
+  loop.reset();
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
@@ -0,0 +1,194 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/messages/loopback.h"
+
+#include <cassert>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace rocketspeed {
+
+LoopbackChannel::LoopbackChannel()
+: closed_(false)
+, read_ready_(true, true) {
+  assert(read_ready_.status() == 0);
+}
+
+LoopbackChannel::~LoopbackChannel() {
+  read_ready_.closefd();
+}
+
+bool LoopbackChannel::Write(LoopbackFrame frame) {
+  bool notify;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return false;
+    }
+    // The reader drains until there are no frames, so it only needs waking
+    // when the first one arrives.
+    notify = frames_.empty();
+    frames_.emplace_back(std::move(frame));
+  }
+  if (notify) {
+    NotifyReader();
+  }
+  return true;
+}
+
+bool LoopbackChannel::Read(LoopbackFrame* frame, bool* closed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (frames_.empty()) {
+    *closed = closed_;
+    return false;
+  }
+  *frame = std::move(frames_.front());
+  frames_.pop_front();
+  return true;
+}
+
+void LoopbackChannel::ClearReadEvent() {
+  eventfd_t value;
+  read_ready_.read_event(&value);
+}
+
+void LoopbackChannel::NotifyReader() {
+  read_ready_.write_event(1);
+}
+
+void LoopbackChannel::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+  }
+  NotifyReader();
+}
+
+LoopbackTransport* LoopbackTransport::Default() {
+  static LoopbackTransport transport;
+  return &transport;
+}
+
+Status LoopbackTransport::Listen(int port,
+                                 std::function<Status(int handle)> accept) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto listener = std::make_shared<Listener>(std::move(accept));
+  if (!listeners_.emplace(port, std::move(listener)).second) {
+    return Status::IOError("Loopback port " + std::to_string(port) +
+                           " already in use");
+  }
+  return Status::OK();
+}
+
+void LoopbackTransport::Unlisten(int port) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = listeners_.find(port);
+  if (it == listeners_.end()) {
+    return;
+  }
+  std::shared_ptr<Listener> listener = std::move(it->second);
+  listeners_.erase(it);
+  // Wait for concurrent Connect calls that are still invoking it.
+  idle_.wait(lock, [&] () { return listener->active == 0; });
+
+  // Nobody is left to take the connections that were not taken yet.
+  for (auto acc = accepted_.begin(); acc != accepted_.end(); ) {
+    if (acc->second.port == port) {
+      acc = accepted_.erase(acc);
+    } else {
+      ++acc;
+    }
+  }
+}
+
+Status LoopbackTransport::Connect(const HostId& destination,
+                                  Endpoint* endpoint) {
+  if (!IsLoopbackAddress(destination)) {
+    return Status::NotFound("Not a loopback address");
+  }
+  const sockaddr* addr = destination.GetSockaddr();
+  const int port = addr->sa_family == AF_INET ?
+    ntohs(reinterpret_cast<const sockaddr_in*>(addr)->sin_port) :
+    ntohs(reinterpret_cast<const sockaddr_in6*>(addr)->sin6_port);
+
+  std::shared_ptr<Listener> listener;
+  Endpoint connecting;
+  int handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = listeners_.find(port);
+    if (it == listeners_.end()) {
+      return Status::NotFound("No loop listening on port " +
+                              std::to_string(port) + " in this process");
+    }
+
+    Accepted accepted;
+    accepted.endpoint.in = std::make_shared<LoopbackChannel>();
+    accepted.endpoint.out = std::make_shared<LoopbackChannel>();
+    accepted.port = port;
+    connecting.in = accepted.endpoint.out;
+    connecting.out = accepted.endpoint.in;
+
+    // The read descriptor stays open while the channel is referenced from
+    // accepted_, so it cannot be reused as a handle meanwhile.
+    handle = accepted.endpoint.in->GetReadFd();
+    accepted_.emplace(handle, std::move(accepted));
+
+    // Unlisten waits until the callback has returned.
+    listener = it->second;
+    ++listener->active;
+  }
+
+  Status st = listener->accept(handle);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --listener->active;
+    if (!st.ok()) {
+      // The connection will never be taken.
+      accepted_.erase(handle);
+    }
+  }
+  idle_.notify_all();
+  if (!st.ok()) {
+    return st;
+  }
+  *endpoint = std::move(connecting);
+  return Status::OK();
+}
+
+bool LoopbackTransport::TakeAccepted(int handle, Endpoint* endpoint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = accepted_.find(handle);
+  if (it == accepted_.end()) {
+    return false;
+  }
+  *endpoint = std::move(it->second.endpoint);
+  accepted_.erase(it);
+  return true;
+}
+
+bool LoopbackTransport::IsLoopbackAddress(const HostId& host) {
+  if (!host) {
+    return false;
+  }
+  const sockaddr* addr = host.GetSockaddr();
+  if (addr->sa_family == AF_INET) {
+    const uint32_t ip = ntohl(
+      reinterpret_cast<const sockaddr_in*>(addr)->sin_addr.s_addr);
+    return (ip >> 24) == 127;
+  }
+  if (addr->sa_family == AF_INET6) {
+    const in6_addr& ip = reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr;
+    return IN6_IS_ADDR_LOOPBACK(&ip) ||
+      (IN6_IS_ADDR_V4MAPPED(&ip) && ip.s6_addr[12] == 127);
+  }
+  return false;
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,177 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "include/Status.h"
+#include "src/port/port.h"
+#include "src/util/common/block_pool.h"
+#include "src/util/common/host_id.h"
+
+namespace rocketspeed {
+
+/**
+ * A frame handed over a loopback connection: the encoded origin stream
+ * followed by the serialized message. Frames carry no header, since their
+ * boundaries are kept.
+ */
+struct LoopbackFrame {
+  PooledBuffer data;
+  size_t size = 0;
+};
+
+/**
+ * One direction of an in-process connection. The writing EventLoop appends
+ * frames under a mutex, and the reading EventLoop is woken through an
+ * eventfd, so no data goes through the kernel.
+ *
+ * Thread safe.
+ */
+class LoopbackChannel {
+ public:
+  LoopbackChannel();
+
+  ~LoopbackChannel();
+
+  /**
+   * Appends a frame.
+   *
+   * @param frame The frame to append.
+   * @return false if the channel is closed, in which case the frame is
+   *         dropped.
+   */
+  bool Write(LoopbackFrame frame);
+
+  /**
+   * Takes the next frame.
+   *
+   * @param frame Output for the frame.
+   * @param closed Set to whether the channel is closed, when there are no
+   *               frames.
+   * @return true iff a frame was read.
+   */
+  bool Read(LoopbackFrame* frame, bool* closed);
+
+  /**
+   * Clears the read notification. The reader must call this before it
+   * starts reading, and must either read until there are no frames or call
+   * NotifyReader.
+   */
+  void ClearReadEvent();
+
+  /** Makes the read descriptor readable again. */
+  void NotifyReader();
+
+  /**
+   * Closes the channel. The reader still gets the frames written before,
+   * then sees the channel closed. Writes fail from now on.
+   */
+  void Close();
+
+  /** @return Descriptor that is readable when there is something to read. */
+  int GetReadFd() const {
+    return read_ready_.readfd();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<LoopbackFrame> frames_;
+  bool closed_;
+  port::Eventfd read_ready_;
+};
+
+/**
+ * Connects EventLoops in the same process without sockets. A loop that
+ * listens on a port registers itself, and connections to a loopback address
+ * with that port are made of a pair of LoopbackChannels instead of a TCP
+ * connection. Anything else, e.g. hosts in other processes, is left to TCP.
+ *
+ * Thread safe.
+ */
+class LoopbackTransport {
+ public:
+  /** Both directions of a connection, as seen from one end. */
+  struct Endpoint {
+    std::shared_ptr<LoopbackChannel> in;
+    std::shared_ptr<LoopbackChannel> out;
+  };
+
+  /** @return The transport shared by the whole process. */
+  static LoopbackTransport* Default();
+
+  /**
+   * Starts accepting connections on a port.
+   *
+   * @param port Port to listen on.
+   * @param accept Invoked with a handle to each new connection, from the
+   *               thread that connects, without holding the transport's
+   *               lock. The handle is a descriptor, unique in the process
+   *               until the connection is taken with TakeAccepted. Returns
+   *               an error if the connection cannot be handed over, which
+   *               fails the Connect call. Must not call Unlisten.
+   * @return Error if the port is already in use.
+   */
+  Status Listen(int port, std::function<Status(int handle)> accept);
+
+  /**
+   * Stops accepting connections on a port. Once this returns, the accept
+   * callback is not running and will not be invoked again, and connections
+   * that were not taken yet are dropped.
+   */
+  void Unlisten(int port);
+
+  /**
+   * Connects to a loop in this process.
+   *
+   * @param destination Host to connect to.
+   * @param endpoint Output for the connecting end.
+   * @return NotFound if the destination is not in this process, or the
+   *         error of the accept callback.
+   */
+  Status Connect(const HostId& destination, Endpoint* endpoint);
+
+  /**
+   * Claims the accepted end of a connection.
+   *
+   * @param handle Handle passed to the accept callback.
+   * @param endpoint Output for the accepted end.
+   * @return true iff handle belongs to a connection on this transport.
+   */
+  bool TakeAccepted(int handle, Endpoint* endpoint);
+
+  /** @return true iff host has a loopback address. */
+  static bool IsLoopbackAddress(const HostId& host);
+
+ private:
+  struct Listener {
+    explicit Listener(std::function<Status(int)> _accept)
+    : accept(std::move(_accept))
+    , active(0) {
+    }
+
+    const std::function<Status(int)> accept;
+    // Number of Connect calls that are invoking the callback.
+    int active;
+  };
+
+  struct Accepted {
+    Endpoint endpoint;
+    int port;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::unordered_map<int, std::shared_ptr<Listener>> listeners_;
+  std::unordered_map<int, Accepted> accepted_;
+};
+
+}  // namespace rocketspeed
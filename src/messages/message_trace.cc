@@ -0,0 +1,117 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/messages/message_trace.h"
+
+#include <chrono>
+
+#include "src/util/common/coding.h"
+#include "src/util/common/statistics.h"
+
+namespace rocketspeed {
+
+namespace {
+
+/** Set in the leading byte of an encoded trace. */
+const uint8_t kTraceSampled = 0x01;
+
+/** Upper bound on hops in a trace, to reject garbage. */
+const uint32_t kMaxTraceHops = 64;
+
+const char* const kTraceStageNames[size_t(TraceStage::max) + 1] = {
+  "publish",
+  "pilot_receive",
+  "tower_read",
+  "tower_cache",
+  "copilot_receive",
+  "deliver",
+};
+
+// Hops come from different hosts, so consecutive timestamps may go back.
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // namespace
+
+uint64_t MessageTrace::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* MessageTrace::StageName(TraceStage stage) {
+  return stage <= TraceStage::max ? kTraceStageNames[size_t(stage)] : "unknown";
+}
+
+uint64_t MessageTrace::AddHop(TraceStage stage, uint64_t now_micros) {
+  uint64_t elapsed = 0;
+  if (!hops_.empty() && now_micros > hops_.back().micros) {
+    elapsed = now_micros - hops_.back().micros;
+  }
+  hops_.push_back(Hop{stage, now_micros});
+  return elapsed;
+}
+
+void MessageTrace::RecordHopSlow(TraceStage stage, Histogram* latency) {
+  latency->Record(AddHop(stage));
+}
+
+uint64_t MessageTrace::GetTotalMicros() const {
+  if (hops_.empty() || hops_.back().micros < hops_.front().micros) {
+    return 0;
+  }
+  return hops_.back().micros - hops_.front().micros;
+}
+
+void MessageTrace::EncodeTo(std::string* out) const {
+  if (hops_.empty()) {
+    return;
+  }
+  PutFixed8(out, kTraceSampled);
+  PutVarint32(out, static_cast<uint32_t>(hops_.size()));
+  uint64_t previous = 0;
+  for (const Hop& hop : hops_) {
+    PutFixed8(out, static_cast<uint8_t>(hop.stage));
+    PutVarint64(out, ZigZag(static_cast<int64_t>(hop.micros - previous)));
+    previous = hop.micros;
+  }
+}
+
+Status MessageTrace::DecodeFrom(Slice* in) {
+  hops_.clear();
+  if (in->empty()) {
+    return Status::OK();
+  }
+  uint8_t flags;
+  uint32_t count;
+  if (!GetFixed8(in, &flags) ||
+      !GetVarint32(in, &count) ||
+      count > kMaxTraceHops) {
+    return Status::InvalidArgument("Bad trace header");
+  }
+  if (!(flags & kTraceSampled)) {
+    return Status::OK();
+  }
+  hops_.reserve(count);
+  uint64_t previous = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint8_t stage;
+    uint64_t delta;
+    if (!GetFixed8(in, &stage) || !GetVarint64(in, &delta)) {
+      hops_.clear();
+      return Status::InvalidArgument("Bad trace hop");
+    }
+    previous += static_cast<uint64_t>(UnZigZag(delta));
+    hops_.push_back(Hop{static_cast<TraceStage>(stage), previous});
+  }
+  return Status::OK();
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,102 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "include/Slice.h"
+#include "include/Status.h"
+
+namespace rocketspeed {
+
+class Histogram;
+
+/** Points along the publish to delivery pipeline where a trace is stamped. */
+enum class TraceStage : uint8_t {
+  kPublish = 0,         // client accepted the publish
+  kPilotReceive = 1,    // pilot received the publish
+  kTowerRead = 2,       // tower read the record from the log
+  kTowerCache = 3,      // tower served the record from its cache
+  kCopilotReceive = 4,  // copilot received the delivery from the tower
+  kDeliver = 5,         // client handed the message to the application
+  max = kDeliver,
+};
+
+/**
+ * Trace context of a sampled message. Each hop appends its stage and the
+ * wall clock time it saw the message, so the latency of every stage can be
+ * recovered at any later hop. Clocks of different hosts are not synchronised,
+ * so cross host stages are only as accurate as the clocks are.
+ *
+ * An unsampled message has an empty trace, which takes no space on the wire
+ * or in the log, and no allocation in memory.
+ */
+class MessageTrace {
+ public:
+  struct Hop {
+    TraceStage stage;
+    uint64_t micros;
+  };
+
+  /** @return Current wall clock time in microseconds. */
+  static uint64_t NowMicros();
+
+  /** @return Short name of a stage, used for naming statistics. */
+  static const char* StageName(TraceStage stage);
+
+  /** @return true iff the message is being traced. */
+  bool IsSampled() const {
+    return !hops_.empty();
+  }
+
+  /**
+   * Stamps the message at a stage, which starts the trace if this is the
+   * first hop.
+   *
+   * @param stage Stage the message has reached.
+   * @param now_micros Time it reached the stage.
+   * @return Microseconds since the previous hop, or 0 for the first one.
+   */
+  uint64_t AddHop(TraceStage stage, uint64_t now_micros = NowMicros());
+
+  /**
+   * Stamps a sampled message and records the time since the previous hop.
+   * Does nothing if the message is not sampled.
+   */
+  void RecordHop(TraceStage stage, Histogram* latency) {
+    if (IsSampled()) {
+      RecordHopSlow(stage, latency);
+    }
+  }
+
+  /** @return Microseconds between the first and the last hop. */
+  uint64_t GetTotalMicros() const;
+
+  const std::vector<Hop>& GetHops() const {
+    return hops_;
+  }
+
+  /**
+   * Appends the trace to a serialized message. Appends nothing if the
+   * message is not sampled, so traces must be the last part of a message.
+   */
+  void EncodeTo(std::string* out) const;
+
+  /**
+   * Parses a trace from the rest of a serialized message. No bytes left
+   * means the message is not sampled.
+   */
+  Status DecodeFrom(Slice* in);
+
+ private:
+  void RecordHopSlow(TraceStage stage, Histogram* latency);
+
+  std::vector<Hop> hops_;
+};
+
+}  // namespace rocketspeed
@@ -23,6 +23,50 @@
  */
 namespace rocketspeed {
 
+namespace {
+
+/**
+ * Appends the message ID of data messages, preceded by the payload codec
+ * unless the payload is uncompressed. The codec is a one byte field where
+ * the message ID used to be, so readers that predate compression reject
+ * compressed messages as having a bad message ID, rather than passing the
+ * compressed bytes on as the payload.
+ */
+void EncodeMessageId(std::string* out,
+                     const MsgId& msgid,
+                     CompressionType compression) {
+  if (compression != CompressionType::kNone) {
+    const char codec = static_cast<char>(compression);
+    PutLengthPrefixedSlice(out, Slice(&codec, sizeof(codec)));
+  }
+  PutLengthPrefixedSlice(out, Slice((const char*)&msgid, sizeof(msgid)));
+}
+
+bool DecodeMessageId(Slice* in,
+                     MsgId* msgid,
+                     CompressionType* compression) {
+  Slice id_slice;
+  if (!GetLengthPrefixedSlice(in, &id_slice)) {
+    return false;
+  }
+  *compression = CompressionType::kNone;
+  if (id_slice.size() == sizeof(uint8_t)) {
+    // Not validated, servers pass codecs of newer clients through and
+    // subscribers check that they support them.
+    *compression = static_cast<CompressionType>(id_slice[0]);
+    if (!GetLengthPrefixedSlice(in, &id_slice)) {
+      return false;
+    }
+  }
+  if (id_slice.size() < sizeof(*msgid)) {
+    return false;
+  }
+  memcpy(msgid, id_slice.data(), sizeof(*msgid));
+  return true;
+}
+
+}  // namespace
+
 const char* const kMessageTypeNames[size_t(MessageType::max) + 1] = {
   "invalid",
   "ping",
@@ -171,6 +215,11 @@ std::unique_ptr<Message> Message::CreateNewInstance(std::unique_ptr<char[]> in,
 
 std::unique_ptr<Message> Message::CreateNewInstance(std::unique_ptr<char[]> in,
                                                     Slice slice) {
+  return CreateNewInstance(PooledBuffer(in.release()), slice);
+}
+
+std::unique_ptr<Message> Message::CreateNewInstance(PooledBuffer in,
+                                                    Slice slice) {
   std::unique_ptr<Message> msg = Message::CreateNewInstance(&slice);
   if (msg) {
     msg->buffer_ = std::move(in);
@@ -251,7 +300,8 @@ MessageData::MessageData(MessageType type,
   Message(type, tenantID),
   topic_name_(topic_name),
   payload_(payload),
-  namespaceid_(namespace_id) {
+  namespaceid_(namespace_id),
+  compression_(CompressionType::kNone) {
   assert(type == MessageType::mPublish || type == MessageType::mDeliver);
   seqno_ = 0;
   seqno_prev_ = 0;
@@ -317,10 +367,18 @@ size_t MessageData::GetTotalSize() const {
 void MessageData::SerializeInternal() const {
   PutFixed16(&serialize_buffer__, tenantid_);
   PutTopicID(&serialize_buffer__, namespaceid_, topic_name_);
-  PutLengthPrefixedSlice(&serialize_buffer__,
-                         Slice((const char*)&msgid_, sizeof(msgid_)));
+  EncodeMessageId(&serialize_buffer__, msgid_, compression_);
 
   PutLengthPrefixedSlice(&serialize_buffer__, payload_);
+
+  // Older readers stop after the payload, so the trace must come last.
+  trace_.EncodeTo(&serialize_buffer__);
+}
+
+Slice MessageData::SerializeStorage() const {
+  serialize_buffer__.clear();
+  SerializeInternal();
+  return Slice(serialize_buffer__);
 }
 
 Status MessageData::DeSerializeStorage(Slice* in) {
@@ -334,19 +392,18 @@ Status MessageData::DeSerializeStorage(Slice* in) {
     return Status::InvalidArgument("Bad Message Topic ID");
   }
 
-  // extract message id
-  Slice idSlice;
-  if (!GetLengthPrefixedSlice(in, &idSlice) ||
-      idSlice.size() < sizeof(msgid_)) {
+  // extract message id and payload codec
+  if (!DecodeMessageId(in, &msgid_, &compression_)) {
     return Status::InvalidArgument("Bad Message Id");
   }
-  memcpy(&msgid_, idSlice.data(), sizeof(msgid_));
 
-  // extract payload (the rest of the message)
+  // extract payload
   if (!GetLengthPrefixedSlice(in, &payload_)) {
     return Status::InvalidArgument("Bad payload");
   }
-  return Status::OK();
+
+  // extract trace (the rest of the message)
+  return trace_.DecodeFrom(in);
 }
 
 MessageDataAck::MessageDataAck(TenantID tenantID,
@@ -617,11 +674,9 @@ Status MessageUnsubscribe::DeSerialize(Slice* in) {
 
 Slice MessageDeliver::Serialize() const {
   Message::Serialize();
-  PutVarint64(&serialize_buffer__, sub_id_);
-  PutVarint64(&serialize_buffer__, seqno_prev_);
   assert(seqno_ >= seqno_prev_);
-  uint64_t seqno_diff = seqno_ - seqno_prev_;
-  PutVarint64(&serialize_buffer__, seqno_diff);
+  const uint64_t fields[] = { sub_id_, seqno_prev_, seqno_ - seqno_prev_ };
+  PutVarint64Array(&serialize_buffer__, fields, 3);
   return Slice(serialize_buffer__);
 }
 
@@ -630,17 +685,15 @@ Status MessageDeliver::DeSerialize(Slice* in) {
   if (!st.ok()) {
     return st;
   }
-  if (!GetVarint64(in, &sub_id_)) {
-    return Status::InvalidArgument("Bad SubscriptionID");
-  }
-  if (!GetVarint64(in, &seqno_prev_)) {
-    return Status::InvalidArgument("Bad previous SequenceNumber");
+  // SubscriptionID, previous SequenceNumber and the difference between
+  // SequenceNumbers, decoded together as this is on every delivery.
+  uint64_t fields[3];
+  if (!GetVarint64Array(in, fields, 3)) {
+    return Status::InvalidArgument("Bad SubscriptionID or SequenceNumbers");
   }
-  uint64_t seqno_diff;
-  if (!GetVarint64(in, &seqno_diff)) {
-    return Status::InvalidArgument("Bad difference between SequenceNumbers");
-  }
-  seqno_ = seqno_prev_ + seqno_diff;
+  sub_id_ = fields[0];
+  seqno_prev_ = fields[1];
+  seqno_ = seqno_prev_ + fields[2];
   assert(seqno_ >= seqno_prev_);
   return Status::OK();
 }
@@ -664,9 +717,9 @@ Status MessageDeliverGap::DeSerialize(Slice* in) {
 
 Slice MessageDeliverData::Serialize() const {
   MessageDeliver::Serialize();
-  PutLengthPrefixedSlice(&serialize_buffer__,
-                         Slice((const char*)&message_id_, sizeof(message_id_)));
+  EncodeMessageId(&serialize_buffer__, message_id_, compression_);
   PutLengthPrefixedSlice(&serialize_buffer__, payload_);
+  trace_.EncodeTo(&serialize_buffer__);
   return Slice(serialize_buffer__);
 }
 
@@ -675,16 +728,13 @@ Status MessageDeliverData::DeSerialize(Slice* in) {
   if (!st.ok()) {
     return st;
   }
-  Slice id_slice;
-  if (!GetLengthPrefixedSlice(in, &id_slice) ||
-      id_slice.size() < sizeof(message_id_)) {
+  if (!DecodeMessageId(in, &message_id_, &compression_)) {
     return Status::InvalidArgument("Bad Message ID");
   }
-  memcpy(&message_id_, id_slice.data(), sizeof(message_id_));
   if (!GetLengthPrefixedSlice(in, &payload_)) {
     return Status::InvalidArgument("Bad payload");
   }
-  return Status::OK();
+  return trace_.DecodeFrom(in);
 }
 
 }  // namespace rocketspeed
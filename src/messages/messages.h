@@ -13,8 +13,10 @@
 #include "include/Slice.h"
 #include "include/Status.h"
 #include "include/Types.h"
+#include "src/messages/message_trace.h"
 #include "src/messages/serializer.h"
 #include "src/util/common/autovector.h"
+#include "src/util/common/block_pool.h"
 
 /*
  * This file contains all the messages used by RocketSpeed. These messages are
@@ -59,6 +61,25 @@ inline const char* MessageTypeName(MessageType type) {
   return ValidateEnum(type) ? kMessageTypeNames[size_t(type)] : "invalid";
 }
 
+/**
+ * Control messages set up and tear down subscriptions and streams. They are
+ * small, and sent ahead of data messages so that subscription latency and
+ * failure detection hold up under load.
+ */
+inline bool IsControlMessage(MessageType type) {
+  switch (type) {
+    case MessageType::mPing:
+    case MessageType::mGoodbye:
+    case MessageType::mSubscribe:
+    case MessageType::mUnsubscribe:
+    case MessageType::mFindTailSeqno:
+    case MessageType::mTailSeqno:
+      return true;
+    default:
+      return false;
+  }
+}
+
 /*
  * The metadata messages can be of two subtypes
  */
@@ -150,6 +171,12 @@ class Message : public Serializer {
   static std::unique_ptr<Message> CreateNewInstance(std::unique_ptr<char[]> in,
                                                     Slice slice);
 
+  /**
+   * As above, for a buffer that may come from BlockPool.
+   */
+  static std::unique_ptr<Message> CreateNewInstance(PooledBuffer in,
+                                                    Slice slice);
+
   /*
    * Inherited from Serializer
    */
@@ -161,6 +188,18 @@ class Message : public Serializer {
    */
   static std::unique_ptr<Message> Copy(const Message& msg);
 
+  /**
+   * Messages are allocated from the pool of the allocating thread, and go
+   * back there wherever they are destroyed.
+   */
+  static void* operator new(size_t size) {
+    return BlockPool::Allocate(size);
+  }
+
+  static void operator delete(void* ptr) {
+    BlockPool::Free(ptr);
+  }
+
  protected:
   Message(MessageType type, TenantID tenantid) :
           type_(type), tenantid_(tenantid) {
@@ -176,7 +215,7 @@ class Message : public Serializer {
 
   MessageType type_;                // type of this message
   TenantID tenantid_;               // unique id for tenant
-  std::unique_ptr<char[]> buffer_;  // owned memory for slices
+  PooledBuffer buffer_;             // owned memory for slices
 
  private:
   static std::unique_ptr<Message> CreateNewInstance(Slice* in);
@@ -311,16 +350,42 @@ class MessageData : public Message {
   Slice GetNamespaceId() const { return namespaceid_; }
 
   /**
-   * @return The Message payload
+   * @return The Message payload, compressed with GetCompression().
    */
   Slice GetPayload() const { return payload_; }
 
+  /**
+   * @return Codec the payload was compressed with by the publisher.
+   */
+  CompressionType GetCompression() const { return compression_; }
+
+  /**
+   * Sets the codec the payload was compressed with.
+   */
+  void SetCompression(CompressionType compression) {
+    compression_ = compression;
+  }
+
+  /**
+   * @return Trace context of the message, empty unless it was sampled.
+   */
+  MessageTrace* GetTrace() { return &trace_; }
+  const MessageTrace* GetTrace() const { return &trace_; }
+
   /**
    * @return the slice containing tenant ID, topic_name and paylodad from
    * buffer_
    */
   Slice GetStorageSlice() const;
 
+  /**
+   * Serializes the message in the log storage format, e.g. after its trace
+   * was stamped, so GetStorageSlice no longer matches its contents.
+   *
+   * @return Slice that is valid until the message is serialized again.
+   */
+  Slice SerializeStorage() const;
+
   /*
    * Inherited from Serializer
    */
@@ -351,6 +416,8 @@ class MessageData : public Message {
   Slice payload_;             // user data of message
   Slice namespaceid_;         // message namespace
   Slice storage_slice_;       // slice starting from tenantid from buffer_
+  MessageTrace trace_;        // hops of a sampled message
+  CompressionType compression_;  // codec of payload_
 };
 
 /*
@@ -797,17 +864,25 @@ class MessageDeliverData final : public MessageDeliver {
   MessageDeliverData(TenantID tenant_id,
                      SubscriptionID sub_id,
                      MsgId message_id,
-                     Slice payload)
+                     Slice payload,
+                     CompressionType compression = CompressionType::kNone)
       : MessageDeliver(MessageType::mDeliverData, tenant_id, sub_id)
       , message_id_(message_id)
-      , payload_(payload) {}
+      , payload_(payload)
+      , compression_(compression) {}
 
   MessageDeliverData() : MessageDeliver(MessageType::mDeliverData) {}
 
   const MsgId& GetMessageID() const { return message_id_; };
 
+  /** @return The payload, compressed with GetCompression(). */
   Slice GetPayload() const { return payload_; }
 
+  CompressionType GetCompression() const { return compression_; }
+
+  MessageTrace* GetTrace() { return &trace_; }
+  const MessageTrace* GetTrace() const { return &trace_; }
+
   Slice Serialize() const override;
   Status DeSerialize(Slice* in) override;
 
@@ -816,6 +891,10 @@ class MessageDeliverData final : public MessageDeliver {
   MsgId message_id_;
   /** Payload delivered with the message. */
   Slice payload_;
+  /** Codec the publisher compressed the payload with. */
+  CompressionType compression_ = CompressionType::kNone;
+  /** Trace carried over from the published message, if it was sampled. */
+  MessageTrace trace_;
 };
 /** @} */
 
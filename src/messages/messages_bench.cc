@@ -0,0 +1,154 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "src/messages/messages.h"
+#include "src/util/benchharness.h"
+#include "src/util/common/guid_generator.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+namespace {
+
+const std::string kPayload(100, 'x');
+
+std::unique_ptr<Message> MakeMessage(MessageType type) {
+  switch (type) {
+    case MessageType::mPing:
+      return std::unique_ptr<Message>(new MessagePing(
+        Tenant::GuestTenant, MessagePing::Request, "cookie"));
+    case MessageType::mPublish: {
+      std::unique_ptr<MessageData> data(new MessageData(
+        MessageType::mPublish, Tenant::GuestTenant,
+        "benchmark.topic", GuestNamespace, kPayload));
+      data->SetSequenceNumbers(1000, 1001);
+      return std::move(data);
+    }
+    case MessageType::mDataAck: {
+      MessageDataAck::AckVector acks(1);
+      acks[0].msgid = GUIDGenerator().Generate();
+      return std::unique_ptr<Message>(new MessageDataAck(
+        Tenant::GuestTenant, acks));
+    }
+    case MessageType::mGap:
+      return std::unique_ptr<Message>(new MessageGap(
+        Tenant::GuestTenant, GuestNamespace, "benchmark.topic",
+        GapType::kBenign, 1000, 2000));
+    case MessageType::mGoodbye:
+      return std::unique_ptr<Message>(new MessageGoodbye(
+        Tenant::GuestTenant,
+        MessageGoodbye::Code::Graceful,
+        MessageGoodbye::Client));
+    case MessageType::mSubscribe:
+      return std::unique_ptr<Message>(new MessageSubscribe(
+        Tenant::GuestTenant, GuestNamespace, "benchmark.topic", 1000, 42));
+    case MessageType::mUnsubscribe:
+      return std::unique_ptr<Message>(new MessageUnsubscribe(
+        Tenant::GuestTenant, 42, MessageUnsubscribe::Reason::kRequested));
+    case MessageType::mDeliverGap: {
+      std::unique_ptr<MessageDeliverGap> gap(new MessageDeliverGap(
+        Tenant::GuestTenant, 42, GapType::kBenign));
+      gap->SetSequenceNumbers(1000, 2000);
+      return std::move(gap);
+    }
+    case MessageType::mDeliverData: {
+      std::unique_ptr<MessageDeliverData> data(new MessageDeliverData(
+        Tenant::GuestTenant, 42, GUIDGenerator().Generate(), kPayload));
+      data->SetSequenceNumbers(1000, 1001);
+      return std::move(data);
+    }
+    case MessageType::mFindTailSeqno:
+      return std::unique_ptr<Message>(new MessageFindTailSeqno(
+        Tenant::GuestTenant, GuestNamespace, "benchmark.topic"));
+    case MessageType::mTailSeqno:
+      return std::unique_ptr<Message>(new MessageTailSeqno(
+        Tenant::GuestTenant, GuestNamespace, "benchmark.topic", 1000));
+    case MessageType::mDeliver:
+    case MessageType::NotInitialized:
+      break;
+  }
+  return nullptr;
+}
+
+void Serialize(MessageType type, size_t iters) {
+  std::unique_ptr<Message> msg;
+  {
+    BenchmarkSuspender suspender;
+    msg = MakeMessage(type);
+  }
+  std::string serial;
+  for (size_t i = 0; i < iters; ++i) {
+    msg->SerializeToString(&serial);
+    DoNotOptimizeAway(serial);
+  }
+}
+
+void Deserialize(MessageType type, size_t iters) {
+  std::string serial;
+  {
+    BenchmarkSuspender suspender;
+    MakeMessage(type)->SerializeToString(&serial);
+  }
+  // Includes copying into an owned buffer, as when reading from a socket.
+  for (size_t i = 0; i < iters; ++i) {
+    std::unique_ptr<char[]> buffer(new char[serial.size()]);
+    memcpy(buffer.get(), serial.data(), serial.size());
+    auto msg = Message::CreateNewInstance(std::move(buffer), serial.size());
+    DoNotOptimizeAway(msg);
+  }
+}
+
+void DeserializePooled(MessageType type, size_t iters) {
+  std::string serial;
+  {
+    BenchmarkSuspender suspender;
+    MakeMessage(type)->SerializeToString(&serial);
+  }
+  // As above, with the receive buffer from BlockPool, as in EventLoop.
+  for (size_t i = 0; i < iters; ++i) {
+    PooledBuffer buffer = AllocatePooledBuffer(serial.size());
+    memcpy(buffer.get(), serial.data(), serial.size());
+    Slice slice(buffer.get(), serial.size());
+    auto msg = Message::CreateNewInstance(std::move(buffer), slice);
+    DoNotOptimizeAway(msg);
+  }
+}
+
+}  // namespace
+
+#define MESSAGE_BENCHMARKS(type)                      \
+  BENCHMARK(type##Serialize, n) {                     \
+    Serialize(MessageType::type, n);                  \
+  }                                                   \
+  BENCHMARK(type##Deserialize, n) {                   \
+    Deserialize(MessageType::type, n);                \
+  }                                                   \
+  BENCHMARK_RELATIVE(type##DeserializePooled, n) {    \
+    DeserializePooled(MessageType::type, n);          \
+  }
+
+MESSAGE_BENCHMARKS(mPing)
+MESSAGE_BENCHMARKS(mPublish)
+MESSAGE_BENCHMARKS(mDataAck)
+MESSAGE_BENCHMARKS(mGap)
+MESSAGE_BENCHMARKS(mGoodbye)
+MESSAGE_BENCHMARKS(mSubscribe)
+MESSAGE_BENCHMARKS(mUnsubscribe)
+MESSAGE_BENCHMARKS(mDeliverGap)
+MESSAGE_BENCHMARKS(mDeliverData)
+MESSAGE_BENCHMARKS(mFindTailSeqno)
+MESSAGE_BENCHMARKS(mTailSeqno)
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
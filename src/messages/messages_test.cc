@@ -4,15 +4,21 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 //
 
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
 #include "src/messages/messages.h"
 #include "src/messages/msg_loop.h"
+#include "src/messages/queues.h"
 #include "src/port/port.h"
 #include "src/util/testharness.h"
+#include "src/util/common/coding.h"
 #include "src/util/common/multi_producer_queue.h"
+#include "src/util/common/parsing.h"
 #include "src/util/common/guid_generator.h"
 
 namespace rocketspeed {
@@ -236,6 +242,128 @@ TEST(Messaging, MessageDeliverData) {
   ASSERT_EQ(msg1.GetPayload().ToString(), msg2.GetPayload().ToString());
 }
 
+TEST(Messaging, Trace) {
+  MessageData data1(MessageType::mPublish,
+                    Tenant::GuestTenant, "topic", GuestNamespace, "payload");
+
+  // Unsampled messages are unchanged on the wire.
+  std::string untraced;
+  data1.SerializeToString(&untraced);
+  MessageData data2;
+  Slice in(untraced);
+  ASSERT_OK(data2.DeSerialize(&in));
+  ASSERT_TRUE(!data2.GetTrace()->IsSampled());
+
+  // Hops survive publish and storage, even if clocks go back.
+  data1.GetTrace()->AddHop(TraceStage::kPublish, 1000000);
+  ASSERT_EQ(data1.GetTrace()->AddHop(TraceStage::kPilotReceive, 1000250), 250U);
+  ASSERT_EQ(data1.GetTrace()->AddHop(TraceStage::kTowerRead, 999000), 0U);
+  std::string traced;
+  data1.SerializeToString(&traced);
+  ASSERT_GT(traced.size(), untraced.size());
+  in = Slice(traced);
+  ASSERT_OK(data2.DeSerialize(&in));
+  ASSERT_EQ(data2.GetPayload().ToString(), "payload");
+  const auto& hops = data2.GetTrace()->GetHops();
+  ASSERT_EQ(hops.size(), 3U);
+  ASSERT_TRUE(hops[0].stage == TraceStage::kPublish);
+  ASSERT_EQ(hops[0].micros, 1000000U);
+  ASSERT_TRUE(hops[2].stage == TraceStage::kTowerRead);
+  ASSERT_EQ(hops[2].micros, 999000U);
+
+  MessageData stored(MessageType::mDeliver);
+  Slice storage = data2.GetStorageSlice();
+  ASSERT_OK(stored.DeSerializeStorage(&storage));
+  ASSERT_EQ(stored.GetTrace()->GetHops().size(), 3U);
+
+  // The trace is handed over to deliveries.
+  MessageDeliverData deliver1(Tenant::GuestTenant, 42, data2.GetMessageId(),
+                              data2.GetPayload());
+  *deliver1.GetTrace() = *data2.GetTrace();
+  deliver1.GetTrace()->AddHop(TraceStage::kDeliver, 1002000);
+  in = deliver1.Serialize();
+  MessageDeliverData deliver2;
+  ASSERT_OK(deliver2.DeSerialize(&in));
+  ASSERT_EQ(deliver2.GetPayload().ToString(), "payload");
+  ASSERT_EQ(deliver2.GetTrace()->GetHops().size(), 4U);
+  ASSERT_EQ(deliver2.GetTrace()->GetTotalMicros(), 2000U);
+
+  // Truncated traces are rejected.
+  traced.pop_back();
+  in = Slice(traced);
+  ASSERT_TRUE(!data2.DeSerialize(&in).ok());
+}
+
+TEST(Messaging, PayloadCompression) {
+  MessageData data1(MessageType::mPublish,
+                    Tenant::GuestTenant, "topic", GuestNamespace, "payload");
+  std::string plain;
+  data1.SerializeToString(&plain);
+
+  // The codec survives publish and storage, with or without a trace.
+  for (bool sampled : {false, true}) {
+    MessageData data(MessageType::mPublish,
+                     Tenant::GuestTenant, "topic", GuestNamespace, "payload");
+    data.SetCompression(CompressionType::kLZ4);
+    if (sampled) {
+      data.GetTrace()->AddHop(TraceStage::kPublish, 1000000);
+    }
+    std::string compressed;
+    data.SerializeToString(&compressed);
+    ASSERT_GT(compressed.size(), plain.size());
+
+    MessageData data2;
+    Slice in(compressed);
+    ASSERT_OK(data2.DeSerialize(&in));
+    ASSERT_TRUE(in.empty());
+    ASSERT_TRUE(data2.GetCompression() == CompressionType::kLZ4);
+    ASSERT_EQ(data2.GetPayload().ToString(), "payload");
+    ASSERT_EQ(data2.GetTrace()->IsSampled(), sampled);
+
+    MessageData stored(MessageType::mDeliver);
+    Slice storage = data2.GetStorageSlice();
+    ASSERT_OK(stored.DeSerializeStorage(&storage));
+    ASSERT_TRUE(stored.GetCompression() == CompressionType::kLZ4);
+    ASSERT_EQ(stored.GetTrace()->IsSampled(), sampled);
+
+    // Deliveries carry the codec to the subscriber.
+    MessageDeliverData deliver1(Tenant::GuestTenant, 42, data2.GetMessageId(),
+                                data2.GetPayload(), data2.GetCompression());
+    const std::string delivered = deliver1.Serialize().ToString();
+    in = Slice(delivered);
+    MessageDeliverData deliver2;
+    ASSERT_OK(deliver2.DeSerialize(&in));
+    ASSERT_TRUE(deliver2.GetCompression() == CompressionType::kLZ4);
+    ASSERT_EQ(deliver2.GetPayload().ToString(), "payload");
+
+    // Readers that predate compression find a message ID that is too short
+    // in its place, and reject the message.
+    storage = data2.GetStorageSlice();
+    uint16_t tenant;
+    Slice namespace_id, topic, id_slice;
+    ASSERT_TRUE(GetFixed16(&storage, &tenant));
+    ASSERT_TRUE(GetTopicID(&storage, &namespace_id, &topic));
+    ASSERT_TRUE(GetLengthPrefixedSlice(&storage, &id_slice));
+    ASSERT_LT(id_slice.size(), sizeof(MsgId));
+    in = Slice(delivered);
+    MessageDeliverData deliver3;
+    ASSERT_OK(deliver3.MessageDeliver::DeSerialize(&in));
+    ASSERT_TRUE(GetLengthPrefixedSlice(&in, &id_slice));
+    ASSERT_LT(id_slice.size(), sizeof(MsgId));
+
+    // Truncated messages are rejected.
+    compressed.pop_back();
+    in = Slice(compressed);
+    ASSERT_TRUE(!data2.DeSerialize(&in).ok());
+  }
+
+  // Uncompressed messages are unchanged on the wire.
+  MessageData data2;
+  Slice in(plain);
+  ASSERT_OK(data2.DeSerialize(&in));
+  ASSERT_TRUE(data2.GetCompression() == CompressionType::kNone);
+}
+
 TEST(Messaging, InvalidEnum) {
   // create a message
   MessageGoodbye goodbye1(
@@ -333,6 +461,111 @@ TEST(Messaging, PingPong) {
   ASSERT_EQ(pings_recv(server), 1 + num_msgs);
 }
 
+TEST(Messaging, UnixSocket) {
+  const std::string path = test::TmpDir() + "/messages_test.sock";
+  HostId server_host;
+  ASSERT_OK(HostId::Resolve(HostId::kUnixPrefix + path, &server_host));
+  HostId same_host;
+  ASSERT_OK(HostId::CreateFromPath(path, &same_host));
+  ASSERT_TRUE(server_host == same_host);
+  ASSERT_EQ(server_host.ToString(), "unix:" + path);
+  ASSERT_TRUE(!HostId::CreateFromPath("", &same_host).ok());
+  ASSERT_TRUE(!HostId::CreateFromPath(std::string(200, 'x'), &same_host).ok());
+
+  // Server accepting only on the Unix socket, with several workers.
+  MsgLoop::Options options;
+  options.event_loop.unix_socket_path = path;
+  MsgLoop server(env_, env_options_, -1, 2, info_log_, "server", options);
+  ASSERT_OK(server.Initialize());
+  MsgLoopThread t1(env_, &server, "server");
+
+  port::Semaphore ping_sem;
+  MsgLoop loop(env_, env_options_, 0, 1, info_log_, "client");
+  StreamSocket socket(loop.CreateOutboundStream(server_host, 0));
+  loop.RegisterCallbacks({
+      {MessageType::mPing, [&](std::unique_ptr<Message> msg,
+                               StreamID origin) {
+        ASSERT_EQ(socket.GetStreamID(), origin);
+        ping_sem.Post();
+      }},
+  });
+  ASSERT_OK(loop.Initialize());
+  MsgLoopThread t2(env_, &loop, "client");
+  ASSERT_OK(server.WaitUntilRunning());
+  ASSERT_OK(loop.WaitUntilRunning());
+
+  MessagePing msg(
+      Tenant::GuestTenant, MessagePing::PingType::Request, "cookie");
+  const int num_msgs = 100;
+  for (int i = 0; i < num_msgs; i++) {
+    ASSERT_OK(loop.SendRequest(msg, &socket, 0));
+  }
+  for (int i = 0; i < num_msgs; ++i) {
+    ASSERT_TRUE(ping_sem.TimedWait(timeout_));
+  }
+}
+
+TEST(Messaging, UnixSocketPathNotSocket) {
+  // A path that exists and is not a socket must be left alone.
+  const std::string path = test::TmpDir() + "/messages_test.notsock";
+  FILE* file = fopen(path.c_str(), "w");
+  ASSERT_TRUE(file != nullptr);
+  fputs("keep", file);
+  fclose(file);
+
+  MsgLoop::Options options;
+  options.event_loop.unix_socket_path = path;
+  MsgLoop server(env_, env_options_, -1, 1, info_log_, "server", options);
+  ASSERT_TRUE(!server.Initialize().ok());
+
+  char contents[8] = {0};
+  file = fopen(path.c_str(), "r");
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_TRUE(fgets(contents, sizeof(contents), file) != nullptr);
+  fclose(file);
+  std::remove(path.c_str());
+  ASSERT_EQ(std::string(contents), "keep");
+}
+
+TEST(Messaging, UnixSocketInUse) {
+  const std::string path = test::TmpDir() + "/messages_test_inuse.sock";
+  std::remove(path.c_str());
+  HostId address;
+  ASSERT_OK(HostId::CreateFromPath(path, &address));
+  const socklen_t socklen = static_cast<socklen_t>(address.GetSocklen());
+
+  // A socket left behind by a process that exited is replaced.
+  int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_TRUE(stale != -1);
+  ASSERT_EQ(bind(stale, address.GetSockaddr(), socklen), 0);
+  close(stale);
+  {
+    MsgLoop::Options options;
+    options.event_loop.unix_socket_path = path;
+    MsgLoop server(env_, env_options_, -1, 1, info_log_, "server", options);
+    ASSERT_OK(server.Initialize());
+  }
+
+  // But the socket of a live server is not taken over.
+  std::remove(path.c_str());
+  int live = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_TRUE(live != -1);
+  ASSERT_EQ(bind(live, address.GetSockaddr(), socklen), 0);
+  ASSERT_EQ(listen(live, 1), 0);
+  {
+    MsgLoop::Options options;
+    options.event_loop.unix_socket_path = path;
+    MsgLoop server(env_, env_options_, -1, 1, info_log_, "server", options);
+    ASSERT_TRUE(!server.Initialize().ok());
+  }
+  int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_TRUE(client != -1);
+  ASSERT_EQ(connect(client, address.GetSockaddr(), socklen), 0);
+  close(client);
+  close(live);
+  std::remove(path.c_str());
+}
+
 TEST(Messaging, SameStreamsOnDifferentSockets) {
   // Posted on any ping message received by the server.
   port::Semaphore server_ping;
@@ -708,6 +941,105 @@ TEST(Messaging, GatherTest) {
   ASSERT_EQ(n, 45); // 45 = 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9
 }
 
+TEST(Messaging, ControlMessagePriority) {
+  ASSERT_TRUE(IsControlMessage(MessageType::mSubscribe));
+  ASSERT_TRUE(IsControlMessage(MessageType::mGoodbye));
+  ASSERT_TRUE(IsControlMessage(MessageType::mTailSeqno));
+  ASSERT_TRUE(!IsControlMessage(MessageType::mPublish));
+  ASSERT_TRUE(!IsControlMessage(MessageType::mDeliverData));
+
+  // Send commands take the priority of their message.
+  MessageUnsubscribe unsubscribe(Tenant::GuestTenant,
+                                 1,
+                                 MessageUnsubscribe::Reason::kRequested);
+  MessageData data(MessageType::mPublish, Tenant::GuestTenant,
+                   Slice("topic"), GuestNamespace, Slice("payload"));
+  std::string serial;
+  unsubscribe.SerializeToString(&serial);
+  auto command = SerializedSendCommand::Response(serial, {1});
+  ASSERT_TRUE(command->GetPriority() == CommandPriority::kHigh);
+  data.SerializeToString(&serial);
+  command = SerializedSendCommand::Response(serial, {1});
+  ASSERT_TRUE(command->GetPriority() == CommandPriority::kNormal);
+}
+
+TEST(Messaging, PriorityLanes) {
+  MsgLoop::Options options;
+  options.event_loop.high_priority_burst = 4;
+  MsgLoop loop(env_, env_options_, -1, 1, info_log_, "loop", options);
+  ASSERT_OK(loop.Initialize());
+  MsgLoopThread t1(env_, &loop, "loop");
+  ASSERT_OK(loop.WaitUntilRunning());
+
+  auto normal = loop.CreateCommandQueue(0);
+  auto high = loop.CreateCommandQueue(0, 0, CommandPriority::kHigh);
+  std::string order;
+  port::Semaphore done;
+  auto write = [&] (CommandQueue* queue, char c) {
+    std::unique_ptr<Command> command(MakeExecuteCommand([&, c] () {
+      order.push_back(c);
+      done.Post();
+    }));
+    ASSERT_TRUE(queue->Write(command));
+  };
+
+  // Wait until both queues are attached.
+  write(normal.get(), 'n');
+  write(high.get(), 'h');
+  ASSERT_TRUE(done.TimedWait(timeout_));
+  ASSERT_TRUE(done.TimedWait(timeout_));
+  order.clear();
+
+  // Queue up both lanes while the loop is busy.
+  port::Semaphore busy, release;
+  std::unique_ptr<Command> block(MakeExecuteCommand([&] () {
+    busy.Post();
+    release.Wait();
+  }));
+  ASSERT_TRUE(normal->Write(block));
+  ASSERT_TRUE(busy.TimedWait(timeout_));
+  for (int i = 0; i < 20; ++i) {
+    write(high.get(), 'h');
+  }
+  for (int i = 0; i < 5; ++i) {
+    write(normal.get(), 'n');
+  }
+  release.Post();
+  for (int i = 0; i < 25; ++i) {
+    ASSERT_TRUE(done.TimedWait(timeout_));
+  }
+
+  // High priority commands go first, in bursts in between normal ones.
+  ASSERT_EQ(order, "hhhhnhhhhnhhhhnhhhhnhhhhn");
+  Statistics stats = loop.GetStatisticsSync();
+  ASSERT_GE(stats.GetCounterValue("loop.high_priority_bursts"), 5);
+}
+
+TEST(Messaging, Placement) {
+  std::vector<int> cpus;
+  if (!env_->GetCurrentThreadAffinity(&cpus).ok()) {
+    return;  // Not supported on this platform.
+  }
+  // Pin three workers round robin to the first two CPUs we may use.
+  cpus.resize(std::min<size_t>(cpus.size(), 2));
+  MsgLoop::Options options;
+  options.cpus = cpus;
+  MsgLoop loop(env_, env_options_, -1, 3, info_log_, "loop", options);
+  ASSERT_OK(loop.Initialize());
+  MsgLoopThread t1(env_, &loop, "loop");
+  ASSERT_OK(loop.WaitUntilRunning());
+
+  std::vector<std::string> lines = SplitString(loop.GetPlacementSync(), '\n');
+  ASSERT_EQ(lines.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    const int cpu = cpus[i % cpus.size()];
+    const std::string expected =
+      "loop-" + std::to_string(i) + ": cpus " + std::to_string(cpu) +
+      ", on cpu " + std::to_string(cpu);
+    ASSERT_EQ(lines[i].substr(0, expected.size()), expected);
+  }
+}
+
 TEST(Messaging, TimeoutTest) {
   // Initialize, but don't start loop.
   MsgLoop loop(env_, env_options_, -1, 4, info_log_, "loop");
@@ -6,6 +6,8 @@
 #define __STDC_FORMAT_MACROS
 #include "msg_loop.h"
 
+#include <sys/socket.h>
+
 #include <algorithm>
 #include <chrono>
 #include <numeric>
@@ -19,6 +21,7 @@
 #include "src/messages/serializer.h"
 #include "src/messages/stream_allocator.h"
 #include "src/util/common/base_env.h"
+#include "src/util/common/parsing.h"
 
 namespace {
 // free up any thread local storage for worker_ids.
@@ -93,14 +96,23 @@ MsgLoop::MsgLoop(BaseEnv* env,
   };
 
   auto accept_callback = [this] (int fd) {
-    // Assign the new connection to the least loaded event loop.
-    event_loops_[LoadBalancedWorkerId()]->Accept(fd);
+    return event_loops_[AcceptWorkerId(fd)]->Accept(fd);
   };
 
   // Create a stream allocator for the entire stream ID space.
   auto allocs = StreamAllocator().Divide(num_workers, nullptr);
   options.event_loop.stats_prefix = name;
+  options.event_loop.network_port = port > 0 ? port : 0;
   for (int i = 0; i < num_workers; ++i) {
+    if (!options.cpus.empty()) {
+      const int cpu = options.cpus[i % options.cpus.size()];
+      options.event_loop.cpus = {cpu};
+      // Connections on the network go through the simulated network, so
+      // have no receiving CPU.
+      if (!options.event_loop.network) {
+        cpu_workers_[cpu].push_back(i);
+      }
+    }
     EventLoop* event_loop = new EventLoop(env,
                                           env_options,
                                           i == 0 ? port : 0,
@@ -110,6 +122,8 @@ MsgLoop::MsgLoop(BaseEnv* env,
                                           std::move(allocs[i]),
                                           options.event_loop);
     event_loops_.emplace_back(event_loop);
+    // Like the port, the Unix socket is only accepted on by the first loop.
+    options.event_loop.unix_socket_path.clear();
   }
 
   // log an informational message
@@ -334,6 +348,27 @@ MsgLoop::ProcessPing(std::unique_ptr<Message> msg, StreamID origin) {
   }
 }
 
+int MsgLoop::AcceptWorkerId(int fd) const {
+#ifdef SO_INCOMING_CPU
+  if (!cpu_workers_.empty()) {
+    // Keep the connection on the CPU that handles its interrupts, so its
+    // packets stay in that CPU's caches.
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0) {
+      auto it = cpu_workers_.find(cpu);
+      if (it != cpu_workers_.end()) {
+        // Spread connections across the workers sharing that CPU.
+        const std::vector<int>& workers = it->second;
+        return workers[next_worker_id_++ % workers.size()];
+      }
+    }
+  }
+#endif
+  // Otherwise assign the new connection to the least loaded event loop.
+  return LoadBalancedWorkerId();
+}
+
 int MsgLoop::LoadBalancedWorkerId() const {
   // Find the event loop with minimum load.
   int worker_id = static_cast<int>(next_worker_id_++ % event_loops_.size());
@@ -379,26 +414,63 @@ int MsgLoop::GetNumClientsSync() {
   return result;
 }
 
-std::shared_ptr<CommandQueue> MsgLoop::CreateCommandQueue(int worker_id,
-                                                          size_t size) {
+std::string MsgLoop::GetPlacementSync() {
+  auto map = [this] (int i) {
+    std::string line = name_ + "-" + std::to_string(i) + ": cpus ";
+    std::vector<int> cpus;
+    Status st = env_->GetCurrentThreadAffinity(&cpus);
+    line += st.ok() ? FormatCpuList(cpus) : "unknown";
+    const int cpu = env_->GetCurrentCpu();
+    if (cpu >= 0) {
+      line += ", on cpu " + std::to_string(cpu);
+      const int node = env_->GetNumaNode(cpu);
+      if (node >= 0) {
+        line += ", node " + std::to_string(node);
+      }
+    }
+    return std::make_pair(i, line);
+  };
+  auto reduce = [] (std::vector<std::pair<int, std::string>> lines) {
+    // Results arrive in any order.
+    std::sort(lines.begin(), lines.end());
+    std::string result;
+    for (const auto& line : lines) {
+      result += line.second + '\n';
+    }
+    return result;
+  };
+  std::string result;
+  Status st = MapReduceSync(map, reduce, &result);
+  if (!st.ok()) {
+    return "Failed to get placement: " + st.ToString();
+  }
+  return result;
+}
+
+std::shared_ptr<CommandQueue> MsgLoop::CreateCommandQueue(
+    int worker_id,
+    size_t size,
+    CommandPriority priority) {
   assert(worker_id < GetNumWorkers());
-  return event_loops_[worker_id]->CreateCommandQueue(size);
+  return event_loops_[worker_id]->CreateCommandQueue(size, priority);
 }
 
 std::vector<std::shared_ptr<CommandQueue>>
-MsgLoop::CreateWorkerQueues(size_t size) {
+MsgLoop::CreateWorkerQueues(size_t size, CommandPriority priority) {
   std::vector<std::shared_ptr<CommandQueue>> queues;
   for (int i = 0; i < GetNumWorkers(); ++i) {
-    queues.emplace_back(CreateCommandQueue(i, size));
+    queues.emplace_back(CreateCommandQueue(i, size, priority));
   }
   return queues;
 }
 
 std::unique_ptr<ThreadLocalCommandQueues>
-MsgLoop::CreateThreadLocalQueues(int worker_id, size_t size) {
+MsgLoop::CreateThreadLocalQueues(int worker_id,
+                                 size_t size,
+                                 CommandPriority priority) {
   return std::unique_ptr<ThreadLocalCommandQueues>(
-    new ThreadLocalCommandQueues([this, worker_id, size] () {
-      return CreateCommandQueue(worker_id, size);
+    new ThreadLocalCommandQueues([this, worker_id, size, priority] () {
+      return CreateCommandQueue(worker_id, size, priority);
     }));
 }
 
@@ -8,6 +8,9 @@
 #include <atomic>
 #include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "src/messages/commands.h"
 #include "src/messages/messages.h"
@@ -37,6 +40,10 @@ class MsgLoop : public MsgLoopBase {
     // the options used for constructing the underlying event loop. will get
     // modified within the constructor.
     EventLoop::Options event_loop;
+    // if not empty, worker i is pinned to CPU cpus[i % cpus.size()], and a
+    // new connection is given to the worker pinned to the CPU that received
+    // its packets, if there is one
+    std::vector<int> cpus;
   };
 
   // Create a listener to receive messages on a specified port.
@@ -163,33 +170,49 @@ class MsgLoop : public MsgLoopBase {
    */
   int GetNumClientsSync();
 
+  /**
+   * Synchronously describes where each worker runs: the CPUs it may run on,
+   * the CPU it is on and its NUMA node, one line per worker.
+   *
+   * @return The description, or an error message on timeout.
+   */
+  std::string GetPlacementSync();
+
   /**
    * Creates a new queue that will be read by a worker loop.
    *
    * @param worker_id The worker to read from this queue.
    * @param size Size of the queue (number of commands). Defaults to whatever
    *             the EventLoop default command queue size is.
+   * @param priority Lane of the queue, high for queues of control messages.
    * @return The created queue.
    */
-  std::shared_ptr<CommandQueue> CreateCommandQueue(int worker_id,
-                                                   size_t size = 0);
+  std::shared_ptr<CommandQueue> CreateCommandQueue(
+      int worker_id,
+      size_t size = 0,
+      CommandPriority priority = CommandPriority::kNormal);
 
   /**
    * Creates a vector of command queues, one for each worker.
    *
    * @param size Size of the queue (number of commands). Defaults to whatever
    *             the EventLoop default command queue size is.
+   * @param priority Lane of the queues, high for queues of control messages.
    * @return The created queue vector.
    */
   std::vector<std::shared_ptr<CommandQueue>>
-    CreateWorkerQueues(size_t size = 0);
+    CreateWorkerQueues(size_t size = 0,
+                       CommandPriority priority = CommandPriority::kNormal);
 
   /**
    * Creates a logical set of queues from each thread, to a particular worker.
    * The queues are created on demand for each thread.
    */
   std::unique_ptr<ThreadLocalCommandQueues>
-    CreateThreadLocalQueues(int worker_id, size_t size = 0);
+    CreateThreadLocalQueues(
+      int worker_id,
+      size_t size = 0,
+      CommandPriority priority = CommandPriority::kNormal);
 
  private:
   void SetThreadWorkerIndex(int worker_index);
@@ -225,6 +248,13 @@ class MsgLoop : public MsgLoopBase {
   // Looping counter to distribute load on the message loop.
   mutable std::atomic<int> next_worker_id_;
 
+  // Workers pinned to each CPU, for giving connections to a worker on the
+  // CPU that handles their interrupts.
+  std::unordered_map<int, std::vector<int>> cpu_workers_;
+
+  // Worker for a newly accepted connection.
+  int AcceptWorkerId(int fd) const;
+
   // The EventLoop callback.
   void EventCallback(std::unique_ptr<Message> msg, StreamID origin);
 
@@ -16,7 +16,9 @@ namespace rocketspeed {
 
 QueueStats::QueueStats(const std::string& prefix) {
   batched_read_size = all.AddHistogram(
-      prefix + ".batched_read_size", 0, kMaxQueueBatchReadSize, 1, 1.1);
+      prefix + ".batched_read_size", 0, kMaxAdaptiveBatchReadSize, 1, 1.1);
+  batch_size_limit = all.AddHistogram(
+      prefix + ".batch_size_limit", 0, kMaxAdaptiveBatchReadSize, 1, 1.1);
   response_latency = all.AddLatency(prefix + ".response_latency");
   num_reads = all.AddCounter(prefix + ".num_reads");
   eventfd_num_writes = all.AddCounter(prefix + ".eventfd_num_writes");
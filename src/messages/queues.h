@@ -5,6 +5,8 @@
 //
 #pragma once
 
+#include <string.h>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -17,6 +19,7 @@
 #include "src/port/port.h"
 #include "src/util/common/base_env.h"
 #include "src/util/common/flow.h"
+#include "src/util/common/huge_page_allocator.h"
 #include "src/util/common/statistics.h"
 #include "src/util/common/thread_check.h"
 #include "src/util/common/thread_local.h"
@@ -47,12 +50,46 @@ struct QueueStats {
 
   Statistics all;
   Histogram* batched_read_size;
+  Histogram* batch_size_limit;  // batch size chosen for each read batch
   Histogram* response_latency;
   Counter* num_reads;
   Counter* eventfd_num_writes;
   Counter* eventfd_num_reads;
 };
 
+/**
+ * Number of elements to read from a queue in a batch, and the initial size
+ * of adaptive batches.
+ */
+constexpr size_t kMaxQueueBatchReadSize = 100;
+
+/** Bounds of adaptive batch sizes. */
+constexpr size_t kMinAdaptiveBatchReadSize = 8;
+constexpr size_t kMaxAdaptiveBatchReadSize = 1600;
+
+/**
+ * Sizes the batches read from the queues of one reader.
+ *
+ * A queue's batches double while full batches take well under its share of
+ * the latency target, which amortizes notifications under load, and halve
+ * when they take longer, so that a flooded queue does not hold up the
+ * others. The target is shared by all queues that had items left after
+ * their last batch.
+ *
+ * Only used on the reader thread.
+ */
+struct QueueBatchPolicy {
+  explicit QueueBatchPolicy(std::chrono::microseconds _latency_target)
+  : latency_target(_latency_target) {
+  }
+
+  /** Time to read one batch from every backlogged queue. */
+  const std::chrono::microseconds latency_target;
+
+  /** Number of queues that had items left after their last batch. */
+  size_t backlogged_queues = 0;
+};
+
 /**
  * Creates an EventCallback on the read availability of an fd.
  */
@@ -73,10 +110,12 @@ class Queue : public Source<Item>, public Sink<Item> {
    * @param info_log Logging interface.
    * @param stats A stats that can be shared with other queues.
    * @param size Maximum number of queued up commands.
+   * @param huge_pages Pages backing the ring buffer.
    */
   Queue(std::shared_ptr<Logger> info_log,
         std::shared_ptr<QueueStats> stats,
-        size_t size);
+        size_t size,
+        HugePageMode huge_pages = HugePageMode::kNone);
 
   ~Queue();
 
@@ -87,6 +126,39 @@ class Queue : public Source<Item>, public Sink<Item> {
   /** Upper-bound estimate of queue size. */
   size_t GetSize() const { return queue_.sizeGuess(); }
 
+  /**
+   * Adapts the size of read batches from now on, instead of reading
+   * kMaxQueueBatchReadSize items at a time.
+   * Must be called before reading, or on the reader thread.
+   *
+   * @param policy Policy shared with the other queues of the reader.
+   */
+  void SetBatchPolicy(std::shared_ptr<QueueBatchPolicy> policy) {
+    batch_policy_ = std::move(policy);
+  }
+
+  /** Current maximum number of items read in a batch. */
+  size_t GetBatchSize() const { return batch_size_; }
+
+  /**
+   * Sets a flag after every write, so that a reader busy with other work can
+   * poll for new items without waiting for the read event.
+   * Must be called before the queue is shared with writers.
+   *
+   * @param flag Flag to set.
+   */
+  void SetWriteFlag(std::shared_ptr<std::atomic<bool>> flag) {
+    write_flag_ = std::move(flag);
+  }
+
+  /**
+   * Memory used by the queue's ring buffer. Does not include memory owned by
+   * the queued items.
+   */
+  size_t GetHeapMemoryUsage() const {
+    return (queue_.maxSize() + 1) * sizeof(Timestamped<Item>);
+  }
+
   void RegisterReadEvent(EventLoop* event_loop) final override {
     assert(!read_event_);
     read_event_ =
@@ -128,8 +200,25 @@ class Queue : public Source<Item>, public Sink<Item> {
    * batches.
    */
   std::atomic<size_t> synced_size_;
+  std::shared_ptr<std::atomic<bool>> write_flag_;
   ThreadCheck read_check_;
   ThreadCheck write_check_;
+
+  // Batch sizing, accessed by the reader only.
+  std::shared_ptr<QueueBatchPolicy> batch_policy_;
+  size_t batch_size_;
+  bool backlogged_;  // were items left after the last batch?
+
+  // Allocates the ring and touches all of it, so that its pages are placed
+  // on the NUMA node of the thread creating the queue rather than whichever
+  // thread first writes to each of them.
+  static Timestamped<Item>* AllocateRing(size_t count,
+                                         HugePageMode huge_pages);
+
+  // Called at the end of each batch.
+  void AdaptBatchSize(std::chrono::steady_clock::time_point start,
+                      size_t read,
+                      bool backlogged);
 };
 
 /**
@@ -142,9 +231,6 @@ class CommandQueue : public Queue<std::unique_ptr<Command>> {
   using Base::Base;
 };
 
-/** Maximum number of elements to read from a queue in a batch. */
-constexpr size_t kMaxQueueBatchReadSize = 100;
-
 /**
  * Utility for efficiently reading from a queue in batches. Optimized for
  * minimizing eventfd reads and writes.
@@ -183,6 +269,8 @@ class BatchedRead {
 
  private:
   Queue<Item>* queue_;
+  // Time at the start of the batch, used for latency of all items read.
+  std::chrono::steady_clock::time_point now_;
   size_t pending_reads_;  // pending items we intend to process.
   size_t commands_read_;  // successful reads from the queue.
   size_t delayed_reads_;  // pending items we intend not to process (yet).
@@ -218,7 +306,11 @@ class ThreadLocalCommandQueues {
 
 template <typename Item>
 BatchedRead<Item>::BatchedRead(Queue<Item>* queue)
-    : queue_(queue), pending_reads_(0), commands_read_(0), delayed_reads_(0) {
+    : queue_(queue)
+    , now_(std::chrono::steady_clock::now())
+    , pending_reads_(0)
+    , commands_read_(0)
+    , delayed_reads_(0) {
   // Clear notification, it will be added if batch finishes after hitting size
   // limit.
   eventfd_t value;
@@ -235,9 +327,11 @@ BatchedRead<Item>::~BatchedRead() {
   // If we've exited batch because of size limit, we must notify regardless of
   // the locally cached number of commands, as we didn't check if there is a
   // command waiting for us.
-  if (commands_read_ >= kMaxQueueBatchReadSize ||
-      pending_reads_ > 0 ||
-      delayed_reads_ > 0) {
+  const bool more = commands_read_ >= queue_->batch_size_ ||
+                    pending_reads_ > 0 ||
+                    delayed_reads_ > 0;
+  queue_->AdaptBatchSize(now_, commands_read_, more);
+  if (more) {
     // Return tokens back to atomic size.
     queue_->synced_size_.fetch_add(pending_reads_);
     // Notify ourselves, so the EventLoop will pick this queue eventually.
@@ -263,7 +357,7 @@ template <typename Item>
 bool BatchedRead<Item>::Read(Item& item) {
   queue_->read_check_.Check();
   // Check if we didn't exceed allowed batch size.
-  if (commands_read_ >= kMaxQueueBatchReadSize) {
+  if (commands_read_ >= queue_->batch_size_) {
     return false;
   }
   if (pending_reads_ == 0) {
@@ -291,8 +385,7 @@ bool BatchedRead<Item>::Read(Item& item) {
     if (!success) {
       return false;
     }
-    auto now = std::chrono::steady_clock::now();
-    auto delta = now - entry.timestamp;
+    auto delta = now_ - entry.timestamp;
     auto micros = std::chrono::duration_cast<std::chrono::microseconds>(delta);
     queue_->stats_->response_latency->Record(micros.count());
     item = std::move(entry.item);
@@ -312,23 +405,75 @@ bool BatchedRead<Item>::Read(Item& item) {
 template <typename Item>
 Queue<Item>::Queue(std::shared_ptr<Logger> info_log,
                    std::shared_ptr<QueueStats> stats,
-                   size_t size)
+                   size_t size,
+                   HugePageMode huge_pages)
     : info_log_(std::move(info_log))
     , stats_(std::move(stats))
-    , queue_(static_cast<uint32_t>(size + 1))  // ProducerConsumerQueue needs
-    , read_ready_fd_(true, true)               // n+1 to store n items.
+    // ProducerConsumerQueue needs n+1 to store n items.
+    , queue_(static_cast<uint32_t>(size + 1),
+             AllocateRing(size + 1, huge_pages),
+             [huge_pages, size] (Timestamped<Item>* ring) {
+               HugePageAllocator::Get(huge_pages)->Free(
+                 ring, (size + 1) * sizeof(Timestamped<Item>));
+             })
+    , read_ready_fd_(true, true)
     , write_ready_fd_(true, true)
-    , synced_size_(0) {
+    , synced_size_(0)
+    , batch_size_(kMaxQueueBatchReadSize)
+    , backlogged_(false) {
   assert(read_ready_fd_.status() == 0);
   assert(write_ready_fd_.status() == 0);
 }
 
+template <typename Item>
+Timestamped<Item>* Queue<Item>::AllocateRing(size_t count,
+                                             HugePageMode huge_pages) {
+  const size_t bytes = count * sizeof(Timestamped<Item>);
+  void* ring = HugePageAllocator::Get(huge_pages)->Allocate(bytes);
+  memset(ring, 0, bytes);
+  return static_cast<Timestamped<Item>*>(ring);
+}
+
 template <typename Item>
 Queue<Item>::~Queue() {
+  if (batch_policy_ && backlogged_) {
+    --batch_policy_->backlogged_queues;
+  }
   read_ready_fd_.closefd();
   write_ready_fd_.closefd();
 }
 
+template <typename Item>
+void Queue<Item>::AdaptBatchSize(std::chrono::steady_clock::time_point start,
+                                 size_t read,
+                                 bool backlogged) {
+  if (!batch_policy_) {
+    return;
+  }
+  if (backlogged != backlogged_) {
+    backlogged_ = backlogged;
+    if (backlogged) {
+      ++batch_policy_->backlogged_queues;
+    } else {
+      --batch_policy_->backlogged_queues;
+    }
+  }
+  if (read == 0) {
+    return;
+  }
+  stats_->batch_size_limit->Record(batch_size_);
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const auto share = batch_policy_->latency_target /
+    static_cast<std::chrono::microseconds::rep>(
+      std::max<size_t>(batch_policy_->backlogged_queues, 1));
+  if (elapsed > share) {
+    batch_size_ = std::max(batch_size_ / 2, kMinAdaptiveBatchReadSize);
+  } else if (read >= batch_size_ && elapsed * 2 < share) {
+    batch_size_ = std::min(batch_size_ * 2, kMaxAdaptiveBatchReadSize);
+  }
+}
+
 template <typename Item>
 bool Queue<Item>::TryWrite(Item& item, bool check_thread) {
   if (check_thread) {
@@ -363,6 +508,9 @@ bool Queue<Item>::TryWrite(Item& item, bool check_thread) {
       // With errno == EAGAIN, we can just let this fall through.
     }
   }
+  if (write_flag_) {
+    write_flag_->store(true, std::memory_order_release);
+  }
 
   return true;
 }
@@ -0,0 +1,166 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/messages/simulated_network.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace rocketspeed {
+
+SimulatedLink::Clock::time_point SimulatedLink::Schedule(
+    size_t bytes,
+    Clock::time_point now) {
+  // Frames are serialized onto the link one after another.
+  Clock::time_point start = std::max(now, transmit_free_);
+  Clock::duration transmit(0);
+  if (options_.bandwidth) {
+    transmit = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(
+        static_cast<double>(bytes) / static_cast<double>(options_.bandwidth)));
+  }
+  transmit_free_ = start + transmit;
+
+  Clock::time_point arrival = transmit_free_ + options_.latency;
+  if (options_.loss > 0.0) {
+    std::bernoulli_distribution lost(std::min(options_.loss, 1.0));
+    const size_t packets =
+      std::max<size_t>(1, (bytes + options_.packet_size - 1) /
+                          std::max<size_t>(1, options_.packet_size));
+    for (size_t i = 0; i < packets; ++i) {
+      if (lost(rng_)) {
+        arrival += options_.retransmit_timeout;
+      }
+    }
+  }
+
+  // Delivery is in order, so a frame cannot overtake a delayed one.
+  last_arrival_ = std::max(last_arrival_, arrival);
+  return last_arrival_;
+}
+
+SimulatedNetwork::SimulatedNetwork(Options options)
+: options_(std::move(options)) {
+}
+
+void SimulatedNetwork::SetLink(int from_port,
+                               int to_port,
+                               SimulatedLink::Options link) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  links_[std::make_pair(from_port, to_port)] = link;
+}
+
+Status SimulatedNetwork::Listen(int port, std::function<void(int fd)> accept) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto listener = std::make_shared<Listener>(std::move(accept));
+  if (!listeners_.emplace(port, std::move(listener)).second) {
+    return Status::IOError("Simulated port " + std::to_string(port) +
+                           " already in use");
+  }
+  return Status::OK();
+}
+
+void SimulatedNetwork::Unlisten(int port) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = listeners_.find(port);
+  if (it == listeners_.end()) {
+    return;
+  }
+  std::shared_ptr<Listener> listener = std::move(it->second);
+  listeners_.erase(it);
+  // Wait for concurrent Connect calls that are still invoking it.
+  idle_.wait(lock, [&] () { return listener->active == 0; });
+}
+
+Status SimulatedNetwork::Connect(int from_port,
+                                 const HostId& destination,
+                                 int* fd,
+                                 std::shared_ptr<SimulatedLink>* link) {
+  const int to_port = GetPort(destination);
+
+  std::shared_ptr<Listener> listener;
+  int fds[2];
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = listeners_.find(to_port);
+    if (it == listeners_.end()) {
+      return Status::IOError("Connection refused by simulated host " +
+                             destination.ToString());
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      return Status::IOError("socketpair failed: " + std::to_string(errno));
+    }
+    for (int end : fds) {
+      fcntl(end, F_SETFL, fcntl(end, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    *fd = fds[0];
+    *link = CreateLink(from_port, to_port);
+    accepted_links_[fds[1]] = CreateLink(to_port, from_port);
+
+    // Unlisten waits until the callback has returned.
+    listener = it->second;
+    ++listener->active;
+  }
+
+  listener->accept(fds[1]);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --listener->active;
+  }
+  idle_.notify_all();
+  return Status::OK();
+}
+
+std::shared_ptr<SimulatedLink> SimulatedNetwork::TakeAcceptedLink(int fd) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = accepted_links_.find(fd);
+  if (it == accepted_links_.end()) {
+    return nullptr;
+  }
+  std::shared_ptr<SimulatedLink> link = std::move(it->second);
+  accepted_links_.erase(it);
+  return link;
+}
+
+int SimulatedNetwork::GetPort(const HostId& host) {
+  const sockaddr* addr = host.GetSockaddr();
+  if (!host) {
+    return 0;
+  }
+  if (addr->sa_family == AF_INET) {
+    return ntohs(reinterpret_cast<const sockaddr_in*>(addr)->sin_port);
+  }
+  if (addr->sa_family == AF_INET6) {
+    return ntohs(reinterpret_cast<const sockaddr_in6*>(addr)->sin6_port);
+  }
+  return 0;
+}
+
+std::shared_ptr<SimulatedLink> SimulatedNetwork::CreateLink(int from_port,
+                                                            int to_port) {
+  const auto key = std::make_pair(from_port, to_port);
+  auto it = links_.find(key);
+  const SimulatedLink::Options& link =
+    it == links_.end() ? options_.default_link : it->second;
+
+  // Seed from the endpoints rather than the order of all connections, which
+  // depends on thread scheduling.
+  const uint64_t count = connection_counts_[key]++;
+  std::seed_seq seed{static_cast<uint32_t>(options_.seed),
+                     static_cast<uint32_t>(options_.seed >> 32),
+                     static_cast<uint32_t>(from_port),
+                     static_cast<uint32_t>(to_port),
+                     static_cast<uint32_t>(count)};
+  std::mt19937_64 seeder(seed);
+  return std::make_shared<SimulatedLink>(link, seeder());
+}
+
+}  // namespace rocketspeed
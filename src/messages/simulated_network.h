@@ -0,0 +1,184 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <utility>
+
+#include "include/Status.h"
+#include "src/util/common/host_id.h"
+
+namespace rocketspeed {
+
+/**
+ * One direction of a simulated connection. Models a link with fixed latency,
+ * limited bandwidth and packet loss, where lost packets are retransmitted
+ * after a timeout, as TCP would. Bytes are delivered in order, so a lost
+ * packet delays everything behind it.
+ *
+ * Only used by the EventLoop that sends on the connection, so not thread safe.
+ */
+class SimulatedLink {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Options {
+    /** One way delay of every byte. */
+    std::chrono::microseconds latency{0};
+
+    /** Bytes per second the link can carry, or 0 for unlimited. */
+    uint64_t bandwidth = 0;
+
+    /** Probability that a packet is lost and has to be retransmitted. */
+    double loss = 0.0;
+
+    /** Additional delay of a lost packet. */
+    std::chrono::microseconds retransmit_timeout{200000};
+
+    /** Bytes per packet, for loss. */
+    size_t packet_size = 1460;
+  };
+
+  SimulatedLink(Options options, uint64_t seed)
+  : options_(options)
+  , rng_(seed) {
+  }
+
+  /**
+   * Schedules a frame for transmission.
+   *
+   * @param bytes Size of the frame.
+   * @param now Time the frame is ready to be sent.
+   * @return Time the frame arrives at the other end. Never earlier than for
+   *         a previously scheduled frame.
+   */
+  Clock::time_point Schedule(size_t bytes, Clock::time_point now);
+
+  const Options& GetOptions() const {
+    return options_;
+  }
+
+ private:
+  const Options options_;
+  std::mt19937_64 rng_;
+  Clock::time_point transmit_free_;  // when the link finishes sending
+  Clock::time_point last_arrival_;   // arrival of the last frame
+};
+
+/**
+ * In-process replacement for TCP, for running many servers and clients in
+ * one process without binding ports. EventLoops given a network (see
+ * EventLoop::Options::network) listen and connect on it rather than on real
+ * sockets. Connections are Unix socket pairs, so reads, writes, backpressure
+ * and disconnects behave as before, but the sending EventLoop holds each
+ * frame back until the SimulatedLink for the connection delivers it.
+ *
+ * Delays are measured on the clock of the sending EventLoop. With a
+ * SimulatedClock (see EventLoop::Options::clock), time only passes when the
+ * clock is advanced, so delivery order relative to time is reproducible.
+ * Loss is decided by a random generator seeded per link from Options::seed
+ * and the endpoints.
+ *
+ * Endpoints are identified by port. EventLoops without a port, e.g. those of
+ * clients, connect from port kClientPort.
+ *
+ * Thread safe.
+ */
+class SimulatedNetwork {
+ public:
+  /** Port of connections from EventLoops that do not listen. */
+  static const int kClientPort = 0;
+
+  struct Options {
+    /** Seed for packet loss. */
+    uint64_t seed = 0;
+
+    /** Link used unless overridden with SetLink. */
+    SimulatedLink::Options default_link;
+  };
+
+  explicit SimulatedNetwork(Options options);
+
+  /**
+   * Sets the link used for connections from one port to another, in that
+   * direction. Affects new connections only.
+   */
+  void SetLink(int from_port, int to_port, SimulatedLink::Options link);
+
+  /**
+   * Starts accepting connections on a port.
+   *
+   * @param port Port to listen on.
+   * @param accept Invoked with the accepted end of each new connection, from
+   *               the thread that connects, without holding the network's
+   *               lock. Must not call Unlisten.
+   * @return Error if the port is already in use.
+   */
+  Status Listen(int port, std::function<void(int fd)> accept);
+
+  /**
+   * Stops accepting connections on a port. Once this returns, the accept
+   * callback is not running and will not be invoked again.
+   */
+  void Unlisten(int port);
+
+  /**
+   * Connects to a listening port.
+   *
+   * @param from_port Port of the connecting endpoint.
+   * @param destination Host to connect to. Only the port is used.
+   * @param fd Output for the connected end.
+   * @param link Output for the link carrying data from the connected end.
+   * @return Error if nothing listens on the port.
+   */
+  Status Connect(int from_port,
+                 const HostId& destination,
+                 int* fd,
+                 std::shared_ptr<SimulatedLink>* link);
+
+  /**
+   * Claims the link carrying data from the accepted end of a connection.
+   *
+   * @param fd The accepted end, as passed to the accept callback.
+   * @return The link, or null if fd was not accepted from this network.
+   */
+  std::shared_ptr<SimulatedLink> TakeAcceptedLink(int fd);
+
+  /** @return Port of a host, or 0 if it has no IP address. */
+  static int GetPort(const HostId& host);
+
+ private:
+  struct Listener {
+    explicit Listener(std::function<void(int)> _accept)
+    : accept(std::move(_accept))
+    , active(0) {
+    }
+
+    const std::function<void(int)> accept;
+    // Number of Connect calls that are invoking the callback.
+    int active;
+  };
+
+  std::shared_ptr<SimulatedLink> CreateLink(int from_port, int to_port);
+
+  const Options options_;
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::map<std::pair<int, int>, SimulatedLink::Options> links_;
+  std::map<std::pair<int, int>, uint64_t> connection_counts_;
+  std::unordered_map<int, std::shared_ptr<Listener>> listeners_;
+  std::unordered_map<int, std::shared_ptr<SimulatedLink>> accepted_links_;
+};
+
+}  // namespace rocketspeed
@@ -129,6 +129,55 @@ TEST(CommandQueueTest, TwoItemsTwoBatches) {
   loop_thread.join();
 }
 
+TEST(CommandQueueTest, AdaptiveBatchSize) {
+  Queue<int> queue(std::make_shared<NullLogger>(),
+                   std::make_shared<QueueStats>("test"),
+                   2000);
+  auto policy =
+    std::make_shared<QueueBatchPolicy>(std::chrono::milliseconds(100));
+  queue.SetBatchPolicy(policy);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(queue.Write(i));
+  }
+
+  // Reads one batch, sleeping after each item.
+  auto read_batch = [&] (std::chrono::microseconds sleep) {
+    BatchedRead<int> batch(&queue);
+    int item;
+    size_t read = 0;
+    while (batch.Read(item)) {
+      ++read;
+      /* sleep override */
+      std::this_thread::sleep_for(sleep);
+    }
+    return read;
+  };
+
+  // Cheap full batches grow, the queue is backlogged until drained.
+  const std::chrono::microseconds kNoSleep(0);
+  ASSERT_EQ(queue.GetBatchSize(), kMaxQueueBatchReadSize);
+  ASSERT_EQ(read_batch(kNoSleep), 100);
+  ASSERT_EQ(policy->backlogged_queues, 1);
+  ASSERT_EQ(queue.GetBatchSize(), 200);
+  ASSERT_EQ(read_batch(kNoSleep), 200);
+  ASSERT_EQ(read_batch(kNoSleep), 400);
+  ASSERT_EQ(queue.GetBatchSize(), 800);
+  ASSERT_EQ(read_batch(kNoSleep), 300);
+  ASSERT_EQ(policy->backlogged_queues, 0);
+  ASSERT_EQ(queue.GetBatchSize(), 800);
+
+  // Batches over the latency target shrink, down to the minimum.
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(queue.Write(i));
+  }
+  ASSERT_EQ(read_batch(std::chrono::milliseconds(20)), 10);
+  ASSERT_EQ(queue.GetBatchSize(), 400);
+  for (int i = 0; i < 7; ++i) {
+    ASSERT_TRUE(queue.Write(i));
+    ASSERT_EQ(read_batch(std::chrono::milliseconds(150)), 1);
+  }
+  ASSERT_EQ(queue.GetBatchSize(), kMinAdaptiveBatchReadSize);
+}
 
 }  // namespace rocketspeed
 
@@ -0,0 +1,190 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "src/messages/loopback.h"
+#include "src/messages/msg_loop.h"
+#include "src/port/port.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class LoopbackTest {
+ public:
+  LoopbackTest() : timeout_(1) {
+    env_ = Env::Default();
+    ASSERT_OK(test::CreateLogger(env_, "LoopbackTest", &info_log_));
+  }
+
+  /** A server that answers pings, and a client connected to it. */
+  struct PingPong {
+    PingPong(LoopbackTest* test, bool server_loopback, bool client_loopback)
+    : server(test->env_, test->env_options_, 58499, 1, test->info_log_,
+             "server", Options(server_loopback))
+    , client(test->env_, test->env_options_, 0, 1, test->info_log_,
+             "client", Options(client_loopback))
+    , socket(client.CreateOutboundStream(server.GetHostId(), 0)) {
+      client.RegisterCallbacks({
+        {MessageType::mPing, [this] (std::unique_ptr<Message> msg,
+                                     StreamID origin) {
+          pongs.Post();
+        }},
+        {MessageType::mGoodbye, [this] (std::unique_ptr<Message> msg,
+                                        StreamID origin) {
+          goodbyes.Post();
+        }},
+      });
+      ASSERT_OK(server.Initialize());
+      ASSERT_OK(client.Initialize());
+      server_thread.reset(new MsgLoopThread(test->env_, &server, "server"));
+      client_thread.reset(new MsgLoopThread(test->env_, &client, "client"));
+      ASSERT_OK(server.WaitUntilRunning());
+      ASSERT_OK(client.WaitUntilRunning());
+    }
+
+    static MsgLoop::Options Options(bool loopback) {
+      MsgLoop::Options options;
+      options.event_loop.loopback = loopback;
+      return options;
+    }
+
+    Status Ping() {
+      MessagePing ping(Tenant::GuestTenant,
+                       MessagePing::PingType::Request,
+                       "cookie");
+      return client.SendRequest(ping, &socket, 0);
+    }
+
+    int64_t ClientCounter(const std::string& name) {
+      return client.GetStatisticsSync().GetCounterValue("client." + name);
+    }
+
+    MsgLoop server;
+    MsgLoop client;
+    StreamSocket socket;
+    port::Semaphore pongs;
+    port::Semaphore goodbyes;
+    std::unique_ptr<MsgLoopThread> server_thread;
+    std::unique_ptr<MsgLoopThread> client_thread;
+  };
+
+  const std::chrono::seconds timeout_;
+  Env* env_;
+  EnvOptions env_options_;
+  std::shared_ptr<Logger> info_log_;
+};
+
+TEST(LoopbackTest, Channel) {
+  LoopbackChannel channel;
+  for (size_t i = 1; i <= 3; ++i) {
+    LoopbackFrame frame;
+    frame.size = i;
+    frame.data.reset(new char[i]);
+    memset(frame.data.get(), static_cast<char>('0' + i), i);
+    ASSERT_TRUE(channel.Write(std::move(frame)));
+  }
+  channel.Close();
+
+  // A closed channel rejects writes.
+  LoopbackFrame rejected;
+  ASSERT_TRUE(!channel.Write(std::move(rejected)));
+
+  // But frames written before can still be read, in order.
+  LoopbackFrame frame;
+  bool closed = false;
+  for (size_t i = 1; i <= 3; ++i) {
+    ASSERT_TRUE(channel.Read(&frame, &closed));
+    ASSERT_EQ(frame.size, i);
+    ASSERT_EQ(std::string(frame.data.get(), frame.size),
+              std::string(i, static_cast<char>('0' + i)));
+  }
+  ASSERT_TRUE(!channel.Read(&frame, &closed));
+  ASSERT_TRUE(closed);
+}
+
+TEST(LoopbackTest, Addresses) {
+  HostId host;
+  ASSERT_TRUE(LoopbackTransport::IsLoopbackAddress(HostId::CreateLocal(1)));
+  ASSERT_OK(HostId::CreateFromIP("127.1.2.3", 1, &host));
+  ASSERT_TRUE(LoopbackTransport::IsLoopbackAddress(host));
+  ASSERT_OK(HostId::CreateFromIP("::1", 1, &host));
+  ASSERT_TRUE(LoopbackTransport::IsLoopbackAddress(host));
+  ASSERT_OK(HostId::CreateFromIP("10.0.0.1", 1, &host));
+  ASSERT_TRUE(!LoopbackTransport::IsLoopbackAddress(host));
+  ASSERT_TRUE(!LoopbackTransport::IsLoopbackAddress(HostId()));
+}
+
+TEST(LoopbackTest, RejectedAccept) {
+  LoopbackTransport transport;
+  const HostId host = HostId::CreateLocal(58498);
+  LoopbackTransport::Endpoint endpoint;
+  int handle = -1;
+
+  // A listener that cannot take the connection fails the Connect call, and
+  // nothing is left for it to take later.
+  ASSERT_OK(transport.Listen(58498, [&] (int h) {
+    handle = h;
+    return Status::NoBuffer();
+  }));
+  ASSERT_TRUE(!transport.Connect(host, &endpoint).ok());
+  ASSERT_TRUE(!endpoint.out);
+  ASSERT_TRUE(!transport.TakeAccepted(handle, &endpoint));
+  transport.Unlisten(58498);
+
+  // Connections that were never taken are dropped on Unlisten.
+  ASSERT_OK(transport.Listen(58498, [&] (int h) {
+    handle = h;
+    return Status::OK();
+  }));
+  ASSERT_OK(transport.Connect(host, &endpoint));
+  ASSERT_TRUE(endpoint.out != nullptr);
+  transport.Unlisten(58498);
+  LoopbackTransport::Endpoint accepted;
+  ASSERT_TRUE(!transport.TakeAccepted(handle, &accepted));
+  ASSERT_TRUE(transport.Connect(host, &endpoint).IsNotFound());
+}
+
+TEST(LoopbackTest, PingPong) {
+  PingPong pair(this, true, true);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_OK(pair.Ping());
+  }
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(pair.pongs.TimedWait(timeout_));
+  }
+  // Nothing went through a socket.
+  ASSERT_EQ(pair.ClientCounter("loopback_frames"), 100);
+  ASSERT_EQ(pair.ClientCounter("socket_writes"), 0);
+}
+
+TEST(LoopbackTest, FallBackToTcp) {
+  // The server only accepts over TCP, so the client must use it too.
+  PingPong pair(this, false, true);
+  ASSERT_OK(pair.Ping());
+  ASSERT_TRUE(pair.pongs.TimedWait(timeout_));
+  ASSERT_EQ(pair.ClientCounter("loopback_frames"), 0);
+  ASSERT_GT(pair.ClientCounter("socket_writes"), 0);
+}
+
+TEST(LoopbackTest, Disconnect) {
+  PingPong pair(this, true, true);
+  ASSERT_OK(pair.Ping());
+  ASSERT_TRUE(pair.pongs.TimedWait(timeout_));
+
+  // Closing the server end closes the client's stream.
+  pair.server.Stop();
+  pair.server_thread.reset();
+  ASSERT_TRUE(pair.goodbyes.TimedWait(timeout_));
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
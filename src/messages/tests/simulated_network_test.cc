@@ -0,0 +1,241 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "src/messages/msg_loop.h"
+#include "src/messages/simulated_network.h"
+#include "src/port/port.h"
+#include "src/util/common/simulated_clock.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class SimulatedNetworkTest {
+ public:
+  SimulatedNetworkTest() : timeout_(1) {
+    env_ = Env::Default();
+    ASSERT_OK(test::CreateLogger(env_, "SimulatedNetworkTest", &info_log_));
+  }
+
+  /** A server that answers pings, and a client connected to it. */
+  struct PingPong {
+    PingPong(SimulatedNetworkTest* test,
+             int port,
+             MsgLoop::Options options)
+    : server(test->env_, test->env_options_, port, 1, test->info_log_,
+             "server", options)
+    , client(test->env_, test->env_options_, 0, 1, test->info_log_,
+             "client", options)
+    , socket(client.CreateOutboundStream(server.GetHostId(), 0)) {
+      client.RegisterCallbacks({
+        {MessageType::mPing, [this] (std::unique_ptr<Message> msg,
+                                     StreamID origin) {
+          pongs.Post();
+        }},
+      });
+      ASSERT_OK(server.Initialize());
+      ASSERT_OK(client.Initialize());
+      server_thread.reset(new MsgLoopThread(test->env_, &server, "server"));
+      client_thread.reset(new MsgLoopThread(test->env_, &client, "client"));
+      ASSERT_OK(server.WaitUntilRunning());
+      ASSERT_OK(client.WaitUntilRunning());
+    }
+
+    Status Ping() {
+      MessagePing ping(Tenant::GuestTenant,
+                       MessagePing::PingType::Request,
+                       "cookie");
+      return client.SendRequest(ping, &socket, 0);
+    }
+
+    int64_t PingsReceived() {
+      return server.GetStatisticsSync()
+        .GetCounterValue("server.messages_received.ping");
+    }
+
+    MsgLoop server;
+    MsgLoop client;
+    StreamSocket socket;
+    port::Semaphore pongs;
+    std::unique_ptr<MsgLoopThread> server_thread;
+    std::unique_ptr<MsgLoopThread> client_thread;
+  };
+
+  const std::chrono::seconds timeout_;
+  Env* env_;
+  EnvOptions env_options_;
+  std::shared_ptr<Logger> info_log_;
+};
+
+TEST(SimulatedNetworkTest, LinkSchedule) {
+  typedef SimulatedLink::Clock Clock;
+  const Clock::time_point start = Clock::time_point() + std::chrono::hours(1);
+  const auto ms = [] (int n) { return std::chrono::milliseconds(n); };
+
+  SimulatedLink::Options options;
+  options.latency = ms(10);
+  options.bandwidth = 1000;
+  SimulatedLink link(options, 0);
+
+  // Frames queue behind each other for bandwidth, but share latency.
+  ASSERT_TRUE(link.Schedule(100, start) == start + ms(110));
+  ASSERT_TRUE(link.Schedule(100, start) == start + ms(210));
+  // Once the link is idle, only the frame's own transmission counts.
+  ASSERT_TRUE(link.Schedule(1, start + ms(1000)) == start + ms(1011));
+
+  // Every lost packet is retransmitted after a timeout.
+  SimulatedLink::Options lossy;
+  lossy.loss = 1.0;
+  lossy.packet_size = 100;
+  lossy.retransmit_timeout = ms(200);
+  SimulatedLink lossy_link(lossy, 0);
+  ASSERT_TRUE(lossy_link.Schedule(250, start) == start + ms(600));
+
+  // Later frames wait for retransmitted ones, and the same seed gives the
+  // same losses.
+  SimulatedLink::Options partial = lossy;
+  partial.loss = 0.5;
+  SimulatedLink link1(partial, 42);
+  SimulatedLink link2(partial, 42);
+  Clock::time_point last = start;
+  for (int i = 0; i < 100; ++i) {
+    const Clock::time_point now = start + ms(i);
+    const Clock::time_point arrival = link1.Schedule(100, now);
+    ASSERT_TRUE(arrival >= last);
+    ASSERT_TRUE(arrival >= now);
+    ASSERT_TRUE(arrival == link2.Schedule(100, now));
+    last = arrival;
+  }
+}
+
+TEST(SimulatedNetworkTest, PingPong) {
+  // Two servers on the same port, each on its own network, with nothing
+  // bound to the port over TCP.
+  std::vector<std::unique_ptr<PingPong>> pairs;
+  for (int i = 0; i < 2; ++i) {
+    MsgLoop::Options options;
+    options.event_loop.network =
+      std::make_shared<SimulatedNetwork>(SimulatedNetwork::Options());
+    pairs.emplace_back(new PingPong(this, 58499, options));
+  }
+  for (auto& pair : pairs) {
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_OK(pair->Ping());
+    }
+  }
+  for (auto& pair : pairs) {
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_TRUE(pair->pongs.TimedWait(timeout_));
+    }
+    ASSERT_EQ(pair->PingsReceived(), 10);
+  }
+}
+
+TEST(SimulatedNetworkTest, ListenTwice) {
+  auto network =
+    std::make_shared<SimulatedNetwork>(SimulatedNetwork::Options());
+  ASSERT_OK(network->Listen(58499, [] (int) {}));
+  ASSERT_TRUE(!network->Listen(58499, [] (int) {}).ok());
+  network->Unlisten(58499);
+  ASSERT_OK(network->Listen(58499, [] (int) {}));
+}
+
+TEST(SimulatedNetworkTest, SimulatedLatency) {
+  SimulatedNetwork::Options network_options;
+  network_options.default_link.latency = std::chrono::milliseconds(100);
+  MsgLoop::Options options;
+  options.event_loop.network =
+    std::make_shared<SimulatedNetwork>(network_options);
+  options.event_loop.clock = std::make_shared<SimulatedClock>();
+  PingPong pair(this, 58499, options);
+
+  // Nothing arrives while the clock stands still.
+  ASSERT_OK(pair.Ping());
+  ASSERT_TRUE(!pair.pongs.TimedWait(std::chrono::milliseconds(100)));
+  ASSERT_EQ(pair.PingsReceived(), 0);
+
+  options.event_loop.clock->Advance(std::chrono::milliseconds(99));
+  ASSERT_TRUE(!pair.pongs.TimedWait(std::chrono::milliseconds(50)));
+  ASSERT_EQ(pair.PingsReceived(), 0);
+
+  // The ping arrives after its latency.
+  options.event_loop.clock->Advance(std::chrono::milliseconds(1));
+  const auto deadline = std::chrono::steady_clock::now() + timeout_;
+  while (pair.PingsReceived() == 0) {
+    ASSERT_TRUE(std::chrono::steady_clock::now() < deadline);
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_TRUE(!pair.pongs.TimedWait(std::chrono::milliseconds(50)));
+
+  // And the response after another.
+  options.event_loop.clock->Advance(std::chrono::milliseconds(100));
+  ASSERT_TRUE(pair.pongs.TimedWait(timeout_));
+}
+
+TEST(SimulatedNetworkTest, AdvanceWithFullQueue) {
+  SimulatedNetwork::Options network_options;
+  network_options.default_link.latency = std::chrono::milliseconds(100);
+  MsgLoop::Options options;
+  options.event_loop.network =
+    std::make_shared<SimulatedNetwork>(network_options);
+  options.event_loop.clock = std::make_shared<SimulatedClock>();
+  options.event_loop.command_queue_size = 1;
+  PingPong pair(this, 58499, options);
+  ASSERT_OK(pair.Ping());
+
+  // Block the client, which holds the delayed ping, and fill the queue from
+  // this thread to it.
+  port::Semaphore blocked, unblock;
+  auto send = [&] (std::function<void()> func) {
+    std::unique_ptr<Command> command(MakeExecuteCommand(std::move(func)));
+    return pair.client.SendCommand(std::move(command), 0);
+  };
+  while (!send([&] () { blocked.Post(); unblock.Wait(); }).ok()) {
+    std::this_thread::yield();
+  }
+  ASSERT_TRUE(blocked.TimedWait(timeout_));
+  int queued = 0;
+  while (send([] () {}).ok()) {
+    ASSERT_LT(++queued, 1 << 20);
+  }
+
+  // The client cannot be told about this advance, but must still resume the
+  // ping once it reads the queue again.
+  options.event_loop.clock->Advance(std::chrono::milliseconds(100));
+  unblock.Post();
+  const auto deadline = std::chrono::steady_clock::now() + timeout_;
+  while (pair.PingsReceived() == 0) {
+    ASSERT_TRUE(std::chrono::steady_clock::now() < deadline);
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST(SimulatedNetworkTest, RealTimeLatency) {
+  // Without a simulated clock, delays are measured in real time.
+  SimulatedNetwork::Options network_options;
+  network_options.default_link.latency = std::chrono::milliseconds(50);
+  MsgLoop::Options options;
+  options.event_loop.network =
+    std::make_shared<SimulatedNetwork>(network_options);
+  PingPong pair(this, 58499, options);
+
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_OK(pair.Ping());
+  ASSERT_TRUE(pair.pongs.TimedWait(timeout_));
+  ASSERT_TRUE(std::chrono::steady_clock::now() - start >=
+              std::chrono::milliseconds(100));
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
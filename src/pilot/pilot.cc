@@ -18,13 +18,20 @@ void AppendClosure::operator()(Status append_status, SequenceNumber seqno) {
   // IMPORTANT: This may be called after Stop(). Must not use the log storage
   // or log router after this point.
 
-  // Record latency
-  uint64_t latency = pilot_->options_.env->NowMicros() - append_time_;
   Status st = pilot_->options_.msg_loop->SendCommand(
     std::unique_ptr<Command>(MakeExecuteCommand(
-      [this, latency, append_status, seqno] () {
-        pilot_->worker_data_[worker_id_].stats_.append_latency->Record(latency);
-        pilot_->worker_data_[worker_id_].stats_.append_requests->Add(1);
+      [this, append_status, seqno] () {
+        // Latency is measured on the worker, which has a cached clock, so it
+        // includes the time spent in the command queue.
+        const uint64_t latency =
+          pilot_->options_.msg_loop->GetEventLoop(worker_id_)
+            ->GetCachedTimeMicros() - append_time_;
+        auto& stats = pilot_->worker_data_[worker_id_].stats_;
+        stats.append_latency->Record(latency);
+        stats.append_requests->Add(1);
+        if (msg_->GetTrace()->IsSampled()) {
+          stats.trace_append_latency->Record(latency);
+        }
         pilot_->AppendCallback(append_status,
                                seqno,
                                std::move(msg_),
@@ -36,7 +43,7 @@ void AppendClosure::operator()(Status append_status, SequenceNumber seqno) {
       })), worker_id_);
 
   if (!st.ok()) {
-    LOG_WARN(pilot_->options_.info_log,
+    LOG_WARN_RATELIMITED(pilot_->options_.info_log,
       "Failed to send command for append callback on Log(%" PRIu64 ")"
       " Topic(%s,%s): %s",
       logid_,
@@ -153,8 +160,18 @@ void Pilot::ProcessPublish(std::unique_ptr<Message> msg, StreamID origin) {
       msg_data->GetTopicName().ToString().c_str(),
       logid);
 
+  // The stamped trace has to be written with the record, so sampled
+  // messages are serialized again.
+  Slice storage_slice = msg_data->GetStorageSlice();
+  if (msg_data->GetTrace()->IsSampled()) {
+    msg_data->GetTrace()->RecordHop(TraceStage::kPilotReceive,
+                                    worker_data.stats_.trace_receive_latency);
+    storage_slice = msg_data->SerializeStorage();
+  }
+
   // Setup AppendCallback
-  uint64_t now = options_.env->NowMicros();
+  uint64_t now =
+    options_.msg_loop->GetEventLoop(worker_id)->GetCachedTimeMicros();
   AppendClosure* closure;
   std::unique_ptr<MessageData> msg_owned(msg_data);
   closure = worker_data.append_closure_pool_->Allocate(
@@ -168,7 +185,7 @@ void Pilot::ProcessPublish(std::unique_ptr<Message> msg, StreamID origin) {
   // Asynchronously append to log storage.
   auto append_callback = std::ref(*closure);
   auto status = log_storage_->AppendAsync(logid,
-                                          msg_data->GetStorageSlice(),
+                                          storage_slice,
                                           std::move(append_callback));
 
   // Fault injection: insert corrupt data into the logs.
@@ -50,7 +50,7 @@ struct AppendClosure : public PooledObject<AppendClosure> {
   Pilot* pilot_;
   std::unique_ptr<MessageData> msg_;
   LogID logid_;
-  uint64_t append_time_;
+  uint64_t append_time_;  // Cached time of the worker's EventLoop.
   int worker_id_;
   StreamID origin_;
 };
@@ -99,6 +99,8 @@ class Pilot {
       append_latency = all.AddLatency("pilot.append_latency_us");
       append_requests = all.AddCounter("pilot.append_requests");
       failed_appends = all.AddCounter("pilot.failed_appends");
+      trace_receive_latency = all.AddLatency("pilot.trace.pilot_receive_us");
+      trace_append_latency = all.AddLatency("pilot.trace.append_us");
 
       FAULT_corrupt_writes = all.AddCounter("pilot.FAULT_corrupt_writes");
     }
@@ -114,6 +116,12 @@ class Pilot {
     // Number of append failures.
     Counter* failed_appends;
 
+    // Latency of sampled messages from the publisher to the pilot.
+    Histogram* trace_receive_latency;
+
+    // Latency of appends of sampled messages.
+    Histogram* trace_append_latency;
+
     // Number of written corrupt records through fault injection.
     Counter* FAULT_corrupt_writes;
   };
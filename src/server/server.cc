@@ -13,6 +13,7 @@
 #include <gflags/gflags.h>
 #include <signal.h>
 #include <algorithm>
+#include <cmath>
 #include <set>
 #include <string>
 
@@ -24,12 +25,19 @@
 #include "src/controltower/options.h"
 #include "src/controltower/tower.h"
 #include "src/supervisor/supervisor_loop.h"
+#include "src/util/async_logger.h"
+#include "src/util/common/huge_page_allocator.h"
 #include "src/util/common/parsing.h"
 #include "src/util/control_tower_router.h"
 #include "src/util/storage.h"
 
 // Common settings
 DEFINE_bool(log_to_stderr, false, "log to stderr (otherwise LOG file)");
+DEFINE_bool(async_log, false,
+            "format and write log entries on a background thread");
+DEFINE_int64(async_log_buffer_bytes,
+             rocketspeed::AsyncLogger::kDefaultRingBytes,
+             "per-thread buffer size of the async logger, in bytes");
 
 // Control tower settings
 DEFINE_bool(tower, false, "start the control tower");
@@ -37,6 +45,8 @@ DEFINE_int32(tower_port,
              rocketspeed::ControlTower::DEFAULT_PORT,
              "tower port number");
 DEFINE_int32(tower_workers, 40, "tower rooms");
+DEFINE_string(tower_cpus, "",
+              "pin tower rooms to these CPUs, one each, e.g. 0-19,40-59");
 DEFINE_int64(tower_max_subscription_lag, 10000,
              "max seqno lag on subscriptions");
 DEFINE_int32(tower_readers_per_room, 2, "log readers per room");
@@ -50,6 +60,10 @@ DEFINE_int32(pilot_port,
              rocketspeed::Pilot::DEFAULT_PORT,
              "pilot port number");
 DEFINE_int32(pilot_workers, 40, "pilot worker threads");
+DEFINE_string(pilot_cpus, "",
+              "pin pilot workers to these CPUs, one each, e.g. 0-19,40-59");
+DEFINE_string(pilot_unix_socket, "",
+              "also accept clients on a Unix domain socket at this path");
 DEFINE_double(FAULT_pilot_corrupt_extra_probability, 0.0,
   "probability of writing a corrupt message to the log after each publish");
 
@@ -59,9 +73,17 @@ DEFINE_int32(copilot_port,
              rocketspeed::Copilot::DEFAULT_PORT,
              "copilot port number");
 DEFINE_int32(copilot_workers, 40, "copilot worker threads");
+DEFINE_string(copilot_cpus, "",
+              "pin copilot workers to these CPUs, one each, e.g. 0-19,40-59");
+DEFINE_string(copilot_unix_socket, "",
+              "also accept clients on a Unix domain socket at this path");
 DEFINE_string(control_towers,
               "localhost",
               "comma-separated control tower hostnames");
+DEFINE_string(control_tower_weights,
+              "",
+              "comma-separated relative capacities of control_towers, "
+              "in the same order (default 1 each)");
 DEFINE_int32(copilot_connections, 8,
              "num connections between one copilot and one control tower");
 DEFINE_int32(copilot_towers_per_log, 2,
@@ -91,6 +113,14 @@ DEFINE_int32(heartbeat_timeout,
 DEFINE_int32(heartbeat_expire_batch, -1 /* unbounded */,
              "number of streams to expire in one blocking call");
 
+DEFINE_int32(command_batch_latency_us, 1000,
+             "target time to read a batch from each backlogged command queue, "
+             "in microseconds (0 for fixed batches)");
+
+DEFINE_string(huge_pages, "none",
+              "pages backing command queues and the tower cache: "
+              "none|transparent|explicit");
+
 DEFINE_string(rs_log_dir, "", "directory for server logs");
 
 #ifdef NDEBUG
@@ -130,6 +160,11 @@ RocketSpeed::RocketSpeed(Env* env, EnvOptions env_options)
   if (!st.ok()) {
     fprintf(stderr, "RocketSpeed failed to create Logger\n");
     info_log_ = std::make_shared<NullLogger>();
+  } else if (FLAGS_async_log) {
+    info_log_ = std::make_shared<AsyncLogger>(
+      env_,
+      std::move(info_log_),
+      static_cast<size_t>(FLAGS_async_log_buffer_bytes));
   }
 }
 
@@ -153,16 +188,46 @@ Status RocketSpeed::Initialize(
     LOG_FATAL(info_log_, "Failed to create LogRouter");
   }
 
+  // CPUs to pin workers of each message loop to, if any.
+  std::vector<int> tower_cpus;
+  std::vector<int> pilot_cpus;
+  std::vector<int> copilot_cpus;
+  for (auto flag : {std::make_pair(&FLAGS_tower_cpus, &tower_cpus),
+                    std::make_pair(&FLAGS_pilot_cpus, &pilot_cpus),
+                    std::make_pair(&FLAGS_copilot_cpus, &copilot_cpus)}) {
+    if (!flag.first->empty()) {
+      Status st = ParseCpuList(*flag.first, flag.second);
+      if (!st.ok()) {
+        return st;
+      }
+    }
+  }
+
+  HugePageMode huge_pages;
+  Status huge_pages_st = ParseHugePageMode(FLAGS_huge_pages, &huge_pages);
+  if (!huge_pages_st.ok()) {
+    return huge_pages_st;
+  }
+
   // Utility for creating a message loop.
-  auto make_msg_loop = [&] (int port, int workers, std::string name) {
+  auto make_msg_loop = [&] (int port,
+                            int workers,
+                            std::string name,
+                            std::string unix_socket,
+                            std::vector<int> cpus) {
     LOG_VITAL(info_log_, "Constructing MsgLoop port=%d workers=%d name=%s",
       port, workers, name.c_str());
     MsgLoop::Options options;
+    options.cpus = std::move(cpus);
+    options.event_loop.huge_pages = huge_pages;
+    options.event_loop.unix_socket_path = std::move(unix_socket);
     options.event_loop.heartbeat_timeout =
       std::chrono::seconds(FLAGS_heartbeat_timeout);
     options.event_loop.heartbeat_expire_batch =
       FLAGS_heartbeat_expire_batch;
     options.event_loop.heartbeat_enabled = FLAGS_heartbeat_enabled;
+    options.event_loop.command_batch_latency =
+      std::chrono::microseconds(FLAGS_command_batch_latency_us);
     return new MsgLoop(env_,
                        env_options_,
                        port,
@@ -183,7 +248,9 @@ Status RocketSpeed::Initialize(
   if (FLAGS_tower) {
     tower_loop.reset(make_msg_loop(FLAGS_tower_port,
                                    FLAGS_tower_workers,
-                                   "tower"));
+                                   "tower",
+                                   "",
+                                   tower_cpus));
   }
 
   std::shared_ptr<LogStorage> storage;
@@ -201,21 +268,36 @@ Status RocketSpeed::Initialize(
     LOG_VITAL(info_log_, "Pilot and copilot sharing MsgLoop port=%d",
       FLAGS_pilot_port);
     int workers = std::max(FLAGS_pilot_workers, FLAGS_copilot_workers);
+    if (!FLAGS_pilot_unix_socket.empty() &&
+        !FLAGS_copilot_unix_socket.empty() &&
+        FLAGS_pilot_unix_socket != FLAGS_copilot_unix_socket) {
+      return Status::InvalidArgument(
+        "Pilot and copilot sharing MsgLoop need the same Unix socket");
+    }
     pilot_loop.reset(make_msg_loop(FLAGS_pilot_port,
                                    workers,
-                                   "cockpit"));
+                                   "cockpit",
+                                   FLAGS_pilot_unix_socket.empty() ?
+                                     FLAGS_copilot_unix_socket :
+                                     FLAGS_pilot_unix_socket,
+                                   pilot_cpus.empty() ? copilot_cpus :
+                                                        pilot_cpus));
     copilot_loop = pilot_loop;
   } else {
     // Separate message loops if enabled.
     if (FLAGS_pilot) {
       pilot_loop.reset(make_msg_loop(FLAGS_pilot_port,
                                      FLAGS_pilot_workers,
-                                     "pilot"));
+                                     "pilot",
+                                     FLAGS_pilot_unix_socket,
+                                     pilot_cpus));
     }
     if (FLAGS_copilot) {
       copilot_loop.reset(make_msg_loop(FLAGS_copilot_port,
                                        FLAGS_copilot_workers,
-                                       "copilot"));
+                                       "copilot",
+                                       FLAGS_copilot_unix_socket,
+                                       copilot_cpus));
     }
   }
 
@@ -251,6 +333,7 @@ Status RocketSpeed::Initialize(
     if (FLAGS_tower_cache_size != -1) {
       tower_opts.cache_size = FLAGS_tower_cache_size;
     }
+    tower_opts.cache_huge_pages = huge_pages;
     tower_opts.topic_tailer.FAULT_send_log_record_failure_rate =
       FLAGS_FAULT_tower_send_log_record_failure_rate;
 
@@ -316,13 +399,37 @@ Status RocketSpeed::Initialize(
         host.ToString().c_str());
       ++node_id;
     }
-    copilot_opts.control_tower_router =
-        std::make_shared<ConsistentHashTowerRouter>(
-            std::move(nodes), 20, FLAGS_copilot_towers_per_log);
+    std::unordered_map<ControlTowerId, double> weights;
+    if (!FLAGS_control_tower_weights.empty()) {
+      auto weight_strs = SplitString(FLAGS_control_tower_weights);
+      if (weight_strs.size() != nodes.size()) {
+        return Status::InvalidArgument(
+          "control_tower_weights must have one weight per control tower");
+      }
+      for (ControlTowerId id = 0; id < weight_strs.size(); ++id) {
+        const std::string& token = weight_strs[id];
+        char* end = nullptr;
+        double weight = strtod(token.c_str(), &end);
+        if (token.empty() || end != token.c_str() + token.size() ||
+            !std::isfinite(weight) || !(weight > 0.0)) {
+          return Status::InvalidArgument(
+            "control_tower_weights must be positive numbers, got '" +
+            token + "'");
+        }
+        weights.emplace(id, weight);
+      }
+    }
+    std::unique_ptr<ConsistentHashTowerRouter> router;
+    Status st = ConsistentHashTowerRouter::Create(
+        std::move(nodes), weights, 20, FLAGS_copilot_towers_per_log, &router);
+    if (!st.ok()) {
+      return st;
+    }
+    copilot_opts.control_tower_router = std::move(router);
     if (FLAGS_pilot) {
       copilot_opts.pilots.push_back(pilot_host);
     }
-    Status st = Copilot::CreateNewInstance(std::move(copilot_opts),
+    st = Copilot::CreateNewInstance(std::move(copilot_opts),
                                            &copilot);
     if (!st.ok()) {
       return st;
@@ -299,7 +299,9 @@ std::map<std::string, SupervisorCommand> SupervisorLoop::commands_ = {
       "info tower tail_seqno N\n"
       "info copilot subscriptions FILTER [MAX]\n"
       "info copilot towers_for_log N\n"
-      "info copilot log_for_topic NAMESPACE TOPIC\n",
+      "info copilot tower_load_shares\n"
+      "info copilot log_for_topic NAMESPACE TOPIC\n"
+      "info pilot|copilot|tower placement\n",
       [](std::vector<std::string> args, SupervisorLoop* supervisor)
         -> std::string {
 
@@ -308,6 +310,19 @@ std::map<std::string, SupervisorCommand> SupervisorLoop::commands_ = {
         }
         std::string handler = args[1];
         args.erase(args.begin(), args.begin() + 2);
+        if (args.size() == 1 && args[0] == "placement") {
+          // Placement of the workers is common to all handlers.
+          const SupervisorOptions& options = supervisor->options_;
+          MsgLoop* msg_loop = nullptr;
+          if (handler == "pilot" && options.pilot) {
+            msg_loop = options.pilot->GetMsgLoop();
+          } else if (handler == "copilot" && options.copilot) {
+            msg_loop = options.copilot->GetMsgLoop();
+          } else if (handler == "tower" && options.tower) {
+            msg_loop = options.tower->GetMsgLoop();
+          }
+          return msg_loop ? msg_loop->GetPlacementSync() : "Invalid command";
+        }
         if (handler == "pilot" && supervisor->options_.pilot) {
           return supervisor->options_.pilot->GetInfoSync(std::move(args));
         } else if (handler == "copilot" && supervisor->options_.copilot) {
@@ -102,6 +102,114 @@ TEST(IntegrationTest, OneMessage) {
   ASSERT_TRUE(result);
 }
 
+/**
+ * Traces every message and checks that each stage of the pipeline recorded
+ * its latency.
+ */
+TEST(IntegrationTest, SampledTrace) {
+  LocalTestCluster cluster(info_log);
+  ASSERT_OK(cluster.GetStatus());
+
+  port::Semaphore msg_acked;
+  auto publish_callback = [&] (std::unique_ptr<ResultStatus> rs) {
+    msg_acked.Post();
+  };
+  port::Semaphore msg_received;
+  auto receive_callback = [&] (std::unique_ptr<MessageReceived>& mr) {
+    msg_received.Post();
+  };
+
+  ClientOptions options;
+  options.config = cluster.GetConfiguration();
+  options.info_log = info_log;
+  options.trace_sample_rate = 1.0;
+  std::unique_ptr<ClientImpl> client;
+  ASSERT_OK(ClientImpl::Create(std::move(options), &client));
+
+  const Topic topic = "SampledTrace";
+  const uint64_t num_messages = 3;
+  for (uint64_t i = 0; i < num_messages; ++i) {
+    ASSERT_OK(client->Publish(GuestTenant, topic, GuestNamespace,
+                              TopicOptions(), "data", publish_callback,
+                              MsgId()).status);
+  }
+  // Appends are recorded by the time they are acknowledged.
+  for (uint64_t i = 0; i < num_messages; ++i) {
+    ASSERT_TRUE(msg_acked.TimedWait(timeout));
+  }
+  ASSERT_TRUE(client->Subscribe(GuestTenant, GuestNamespace, topic, 1,
+                                receive_callback));
+  for (uint64_t i = 0; i < num_messages; ++i) {
+    ASSERT_TRUE(msg_received.TimedWait(timeout));
+  }
+
+  Statistics stats = cluster.GetStatisticsSync();
+  stats.Aggregate(client->GetStatisticsSync());
+  const auto& histograms = stats.GetHistograms();
+  for (const char* name : {"pilot.trace.pilot_receive_us",
+                           "pilot.trace.append_us",
+                           "tower.topic_tailer.trace.tower_read_us",
+                           "copilot.trace.copilot_receive_us",
+                           "client.trace.deliver_us",
+                           "client.trace.end_to_end_us"}) {
+    auto it = histograms.find(name);
+    ASSERT_TRUE(it != histograms.end());
+    ASSERT_EQ(it->second->GetNumSamples(), num_messages);
+  }
+}
+
+/**
+ * Publishes compressed payloads, traced and not, and checks that they are
+ * acknowledged and delivered uncompressed.
+ */
+TEST(IntegrationTest, CompressedPayload) {
+  LocalTestCluster cluster(info_log);
+  ASSERT_OK(cluster.GetStatus());
+
+  std::string data;
+  for (int i = 0; i < 50; ++i) {
+    data += "{\"id\":" + std::to_string(i) + ",\"kind\":\"update\"},";
+  }
+
+  port::Semaphore msg_acked;
+  auto publish_callback = [&] (std::unique_ptr<ResultStatus> rs) {
+    ASSERT_OK(rs->GetStatus());
+    ASSERT_EQ(rs->GetContents().ToString(), data);
+    msg_acked.Post();
+  };
+  port::Semaphore msg_received;
+  auto receive_callback = [&] (std::unique_ptr<MessageReceived>& mr) {
+    ASSERT_EQ(mr->GetContents().ToString(), data);
+    msg_received.Post();
+  };
+
+  for (double trace_sample_rate : {0.0, 1.0}) {
+    const Topic topic = trace_sample_rate > 0.0 ? "CompressedPayloadTraced" :
+                                                  "CompressedPayload";
+    ClientOptions options;
+    options.config = cluster.GetConfiguration();
+    options.info_log = info_log;
+    options.trace_sample_rate = trace_sample_rate;
+    std::unique_ptr<Client> client;
+    ASSERT_OK(Client::Create(std::move(options), &client));
+
+    // Falls back to no compression where a codec is not built in.
+    for (CompressionType type : {CompressionType::kSnappy,
+                                 CompressionType::kLZ4,
+                                 CompressionType::kZlib}) {
+      ASSERT_OK(client->Publish(GuestTenant, topic, GuestNamespace,
+                                TopicOptions(type), data, publish_callback,
+                                MsgId()).status);
+      ASSERT_TRUE(msg_acked.TimedWait(timeout));
+    }
+    ASSERT_TRUE(client->Subscribe(GuestTenant, GuestNamespace, topic, 1,
+                                  receive_callback));
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(msg_received.TimedWait(timeout));
+    }
+  }
+}
+
 /**
  * Publishes 1 message. Trims message. Attempts to read
  * message and ensures that one gap is received.
@@ -156,10 +156,18 @@ void LocalTestCluster::Initialize(Options opts) {
   opts.tower.log_router = storage_->log_router_;
 
   EnvOptions env_options;
+  msg_loop_options_.event_loop.network = opts.network;
+  msg_loop_options_.event_loop.clock = opts.clock;
+  msg_loop_options_.event_loop.loopback = opts.loopback;
 
   if (opts.start_controltower) {
-    control_tower_loop_.reset(new MsgLoop(
-        env_, env_options, opts.controltower_port, 4, info_log_, "tower"));
+    control_tower_loop_.reset(new MsgLoop(env_,
+                                          env_options,
+                                          opts.controltower_port,
+                                          4,
+                                          info_log_,
+                                          "tower",
+                                          msg_loop_options_));
     status_ = control_tower_loop_->Initialize();
     if (!status_.ok()) {
       LOG_ERROR(info_log_, "Failed to initialize Control Tower loop.");
@@ -194,8 +202,13 @@ void LocalTestCluster::Initialize(Options opts) {
   }
 
   if (opts.start_copilot || opts.start_pilot) {
-    cockpit_loop_.reset(new MsgLoop(
-        env_, env_options, opts.cockpit_port, 4, info_log_, "cockpit"));
+    cockpit_loop_.reset(new MsgLoop(env_,
+                                    env_options,
+                                    opts.cockpit_port,
+                                    4,
+                                    info_log_,
+                                    "cockpit",
+                                    msg_loop_options_));
     status_ = cockpit_loop_->Initialize();
     if (!status_.ok()) {
       LOG_ERROR(info_log_, "Failed to initialize Cockpit loop.");
@@ -264,7 +277,9 @@ LocalTestCluster::CreateClient(std::unique_ptr<ClientImpl>* client,
   client_options.info_log = info_log_;
   client_options.config = GetConfiguration();
   Status status = ClientImpl::Create(std::move(client_options),
-                                     client, is_internal);
+                                     client,
+                                     is_internal,
+                                     msg_loop_options_);
   return status;
 }
 
@@ -17,6 +17,7 @@
 #include "src/pilot/options.h"
 #include "src/pilot/pilot.h"
 #include "src/messages/msg_loop.h"
+#include "src/messages/simulated_network.h"
 #include "src/util/storage.h"
 #include "src/util/common/statistics.h"
 #include "src/logdevice/storage.h"
@@ -53,6 +54,14 @@ class LocalTestCluster {
     int cockpit_port = Copilot::DEFAULT_PORT;
     std::shared_ptr<LogDeviceStorage> log_storage;
     std::shared_ptr<LogDeviceLogRouter> log_router;
+    // If set, servers and clients communicate over this network instead of
+    // TCP, so several clusters can share a process if they use other ports.
+    std::shared_ptr<SimulatedNetwork> network;
+    // If set, servers and clients read time from this clock.
+    std::shared_ptr<SimulatedClock> clock;
+    // If set, servers and clients hand messages to each other in memory
+    // rather than over TCP.
+    bool loopback = false;
   };
 
   /**
@@ -135,6 +144,9 @@ class LocalTestCluster {
  private:
   void Initialize(Options opts);
 
+  /** Options for the message loops of servers and clients. */
+  MsgLoop::Options msg_loop_options_;
+
   struct TestStorage;
   std::unique_ptr<TestStorage> storage_;
 
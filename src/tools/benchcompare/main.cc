@@ -0,0 +1,116 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+// Compares benchmark results against a baseline, as written by rocketbench
+// --json_output or by the microbenchmarks with ROCKETSPEED_BENCH_JSON set.
+// Samples from several files (e.g. repeated trials) are merged per metric.
+// A metric has regressed if its median moved in the wrong direction by more
+// than the threshold and the Mann-Whitney U test finds the change
+// significant. Exits with status 1 if any metric regressed.
+//
+#include <cmath>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <stdio.h>
+
+#include "src/util/common/parsing.h"
+#include "src/util/perf_results.h"
+
+DEFINE_string(baseline, "", "comma separated list of baseline result files");
+DEFINE_string(candidate, "", "comma separated list of candidate result files");
+DEFINE_double(threshold, 5.0,
+"percentage change in the median to tolerate before reporting a regression");
+DEFINE_double(alpha, 0.05,
+"significance level a change must reach to be reported as a regression");
+
+using namespace rocketspeed;
+
+namespace {
+
+bool ReadResults(const std::string& paths, PerfResults* results) {
+  for (const std::string& path : SplitString(paths)) {
+    if (path.empty()) {
+      continue;
+    }
+    Status st = PerfResults::ReadFromFile(path, results);
+    if (!st.ok()) {
+      fprintf(stderr, "%s\n", st.ToString().c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  GFLAGS::SetUsageMessage(
+    "benchcompare --baseline=<files> --candidate=<files>");
+  GFLAGS::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_baseline.empty() || FLAGS_candidate.empty()) {
+    fprintf(stderr, "Both --baseline and --candidate are required.\n");
+    return 1;
+  }
+  if (FLAGS_threshold < 0.0 || FLAGS_alpha <= 0.0 || FLAGS_alpha > 1.0) {
+    fprintf(stderr, "threshold must be non-negative and alpha in (0, 1].\n");
+    return 1;
+  }
+
+  PerfResults baseline;
+  PerfResults candidate;
+  if (!ReadResults(FLAGS_baseline, &baseline) ||
+      !ReadResults(FLAGS_candidate, &candidate)) {
+    return 1;
+  }
+
+  printf("%-48s%12s%12s%9s%8s\n",
+         "metric", "baseline", "candidate", "change", "p");
+  int regressions = 0;
+  int improvements = 0;
+  for (const auto& entry : candidate.GetMetrics()) {
+    const std::string& name = entry.first;
+    const PerfMetric& after = entry.second;
+    auto it = baseline.GetMetrics().find(name);
+    if (it == baseline.GetMetrics().end() ||
+        it->second.samples.empty() ||
+        after.samples.empty()) {
+      printf("%-48s%12s%12s%9s%8s  (no baseline)\n",
+             name.c_str(), "-", "-", "-", "-");
+      continue;
+    }
+    const PerfMetric& before = it->second;
+    const double median_before = Median(before.samples);
+    const double median_after = Median(after.samples);
+    const double change = median_before != 0.0 ?
+      100.0 * (median_after - median_before) / std::fabs(median_before) :
+      0.0;
+    const double p = MannWhitneyPValue(before.samples, after.samples);
+
+    // Positive when the candidate is worse.
+    const double worse = after.higher_is_better ? -change : change;
+    const char* verdict = "";
+    if (p < FLAGS_alpha && worse > FLAGS_threshold) {
+      verdict = "  REGRESSION";
+      ++regressions;
+    } else if (p < FLAGS_alpha && -worse > FLAGS_threshold) {
+      verdict = "  improvement";
+      ++improvements;
+    }
+    printf("%-48s%12.4g%12.4g%+8.1f%%%8.3f%s\n",
+           name.c_str(), median_before, median_after, change, p, verdict);
+  }
+  for (const auto& entry : baseline.GetMetrics()) {
+    if (!candidate.GetMetrics().count(entry.first)) {
+      printf("%-48s%12s%12s%9s%8s  (no candidate)\n",
+             entry.first.c_str(), "-", "-", "-", "-");
+    }
+  }
+
+  printf("\n%d regression(s), %d improvement(s) beyond %.1f%% at p < %.3f\n",
+         regressions, improvements, FLAGS_threshold, FLAGS_alpha);
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,400 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+// Benchmarks the copilot fan-out path (CopilotWorker::ProcessData) in
+// isolation. A single CopilotWorker is driven directly on the main thread,
+// with a stub control tower router, and the queues to clients and towers
+// replaced by sinks that count outgoing messages. No network is involved.
+//
+#define __STDC_FORMAT_MACROS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+
+#include "include/Logger.h"
+#include "include/Types.h"
+#include "src/copilot/control_tower_router.h"
+#include "src/copilot/copilot.h"
+#include "src/copilot/options.h"
+#include "src/copilot/worker.h"
+#include "src/logdevice/log_router.h"
+#include "src/messages/commands.h"
+#include "src/messages/messages.h"
+#include "src/messages/msg_loop.h"
+#include "src/messages/queues.h"
+#include "src/port/Env.h"
+#include "src/util/topic_uuid.h"
+#include "src/util/common/guid_generator.h"
+#include "src/util/common/host_id.h"
+
+DEFINE_string(subscribers_per_topic, "1,10,100,1000,10000,100000",
+"comma separated list of subscribers per topic to sweep");
+DEFINE_string(topics, "1,100,10000",
+"comma separated list of topics per worker to sweep");
+DEFINE_uint64(max_subscriptions, 1000000,
+"skip configurations with more subscriptions than this in total");
+DEFINE_uint64(deliveries, 1000000,
+"approximate number of deliveries to measure for each configuration");
+DEFINE_uint64(client_streams, 1000,
+"number of client streams the subscriptions are spread over");
+DEFINE_int32(message_size, 100, "message size (bytes)");
+
+namespace {
+
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> allocated_bytes(0);
+
+}  // namespace
+
+// Counts every allocation made by the process. The benchmark is single
+// threaded while measuring, so all counted allocations are on the fan-out
+// path.
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* ptr = malloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+namespace rocketspeed {
+
+/** Routes every log to the same, non-existent, control tower. */
+class StubTowerRouter : public ControlTowerRouter {
+ public:
+  StubTowerRouter() : tower_(HostId::CreateLocal(58500, "tower")) {}
+
+  Status GetControlTowers(LogID logID,
+                          std::vector<HostId const*>* out) const override {
+    out->push_back(&tower_);
+    return Status::OK();
+  }
+
+ private:
+  const HostId tower_;
+};
+
+/**
+ * Drives a CopilotWorker from the calling thread. Messages sent by the
+ * worker to clients and towers are written to queues that are only ever
+ * drained by this object.
+ */
+class CopilotWorkerBench {
+ public:
+  CopilotWorkerBench(Copilot* copilot, size_t client_queue_size,
+                     size_t tower_queue_size)
+  : info_log_(copilot->GetOptions().info_log)
+  , queue_stats_(std::make_shared<QueueStats>("copilotbench")) {
+    worker_.reset(new CopilotWorker(copilot->GetOptions(),
+                                    std::make_shared<StubTowerRouter>(),
+                                    0,
+                                    copilot,
+                                    nullptr));
+    // Worker queues are indexed by MsgLoop worker.
+    for (auto& queue : worker_->client_queues_) {
+      queue = std::make_shared<CommandQueue>(info_log_,
+                                             queue_stats_,
+                                             client_queue_size);
+    }
+    for (auto& queue : worker_->tower_queues_) {
+      queue = std::make_shared<CommandQueue>(info_log_,
+                                             queue_stats_,
+                                             tower_queue_size);
+    }
+  }
+
+  void Subscribe(const TopicUUID& uuid,
+                 StreamID stream,
+                 SubscriptionID sub_id,
+                 SequenceNumber seqno) {
+    Slice namespace_id;
+    Slice topic_name;
+    uuid.GetTopicID(&namespace_id, &topic_name);
+    std::unique_ptr<Message> msg(new MessageSubscribe(Tenant::GuestTenant,
+                                                      namespace_id.ToString(),
+                                                      topic_name.ToString(),
+                                                      seqno,
+                                                      sub_id));
+    Execute(worker_->WorkerCommand(1, std::move(msg), 0, stream));
+  }
+
+  /**
+   * Finds the subscription the worker opened on the tower for a topic.
+   *
+   * @return false if the worker has not subscribed to the topic.
+   */
+  bool GetTowerSubscription(const TopicUUID& uuid,
+                            StreamID* stream,
+                            SubscriptionID* sub_id) const {
+    auto it = worker_->topics_.find(uuid);
+    if (it == worker_->topics_.end() || it->second.towers.empty()) {
+      return false;
+    }
+    *stream = it->second.towers[0].stream->GetStreamID();
+    *sub_id = it->second.towers[0].sub_id;
+    return true;
+  }
+
+  /** @return Command delivering a record from a tower subscription. */
+  std::unique_ptr<Command> DeliverCommand(StreamID stream,
+                                          SubscriptionID sub_id,
+                                          SequenceNumber seqno,
+                                          const std::string& payload) {
+    std::unique_ptr<MessageDeliverData> data(
+      new MessageDeliverData(Tenant::GuestTenant,
+                             sub_id,
+                             GUIDGenerator::ThreadLocalGUIDGenerator()->
+                               Generate(),
+                             payload));
+    data->SetSequenceNumbers(seqno, seqno);
+    return worker_->WorkerCommand(1, std::move(data), 0, stream);
+  }
+
+  void Execute(std::unique_ptr<Command> command) {
+    static_cast<ExecuteCommand*>(command.get())->Execute();
+  }
+
+  /** @return Number of messages sent to clients since the last drain. */
+  uint64_t DrainClients() {
+    return DrainQueues(worker_->client_queues_);
+  }
+
+  /** @return Number of messages sent to towers since the last drain. */
+  uint64_t DrainTowers() {
+    return DrainQueues(worker_->tower_queues_);
+  }
+
+ private:
+  uint64_t DrainQueues(std::vector<std::shared_ptr<CommandQueue>>& queues) {
+    uint64_t sent = 0;
+    for (auto& queue : queues) {
+      // Reads are done in batches of at most kMaxQueueBatchReadSize.
+      bool more = true;
+      while (more) {
+        more = false;
+        BatchedRead<std::unique_ptr<Command>> batch(queue.get());
+        std::unique_ptr<Command> command;
+        while (batch.Read(command)) {
+          more = true;
+          assert(command->GetCommandType() == CommandType::kSendCommand);
+          sent += static_cast<SendCommand*>(command.get())
+            ->GetDestinations().size();
+        }
+      }
+    }
+    return sent;
+  }
+
+  std::shared_ptr<Logger> info_log_;
+  std::shared_ptr<QueueStats> queue_stats_;
+  std::unique_ptr<CopilotWorker> worker_;
+};
+
+}  // namespace rocketspeed
+
+using namespace rocketspeed;
+
+namespace {
+
+bool ParseList(const std::string& str, std::vector<uint64_t>* out) {
+  size_t pos = 0;
+  while (pos <= str.size()) {
+    size_t end = str.find(',', pos);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+    const std::string item = str.substr(pos, end - pos);
+    char* parse_end;
+    const uint64_t value = strtoull(item.c_str(), &parse_end, 10);
+    if (item.empty() || *parse_end != '\0' || value == 0) {
+      return false;
+    }
+    out->push_back(value);
+    pos = end + 1;
+  }
+  return !out->empty();
+}
+
+struct Result {
+  double setup_secs;
+  uint64_t deliveries;
+  uint64_t expected_deliveries;
+  double secs;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+};
+
+Result RunConfiguration(Copilot* copilot,
+                        uint64_t subscribers_per_topic,
+                        uint64_t num_topics,
+                        const std::string& payload) {
+  Result result;
+  CopilotWorkerBench bench(copilot,
+                           subscribers_per_topic,
+                           num_topics + 1);
+
+  // Subscribe at seqno 1, spreading subscribers over the client streams.
+  std::vector<TopicUUID> topics;
+  const auto setup_start = std::chrono::steady_clock::now();
+  SubscriptionID next_sub_id = 1;
+  for (uint64_t t = 0; t < num_topics; ++t) {
+    topics.emplace_back(GuestNamespace, "topic-" + std::to_string(t));
+    for (uint64_t i = 0; i < subscribers_per_topic; ++i) {
+      const StreamID stream = 1 + next_sub_id % FLAGS_client_streams;
+      bench.Subscribe(topics.back(), stream, next_sub_id++, 1);
+    }
+  }
+  bench.DrainTowers();
+  result.setup_secs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - setup_start).count();
+
+  // Find the tower subscriptions that records will be delivered on.
+  struct TowerSub {
+    StreamID stream;
+    SubscriptionID sub_id;
+  };
+  std::vector<TowerSub> tower_subs(num_topics);
+  for (uint64_t t = 0; t < num_topics; ++t) {
+    if (!bench.GetTowerSubscription(topics[t],
+                                    &tower_subs[t].stream,
+                                    &tower_subs[t].sub_id)) {
+      fprintf(stderr, "No tower subscription for %s\n",
+              topics[t].ToString().c_str());
+      exit(1);
+    }
+  }
+
+  // Deliver rounds of one record on every topic. Commands for a round are
+  // built up front so that only the worker and the sinks are measured.
+  const uint64_t subscriptions = subscribers_per_topic * num_topics;
+  const uint64_t rounds =
+    std::max<uint64_t>(1, FLAGS_deliveries / subscriptions);
+  result.deliveries = 0;
+  result.expected_deliveries = rounds * subscriptions;
+  result.secs = 0;
+  result.allocations = 0;
+  result.allocated_bytes = 0;
+  std::vector<std::unique_ptr<Command>> commands;
+  commands.reserve(num_topics);
+  for (uint64_t round = 0; round < rounds; ++round) {
+    const SequenceNumber seqno = round + 1;
+    for (const TowerSub& sub : tower_subs) {
+      commands.emplace_back(
+        bench.DeliverCommand(sub.stream, sub.sub_id, seqno, payload));
+    }
+
+    const uint64_t start_allocations = allocations.load();
+    const uint64_t start_bytes = allocated_bytes.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& command : commands) {
+      bench.Execute(std::move(command));
+      result.deliveries += bench.DrainClients();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    result.secs += std::chrono::duration<double>(end - start).count();
+    result.allocations += allocations.load() - start_allocations;
+    result.allocated_bytes += allocated_bytes.load() - start_bytes;
+    commands.clear();
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Env::InstallSignalHandlers();
+  GFLAGS::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<uint64_t> subscribers_sweep;
+  std::vector<uint64_t> topics_sweep;
+  if (!ParseList(FLAGS_subscribers_per_topic, &subscribers_sweep) ||
+      !ParseList(FLAGS_topics, &topics_sweep)) {
+    fprintf(stderr, "subscribers_per_topic and topics must be comma "
+                    "separated lists of positive integers.\n");
+    return 1;
+  }
+  if (FLAGS_client_streams == 0) {
+    fprintf(stderr, "client_streams must be greater than 0.\n");
+    return 1;
+  }
+  if (FLAGS_message_size < 0 || FLAGS_message_size > 1024 * 1024) {
+    fprintf(stderr, "message_size must be 0-1MB.\n");
+    return 1;
+  }
+
+  // The MsgLoop is never run. It is only needed to construct the workers and
+  // to allocate tower streams.
+  Env* env = Env::Default();
+  auto info_log = std::make_shared<NullLogger>();
+  MsgLoop msg_loop(env, EnvOptions(), 0, 1, info_log, "copilot");
+  Status st = msg_loop.Initialize();
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to initialize MsgLoop: %s\n",
+            st.ToString().c_str());
+    return 1;
+  }
+
+  CopilotOptions options;
+  options.msg_loop = &msg_loop;
+  options.info_log = info_log;
+  options.control_tower_router = std::make_shared<StubTowerRouter>();
+  options.log_router = std::make_shared<LogDeviceLogRouter>(1, 1);
+  options.rollcall_enabled = false;
+  Copilot* copilot_raw;
+  st = Copilot::CreateNewInstance(std::move(options), &copilot_raw);
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to create Copilot: %s\n", st.ToString().c_str());
+    return 1;
+  }
+  std::unique_ptr<Copilot> copilot(copilot_raw);
+
+  const std::string payload(FLAGS_message_size, 'x');
+  printf("%12s %8s %10s %12s %14s %12s %14s %14s\n",
+         "subs/topic", "topics", "setup(s)", "deliveries",
+         "deliveries/s", "ns/delivery", "allocs/deliv", "bytes/deliv");
+  for (uint64_t num_topics : topics_sweep) {
+    for (uint64_t subscribers : subscribers_sweep) {
+      if (subscribers * num_topics > FLAGS_max_subscriptions) {
+        continue;
+      }
+      const Result r =
+        RunConfiguration(copilot.get(), subscribers, num_topics, payload);
+      const double deliveries =
+        static_cast<double>(std::max<uint64_t>(r.deliveries, 1));
+      printf("%12" PRIu64 " %8" PRIu64 " %10.2f %12" PRIu64
+             " %14.0f %12.1f %14.2f %14.1f\n",
+             subscribers,
+             num_topics,
+             r.setup_secs,
+             r.deliveries,
+             static_cast<double>(r.deliveries) / r.secs,
+             r.secs * 1e9 / deliveries,
+             static_cast<double>(r.allocations) / deliveries,
+             static_cast<double>(r.allocated_bytes) / deliveries);
+      if (r.deliveries != r.expected_deliveries) {
+        fprintf(stderr, "Expected %" PRIu64 " deliveries, got %" PRIu64 "\n",
+                r.expected_deliveries, r.deliveries);
+        return 1;
+      }
+      fflush(stdout);
+    }
+  }
+
+  copilot->Stop();
+  return 0;
+}
@@ -27,9 +27,11 @@
 #include "src/util/common/guid_generator.h"
 #include "src/util/common/host_id.h"
 #include "src/util/common/parsing.h"
+#include "src/util/perf_results.h"
 #include "src/tools/rocketbench/random_distribution.h"
 #include "src/client/client.h"
 #include "src/util/common/client_env.h"
+#include "src/util/common/compression.h"
 
 // This tool can behave as a standalone producer, a standalone
 // consumer or both a producer and a consumer.
@@ -37,6 +39,9 @@ DEFINE_bool(start_producer, true, "starts the producer");
 DEFINE_bool(start_consumer, true, "starts the consumer");
 DEFINE_bool(start_local_server, false, "starts an embedded rocketspeed server");
 DEFINE_string(storage_url, "", "Storage service URL for local server");
+DEFINE_bool(loopback, false,
+"with start_local_server, clients and servers hand messages to each other "
+"in memory instead of over TCP");
 
 DEFINE_int32(num_threads, 8, "number of threads");
 DEFINE_string(config,
@@ -58,7 +63,11 @@ DEFINE_bool(await_ack, true, "wait for and include acks in times");
 DEFINE_bool(delay_subscribe, false, "start reading after publishing");
 DEFINE_bool(logging, true, "enable/disable logging");
 DEFINE_bool(report, true, "report results to stdout");
+DEFINE_double(trace_sample_rate, 0.0,
+"fraction of messages whose per-stage latencies are traced and reported");
 DEFINE_string(namespaceid, rocketspeed::GuestNamespace, "namespace id");
+DEFINE_string(compression, "none",
+              "payload codec: none, snappy, lz4 or zlib");
 DEFINE_string(topics_distribution, "uniform",
 "uniform, normal, poisson, fixed");
 DEFINE_int64(topics_mean, 0,
@@ -66,11 +75,20 @@ DEFINE_int64(topics_mean, 0,
 DEFINE_int64(topics_stddev, 0,
 "Standard Deviation for Normal topic distribution (rounded to nearest int64)");
 DEFINE_int32(wait_for_debugger, 0, "wait for debugger to attach to me");
+DEFINE_bool(open_loop, false,
+"send on a fixed schedule regardless of stalls, and measure latencies from "
+"the intended send time (requires message_rate)");
+DEFINE_int32(report_interval, 0,
+"print latency distributions every X seconds (0 = only at the end)");
+DEFINE_string(json_output, "",
+"also write throughput and latency percentiles to this file as JSON, for "
+"comparison against a baseline with benchcompare");
 
 using namespace rocketspeed;
 
 rocketspeed::Env* env;
 std::shared_ptr<rocketspeed::Logger> info_log;
+rocketspeed::CompressionType compression;
 
 
 typedef std::pair<rocketspeed::MsgId, uint64_t> MsgTime;
@@ -139,6 +157,7 @@ static void ProducerWorker(void* param) {
   int64_t rate = FLAGS_message_rate / FLAGS_num_threads + 1;
 
   auto start = std::chrono::steady_clock::now();
+  uint64_t start_micros = env->NowMicros();
   for (int64_t i = 0; i < num_messages; ++i) {
     // Create random topic name
     char topic_name[64];
@@ -149,10 +168,23 @@ static void ProducerWorker(void* param) {
              "benchmark.%llu",
              static_cast<long long unsigned int>(topic_num));
 
-    TopicOptions topic_options;
+    TopicOptions topic_options(compression);
     // Add ID and timestamp to message ID.
     static std::atomic<uint64_t> message_index;
-    uint64_t send_time = env->NowMicros();
+    uint64_t send_time;
+    if (FLAGS_open_loop) {
+      // Wait for the time this message is scheduled on the ideal timeline.
+      // If we are behind, e.g. after a stall, send immediately but keep the
+      // scheduled time so that latencies include the time spent waiting.
+      send_time = start_micros + 1000000 * i / rate;
+      uint64_t now = env->NowMicros();
+      if (send_time > now) {
+        /* sleep override */
+        std::this_thread::sleep_for(std::chrono::microseconds(send_time - now));
+      }
+    } else {
+      send_time = env->NowMicros();
+    }
     uint64_t index = message_index++;
     snprintf(data.data(), data.size(),
              "%llu %llu",
@@ -176,7 +208,7 @@ static void ProducerWorker(void* param) {
       args->result = false;
     }
 
-    if (FLAGS_message_rate) {
+    if (FLAGS_message_rate && !FLAGS_open_loop) {
       // Check if we are sending messages too fast, and if so, sleep.
       int64_t have_sent = i;
 
@@ -354,6 +386,26 @@ int main(int argc, char** argv) {
     fprintf(stderr, "num_messages must be greater than 0.\n");
     return 1;
   }
+  if (FLAGS_open_loop && FLAGS_message_rate <= 0) {
+    fprintf(stderr, "open_loop requires a message_rate.\n");
+    return 1;
+  }
+
+  if (FLAGS_report_interval < 0) {
+    fprintf(stderr, "report_interval must not be negative.\n");
+    return 1;
+  }
+
+  if (!rocketspeed::ParseCompressionType(FLAGS_compression,
+                                         &compression).ok()) {
+    fprintf(stderr, "compression must be none, snappy, lz4 or zlib.\n");
+    return 1;
+  }
+  if (!rocketspeed::IsCompressionSupported(compression)) {
+    fprintf(stderr, "%s is not built in, payloads are sent uncompressed.\n",
+            FLAGS_compression.c_str());
+  }
+
   if (!FLAGS_start_consumer && !FLAGS_start_producer) {
     fprintf(stderr, "You must specify at least one --start_producer "
             "or --start_consumer\n");
@@ -394,6 +446,7 @@ int main(int argc, char** argv) {
     test_options.start_copilot = true;
     test_options.start_pilot = true;
     test_options.storage_url = FLAGS_storage_url;
+    test_options.loopback = FLAGS_loopback;
     if (FLAGS_cache_size) {
       test_options.tower.cache_size = FLAGS_cache_size;
     }
@@ -443,6 +496,18 @@ int main(int argc, char** argv) {
   rocketspeed::ThreadLocalPtr ack_latency;
   rocketspeed::ThreadLocalPtr recv_latency;
 
+  // Latencies since the last interval report. These are recorded on the
+  // client threads and collected by the reporter thread, so each is guarded
+  // by a (mostly uncontended) per-thread mutex.
+  struct IntervalStats {
+    std::mutex mutex;
+    rocketspeed::Statistics stats;
+    rocketspeed::Histogram* ack_latency;
+    rocketspeed::Histogram* recv_latency;
+  };
+  std::vector<std::unique_ptr<IntervalStats>> all_interval_stats;
+  rocketspeed::ThreadLocalPtr interval_stats;
+
   // Initializes stats for current thread.
   auto InitThreadLocalStats = [&] () {
     if (!per_thread_stats.Get()) {
@@ -451,21 +516,57 @@ int main(int argc, char** argv) {
       per_thread_stats.Reset(stats.get());
       ack_latency.Reset(stats->AddLatency("ack-latency"));
       recv_latency.Reset(stats->AddLatency("recv-latency"));
+      std::unique_ptr<IntervalStats> interval(new IntervalStats());
+      interval->ack_latency = interval->stats.AddLatency("ack-latency");
+      interval->recv_latency = interval->stats.AddLatency("recv-latency");
+      interval_stats.Reset(interval.get());
       std::lock_guard<std::mutex> lock(all_stats_mutex);
       all_stats.emplace_back(std::move(stats));
+      all_interval_stats.emplace_back(std::move(interval));
     }
   };
 
-  // Get thread local ack latency histogram.
-  auto GetAckLatency = [&] () {
+  // Records a latency in the thread local histograms.
+  auto RecordLatency = [&] (rocketspeed::ThreadLocalPtr& histogram,
+                            rocketspeed::Histogram* IntervalStats::*interval,
+                            uint64_t latency) {
     InitThreadLocalStats();
-    return static_cast<rocketspeed::Histogram*>(ack_latency.Get());
+    static_cast<rocketspeed::Histogram*>(histogram.Get())->Record(latency);
+    if (FLAGS_report_interval) {
+      auto stats = static_cast<IntervalStats*>(interval_stats.Get());
+      std::lock_guard<std::mutex> lock(stats->mutex);
+      (stats->*interval)->Record(latency);
+    }
   };
 
-  // Get thread local recv latency histogram.
-  auto GetRecvLatency = [&] () {
-    InitThreadLocalStats();
-    return static_cast<rocketspeed::Histogram*>(recv_latency.Get());
+  auto RecordAckLatency = [&] (uint64_t latency) {
+    RecordLatency(ack_latency, &IntervalStats::ack_latency, latency);
+  };
+
+  auto RecordRecvLatency = [&] (uint64_t latency) {
+    RecordLatency(recv_latency, &IntervalStats::recv_latency, latency);
+  };
+
+  // Prints the latencies recorded since the previous call.
+  auto ReportInterval = [&] (uint64_t elapsed_seconds) {
+    rocketspeed::Statistics stats;
+    rocketspeed::Histogram* ack = stats.AddLatency("ack-latency");
+    rocketspeed::Histogram* recv = stats.AddLatency("recv-latency");
+    {
+      std::lock_guard<std::mutex> lock(all_stats_mutex);
+      for (auto& interval : all_interval_stats) {
+        std::lock_guard<std::mutex> interval_lock(interval->mutex);
+        ack->Aggregate(interval->ack_latency->MoveThread());
+        recv->Aggregate(interval->recv_latency->MoveThread());
+      }
+    }
+    printf("[%4" PRIu64 "s] ack-latency:  %s\n",
+           elapsed_seconds, ack->ReportDistribution().c_str());
+    if (FLAGS_start_consumer) {
+      printf("[%4" PRIu64 "s] recv-latency: %s\n",
+             elapsed_seconds, recv->ReportDistribution().c_str());
+    }
+    fflush(stdout);
   };
 
   // Create callback for publish acks.
@@ -485,7 +586,7 @@ int main(int argc, char** argv) {
       rocketspeed::Slice data = rs->GetContents();
       unsigned long long int message_index, send_time;
       std::sscanf(data.data(), "%llu %llu", &message_index, &send_time);
-      GetAckLatency()->Record(static_cast<uint64_t>(now - send_time));
+      RecordAckLatency(static_cast<uint64_t>(now - send_time));
 
       if (FLAGS_delay_subscribe) {
         if (rs->GetStatus().ok()) {
@@ -539,7 +640,7 @@ int main(int argc, char** argv) {
           "Received message %llu with timestamp %llu",
           static_cast<long long unsigned int>(message_index),
           static_cast<long long unsigned int>(send_time));
-      GetRecvLatency()->Record(static_cast<uint64_t>(now - send_time));
+      RecordRecvLatency(static_cast<uint64_t>(now - send_time));
       std::lock_guard<std::mutex> lock(is_received_mutex);
       if (is_received[message_index]) {
         LOG_WARN(info_log,
@@ -578,6 +679,7 @@ int main(int argc, char** argv) {
     rocketspeed::ClientOptions options;
     options.info_log = info_log;
     options.num_workers = 1;
+    options.trace_sample_rate = FLAGS_trace_sample_rate;
 
     if (!FLAGS_config.empty()) {
       // Use provided configuration string.
@@ -597,7 +699,14 @@ int main(int argc, char** argv) {
 
     std::unique_ptr<rocketspeed::ClientImpl> client;
     // Create the client.
-    auto st = rocketspeed::ClientImpl::Create(std::move(options), &client);
+    // Connections to the embedded server may skip TCP.
+    rocketspeed::MsgLoop::Options msg_loop_options;
+    msg_loop_options.event_loop.loopback =
+      FLAGS_start_local_server && FLAGS_loopback;
+    auto st = rocketspeed::ClientImpl::Create(std::move(options),
+                                              &client,
+                                              false,
+                                              msg_loop_options);
     if (!st.ok()) {
       LOG_ERROR(info_log, "Failed to open client: %s.", st.ToString().c_str());
       return 1;
@@ -630,6 +739,20 @@ int main(int argc, char** argv) {
   rocketspeed::Env::ThreadId producer_threadid = 0;
   rocketspeed::Env::ThreadId consumer_threadid = 0;
 
+  // Periodically report latency distributions while the benchmark runs.
+  rocketspeed::port::Semaphore reporter_done;
+  rocketspeed::Env::ThreadId reporter_threadid = 0;
+  if (FLAGS_report_interval) {
+    reporter_threadid = env->StartThread([&] () {
+      auto interval = std::chrono::seconds(FLAGS_report_interval);
+      uint64_t elapsed_seconds = 0;
+      while (!reporter_done.TimedWait(interval)) {
+        elapsed_seconds += FLAGS_report_interval;
+        ReportInterval(elapsed_seconds);
+      }
+    }, "Reporter");
+  }
+
   // Start producing messages
   if (FLAGS_start_producer) {
     printf("Publishing messages.\n");
@@ -718,6 +841,11 @@ int main(int argc, char** argv) {
 
   end = std::chrono::steady_clock::now();
 
+  if (FLAGS_report_interval) {
+    reporter_done.Post();
+    env->WaitForJoin(reporter_threadid);
+  }
+
   // Calculate total time.
   auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(
     end - start);
@@ -819,6 +947,33 @@ int main(int argc, char** argv) {
         stats.Aggregate(client->GetStatisticsSync());
       }
 
+      rocketspeed::PerfResults results;
+      results.AddSample("rocketbench.throughput", "messages/s", true,
+                        static_cast<double>(msg_per_sec));
+
+      printf("\n");
+      printf("Latency distribution (micros%s)\n",
+             FLAGS_open_loop ? ", from intended send time" : "");
+      for (const char* name : {"ack-latency", "recv-latency"}) {
+        auto it = stats.GetHistograms().find(name);
+        if (it != stats.GetHistograms().end()) {
+          printf("%s: %s\n", name, it->second->ReportDistribution().c_str());
+          const std::string metric = std::string("rocketbench.") + name;
+          results.AddSample(metric + ".p50", "micros", false,
+                            it->second->Percentile(0.50));
+          results.AddSample(metric + ".p99", "micros", false,
+                            it->second->Percentile(0.99));
+        }
+      }
+
+      if (!FLAGS_json_output.empty()) {
+        rocketspeed::Status st = results.WriteToFile(FLAGS_json_output);
+        if (!st.ok()) {
+          fprintf(stderr, "%s\n", st.ToString().c_str());
+          ret = 1;
+        }
+      }
+
       printf("\n");
       printf("Statistics\n");
       printf("%s", stats.Report().c_str());
@@ -0,0 +1,322 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+// Scale test for subscription state. Opens a large number of subscriptions
+// on a LocalTestCluster from several simulated clients, then reports the
+// memory used per subscription by each component, subscribe and unsubscribe
+// churn rates, and the time taken for subscriptions to be restored after the
+// copilot restarts.
+//
+#define __STDC_FORMAT_MACROS
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "include/Logger.h"
+#include "include/RocketSpeed.h"
+#include "include/Types.h"
+#include "src/client/client.h"
+#include "src/port/Env.h"
+#include "src/test/test_cluster.h"
+#include "src/util/common/statistics.h"
+
+DEFINE_uint64(subscriptions, 1000000, "total number of subscriptions");
+DEFINE_uint64(clients, 10, "number of clients the subscriptions are spread "
+"over");
+DEFINE_uint64(topics, 100000, "number of distinct topics subscribed to");
+DEFINE_uint64(churn, 100000, "number of subscriptions to unsubscribe and "
+"then subscribe again when measuring churn rates");
+DEFINE_bool(restart, true, "restart the cluster and measure the time taken "
+"for subscriptions to be restored");
+DEFINE_int32(timeout, 600, "seconds to wait for each phase to complete");
+DEFINE_bool(logging, false, "enable server and client logs");
+
+using namespace rocketspeed;
+
+namespace {
+
+const char* kIncomingSubscriptions = "copilot.incoming_subscriptions";
+
+/** Memory and rollcall measurements across the cluster and clients. */
+struct Sample {
+  int64_t client_subscriptions;
+  int64_t copilot_topics;
+  int64_t copilot_client_subscriptions;
+  int64_t copilot_tower_subscriptions;
+  int64_t tower_topic_manager;
+  int64_t tower_subscriptions;
+  int64_t rollcall_writes;
+  int64_t rss;
+};
+
+int64_t ResidentBytes() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (!file) {
+    return 0;
+  }
+  long pages = 0;
+  long resident = 0;
+  if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(file);
+  return static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+Sample TakeSample(LocalTestCluster* cluster,
+                  const std::vector<std::unique_ptr<ClientImpl>>& clients) {
+  Sample sample;
+  sample.client_subscriptions = 0;
+  for (const auto& client : clients) {
+    sample.client_subscriptions += client->GetStatisticsSync()
+      .GetCounterValue("client.memory.subscriptions");
+  }
+  const Statistics stats = cluster->GetStatisticsSync();
+  sample.copilot_topics =
+    stats.GetCounterValue("copilot.memory.topics");
+  sample.copilot_client_subscriptions =
+    stats.GetCounterValue("copilot.memory.client_subscriptions");
+  sample.copilot_tower_subscriptions =
+    stats.GetCounterValue("copilot.memory.tower_subscriptions");
+  sample.tower_topic_manager =
+    stats.GetCounterValue("tower.topic_tailer.memory.topic_manager");
+  sample.tower_subscriptions =
+    stats.GetCounterValue("tower.topic_tailer.memory.subscriptions");
+  sample.rollcall_writes =
+    stats.GetCounterValue("copilot.numwrites_rollcall_total");
+  sample.rss = ResidentBytes();
+  return sample;
+}
+
+/**
+ * Polls the copilot until it holds the expected number of subscriptions.
+ *
+ * @return Seconds elapsed since start, or a negative value on timeout.
+ */
+double WaitForSubscriptions(LocalTestCluster* cluster,
+                            int64_t expected,
+                            std::chrono::steady_clock::time_point start) {
+  const auto deadline = start + std::chrono::seconds(FLAGS_timeout);
+  for (;;) {
+    const int64_t current = cluster->GetCopilot()->GetStatisticsSync()
+      .GetCounterValue(kIncomingSubscriptions);
+    const auto now = std::chrono::steady_clock::now();
+    if (current == expected) {
+      return std::chrono::duration<double>(now - start).count();
+    }
+    if (now > deadline) {
+      fprintf(stderr, "Timed out with %" PRIi64 "/%" PRIi64
+              " subscriptions on the copilot\n", current, expected);
+      return -1.0;
+    }
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+void PrintPerSubscription(const char* name,
+                          int64_t before,
+                          int64_t after,
+                          uint64_t subscriptions) {
+  printf("  %-34s %10.1f bytes\n",
+         name,
+         static_cast<double>(after - before) /
+           static_cast<double>(subscriptions));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Env::InstallSignalHandlers();
+  GFLAGS::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_subscriptions == 0 || FLAGS_clients == 0 || FLAGS_topics == 0) {
+    fprintf(stderr, "subscriptions, clients and topics must be greater "
+                    "than 0.\n");
+    return 1;
+  }
+  if (FLAGS_churn > FLAGS_subscriptions) {
+    fprintf(stderr, "churn must not exceed subscriptions.\n");
+    return 1;
+  }
+
+  std::shared_ptr<Logger> info_log;
+  if (FLAGS_logging) {
+    if (!CreateLoggerFromOptions(Env::Default(),
+                                 "",
+                                 "LOG.scaletest",
+                                 0,
+                                 0,
+#ifdef NDEBUG
+                                 WARN_LEVEL,
+#else
+                                 INFO_LEVEL,
+#endif
+                                 &info_log).ok()) {
+      fprintf(stderr, "Error creating logger, aborting.\n");
+      return 1;
+    }
+  } else {
+    info_log = std::make_shared<NullLogger>();
+  }
+
+  LocalTestCluster::Options cluster_options;
+  cluster_options.info_log = info_log;
+  std::unique_ptr<LocalTestCluster> cluster(
+    new LocalTestCluster(cluster_options));
+  if (!cluster->GetStatus().ok()) {
+    fprintf(stderr, "Failed to start cluster: %s\n",
+            cluster->GetStatus().ToString().c_str());
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<ClientImpl>> clients(FLAGS_clients);
+  for (auto& client : clients) {
+    Status st = cluster->CreateClient(&client, false);
+    if (!st.ok()) {
+      fprintf(stderr, "Failed to create client: %s\n", st.ToString().c_str());
+      return 1;
+    }
+  }
+
+  std::vector<std::string> topics;
+  for (uint64_t i = 0; i < FLAGS_topics; ++i) {
+    topics.push_back("scaletest." + std::to_string(i));
+  }
+
+  // Subscribes i-th subscription, retrying while the client is backlogged.
+  std::vector<SubscriptionHandle> handles(FLAGS_subscriptions);
+  auto subscribe = [&] (uint64_t i) {
+    ClientImpl* client = clients[i % clients.size()].get();
+    for (;;) {
+      handles[i] = client->Subscribe(GuestTenant,
+                                     GuestNamespace,
+                                     topics[i % topics.size()],
+                                     0);
+      if (handles[i]) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+  };
+
+  printf("Subscriptions: %" PRIu64 "\n", FLAGS_subscriptions);
+  printf("Clients:       %" PRIu64 "\n", FLAGS_clients);
+  printf("Topics:        %" PRIu64 "\n", FLAGS_topics);
+  printf("\n");
+
+  // Open all subscriptions.
+  const Sample before = TakeSample(cluster.get(), clients);
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < FLAGS_subscriptions; ++i) {
+    subscribe(i);
+  }
+  double secs = WaitForSubscriptions(
+    cluster.get(), static_cast<int64_t>(FLAGS_subscriptions), start);
+  if (secs < 0) {
+    return 1;
+  }
+  printf("Subscribe:   %10.0f subscriptions/s (%.2f s)\n",
+         static_cast<double>(FLAGS_subscriptions) / secs, secs);
+  const Sample after = TakeSample(cluster.get(), clients);
+
+  printf("\nMemory per subscription\n");
+  PrintPerSubscription("client subscriptions",
+                       before.client_subscriptions,
+                       after.client_subscriptions,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("copilot topics",
+                       before.copilot_topics,
+                       after.copilot_topics,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("copilot client_subscriptions",
+                       before.copilot_client_subscriptions,
+                       after.copilot_client_subscriptions,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("copilot tower subscriptions",
+                       before.copilot_tower_subscriptions,
+                       after.copilot_tower_subscriptions,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("tower topic manager",
+                       before.tower_topic_manager,
+                       after.tower_topic_manager,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("tower subscriptions",
+                       before.tower_subscriptions,
+                       after.tower_subscriptions,
+                       FLAGS_subscriptions);
+  PrintPerSubscription("process resident",
+                       before.rss,
+                       after.rss,
+                       FLAGS_subscriptions);
+  // Rollcall state lives in the rollcall log rather than in memory.
+  printf("  %-34s %10.2f\n",
+         "rollcall writes per subscription",
+         static_cast<double>(after.rollcall_writes - before.rollcall_writes) /
+           static_cast<double>(FLAGS_subscriptions));
+
+  // Churn: unsubscribe then resubscribe a subset of subscriptions.
+  if (FLAGS_churn) {
+    printf("\n");
+    const int64_t remaining =
+      static_cast<int64_t>(FLAGS_subscriptions - FLAGS_churn);
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < FLAGS_churn; ++i) {
+      ClientImpl* client = clients[i % clients.size()].get();
+      while (!client->Unsubscribe(handles[i]).ok()) {
+        std::this_thread::yield();
+      }
+    }
+    secs = WaitForSubscriptions(cluster.get(), remaining, start);
+    if (secs < 0) {
+      return 1;
+    }
+    printf("Unsubscribe: %10.0f unsubscriptions/s (%.2f s)\n",
+           static_cast<double>(FLAGS_churn) / secs, secs);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < FLAGS_churn; ++i) {
+      subscribe(i);
+    }
+    secs = WaitForSubscriptions(
+      cluster.get(), static_cast<int64_t>(FLAGS_subscriptions), start);
+    if (secs < 0) {
+      return 1;
+    }
+    printf("Resubscribe: %10.0f subscriptions/s (%.2f s)\n",
+           static_cast<double>(FLAGS_churn) / secs, secs);
+  }
+
+  // The copilot shares its process with the rest of the cluster, so restart
+  // the whole cluster. Clients see their connections drop and resubscribe
+  // after their back off.
+  if (FLAGS_restart) {
+    cluster.reset();
+    start = std::chrono::steady_clock::now();
+    cluster.reset(new LocalTestCluster(cluster_options));
+    if (!cluster->GetStatus().ok()) {
+      fprintf(stderr, "Failed to restart cluster: %s\n",
+              cluster->GetStatus().ToString().c_str());
+      return 1;
+    }
+    secs = WaitForSubscriptions(
+      cluster.get(), static_cast<int64_t>(FLAGS_subscriptions), start);
+    if (secs < 0) {
+      return 1;
+    }
+    printf("\nRestore after restart: %.2f s\n", secs);
+  }
+
+  clients.clear();
+  cluster.reset();
+  return 0;
+}
@@ -0,0 +1,548 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+// Benchmarks the control tower read path (LogTailer, TopicTailer and
+// DataCache) in isolation, by tailing synthetic logs held in memory. No
+// network or real storage is involved, so results are only affected by the
+// tower itself.
+//
+#define __STDC_FORMAT_MACROS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "include/Logger.h"
+#include "include/Types.h"
+#include "src/controltower/log_tailer.h"
+#include "src/controltower/options.h"
+#include "src/controltower/topic_tailer.h"
+#include "src/logdevice/log_router.h"
+#include "src/messages/messages.h"
+#include "src/messages/msg_loop.h"
+#include "src/port/Env.h"
+#include "src/port/port.h"
+#include "src/util/storage.h"
+#include "src/util/topic_uuid.h"
+#include "src/util/common/guid_generator.h"
+
+DEFINE_uint64(num_logs, 10, "number of logs");
+DEFINE_uint64(topics_per_log, 100, "number of topics in each log");
+DEFINE_uint64(subscriptions_per_topic, 1, "subscriptions on each topic");
+DEFINE_uint64(backlog, 100000, "number of records in each log");
+DEFINE_int32(message_size, 100, "message size (bytes)");
+DEFINE_uint64(cache_size, 0, "size of the tower cache in bytes (0 = none)");
+DEFINE_uint64(readers, 2, "number of log readers");
+DEFINE_int64(max_subscription_lag, 10000,
+"sequence numbers a subscription can lag behind before being sent a gap");
+DEFINE_uint64(passes, 2,
+"number of times to subscribe to all topics from the start of the logs; "
+"passes after the first can be served from the cache");
+DEFINE_int32(timeout, 300, "seconds to wait for a pass to complete");
+
+using namespace rocketspeed;
+
+namespace {
+
+const char* kCounterReceived = "tower.topic_tailer.log_records_received";
+const char* kCounterFromCache = "tower.topic_tailer.records_served_from_cache";
+
+class SyntheticLogReader;
+
+/**
+ * LogStorage serving logs from memory. Log i (1-based) holds the sequence
+ * numbers 1 to backlog, cycling over records[i - 1] in order. Records are
+ * in serialized storage format, as written by the pilot.
+ */
+class SyntheticLogStorage : public LogStorage {
+ public:
+  SyntheticLogStorage(std::vector<std::vector<std::string>> records,
+                      SequenceNumber backlog)
+  : records_(std::move(records))
+  , backlog_(backlog) {
+  }
+
+  Status AppendAsync(LogID id,
+                     const Slice& data,
+                     AppendCallback callback) override {
+    return Status::NotSupported("Synthetic logs are read only");
+  }
+
+  Status FindTimeAsync(LogID id,
+                       std::chrono::milliseconds timestamp,
+                       std::function<void(Status, SequenceNumber)> callback)
+      override {
+    callback(Status::OK(), backlog_ + 1);
+    return Status::OK();
+  }
+
+  Status CreateAsyncReaders(unsigned int parallelism,
+                            std::function<bool(LogRecord&)> record_cb,
+                            std::function<bool(const GapRecord&)> gap_cb,
+                            std::vector<AsyncLogReader*>* readers) override;
+
+  bool CanSubscribePastEnd() const override {
+    return true;
+  }
+
+  SequenceNumber GetBacklog() const {
+    return backlog_;
+  }
+
+  /** Fills in the record at seqno of a log. */
+  void Read(LogID log_id, SequenceNumber seqno, LogRecord* record) const {
+    const auto& records = records_[log_id - 1];
+    record->log_id = log_id;
+    record->seqno = seqno;
+    record->payload = Slice(records[(seqno - 1) % records.size()]);
+  }
+
+  /**
+   * @return true if all readers have reached the end of their open logs.
+   */
+  bool Idle();
+
+  /** @return Number of records accepted from all readers. */
+  uint64_t GetDelivered();
+
+  void Register(SyntheticLogReader* reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    readers_.push_back(reader);
+  }
+
+  void Unregister(SyntheticLogReader* reader);
+
+ private:
+  const std::vector<std::vector<std::string>> records_;
+  const SequenceNumber backlog_;
+
+  std::mutex mutex_;
+  std::vector<SyntheticLogReader*> readers_;
+};
+
+/**
+ * Reads from SyntheticLogStorage on its own thread, as a storage client
+ * would. Records are delivered in batches round robin over the open logs.
+ */
+class SyntheticLogReader : public AsyncLogReader {
+ public:
+  SyntheticLogReader(SyntheticLogStorage* storage,
+                     std::function<bool(LogRecord&)> record_cb)
+  : storage_(storage)
+  , record_cb_(std::move(record_cb))
+  , delivered_(0)
+  , stop_(false) {
+    storage_->Register(this);
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  ~SyntheticLogReader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+    storage_->Unregister(this);
+  }
+
+  Status Open(LogID id,
+              SequenceNumber startPoint,
+              SequenceNumber endPoint) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cursors_[id] = std::max<SequenceNumber>(startPoint, 1);
+    }
+    cond_.notify_one();
+    return Status::OK();
+  }
+
+  Status Close(LogID id) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cursors_.erase(id);
+    return Status::OK();
+  }
+
+  bool Idle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : cursors_) {
+      if (entry.second <= storage_->GetBacklog()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint64_t GetDelivered() const {
+    return delivered_.load();
+  }
+
+ private:
+  static constexpr int kBatchSize = 64;
+
+  void Run() {
+    const SequenceNumber backlog = storage_->GetBacklog();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      bool progress = false;
+      bool blocked = false;
+      for (auto& entry : cursors_) {
+        for (int i = 0; i < kBatchSize && entry.second <= backlog; ++i) {
+          LogRecord record;
+          storage_->Read(entry.first, entry.second, &record);
+          if (!record_cb_(record)) {
+            blocked = true;
+            break;
+          }
+          ++entry.second;
+          ++delivered_;
+          progress = true;
+        }
+      }
+      if (blocked) {
+        // The tower is applying backpressure, so back off and retry.
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+      } else if (!progress) {
+        cond_.wait(lock);
+      }
+    }
+  }
+
+  SyntheticLogStorage* storage_;
+  std::function<bool(LogRecord&)> record_cb_;
+  std::atomic<uint64_t> delivered_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unordered_map<LogID, SequenceNumber> cursors_;
+  bool stop_;
+  std::thread thread_;
+};
+
+Status SyntheticLogStorage::CreateAsyncReaders(
+    unsigned int parallelism,
+    std::function<bool(LogRecord&)> record_cb,
+    std::function<bool(const GapRecord&)> gap_cb,
+    std::vector<AsyncLogReader*>* readers) {
+  for (unsigned int i = 0; i < parallelism; ++i) {
+    readers->push_back(new SyntheticLogReader(this, record_cb));
+  }
+  return Status::OK();
+}
+
+bool SyntheticLogStorage::Idle() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (SyntheticLogReader* reader : readers_) {
+    if (!reader->Idle()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t SyntheticLogStorage::GetDelivered() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t delivered = 0;
+  for (SyntheticLogReader* reader : readers_) {
+    delivered += reader->GetDelivered();
+  }
+  return delivered;
+}
+
+void SyntheticLogStorage::Unregister(SyntheticLogReader* reader) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  readers_.erase(std::find(readers_.begin(), readers_.end(), reader));
+}
+
+/** @return Storage format of a message published on a topic. */
+std::string MakeRecord(const std::string& topic, const std::string& payload) {
+  MessageData data(MessageType::mPublish,
+                   Tenant::GuestTenant,
+                   topic,
+                   GuestNamespace,
+                   payload);
+  data.SetMessageId(GUIDGenerator::ThreadLocalGUIDGenerator()->Generate());
+  std::string serial;
+  data.SerializeToString(&serial);
+  std::unique_ptr<char[]> buffer(new char[serial.size()]);
+  memcpy(buffer.get(), serial.data(), serial.size());
+  std::unique_ptr<Message> msg =
+    Message::CreateNewInstance(std::move(buffer), serial.size());
+  return static_cast<MessageData*>(msg.get())->GetStorageSlice().ToString();
+}
+
+uint64_t ThreadCpuNanos() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t ProcessCpuNanos() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+          * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+/** Measurements taken on the tower worker thread. */
+struct Sample {
+  std::chrono::steady_clock::time_point time;
+  uint64_t worker_cpu_nanos;
+  uint64_t received;
+  uint64_t from_cache;
+  uint64_t deliveries;
+  uint64_t gaps;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Env::InstallSignalHandlers();
+  GFLAGS::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_num_logs == 0 || FLAGS_topics_per_log == 0 ||
+      FLAGS_subscriptions_per_topic == 0 || FLAGS_backlog == 0 ||
+      FLAGS_readers == 0) {
+    fprintf(stderr, "num_logs, topics_per_log, subscriptions_per_topic, "
+                    "backlog and readers must be greater than 0.\n");
+    return 1;
+  }
+  if (FLAGS_message_size < 0 || FLAGS_message_size > 1024 * 1024) {
+    fprintf(stderr, "message_size must be 0-1MB.\n");
+    return 1;
+  }
+
+  Env* env = Env::Default();
+  auto info_log = std::make_shared<NullLogger>();
+  auto log_router = std::make_shared<LogDeviceLogRouter>(1, FLAGS_num_logs);
+
+  // Find topics_per_log topics routed to each log.
+  const std::string payload(FLAGS_message_size, 'x');
+  std::vector<TopicUUID> topics;
+  std::vector<std::vector<std::string>> records(FLAGS_num_logs);
+  size_t full_logs = 0;
+  for (uint64_t i = 0; full_logs < FLAGS_num_logs; ++i) {
+    std::string topic = "topic-" + std::to_string(i);
+    LogID log_id;
+    log_router->GetLogID(GuestNamespace, topic, &log_id);
+    auto& log_records = records[log_id - 1];
+    if (log_records.size() < FLAGS_topics_per_log) {
+      log_records.emplace_back(MakeRecord(topic, payload));
+      topics.emplace_back(GuestNamespace, topic);
+      if (log_records.size() == FLAGS_topics_per_log) {
+        ++full_logs;
+      }
+    }
+  }
+  auto storage = std::make_shared<SyntheticLogStorage>(std::move(records),
+                                                       FLAGS_backlog);
+
+  // A single tower worker, as in one ControlRoom.
+  MsgLoop msg_loop(env, EnvOptions(), 0, 1, info_log, "tower");
+  Status st = msg_loop.Initialize();
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to initialize MsgLoop: %s\n",
+            st.ToString().c_str());
+    return 1;
+  }
+
+  LogTailer* log_tailer_raw;
+  st = LogTailer::CreateNewInstance(env, storage, info_log, &log_tailer_raw);
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to create LogTailer: %s\n", st.ToString().c_str());
+    return 1;
+  }
+  std::unique_ptr<LogTailer> log_tailer(log_tailer_raw);
+
+  // Outgoing messages are counted rather than sent to copilots.
+  uint64_t deliveries = 0;
+  uint64_t gaps = 0;
+  auto on_message = [&] (std::unique_ptr<Message> msg,
+                         std::vector<CopilotSub> recipients) {
+    if (msg->GetMessageType() == MessageType::mDeliver) {
+      deliveries += recipients.size();
+    } else {
+      gaps += recipients.size();
+    }
+  };
+
+  TopicTailer* topic_tailer_raw;
+  st = TopicTailer::CreateNewInstance(env,
+                                      &msg_loop,
+                                      0,
+                                      log_tailer.get(),
+                                      log_router,
+                                      info_log,
+                                      FLAGS_cache_size,
+                                      false,
+                                      HugePageMode::kNone,
+                                      on_message,
+                                      ControlTowerOptions::TopicTailer(),
+                                      &topic_tailer_raw);
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to create TopicTailer: %s\n",
+            st.ToString().c_str());
+    return 1;
+  }
+  std::unique_ptr<TopicTailer> topic_tailer(topic_tailer_raw);
+  TopicTailer* tailer = topic_tailer.get();
+
+  auto on_record = [tailer] (std::unique_ptr<MessageData>& msg,
+                             LogID log_id,
+                             size_t reader_id) {
+    return tailer->SendLogRecord(msg, log_id, reader_id).ok();
+  };
+  auto on_gap = [tailer] (LogID log_id,
+                          GapType type,
+                          SequenceNumber from,
+                          SequenceNumber to,
+                          size_t reader_id) {
+    return tailer->SendGapRecord(log_id, type, from, to, reader_id).ok();
+  };
+  st = log_tailer->Initialize(on_record, on_gap, FLAGS_readers);
+  if (st.ok()) {
+    std::vector<size_t> reader_ids;
+    for (size_t i = 0; i < FLAGS_readers; ++i) {
+      reader_ids.push_back(i);
+    }
+    st = tailer->Initialize(reader_ids, FLAGS_max_subscription_lag);
+  }
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to initialize tailers: %s\n",
+            st.ToString().c_str());
+    return 1;
+  }
+
+  std::thread loop_thread([&]() { msg_loop.Run(); });
+  st = msg_loop.WaitUntilRunning();
+  if (!st.ok()) {
+    fprintf(stderr, "Failed to start MsgLoop: %s\n", st.ToString().c_str());
+    return 1;
+  }
+
+  // Runs a function on the worker thread and waits for it.
+  auto run_on_worker = [&] (std::function<void()> func) {
+    port::Semaphore done;
+    for (;;) {
+      std::unique_ptr<Command> command(MakeExecuteCommand([&]() {
+        func();
+        done.Post();
+      }));
+      if (msg_loop.SendCommand(std::move(command), 0).ok()) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    done.Wait();
+  };
+  auto take_sample = [&] () {
+    Sample sample;
+    sample.time = std::chrono::steady_clock::now();
+    sample.worker_cpu_nanos = ThreadCpuNanos();
+    // The tailer's statistics belong to the thread that created it, so read
+    // from a copy.
+    const Statistics stats(tailer->GetStatistics());
+    sample.received = stats.GetCounterValue(kCounterReceived);
+    sample.from_cache = stats.GetCounterValue(kCounterFromCache);
+    sample.deliveries = deliveries;
+    sample.gaps = gaps;
+    return sample;
+  };
+
+  printf("Logs:                    %" PRIu64 "\n", FLAGS_num_logs);
+  printf("Topics per log:          %" PRIu64 "\n", FLAGS_topics_per_log);
+  printf("Subscriptions per topic: %" PRIu64 "\n",
+         FLAGS_subscriptions_per_topic);
+  printf("Backlog per log:         %" PRIu64 "\n", FLAGS_backlog);
+  printf("Cache size:              %" PRIu64 "\n", FLAGS_cache_size);
+  printf("\n");
+
+  bool timed_out = false;
+  SubscriptionID next_sub_id = 1;
+  for (uint64_t pass = 0; pass < FLAGS_passes && !timed_out; ++pass) {
+    Sample start;
+    const uint64_t start_process_cpu = ProcessCpuNanos();
+
+    // Each pass subscribes on a new stream, from the start of the logs.
+    const StreamID stream = pass + 1;
+    run_on_worker([&]() {
+      start = take_sample();
+      for (const TopicUUID& topic : topics) {
+        for (uint64_t i = 0; i < FLAGS_subscriptions_per_topic; ++i) {
+          tailer->AddSubscriber(topic, 1, CopilotSub(stream, next_sub_id++));
+        }
+      }
+    });
+
+    // Wait until all records have been read and processed.
+    Sample end;
+    bool done = false;
+    const auto deadline =
+      start.time + std::chrono::seconds(FLAGS_timeout);
+    while (!done) {
+      run_on_worker([&]() {
+        end = take_sample();
+        done = storage->Idle() && end.received == storage->GetDelivered();
+      });
+      if (!done) {
+        if (end.time > deadline) {
+          timed_out = true;
+          break;
+        }
+        /* sleep override */
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    const uint64_t process_cpu = ProcessCpuNanos() - start_process_cpu;
+
+    const double secs = std::chrono::duration<double>(end.time - start.time)
+      .count();
+    const uint64_t from_log = end.received - start.received;
+    const uint64_t num_deliveries = end.deliveries - start.deliveries;
+    const uint64_t from_cache = end.from_cache - start.from_cache;
+    const double worker_cpu =
+      static_cast<double>(end.worker_cpu_nanos - start.worker_cpu_nanos);
+    const double num_records =
+      static_cast<double>(std::max<uint64_t>(from_log, 1));
+
+    printf("Pass %" PRIu64 "%s\n", pass + 1, timed_out ? " (timed out)" : "");
+    printf("  Time:                  %.3f s\n", secs);
+    printf("  Records read:          %" PRIu64 "\n", from_log);
+    printf("  Records/s:             %.0f\n",
+           static_cast<double>(from_log) / secs);
+    printf("  Deliveries:            %" PRIu64 " (%" PRIu64 " from cache)\n",
+           num_deliveries, from_cache);
+    printf("  Deliveries/s:          %.0f\n",
+           static_cast<double>(num_deliveries) / secs);
+    printf("  Gap deliveries:        %" PRIu64 "\n", end.gaps - start.gaps);
+    printf("  Worker CPU/record:     %.0f ns\n", worker_cpu / num_records);
+    printf("  Process CPU/record:    %.0f ns\n",
+           static_cast<double>(process_cpu) / num_records);
+    printf("  Worker CPU/delivery:   %.0f ns\n",
+           worker_cpu /
+           static_cast<double>(std::max<uint64_t>(num_deliveries, 1)));
+    printf("\n");
+  }
+
+  msg_loop.Stop();
+  loop_thread.join();
+  log_tailer->Stop();
+  topic_tailer.reset();
+  log_tailer.reset();
+  return timed_out ? 1 : 0;
+}
@@ -0,0 +1,686 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/async_logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "src/port/port.h"
+#include "src/util/async_logger_args.h"
+#include "src/util/posix_logger.h"
+
+namespace rocketspeed {
+
+namespace {
+
+enum EntryKind : uint8_t {
+  // Entry produced by Logv, rendered with level, file and line.
+  kEntryLog,
+  // Entry produced by Append, rendered without level, file and line.
+  kEntryAppend,
+  // Unused space at the end of the ring, skipped by the reader.
+  kEntryPadding,
+};
+
+/**
+ * Fixed part of every entry in a ring. It is followed by the encoded
+ * arguments, in the order in which the format string consumes them:
+ *  - integers, pointers and doubles take 8 bytes each,
+ *  - long doubles take sizeof(long double) bytes,
+ *  - strings take a 4 byte length followed by the NUL-terminated bytes,
+ * each rounded up to a multiple of 8 bytes.
+ */
+struct EntryHeader {
+  uint32_t size;          // Size of the whole entry, a multiple of 8.
+  EntryKind kind;
+  InfoLogLevel level;
+  uint16_t num_args;      // Number of conversions that were encoded.
+  int32_t line;
+  uint32_t truncated;     // Non-zero if some conversions were not encoded.
+  const char* filename;
+  const char* format;
+  uint64_t unix_micros;
+};
+
+using ArgWriter = detail::AsyncLogArgWriter;
+using ArgReader = detail::AsyncLogArgReader;
+
+const size_t kAlignment = detail::kAsyncLogAlignment;
+
+size_t AlignUp(size_t n) {
+  return detail::AsyncLogAlignUp(n);
+}
+
+enum LengthModifier : uint8_t {
+  kLengthNone,
+  kLengthChar,        // hh
+  kLengthShort,       // h
+  kLengthLong,        // l
+  kLengthLongLong,    // ll, q
+  kLengthIntMax,      // j
+  kLengthSize,        // z, Z
+  kLengthPtrDiff,     // t
+  kLengthLongDouble,  // L
+};
+
+/** A single printf conversion specification. */
+struct FormatSpec {
+  const char* begin;  // The '%' character.
+  const char* end;    // One past the conversion character.
+  int num_stars;      // Number of '*' width and precision arguments.
+  bool star_precision;  // Precision is given by the last '*' argument.
+  int precision;      // Literal precision, or -1 if there is none.
+  LengthModifier length;
+  char conversion;
+};
+
+/**
+ * Parses the conversion specification starting at p, which must point at a
+ * '%' character that does not start a "%%" sequence.
+ *
+ * @return true if the specification was understood.
+ */
+bool ParseSpec(const char* p, FormatSpec* spec) {
+  spec->begin = p++;
+  spec->num_stars = 0;
+  spec->star_precision = false;
+  spec->precision = -1;
+  spec->length = kLengthNone;
+  while (*p && strchr("-+ #0'I", *p)) {
+    ++p;
+  }
+  if (*p == '*') {
+    ++spec->num_stars;
+    ++p;
+  } else {
+    while (*p >= '0' && *p <= '9') {
+      ++p;
+    }
+  }
+  if (*p == '.') {
+    ++p;
+    if (*p == '*') {
+      ++spec->num_stars;
+      spec->star_precision = true;
+      ++p;
+    } else {
+      // A lone '.' means a precision of zero.
+      int precision = 0;
+      while (*p >= '0' && *p <= '9') {
+        if (precision < (INT_MAX - 9) / 10) {
+          precision = precision * 10 + (*p - '0');
+        }
+        ++p;
+      }
+      spec->precision = precision;
+    }
+  }
+  switch (*p) {
+    case 'h':
+      ++p;
+      spec->length = kLengthShort;
+      if (*p == 'h') {
+        ++p;
+        spec->length = kLengthChar;
+      }
+      break;
+    case 'l':
+      ++p;
+      spec->length = kLengthLong;
+      if (*p == 'l') {
+        ++p;
+        spec->length = kLengthLongLong;
+      }
+      break;
+    case 'q': ++p; spec->length = kLengthLongLong; break;
+    case 'j': ++p; spec->length = kLengthIntMax; break;
+    case 'z': case 'Z': ++p; spec->length = kLengthSize; break;
+    case 't': ++p; spec->length = kLengthPtrDiff; break;
+    case 'L': ++p; spec->length = kLengthLongDouble; break;
+    default: break;
+  }
+  spec->conversion = *p;
+  if (!*p || !strchr("diouxXcseEfFgGaApn", *p)) {
+    return false;
+  }
+  if (spec->conversion == 's' && spec->length != kLengthNone) {
+    // Wide strings are not supported.
+    return false;
+  }
+  spec->end = p + 1;
+  return true;
+}
+
+bool IsSignedConversion(char c) {
+  return c == 'd' || c == 'i';
+}
+
+bool IsUnsignedConversion(char c) {
+  return c == 'o' || c == 'u' || c == 'x' || c == 'X';
+}
+
+bool IsFloatConversion(char c) {
+  return strchr("eEfFgGaA", c) != nullptr;
+}
+
+/** Reads an integer argument of the specified type, as 64 bits. */
+uint64_t ReadInteger(const FormatSpec& spec, va_list* ap) {
+  if (IsUnsignedConversion(spec.conversion)) {
+    switch (spec.length) {
+      case kLengthLong: return va_arg(*ap, unsigned long);
+      case kLengthLongLong: return va_arg(*ap, unsigned long long);
+      case kLengthIntMax: return va_arg(*ap, uintmax_t);
+      case kLengthSize: return va_arg(*ap, size_t);
+      case kLengthPtrDiff: return va_arg(*ap, ptrdiff_t);
+      default: return va_arg(*ap, unsigned int);
+    }
+  }
+  int64_t value;
+  switch (spec.length) {
+    case kLengthLong: value = va_arg(*ap, long); break;
+    case kLengthLongLong: value = va_arg(*ap, long long); break;
+    case kLengthIntMax: value = va_arg(*ap, intmax_t); break;
+    case kLengthSize: value = va_arg(*ap, ssize_t); break;
+    case kLengthPtrDiff: value = va_arg(*ap, ptrdiff_t); break;
+    default: value = va_arg(*ap, int); break;
+  }
+  return static_cast<uint64_t>(value);
+}
+
+/** Appends a printf-formatted string to out. */
+void AppendPrintf(std::string* out, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((__format__(__printf__, 2, 3)))
+#endif
+    ;
+
+void AppendPrintf(std::string* out, const char* format, ...) {
+  char buffer[256];
+  va_list ap;
+  va_start(ap, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, ap);
+  va_end(ap);
+  if (n < 0) {
+    return;
+  }
+  if (static_cast<size_t>(n) < sizeof(buffer)) {
+    out->append(buffer, static_cast<size_t>(n));
+  } else {
+    const size_t offset = out->size();
+    out->resize(offset + static_cast<size_t>(n) + 1);
+    va_start(ap, format);
+    vsnprintf(&(*out)[offset], static_cast<size_t>(n) + 1, format, ap);
+    va_end(ap);
+    out->resize(offset + static_cast<size_t>(n));
+  }
+}
+
+}  // namespace
+
+/**
+ * Single-producer single-consumer ring of variable size entries.
+ * Positions increase monotonically and are reduced modulo the capacity,
+ * which is a power of two.
+ */
+class AsyncLogger::Ring {
+ public:
+  Ring(size_t capacity, uint64_t thread_id, std::string thread_name)
+  : thread_id_(thread_id)
+  , thread_name_(std::move(thread_name))
+  , capacity_(capacity)
+  , buffer_(new uint64_t[capacity / sizeof(uint64_t)])
+  , head_(0)
+  , tail_(0)
+  , orphaned_(false) {
+    assert((capacity & (capacity - 1)) == 0);
+  }
+
+  /**
+   * Appends an entry. Called only by the owning thread.
+   *
+   * @return false if there is not enough space in the ring.
+   */
+  bool Write(const char* entry, size_t size) {
+    assert(size % kAlignment == 0);
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t offset = static_cast<size_t>(tail & (capacity_ - 1));
+    const size_t contiguous = capacity_ - offset;
+    const size_t padding = size > contiguous ? contiguous : 0;
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    if (tail + padding + size - head > capacity_) {
+      return false;
+    }
+    if (padding) {
+      EntryHeader pad;
+      pad.size = static_cast<uint32_t>(padding);
+      pad.kind = kEntryPadding;
+      // Only the size and kind are read back for padding.
+      memcpy(Data() + offset, &pad, offsetof(EntryHeader, kind) + 1);
+    }
+    memcpy(Data() + (padding ? 0 : offset), entry, size);
+    tail_.store(tail + padding + size, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Invokes visit on each pending entry. Called only by the drainer.
+   *
+   * @return Number of entries visited.
+   */
+  template <typename Visitor>
+  size_t Drain(Visitor visit) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (head != tail) {
+      const char* entry = Data() + (head & (capacity_ - 1));
+      uint32_t size;
+      EntryKind kind;
+      memcpy(&size, entry + offsetof(EntryHeader, size), sizeof(size));
+      memcpy(&kind, entry + offsetof(EntryHeader, kind), sizeof(kind));
+      if (kind != kEntryPadding) {
+        visit(entry);
+        ++count;
+      }
+      head += size;
+      head_.store(head, std::memory_order_release);
+    }
+    return count;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  void SetOrphaned() { orphaned_.store(true, std::memory_order_release); }
+
+  bool IsOrphaned() const { return orphaned_.load(std::memory_order_acquire); }
+
+  const uint64_t thread_id_;
+  const std::string thread_name_;
+
+ private:
+  char* Data() const { return reinterpret_cast<char*>(buffer_.get()); }
+
+  const size_t capacity_;
+  std::unique_ptr<uint64_t[]> buffer_;
+  // Written by the drainer.
+  std::atomic<uint64_t> head_;
+  // Written by the producing thread.
+  std::atomic<uint64_t> tail_;
+  std::atomic<bool> orphaned_;
+};
+
+AsyncLogger::AsyncLogger(BaseEnv* env,
+                         std::shared_ptr<Logger> sink,
+                         size_t ring_bytes,
+                         uint64_t drain_interval_micros)
+: Logger(sink->GetInfoLogLevel())
+, env_(env)
+, sink_(std::move(sink))
+, ring_bytes_([ring_bytes] () {
+    // Round up to a power of two that holds a few maximum size entries.
+    size_t capacity = 4 * kMaxEntryBytes;
+    while (capacity < ring_bytes) {
+      capacity *= 2;
+    }
+    return capacity;
+  }())
+, drain_interval_micros_(drain_interval_micros)
+, dropped_(0)
+, stop_(false)
+, reported_dropped_(0)
+, thread_ring_(&AsyncLogger::OnThreadExit) {
+  thread_id_ = env_->StartThread([this] () { BackgroundLoop(); },
+                                 "rs-async-log");
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    stop_ = true;
+  }
+  drain_cv_.notify_one();
+  env_->WaitForJoin(thread_id_);
+  // The background thread drains all rings before exiting, but threads may
+  // still have logged since then.
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  DrainAll();
+  sink_->Flush();
+}
+
+void AsyncLogger::Logv(const InfoLogLevel log_level,
+                       const char* filename,
+                       int line,
+                       const char* format,
+                       va_list ap) {
+  if (log_level < GetInfoLogLevel()) {
+    return;
+  }
+  Record(true, log_level, filename, line, format, ap);
+}
+
+void AsyncLogger::Append(const char* format, va_list ap) {
+  Record(false, NONE_LEVEL, nullptr, 0, format, ap);
+}
+
+void AsyncLogger::Flush() {
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  DrainAll();
+  sink_->Flush();
+}
+
+AsyncLogger::Ring* AsyncLogger::GetThreadRing() {
+  Ring* ring = static_cast<Ring*>(thread_ring_.Get());
+  if (!ring) {
+    ring = new Ring(ring_bytes_,
+                    env_->GetCurrentThreadId(),
+                    env_->GetCurrentThreadName());
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.emplace_back(ring);
+    }
+    thread_ring_.Reset(ring);
+  }
+  return ring;
+}
+
+void AsyncLogger::OnThreadExit(void* ring) {
+  // The ring is owned by the logger, and released once it has been drained.
+  static_cast<Ring*>(ring)->SetOrphaned();
+}
+
+void AsyncLogger::Record(bool has_level,
+                         InfoLogLevel log_level,
+                         const char* filename,
+                         int line,
+                         const char* format,
+                         va_list ap) {
+  alignas(kAlignment) char entry[kMaxEntryBytes];
+  EntryHeader header;
+  header.kind = has_level ? kEntryLog : kEntryAppend;
+  header.level = log_level;
+  header.num_args = 0;
+  header.line = line;
+  header.truncated = 0;
+  header.filename = filename;
+  header.format = format;
+  header.unix_micros = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+
+  // Copy the arguments, in the order the format consumes them.
+  ArgWriter writer(entry + AlignUp(sizeof(header)), entry + sizeof(entry));
+  va_list args;
+  va_copy(args, ap);
+  for (const char* p = format; *p; ++p) {
+    if (*p != '%') {
+      continue;
+    }
+    if (p[1] == '%') {
+      ++p;
+      continue;
+    }
+    FormatSpec spec;
+    if (!ParseSpec(p, &spec)) {
+      // Cannot know the argument types past this point.
+      header.truncated = 1;
+      break;
+    }
+    bool ok = true;
+    int64_t precision = spec.precision;
+    for (int i = 0; i < spec.num_stars && ok; ++i) {
+      const int64_t star = va_arg(args, int);
+      ok = writer.Put(&star, sizeof(star));
+      if (spec.star_precision && i == spec.num_stars - 1) {
+        // A negative precision is taken as if it were omitted.
+        precision = star;
+      }
+    }
+    if (ok) {
+      if (spec.conversion == 's') {
+        // Strings with a precision need not be NUL-terminated.
+        const char* str = va_arg(args, const char*);
+        ok = writer.PutString(str, precision < 0 ?
+                                     SIZE_MAX : static_cast<size_t>(precision));
+      } else if (spec.conversion == 'p') {
+        const void* ptr = va_arg(args, void*);
+        ok = writer.Put(&ptr, sizeof(ptr));
+      } else if (spec.conversion == 'n') {
+        // Never written through; only consumed.
+        (void)va_arg(args, void*);
+      } else if (IsFloatConversion(spec.conversion)) {
+        if (spec.length == kLengthLongDouble) {
+          const long double value = va_arg(args, long double);
+          ok = writer.Put(&value, sizeof(value));
+        } else {
+          const double value = va_arg(args, double);
+          ok = writer.Put(&value, sizeof(value));
+        }
+      } else {
+        const uint64_t value = ReadInteger(spec, &args);
+        ok = writer.Put(&value, sizeof(value));
+      }
+    }
+    if (!ok) {
+      header.truncated = 1;
+      break;
+    }
+    ++header.num_args;
+    p = spec.end - 1;
+  }
+  va_end(args);
+
+  const size_t size = static_cast<size_t>(writer.Position() - entry);
+  header.size = static_cast<uint32_t>(size);
+  memcpy(entry, &header, sizeof(header));
+  if (!GetThreadRing()->Write(entry, size)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AsyncLogger::BackgroundLoop() {
+  std::unique_lock<std::mutex> lock(drain_mutex_);
+  while (!stop_) {
+    drain_cv_.wait_for(lock,
+                       std::chrono::microseconds(drain_interval_micros_));
+    if (DrainAll()) {
+      sink_->Flush();
+    }
+  }
+}
+
+size_t AsyncLogger::DrainAll() {
+  std::vector<Ring*> rings;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings.reserve(rings_.size());
+    for (auto& ring : rings_) {
+      rings.push_back(ring.get());
+    }
+  }
+
+  size_t count = 0;
+  bool any_orphaned = false;
+  for (Ring* ring : rings) {
+    // Check before draining, so that the ring is known to be complete.
+    const bool orphaned = ring->IsOrphaned();
+    count += ring->Drain([this, ring] (const char* entry) {
+      RenderEntry(*ring, entry);
+      sink_->AppendLine(line_.data(), line_.size());
+    });
+    any_orphaned |= orphaned;
+  }
+
+  const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_) {
+    line_.clear();
+    char prefix[128];
+    FormatLogPrefix(prefix, sizeof(prefix),
+      static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count()),
+      env_->GetCurrentThreadId(),
+      env_->GetCurrentThreadName().c_str());
+    line_.append(prefix);
+    AppendPrintf(&line_,
+      "[%s] AsyncLogger dropped %llu log entries (%llu in total)\n",
+      LogLevelToString(WARN_LEVEL),
+      static_cast<unsigned long long>(dropped - reported_dropped_),
+      static_cast<unsigned long long>(dropped));
+    sink_->AppendLine(line_.data(), line_.size());
+    reported_dropped_ = dropped;
+    ++count;
+  }
+
+  if (any_orphaned) {
+    // Rings of exited threads will not be written to again.
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto it = rings_.begin(); it != rings_.end(); ) {
+      if ((*it)->IsOrphaned() && (*it)->Empty()) {
+        it = rings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return count;
+}
+
+void AsyncLogger::RenderEntry(const Ring& ring, const char* entry) {
+  EntryHeader header;
+  memcpy(&header, entry, sizeof(header));
+
+  line_.clear();
+  char prefix[128];
+  FormatLogPrefix(prefix, sizeof(prefix), header.unix_micros,
+                  ring.thread_id_, ring.thread_name_.c_str());
+  line_.append(prefix);
+  if (header.kind == kEntryLog) {
+    const char* basename = strrchr(header.filename, '/');
+    AppendPrintf(&line_, "[%s] %s:%d: ",
+                 LogLevelToString(header.level),
+                 basename ? basename + 1 : header.filename,
+                 header.line);
+  }
+
+  ArgReader reader(entry + AlignUp(sizeof(header)));
+  size_t rendered = 0;
+  const char* p = header.format;
+  while (*p) {
+    const char* percent = strchr(p, '%');
+    if (!percent) {
+      line_.append(p);
+      break;
+    }
+    line_.append(p, static_cast<size_t>(percent - p));
+    if (percent[1] == '%') {
+      line_.push_back('%');
+      p = percent + 2;
+      continue;
+    }
+    FormatSpec spec;
+    if (rendered == header.num_args || !ParseSpec(percent, &spec)) {
+      // Arguments past this point were not recorded.
+      line_.append("...");
+      break;
+    }
+    ++rendered;
+    p = spec.end;
+
+    // Rebuild the specification with '*' substituted by recorded values.
+    char spec_format[64];
+    char* out = spec_format;
+    char* const out_limit = spec_format + sizeof(spec_format) - 1;
+    for (const char* s = spec.begin; s != spec.end && out < out_limit; ++s) {
+      if (*s == '*') {
+        out += snprintf(out, static_cast<size_t>(out_limit - out), "%d",
+                        static_cast<int>(reader.Get<int64_t>()));
+        out = std::min(out, out_limit);
+      } else {
+        *out++ = *s;
+      }
+    }
+    *out = '\0';
+
+    const char c = spec.conversion;
+    if (c == 'n') {
+      continue;
+    } else if (c == 's') {
+      const char* str = reader.GetString();
+      AppendPrintf(&line_, spec_format, str ? str : "(null)");
+    } else if (c == 'p') {
+      AppendPrintf(&line_, spec_format, reader.Get<void*>());
+    } else if (IsFloatConversion(c)) {
+      if (spec.length == kLengthLongDouble) {
+        AppendPrintf(&line_, spec_format, reader.Get<long double>());
+      } else {
+        AppendPrintf(&line_, spec_format, reader.Get<double>());
+      }
+    } else {
+      const uint64_t value = reader.Get<uint64_t>();
+      const int64_t svalue = static_cast<int64_t>(value);
+      if (IsSignedConversion(c)) {
+        switch (spec.length) {
+          case kLengthLong:
+            AppendPrintf(&line_, spec_format, static_cast<long>(svalue));
+            break;
+          case kLengthLongLong:
+            AppendPrintf(&line_, spec_format, static_cast<long long>(svalue));
+            break;
+          case kLengthIntMax:
+            AppendPrintf(&line_, spec_format, static_cast<intmax_t>(svalue));
+            break;
+          case kLengthSize:
+            AppendPrintf(&line_, spec_format, static_cast<ssize_t>(svalue));
+            break;
+          case kLengthPtrDiff:
+            AppendPrintf(&line_, spec_format, static_cast<ptrdiff_t>(svalue));
+            break;
+          default:
+            AppendPrintf(&line_, spec_format, static_cast<int>(svalue));
+            break;
+        }
+      } else if (IsUnsignedConversion(c)) {
+        switch (spec.length) {
+          case kLengthLong:
+            AppendPrintf(&line_, spec_format,
+                         static_cast<unsigned long>(value));
+            break;
+          case kLengthLongLong:
+            AppendPrintf(&line_, spec_format,
+                         static_cast<unsigned long long>(value));
+            break;
+          case kLengthIntMax:
+            AppendPrintf(&line_, spec_format, static_cast<uintmax_t>(value));
+            break;
+          case kLengthSize:
+          case kLengthPtrDiff:
+            AppendPrintf(&line_, spec_format, static_cast<size_t>(value));
+            break;
+          default:
+            AppendPrintf(&line_, spec_format,
+                         static_cast<unsigned int>(value));
+            break;
+        }
+      } else {
+        // %c
+        AppendPrintf(&line_, spec_format, static_cast<int>(svalue));
+      }
+    }
+  }
+  if (line_.empty() || line_.back() != '\n') {
+    line_.push_back('\n');
+  }
+}
+
+}  // namespace rocketspeed
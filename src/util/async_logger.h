@@ -0,0 +1,137 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include/Logger.h"
+#include "src/util/common/base_env.h"
+#include "src/util/common/thread_local.h"
+
+namespace rocketspeed {
+
+/**
+ * Logger that moves formatting and I/O off the logging threads.
+ *
+ * Logv copies the format string pointer, a timestamp and the raw arguments
+ * into a lock-free ring buffer owned by the calling thread. A background
+ * thread renders pending entries and writes them to the sink logger through
+ * AppendLine, so the output is identical to that of the sink.
+ *
+ * Producers never block: an entry that does not fit in the ring is dropped
+ * and counted. The number of dropped entries is reported in the log and
+ * through GetDroppedCount.
+ *
+ * Format strings and file names must outlive the logger, which is the case
+ * for all uses of the LOG_* macros.
+ */
+class AsyncLogger : public Logger {
+ public:
+  /** Default size of each per-thread ring buffer, in bytes. */
+  static const size_t kDefaultRingBytes = 256 << 10;
+
+  /** Default interval between drains of the ring buffers. */
+  static const uint64_t kDefaultDrainIntervalMicros = 1000;
+
+  /** Maximum size of a single encoded entry, in bytes. */
+  static const size_t kMaxEntryBytes = 2048;
+
+  /**
+   * Creates an AsyncLogger and starts the background thread.
+   *
+   * @param env Environment used to start the background thread.
+   * @param sink Logger that rendered entries are written to.
+   * @param ring_bytes Size of each per-thread ring buffer.
+   * @param drain_interval_micros Time between drains of the ring buffers.
+   */
+  AsyncLogger(BaseEnv* env,
+              std::shared_ptr<Logger> sink,
+              size_t ring_bytes = kDefaultRingBytes,
+              uint64_t drain_interval_micros = kDefaultDrainIntervalMicros);
+
+  /** Writes all pending entries and stops the background thread. */
+  ~AsyncLogger();
+
+  void Logv(const InfoLogLevel log_level,
+            const char* filename,
+            int line,
+            const char* format,
+            va_list ap) override;
+
+  void Append(const char* format, va_list ap) override;
+
+  /** Synchronously writes all pending entries and flushes the sink. */
+  void Flush() override;
+
+  size_t GetLogFileSize() const override {
+    return sink_->GetLogFileSize();
+  }
+
+  /** Total number of entries dropped because a ring buffer was full. */
+  uint64_t GetDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  class Ring;
+
+  /** Returns the ring buffer of the calling thread, creating it if needed. */
+  Ring* GetThreadRing();
+
+  /** Encodes an entry into the ring buffer of the calling thread. */
+  void Record(bool has_level,
+              InfoLogLevel log_level,
+              const char* filename,
+              int line,
+              const char* format,
+              va_list ap);
+
+  /** Body of the background thread. */
+  void BackgroundLoop();
+
+  /**
+   * Renders all pending entries from all rings to the sink.
+   * REQUIRES: drain_mutex_ held.
+   *
+   * @return Number of entries written.
+   */
+  size_t DrainAll();
+
+  /** Renders one entry into line_. REQUIRES: drain_mutex_ held. */
+  void RenderEntry(const Ring& ring, const char* entry);
+
+  static void OnThreadExit(void* ring);
+
+  BaseEnv* env_;
+  std::shared_ptr<Logger> sink_;
+  const size_t ring_bytes_;
+  const uint64_t drain_interval_micros_;
+  std::atomic<uint64_t> dropped_;
+
+  // All rings ever created, including those of exited threads that still
+  // hold pending entries.
+  std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  // Serialises draining between the background thread and Flush.
+  std::mutex drain_mutex_;
+  std::condition_variable drain_cv_;
+  bool stop_;
+  uint64_t reported_dropped_;
+  std::string line_;
+
+  // Declared after rings_ so that it is destroyed first.
+  ThreadLocalPtr thread_ring_;
+  BaseEnv::ThreadId thread_id_;
+};
+
+}  // namespace rocketspeed
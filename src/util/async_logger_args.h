@@ -0,0 +1,111 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace rocketspeed {
+
+namespace detail {
+
+/** Alignment of every argument encoded by AsyncLogger. */
+const size_t kAsyncLogAlignment = 8;
+
+inline size_t AsyncLogAlignUp(size_t n) {
+  return (n + kAsyncLogAlignment - 1) & ~(kAsyncLogAlignment - 1);
+}
+
+/** Bounded writer of AsyncLogger entry arguments. */
+class AsyncLogArgWriter {
+ public:
+  AsyncLogArgWriter(char* begin, char* end) : pos_(begin), end_(end) {}
+
+  bool Put(const void* data, size_t size) {
+    if (AsyncLogAlignUp(size) > Remaining()) {
+      return false;
+    }
+    memcpy(pos_, data, size);
+    pos_ += AsyncLogAlignUp(size);
+    return true;
+  }
+
+  /**
+   * Writes a string argument.
+   *
+   * @param str The string, may be null.
+   * @param max_len Maximum number of bytes read from str, as given by the
+   *                precision of the conversion. str need not be
+   *                NUL-terminated within that many bytes.
+   * @return false if there is no space left for the string.
+   */
+  bool PutString(const char* str, size_t max_len = SIZE_MAX) {
+    // A null string is encoded with a length of UINT32_MAX.
+    uint32_t len = UINT32_MAX;
+    size_t copy = 0;
+    if (str) {
+      if (Remaining() < 2 * kAsyncLogAlignment) {
+        return false;
+      }
+      // Truncate to the remaining space, leaving room for the NUL.
+      const size_t space = Remaining() - sizeof(len) - 1;
+      copy = strnlen(str, max_len < space ? max_len : space);
+      len = static_cast<uint32_t>(copy);
+    } else if (Remaining() < kAsyncLogAlignment) {
+      return false;
+    }
+    memcpy(pos_, &len, sizeof(len));
+    if (copy) {
+      memcpy(pos_ + sizeof(len), str, copy);
+    }
+    pos_[sizeof(len) + copy] = '\0';
+    pos_ += AsyncLogAlignUp(sizeof(len) + copy + 1);
+    return true;
+  }
+
+  char* Position() const { return pos_; }
+
+ private:
+  size_t Remaining() const { return static_cast<size_t>(end_ - pos_); }
+
+  char* pos_;
+  char* end_;
+};
+
+/** Reader of arguments written by AsyncLogArgWriter. */
+class AsyncLogArgReader {
+ public:
+  explicit AsyncLogArgReader(const char* pos) : pos_(pos) {}
+
+  template <typename T>
+  T Get() {
+    T value;
+    memcpy(&value, pos_, sizeof(value));
+    pos_ += AsyncLogAlignUp(sizeof(value));
+    return value;
+  }
+
+  /** @return The NUL-terminated string, or null if null was written. */
+  const char* GetString() {
+    uint32_t len;
+    memcpy(&len, pos_, sizeof(len));
+    if (len == UINT32_MAX) {
+      pos_ += kAsyncLogAlignment;
+      return nullptr;
+    }
+    const char* str = pos_ + sizeof(len);
+    pos_ += AsyncLogAlignUp(sizeof(len) + len + 1);
+    return str;
+  }
+
+ private:
+  const char* pos_;
+};
+
+} // namespace detail
+
+}  // namespace rocketspeed
@@ -36,24 +36,28 @@ void AutoRollLogger::RollLogFile() {
   env_->RenameFile(log_fname_, old_fname);
 }
 
-void AutoRollLogger::Append(const char* format, va_list ap) {
+std::shared_ptr<Logger> AutoRollLogger::GetCurrentLogger() {
   assert(GetStatus().ok());
 
-  std::shared_ptr<Logger> logger;
-  {
-    MutexLock l(&mutex_);
-    if ((kLogFileTimeToRoll > 0 && LogExpired()) ||
-        (kMaxLogFileSize > 0 && logger_->GetLogFileSize() >= kMaxLogFileSize)) {
-      RollLogFile();
-      Status s = ResetLogger();
-      if (!s.ok()) {
-        // can't really log the error if creating a new LOG file failed
-        return;
-      }
+  MutexLock l(&mutex_);
+  if ((kLogFileTimeToRoll > 0 && LogExpired()) ||
+      (kMaxLogFileSize > 0 && logger_->GetLogFileSize() >= kMaxLogFileSize)) {
+    RollLogFile();
+    Status s = ResetLogger();
+    if (!s.ok()) {
+      // can't really log the error if creating a new LOG file failed
+      return nullptr;
     }
+  }
+
+  // pin down the current logger_ instance before releasing the mutex.
+  return logger_;
+}
 
-    // pin down the current logger_ instance before releasing the mutex.
-    logger = logger_;
+void AutoRollLogger::Append(const char* format, va_list ap) {
+  std::shared_ptr<Logger> logger = GetCurrentLogger();
+  if (!logger) {
+    return;
   }
 
   // Another thread could have put a new Logger instance into logger_ by now.
@@ -65,6 +69,13 @@ void AutoRollLogger::Append(const char* format, va_list ap) {
   logger->Append(format, ap);
 }
 
+void AutoRollLogger::AppendLine(const char* line, size_t size) {
+  std::shared_ptr<Logger> logger = GetCurrentLogger();
+  if (logger) {
+    logger->AppendLine(line, size);
+  }
+}
+
 bool AutoRollLogger::LogExpired() {
   if (cached_now_access_count >= call_NowMicros_every_N_records_) {
     cached_now = static_cast<uint64_t>(env_->NowMicros() / 1000000);
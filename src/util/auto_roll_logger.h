@@ -43,6 +43,8 @@ class AutoRollLogger : public Logger {
 
   void Append(const char* format, va_list ap);
 
+  void AppendLine(const char* line, size_t size);
+
   // check if the logger has encountered any problem.
   Status GetStatus() {
     return status_;
@@ -62,6 +64,8 @@ class AutoRollLogger : public Logger {
  private:
   bool LogExpired();
   Status ResetLogger();
+  // Rolls the log file if needed, and returns the current logger.
+  std::shared_ptr<Logger> GetCurrentLogger();
   void RollLogFile();
 
   std::string log_fname_;  // Current active info log's file name.
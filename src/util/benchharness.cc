@@ -0,0 +1,241 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/benchharness.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OS_LINUX)
+#include <sched.h>
+#endif
+
+#include "src/port/Env.h"
+#include "src/util/perf_results.h"
+
+namespace rocketspeed {
+namespace benchmark {
+
+namespace {
+
+struct Benchmark {
+  const char* file;
+  const char* name;
+  void (*func)(size_t);
+  bool relative;
+};
+std::vector<Benchmark>* benchmarks;
+
+typedef std::chrono::steady_clock Clock;
+
+// Time suspended in the current measurement.
+std::chrono::nanoseconds suspended_time(0);
+
+// Upper bound on iterations per epoch, for benchmarks that are optimized
+// away entirely.
+const size_t kMaxIterations = size_t(1) << 30;
+
+size_t GetEnvOption(const char* name, size_t default_value) {
+  const char* value = getenv(name);
+  if (value == nullptr || *value == '\0') {
+    return default_value;
+  }
+  return static_cast<size_t>(strtoull(value, nullptr, 10));
+}
+
+/**
+ * Runs one epoch of the benchmark, doubling the iterations until it takes at
+ * least min_nanos.
+ *
+ * @return Nanoseconds per iteration.
+ */
+double RunEpoch(const Benchmark& bench, double min_nanos) {
+  double nanos = 0.0;
+  size_t iters = 1;
+  for (; iters <= kMaxIterations; iters *= 2) {
+    BenchmarkSuspender::ResetSuspendedTime();
+    auto start = Clock::now();
+    bench.func(iters);
+    auto elapsed = Clock::now() - start -
+      BenchmarkSuspender::GetSuspendedTime();
+    nanos = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if (nanos >= min_nanos) {
+      break;
+    }
+  }
+  return std::max(nanos, 0.0) / static_cast<double>(std::min(iters,
+                                                             kMaxIterations));
+}
+
+/** Formats a value with a metric suffix, e.g. 12.34M. */
+std::string Metric(double value, const char* unit) {
+  static const char* const kSuffixes[] = { "", "k", "M", "G", "T" };
+  size_t i = 0;
+  while (value >= 1000.0 && i + 1 < sizeof(kSuffixes) / sizeof(kSuffixes[0])) {
+    value /= 1000.0;
+    ++i;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.2f%s%s", value, kSuffixes[i], unit);
+  return std::string(buffer);
+}
+
+/** Formats a duration in nanoseconds, e.g. 12.34us. */
+std::string Duration(double nanos) {
+  static const char* const kUnits[] = { "ns", "us", "ms", "s" };
+  size_t i = 0;
+  while (nanos >= 1000.0 && i + 1 < sizeof(kUnits) / sizeof(kUnits[0])) {
+    nanos /= 1000.0;
+    ++i;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.2f%s", nanos, kUnits[i]);
+  return std::string(buffer);
+}
+
+void PrintSeparator(char c) {
+  printf("%s\n", std::string(76, c).c_str());
+}
+
+}  // namespace
+
+bool RegisterBenchmark(const char* file,
+                       const char* name,
+                       void (*func)(size_t),
+                       bool relative) {
+  if (benchmarks == nullptr) {
+    benchmarks = new std::vector<Benchmark>;
+  }
+  Benchmark b;
+  b.file = file;
+  b.name = name;
+  b.func = func;
+  b.relative = relative;
+  benchmarks->push_back(b);
+  return true;
+}
+
+BenchmarkSuspender::BenchmarkSuspender()
+: start_(Clock::now())
+, active_(true) {
+}
+
+void BenchmarkSuspender::Dismiss() {
+  if (active_) {
+    suspended_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start_);
+    active_ = false;
+  }
+}
+
+std::chrono::nanoseconds BenchmarkSuspender::GetSuspendedTime() {
+  return suspended_time;
+}
+
+void BenchmarkSuspender::ResetSuspendedTime() {
+  suspended_time = std::chrono::nanoseconds(0);
+}
+
+int RunAllBenchmarks() {
+  rocketspeed::Env::InstallSignalHandlers();
+
+  const char* matcher = getenv("ROCKETSPEED_BENCHMARKS");
+  const size_t epochs =
+    std::max<size_t>(1, GetEnvOption("ROCKETSPEED_BENCH_EPOCHS", 11));
+  const double min_nanos =
+    1000.0 * static_cast<double>(
+      GetEnvOption("ROCKETSPEED_BENCH_MIN_USEC", 10000));
+
+#if defined(OS_LINUX)
+  // Pinning avoids migrations between cores, which make results noisy.
+  const char* cpu = getenv("ROCKETSPEED_BENCH_CPU");
+  if (cpu != nullptr && *cpu != '\0') {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(atoi(cpu), &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      fprintf(stderr, "Failed to pin benchmark to CPU %s\n", cpu);
+      return 1;
+    }
+  }
+#endif
+
+  if (benchmarks == nullptr) {
+    return 0;
+  }
+
+  const char* json_path = getenv("ROCKETSPEED_BENCH_JSON");
+  PerfResults results;
+
+  const char* current_file = nullptr;
+  double baseline_nanos = 0.0;
+  for (const Benchmark& bench : *benchmarks) {
+    if (matcher != nullptr && strstr(bench.name, matcher) == nullptr) {
+      continue;
+    }
+    if (current_file == nullptr || strcmp(current_file, bench.file) != 0) {
+      if (current_file != nullptr) {
+        PrintSeparator('=');
+        printf("\n");
+      }
+      current_file = bench.file;
+      PrintSeparator('=');
+      printf("%-46s%10s%10s%10s\n",
+             bench.file, "relative", "time/iter", "iters/s");
+      PrintSeparator('=');
+    }
+
+    // Every epoch is kept as a sample so that comparisons against a baseline
+    // can account for the noise.
+    const std::string metric = std::string(bench.file) + ":" + bench.name;
+    double nanos = std::numeric_limits<double>::max();
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+      const double epoch_nanos = RunEpoch(bench, min_nanos);
+      results.AddSample(metric, "ns/iter", false, epoch_nanos);
+      nanos = std::min(nanos, epoch_nanos);
+    }
+    const double iters_per_sec = nanos > 0.0 ? 1e9 / nanos : 0.0;
+
+    if (bench.relative && baseline_nanos > 0.0 && nanos > 0.0) {
+      char relative[16];
+      snprintf(relative, sizeof(relative), "%.2f%%",
+               100.0 * baseline_nanos / nanos);
+      printf("%-46s%10s%10s%10s\n",
+             bench.name, relative,
+             Duration(nanos).c_str(), Metric(iters_per_sec, "").c_str());
+    } else {
+      if (!bench.relative) {
+        baseline_nanos = nanos;
+      }
+      printf("%-46s%10s%10s%10s\n",
+             bench.name, "",
+             Duration(nanos).c_str(), Metric(iters_per_sec, "").c_str());
+    }
+    fflush(stdout);
+  }
+  if (current_file != nullptr) {
+    PrintSeparator('=');
+  }
+  delete benchmarks;
+  benchmarks = nullptr;
+
+  if (json_path != nullptr && *json_path != '\0') {
+    Status st = results.WriteToFile(json_path);
+    if (!st.ok()) {
+      fprintf(stderr, "%s\n", st.ToString().c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace benchmark
+}  // namespace rocketspeed
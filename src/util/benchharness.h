@@ -0,0 +1,109 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace rocketspeed {
+namespace benchmark {
+
+/**
+ * Runs the benchmarks registered by the BENCHMARK macros, in the order they
+ * were defined, and prints the results to stdout.
+ *
+ * Each benchmark is run for a number of epochs. In each epoch, the number of
+ * iterations is doubled until the epoch takes at least a minimum time, and
+ * the fastest time per iteration over all epochs is reported, as it is the
+ * least affected by noise. The following environment variables are used:
+ *
+ *   ROCKETSPEED_BENCHMARKS: Only run benchmarks whose name contains this.
+ *   ROCKETSPEED_BENCH_EPOCHS: Number of epochs (default 11).
+ *   ROCKETSPEED_BENCH_MIN_USEC: Minimum epoch duration (default 10000).
+ *   ROCKETSPEED_BENCH_CPU: Pin the benchmark thread to this CPU.
+ *   ROCKETSPEED_BENCH_JSON: Also write the time per iteration of every epoch
+ *     to this file, in the format of PerfResults, for use with benchcompare.
+ *
+ * @return 0 on success.
+ */
+int RunAllBenchmarks();
+
+// Register the specified benchmark. Typically not used directly, but
+// invoked via the macro expansion of BENCHMARK.
+extern bool RegisterBenchmark(const char* file,
+                              const char* name,
+                              void (*func)(size_t),
+                              bool relative);
+
+/**
+ * Excludes the time spent in its scope from the current benchmark, e.g. for
+ * setting up data for each iteration. Only valid on the benchmark thread.
+ */
+class BenchmarkSuspender {
+ public:
+  BenchmarkSuspender();
+
+  ~BenchmarkSuspender() {
+    Dismiss();
+  }
+
+  /** Resumes timing before the end of the scope. */
+  void Dismiss();
+
+  /** Time suspended since the start of the current measurement. */
+  static std::chrono::nanoseconds GetSuspendedTime();
+
+  /** Starts a new measurement. */
+  static void ResetSuspendedTime();
+
+ private:
+  BenchmarkSuspender(const BenchmarkSuspender&) = delete;
+  BenchmarkSuspender& operator=(const BenchmarkSuspender&) = delete;
+
+  std::chrono::steady_clock::time_point start_;
+  bool active_;
+};
+
+/**
+ * Prevents the compiler from optimizing away the computation of a value
+ * that is otherwise unused.
+ */
+template <typename T>
+inline void DoNotOptimizeAway(T&& datum) {
+  asm volatile("" : : "r"(&datum) : "memory");
+}
+
+}  // namespace benchmark
+}  // namespace rocketspeed
+
+#define BCONCAT(a, b) BCONCAT1(a, b)
+#define BCONCAT1(a, b) a##b
+
+#define BENCHMARK_IMPL(name, iters, relative)                           \
+static void name(size_t iters);                                         \
+bool BCONCAT(_Bench_ignored_, name) =                                   \
+  ::rocketspeed::benchmark::RegisterBenchmark(                          \
+    __FILE__, #name, &name, relative);                                  \
+static void name(size_t iters)
+
+/**
+ * Defines a benchmark. The body should run the benchmarked operation iters
+ * times, e.g.
+ *
+ *   BENCHMARK(VectorPushBack, n) {
+ *     std::vector<int> v;
+ *     for (size_t i = 0; i < n; ++i) {
+ *       v.push_back(i);
+ *     }
+ *   }
+ */
+#define BENCHMARK(name, iters) BENCHMARK_IMPL(name, iters, false)
+
+/**
+ * Defines a benchmark that is reported relative to the closest preceding
+ * BENCHMARK.
+ */
+#define BENCHMARK_RELATIVE(name, iters) BENCHMARK_IMPL(name, iters, true)
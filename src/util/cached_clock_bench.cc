@@ -0,0 +1,97 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <chrono>
+#include <thread>
+
+#include "src/port/Env.h"
+#include "src/util/benchharness.h"
+#include "src/util/common/cached_clock.h"
+#include "src/util/timeout_list.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+namespace {
+
+// Per-message time-keeping done by the EventLoop for a received message and
+// a sent message: heartbeat update and send timestamp. Messages are processed
+// in callbacks of kBatch messages, as read from a socket or a command queue.
+const size_t kBatch = 100;
+const size_t kStreams = 1000;
+
+}  // namespace
+
+BENCHMARK(MessagesWithClockReads, n) {
+  BenchmarkSuspender braces;
+  Env* env = Env::Default();
+  TimeoutList<size_t> heartbeat;
+  braces.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    heartbeat.Add(i % kStreams);
+    auto issued_time = env->NowMicros();
+    DoNotOptimizeAway(issued_time);
+  }
+}
+
+BENCHMARK_RELATIVE(MessagesWithCachedClock, n) {
+  BenchmarkSuspender braces;
+  CachedClock clock;
+  TimeoutList<size_t> heartbeat;
+  braces.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    if (i % kBatch == 0) {
+      clock.Refresh();
+    }
+    heartbeat.Add(i % kStreams, clock.Now());
+    auto issued_time = clock.NowMicros();
+    DoNotOptimizeAway(issued_time);
+  }
+}
+
+BENCHMARK(ClockRead, n) {
+  for (size_t i = 0; i < n; ++i) {
+    auto now = CachedClock::Clock::now();
+    DoNotOptimizeAway(now);
+  }
+}
+
+BENCHMARK_RELATIVE(CachedClockRead, n) {
+  BenchmarkSuspender braces;
+  CachedClock clock;
+  braces.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    auto now = clock.Now();
+    DoNotOptimizeAway(now);
+  }
+}
+
+BENCHMARK_RELATIVE(TimestampCounterRead, n) {
+  BenchmarkSuspender braces;
+  CachedClock clock(true);
+  /* sleep override */
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  clock.Refresh();
+  braces.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    if (i % kBatch == 0) {
+      clock.Refresh();
+    }
+    auto now = clock.FineNow();
+    DoNotOptimizeAway(now);
+  }
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/util/benchharness.h"
+#include "src/util/common/coding.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+namespace {
+
+// Values per encoded array. Each benchmark iteration codes one value.
+const size_t kValues = 1024;
+
+// Byte at a time decoding, as done before the word at a time decoder.
+const char* ByteLoopGetVarint64(const char* p, const char* limit,
+                                uint64_t* value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7) {
+    uint64_t byte = *(reinterpret_cast<const unsigned char*>(p));
+    p++;
+    if (byte & 128) {
+      result |= ((byte & 127) << shift);
+    } else {
+      result |= (byte << shift);
+      *value = result;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Values below 2^7, e.g. sequence number deltas and counts.
+const std::vector<uint64_t>& SmallValues() {
+  static const std::vector<uint64_t> values = [] () {
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> result(kValues);
+    for (uint64_t& v : result) {
+      v = rng() & 0x7f;
+    }
+    return result;
+  }();
+  return values;
+}
+
+// Values of 1 to 64 significant bits, e.g. sequence numbers and IDs.
+const std::vector<uint64_t>& MixedValues() {
+  static const std::vector<uint64_t> values = [] () {
+    std::mt19937_64 rng(2);
+    std::vector<uint64_t> result(kValues);
+    for (uint64_t& v : result) {
+      v = rng() >> (rng() % 64);
+    }
+    return result;
+  }();
+  return values;
+}
+
+std::string Encode(const std::vector<uint64_t>& values) {
+  std::string encoded;
+  for (uint64_t v : values) {
+    PutVarint64(&encoded, v);
+  }
+  return encoded;
+}
+
+template <typename Decode>
+void DecodeEach(size_t n, const std::vector<uint64_t>& values, Decode decode) {
+  std::string encoded;
+  std::vector<uint64_t> decoded(kValues);
+  {
+    BenchmarkSuspender suspender;
+    encoded = Encode(values);
+  }
+  const char* limit = encoded.data() + encoded.size();
+  for (size_t i = 0; i < n; i += kValues) {
+    const char* p = encoded.data();
+    for (uint64_t& v : decoded) {
+      p = decode(p, limit, &v);
+    }
+    DoNotOptimizeAway(p);
+  }
+  DoNotOptimizeAway(decoded);
+}
+
+void DecodeArray(size_t n, const std::vector<uint64_t>& values) {
+  std::string encoded;
+  std::vector<uint64_t> decoded(kValues);
+  {
+    BenchmarkSuspender suspender;
+    encoded = Encode(values);
+  }
+  for (size_t i = 0; i < n; i += kValues) {
+    Slice in(encoded);
+    bool ok = GetVarint64Array(&in, decoded.data(), kValues);
+    DoNotOptimizeAway(ok);
+  }
+  DoNotOptimizeAway(decoded);
+}
+
+void EncodeEach(size_t n, const std::vector<uint64_t>& values) {
+  std::string encoded;
+  for (size_t i = 0; i < n; i += kValues) {
+    encoded.clear();
+    for (uint64_t v : values) {
+      PutVarint64(&encoded, v);
+    }
+    DoNotOptimizeAway(encoded);
+  }
+}
+
+void EncodeArray(size_t n, const std::vector<uint64_t>& values) {
+  std::string encoded;
+  for (size_t i = 0; i < n; i += kValues) {
+    encoded.clear();
+    PutVarint64Array(&encoded, values.data(), kValues);
+    DoNotOptimizeAway(encoded);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(DecodeSmallByteLoop, n) {
+  DecodeEach(n, SmallValues(), ByteLoopGetVarint64);
+}
+
+BENCHMARK_RELATIVE(DecodeSmallGetVarint64Ptr, n) {
+  DecodeEach(n, SmallValues(), GetVarint64Ptr);
+}
+
+BENCHMARK_RELATIVE(DecodeSmallGetVarint64Array, n) {
+  DecodeArray(n, SmallValues());
+}
+
+BENCHMARK(DecodeMixedByteLoop, n) {
+  DecodeEach(n, MixedValues(), ByteLoopGetVarint64);
+}
+
+BENCHMARK_RELATIVE(DecodeMixedGetVarint64Ptr, n) {
+  DecodeEach(n, MixedValues(), GetVarint64Ptr);
+}
+
+BENCHMARK_RELATIVE(DecodeMixedGetVarint64Array, n) {
+  DecodeArray(n, MixedValues());
+}
+
+BENCHMARK(EncodeSmallPutVarint64, n) {
+  EncodeEach(n, SmallValues());
+}
+
+BENCHMARK_RELATIVE(EncodeSmallPutVarint64Array, n) {
+  EncodeArray(n, SmallValues());
+}
+
+BENCHMARK(EncodeMixedPutVarint64, n) {
+  EncodeEach(n, MixedValues());
+}
+
+BENCHMARK_RELATIVE(EncodeMixedPutVarint64Array, n) {
+  EncodeArray(n, MixedValues());
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
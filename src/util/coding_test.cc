@@ -5,6 +5,10 @@
 //
 #include "src/util/common/coding.h"
 
+#include <random>
+#include <string>
+#include <vector>
+
 #include "src/util/testharness.h"
 
 namespace rocketspeed {
@@ -186,6 +190,130 @@ TEST(Coding, Varint64Truncation) {
   ASSERT_EQ(large_value, result);
 }
 
+// Byte at a time decoders, as the optimized ones must behave.
+template <typename T>
+const char* ReferenceGetVarint(const char* p, const char* limit, T* value) {
+  const uint32_t max_shift = sizeof(T) == 4 ? 28 : 63;
+  T result = 0;
+  for (uint32_t shift = 0; shift <= max_shift && p < limit; shift += 7) {
+    T byte = *(reinterpret_cast<const unsigned char*>(p));
+    p++;
+    if (byte & 128) {
+      result |= static_cast<T>((byte & 127) << shift);
+    } else {
+      result |= static_cast<T>(byte << shift);
+      *value = result;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Random value with a random number of significant bits, so that all
+// encoded lengths are equally likely.
+uint64_t RandomVarintValue(std::mt19937_64* rng, int max_bits) {
+  const int bits = static_cast<int>((*rng)() % (max_bits + 1));
+  return bits == 0 ? 0 : (*rng)() >> (64 - bits);
+}
+
+TEST(Coding, VarintLength) {
+  ASSERT_EQ(VarintLength(0), 1);
+  for (int bits = 1; bits <= 64; ++bits) {
+    const uint64_t v = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    std::string s;
+    PutVarint64(&s, v);
+    ASSERT_EQ(VarintLength(v), static_cast<int>(s.size()));
+    ASSERT_EQ(VarintLength(v), (bits + 6) / 7);
+  }
+}
+
+TEST(Coding, VarintFuzz) {
+  // Random bytes, biased towards continuation bits, read with random
+  // limits, must decode exactly as the byte at a time loop does.
+  std::mt19937_64 rng(301);
+  std::vector<char> buffer(16);
+  for (int iter = 0; iter < 200000; ++iter) {
+    const int continuation_percent = static_cast<int>(rng() % 101);
+    for (char& c : buffer) {
+      c = static_cast<char>(rng() & 0x7f);
+      if (static_cast<int>(rng() % 100) < continuation_percent) {
+        c = static_cast<char>(c | 0x80);
+      }
+    }
+    const char* p = buffer.data();
+    const char* limit = p + rng() % (buffer.size() + 1);
+
+    uint32_t v32 = 0;
+    uint32_t ref32 = 0;
+    const char* q32 = GetVarint32Ptr(p, limit, &v32);
+    ASSERT_TRUE(q32 == ReferenceGetVarint(p, limit, &ref32));
+    if (q32) {
+      ASSERT_EQ(v32, ref32);
+    }
+
+    uint64_t v64 = 0;
+    uint64_t ref64 = 0;
+    const char* q64 = GetVarint64Ptr(p, limit, &v64);
+    ASSERT_TRUE(q64 == ReferenceGetVarint(p, limit, &ref64));
+    if (q64) {
+      ASSERT_EQ(v64, ref64);
+    }
+  }
+}
+
+TEST(Coding, VarintArrayFuzz) {
+  std::mt19937_64 rng(302);
+  for (int iter = 0; iter < 2000; ++iter) {
+    // Mostly small values in some arrays, to exercise the bulk path.
+    const int max_bits = iter % 3 == 0 ? 7 : 64;
+    const size_t count = rng() % 100;
+    std::vector<uint64_t> values64(count);
+    std::vector<uint32_t> values32(count);
+    std::string expected64;
+    std::string expected32;
+    for (size_t i = 0; i < count; ++i) {
+      values64[i] = RandomVarintValue(&rng, max_bits);
+      values32[i] = static_cast<uint32_t>(
+        RandomVarintValue(&rng, std::min(max_bits, 32)));
+      PutVarint64(&expected64, values64[i]);
+      PutVarint32(&expected32, values32[i]);
+    }
+
+    // Bulk encoding appends the same bytes as one at a time.
+    std::string encoded64 = "x";
+    std::string encoded32 = "x";
+    PutVarint64Array(&encoded64, values64.data(), count);
+    PutVarint32Array(&encoded32, values32.data(), count);
+    ASSERT_EQ(encoded64, "x" + expected64);
+    ASSERT_EQ(encoded32, "x" + expected32);
+
+    // Bulk decoding round trips, and stops at the end of the array.
+    expected64 += "tail";
+    expected32 += "tail";
+    Slice in64(expected64);
+    Slice in32(expected32);
+    std::vector<uint64_t> decoded64(count);
+    std::vector<uint32_t> decoded32(count);
+    ASSERT_TRUE(GetVarint64Array(&in64, decoded64.data(), count));
+    ASSERT_TRUE(GetVarint32Array(&in32, decoded32.data(), count));
+    ASSERT_TRUE(decoded64 == values64);
+    ASSERT_TRUE(decoded32 == values32);
+    ASSERT_EQ(in64.ToString(), "tail");
+    ASSERT_EQ(in32.ToString(), "tail");
+
+    // Truncated input fails, and leaves the input alone.
+    if (count > 0) {
+      const size_t truncated = expected64.size() - 4 - 1 - rng() % 3;
+      Slice short64(expected64.data(), std::min(truncated, expected64.size()));
+      const Slice before = short64;
+      if (truncated < expected64.size()) {
+        ASSERT_TRUE(!GetVarint64Array(&short64, decoded64.data(), count));
+        ASSERT_TRUE(short64 == before);
+      }
+    }
+  }
+}
+
 TEST(Coding, Strings) {
   std::string s;
   PutLengthPrefixedSlice(&s, Slice(""));
@@ -165,6 +165,11 @@ class autovector :
   using Base::reserve;
   //using Base::shrink_to_fit(); // Hard to implement.
 
+  // Heap memory used once the elements have spilled out of the buffer.
+  size_t GetHeapMemoryUsage() const {
+    return capacity() > kCapacity ? capacity() * sizeof(T) : 0;
+  }
+
   using Base::operator[];
   using Base::at;
   using Base::front;
@@ -5,8 +5,14 @@
 //
 #include "src/util/common/base_env.h"
 
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 #include <thread>
 #include "src/port/port.h"
 #include "src/util/common/thread_local.h"
@@ -62,6 +68,84 @@ const std::string& BaseEnv::GetCurrentThreadName() {
   return *thread_name();
 }
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+Status BaseEnv::SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return Status::InvalidArgument("No CPUs to run on");
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return Status::InvalidArgument("Invalid CPU " + std::to_string(cpu));
+    }
+    CPU_SET(cpu, &set);
+  }
+  // On Linux, pid 0 is the calling thread rather than the whole process.
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    return Status::IOError("sched_setaffinity failed: " +
+                           std::string(strerror(errno)));
+  }
+  return Status::OK();
+}
+
+Status BaseEnv::GetCurrentThreadAffinity(std::vector<int>* cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return Status::IOError("sched_getaffinity failed: " +
+                           std::string(strerror(errno)));
+  }
+  cpus->clear();
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus->push_back(cpu);
+    }
+  }
+  return Status::OK();
+}
+
+int BaseEnv::GetCurrentCpu() {
+  return sched_getcpu();
+}
+
+int BaseEnv::GetNumaNode(int cpu) {
+  // The node of a CPU shows up as a nodeN link in its sysfs directory.
+  const std::string path =
+    "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    return -1;
+  }
+  int node = -1;
+  while (struct dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 &&
+        isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+#else
+Status BaseEnv::SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+  return Status::NotSupported("Thread affinity is not supported");
+}
+
+Status BaseEnv::GetCurrentThreadAffinity(std::vector<int>* cpus) {
+  return Status::NotSupported("Thread affinity is not supported");
+}
+
+int BaseEnv::GetCurrentCpu() {
+  return -1;
+}
+
+int BaseEnv::GetNumaNode(int cpu) {
+  return -1;
+}
+#endif
+
 class SequentialFileImpl : public SequentialFile {
  private:
   std::string filename_;
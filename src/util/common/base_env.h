@@ -9,6 +9,7 @@
 #include <memory>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "include/Status.h"
 #include "include/Slice.h"
@@ -56,6 +57,30 @@ class BaseEnv {
   /** Gets a thread name for current thread. */
   virtual const std::string& GetCurrentThreadName();
 
+  /**
+   * Restricts the current thread to the given CPUs. With the default NUMA
+   * policy, memory that the thread touches first is then allocated on the
+   * nodes of those CPUs.
+   *
+   * @param cpus The CPUs to run on, must not be empty.
+   * @return ok() if set, NotSupported if the platform has no affinity.
+   */
+  virtual Status SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
+  /**
+   * Gets the CPUs the current thread may run on.
+   *
+   * @param cpus Output for the CPUs, in increasing order.
+   * @return ok() if read, NotSupported if the platform has no affinity.
+   */
+  virtual Status GetCurrentThreadAffinity(std::vector<int>* cpus);
+
+  /** Gets the CPU the current thread is running on, or -1 if unknown. */
+  virtual int GetCurrentCpu();
+
+  /** Gets the NUMA node of a CPU, or -1 if unknown. */
+  virtual int GetNumaNode(int cpu);
+
   /**
    * Returns the number of micro-seconds since some fixed point in time.
    * Only useful for computing deltas of time.
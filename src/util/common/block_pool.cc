@@ -0,0 +1,285 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/common/block_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "src/util/common/thread_local.h"
+
+namespace rocketspeed {
+
+namespace {
+
+// Blocks are 64 << size_class bytes, including the header.
+const size_t kMinBlockShift = 6;
+const size_t kNumClasses = 9;
+const size_t kHugeClass = kNumClasses;  // Not pooled
+
+// Bytes kept on each free list before blocks go back to the heap.
+const size_t kMaxCachedBytes = 64 * 1024;
+
+class ThreadCache;
+
+// Precedes every block. While a block is free, the owner is replaced by the
+// next free block, but the size class is kept.
+struct alignas(16) Header {
+  union {
+    ThreadCache* owner;  // Pool the block returns to
+    Header* next;        // Next free block
+  };
+  size_t size_class;
+};
+
+static_assert(sizeof(Header) == 16, "Header must keep blocks aligned");
+static_assert(BlockPool::kMaxPooledSize + sizeof(Header) ==
+                size_t(1) << (kMinBlockShift + kNumClasses - 1),
+              "kMaxPooledSize must fill the largest class");
+
+size_t BlockSize(size_t size_class) {
+  return size_t(1) << (kMinBlockShift + size_class);
+}
+
+size_t SizeClassOf(size_t block_size) {
+  if (block_size <= BlockSize(0)) {
+    return 0;
+  }
+  const size_t bits =
+    64 - static_cast<size_t>(
+      __builtin_clzll(static_cast<unsigned long long>(block_size - 1)));
+  return bits - kMinBlockShift;
+}
+
+// Counters have one writer, the owner, so they need no atomic increments.
+void Bump(std::atomic<uint64_t>* counter, uint64_t n = 1) {
+  counter->store(counter->load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+}
+
+/**
+ * The pool of one thread. Only remote_ and the counters are accessed by
+ * other threads.
+ */
+class ThreadCache {
+ public:
+  ThreadCache() : orphaned_(false), remote_(nullptr) {
+    for (size_t i = 0; i < kNumClasses; ++i) {
+      free_[i] = nullptr;
+      free_count_[i] = 0;
+    }
+    allocations_ = 0;
+    heap_allocations_ = 0;
+    remote_frees_ = 0;
+  }
+
+  Header* Allocate(size_t size_class) {
+    Bump(&allocations_);
+    if (!free_[size_class] &&
+        remote_.load(std::memory_order_relaxed) != nullptr) {
+      TakeRemote();
+    }
+    Header* header = free_[size_class];
+    if (header) {
+      free_[size_class] = header->next;
+      --free_count_[size_class];
+    } else {
+      Bump(&heap_allocations_);
+      header = static_cast<Header*>(::operator new(BlockSize(size_class)));
+      header->size_class = size_class;
+    }
+    header->owner = this;
+    return header;
+  }
+
+  Header* AllocateHuge(size_t size) {
+    Bump(&allocations_);
+    Bump(&heap_allocations_);
+    Header* header =
+      static_cast<Header*>(::operator new(sizeof(Header) + size));
+    header->owner = nullptr;
+    header->size_class = kHugeClass;
+    return header;
+  }
+
+  /** Frees a block of this pool on the owning thread. */
+  void Free(Header* header) {
+    const size_t size_class = header->size_class;
+    if (free_count_[size_class] * BlockSize(size_class) >= kMaxCachedBytes) {
+      ::operator delete(header);
+      return;
+    }
+    header->next = free_[size_class];
+    free_[size_class] = header;
+    ++free_count_[size_class];
+  }
+
+  /** Frees a block of this pool on any other thread. */
+  void FreeRemote(Header* header) {
+    Header* head = remote_.load(std::memory_order_relaxed);
+    do {
+      header->next = head;
+    } while (!remote_.compare_exchange_weak(head,
+                                            header,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+
+  /** Returns all free blocks to the heap. */
+  void Release() {
+    TakeRemote();
+    for (size_t i = 0; i < kNumClasses; ++i) {
+      while (Header* header = free_[i]) {
+        free_[i] = header->next;
+        ::operator delete(header);
+      }
+      free_count_[i] = 0;
+    }
+  }
+
+  void AddStats(BlockPoolStats* stats) const {
+    stats->allocations += allocations_.load(std::memory_order_relaxed);
+    stats->heap_allocations +=
+      heap_allocations_.load(std::memory_order_relaxed);
+    stats->remote_frees += remote_frees_.load(std::memory_order_relaxed);
+  }
+
+  bool orphaned_;  // No thread owns the pool, guarded by the registry mutex
+
+ private:
+  /** Moves blocks freed by other threads to the free lists. */
+  void TakeRemote() {
+    Header* header = remote_.exchange(nullptr, std::memory_order_acquire);
+    uint64_t count = 0;
+    while (header) {
+      Header* next = header->next;
+      Free(header);
+      header = next;
+      ++count;
+    }
+    Bump(&remote_frees_, count);
+  }
+
+  Header* free_[kNumClasses];
+  size_t free_count_[kNumClasses];
+  std::atomic<Header*> remote_;
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> heap_allocations_;
+  std::atomic<uint64_t> remote_frees_;
+};
+
+/**
+ * All pools ever created. Pools are never deleted, since blocks may outlive
+ * the thread that allocated them; the pool of an exited thread is handed to
+ * the next new thread instead.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadCache*> caches;
+};
+
+Registry& GetRegistry() {
+  // Leaked, so that blocks can be freed during static destruction.
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+#if !defined(OS_MACOSX)
+// Caches the pool of this thread to avoid a ThreadLocalPtr lookup.
+__thread ThreadCache* tls_cache_ = nullptr;
+#endif
+
+void OrphanThreadCache(void* ptr) {
+  ThreadCache* cache = static_cast<ThreadCache*>(ptr);
+#if !defined(OS_MACOSX)
+  tls_cache_ = nullptr;
+#endif
+  cache->Release();
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  cache->orphaned_ = true;
+}
+
+ThreadLocalPtr& CacheOwner() {
+  static ThreadLocalPtr* owner = new ThreadLocalPtr(&OrphanThreadCache);
+  return *owner;
+}
+
+// Returns the pool of this thread, or null if it has none.
+ThreadCache* CurrentCache() {
+#if !defined(OS_MACOSX)
+  return tls_cache_;
+#else
+  return static_cast<ThreadCache*>(CacheOwner().Get());
+#endif
+}
+
+// Returns the pool of this thread, adopting or creating one if needed.
+ThreadCache* GetThreadCache() {
+  ThreadCache* cache = CurrentCache();
+  if (cache) {
+    return cache;
+  }
+  {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (ThreadCache* orphan : registry.caches) {
+      if (orphan->orphaned_) {
+        orphan->orphaned_ = false;
+        cache = orphan;
+        break;
+      }
+    }
+    if (!cache) {
+      cache = new ThreadCache();
+      registry.caches.push_back(cache);
+    }
+  }
+  CacheOwner().Reset(cache);
+#if !defined(OS_MACOSX)
+  tls_cache_ = cache;
+#endif
+  return cache;
+}
+
+}  // namespace
+
+constexpr size_t BlockPool::kMaxPooledSize;
+
+void* BlockPool::Allocate(size_t size) {
+  ThreadCache* cache = GetThreadCache();
+  Header* header = size <= kMaxPooledSize ?
+    cache->Allocate(SizeClassOf(sizeof(Header) + size)) :
+    cache->AllocateHuge(size);
+  return header + 1;
+}
+
+void BlockPool::Free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  Header* header = static_cast<Header*>(ptr) - 1;
+  if (header->size_class == kHugeClass) {
+    ::operator delete(header);
+  } else if (header->owner == CurrentCache()) {
+    header->owner->Free(header);
+  } else {
+    header->owner->FreeRemote(header);
+  }
+}
+
+BlockPoolStats BlockPool::GetStats() {
+  BlockPoolStats stats;
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (ThreadCache* cache : registry.caches) {
+    cache->AddStats(&stats);
+  }
+  return stats;
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,100 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace rocketspeed {
+
+/**
+ * Counters of a BlockPool, summed over all threads.
+ */
+struct BlockPoolStats {
+  uint64_t allocations = 0;       // Calls to BlockPool::Allocate
+  uint64_t heap_allocations = 0;  // Allocations that went to the heap
+  uint64_t remote_frees = 0;      // Blocks returned by other threads
+};
+
+/**
+ * Per-thread pools of memory blocks, for objects that are allocated and
+ * freed at a high rate, such as messages and their receive buffers.
+ *
+ * Like PooledObjectList, each thread keeps free lists that are refilled from
+ * the heap when empty, but blocks are untyped, in power of two size classes,
+ * and may be freed on any thread. Every block remembers the pool of the
+ * thread that allocated it, and goes back there:
+ *   - a block freed by its own thread goes on that thread's free list,
+ *     with no synchronization,
+ *   - a block freed by another thread is pushed on a lock-free stack of the
+ *     origin pool, which the origin thread takes over when its free list of
+ *     that size runs out.
+ *
+ * Free lists are capped, so a thread keeps at most a few hundred KB, and
+ * the surplus goes back to the heap. When a thread exits its pool is kept
+ * for the next new thread, since blocks from it may still be in use.
+ * Requests larger than the biggest size class go straight to the heap.
+ *
+ * Thread safe.
+ */
+class BlockPool {
+ public:
+  /** Largest request served from the free lists. */
+  static constexpr size_t kMaxPooledSize = 16 * 1024 - 16;
+
+  /**
+   * Allocates a block of at least size bytes from the pool of the calling
+   * thread. The block is aligned as memory from operator new.
+   */
+  static void* Allocate(size_t size);
+
+  /**
+   * Returns a block from Allocate to the pool it was allocated from.
+   *
+   * @param ptr The block, may be null.
+   */
+  static void Free(void* ptr);
+
+  /**
+   * Counters summed over all threads. Takes a lock, so not for hot paths.
+   */
+  static BlockPoolStats GetStats();
+};
+
+/**
+ * Deleter for character buffers that may come from BlockPool or new[].
+ */
+struct PooledBufferDeleter {
+  PooledBufferDeleter() : pooled(false) {}
+  explicit PooledBufferDeleter(bool _pooled) : pooled(_pooled) {}
+
+  void operator()(char* ptr) const {
+    if (pooled) {
+      BlockPool::Free(ptr);
+    } else {
+      delete[] ptr;
+    }
+  }
+
+  bool pooled;  // ptr is from BlockPool, not new[]
+};
+
+/**
+ * An owned character buffer. Buffers from new[] can be adopted too:
+ * PooledBuffer(std::unique_ptr<char[]>(...).release()).
+ */
+typedef std::unique_ptr<char[], PooledBufferDeleter> PooledBuffer;
+
+/**
+ * Allocates a character buffer of size bytes from the calling thread's pool.
+ */
+inline PooledBuffer AllocatePooledBuffer(size_t size) {
+  return PooledBuffer(static_cast<char*>(BlockPool::Allocate(size)),
+                      PooledBufferDeleter(true));
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,139 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "src/util/common/simulated_clock.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ROCKETSPEED_HAVE_TSC 1
+#endif
+
+namespace rocketspeed {
+
+/**
+ * Monotonic clock that is read once per batch of work and served from a
+ * cache in between. Intended for code that runs on a single thread, e.g. an
+ * EventLoop, which refreshes the clock before each callback so that all
+ * messages processed in the callback see the same timestamp.
+ *
+ * Optionally, FineNow can extrapolate the time since the last refresh from
+ * the CPU timestamp counter, which avoids a clock_gettime call when accurate
+ * time is needed. The counter rate is calibrated against the clock on
+ * refresh.
+ *
+ * If a SimulatedClock is provided, time is read from it instead, and FineNow
+ * is always the simulated time.
+ *
+ * Not thread safe.
+ */
+class CachedClock {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @param use_tsc Use the CPU timestamp counter for FineNow, if available.
+   * @param source Simulated clock to read instead of the steady clock, or
+   *               null. Must outlive this object.
+   */
+  explicit CachedClock(bool use_tsc = false,
+                       const SimulatedClock* source = nullptr)
+  : use_tsc_(use_tsc && !source)
+  , source_(source)
+  , now_(source ? source->Now() : Clock::now())
+  , now_ticks_(ReadTicks())
+  , calibration_time_(now_)
+  , calibration_ticks_(now_ticks_)
+  , ticks_per_micro_(0.0) {
+  }
+
+  /** Reads the clock and caches the result. */
+  Clock::time_point Refresh() {
+    now_ = source_ ? source_->Now() : Clock::now();
+    now_ticks_ = ReadTicks();
+    if (use_tsc_) {
+      Calibrate();
+    }
+    return now_;
+  }
+
+  /** @return Time of the last Refresh. */
+  Clock::time_point Now() const {
+    return now_;
+  }
+
+  /** @return Time of the last Refresh in microseconds since clock epoch. */
+  uint64_t NowMicros() const {
+    return ToMicros(now_);
+  }
+
+  /**
+   * Current time, without updating the cached time. Uses the timestamp
+   * counter if enabled and calibrated, otherwise reads the clock.
+   */
+  Clock::time_point FineNow() const {
+    if (source_) {
+      return source_->Now();
+    }
+    if (ticks_per_micro_ > 0.0) {
+      const double micros =
+        static_cast<double>(ReadTicks() - now_ticks_) / ticks_per_micro_;
+      if (micros < static_cast<double>(kMaxExtrapolationMicros)) {
+        return now_ + std::chrono::microseconds(static_cast<uint64_t>(micros));
+      }
+    }
+    return Clock::now();
+  }
+
+  /** @return FineNow in microseconds since clock epoch. */
+  uint64_t FineNowMicros() const {
+    return ToMicros(FineNow());
+  }
+
+  static uint64_t ToMicros(Clock::time_point time) {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+        time.time_since_epoch()).count());
+  }
+
+ private:
+  // Refreshes closer than this are not used for calibration.
+  static constexpr uint64_t kMinCalibrationMicros = 10000;
+  // Beyond this, drift makes extrapolation worse than a clock read.
+  static constexpr uint64_t kMaxExtrapolationMicros = 100000;
+
+  static uint64_t ReadTicks() {
+#ifdef ROCKETSPEED_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  void Calibrate() {
+    uint64_t micros = ToMicros(now_) - ToMicros(calibration_time_);
+    if (micros >= kMinCalibrationMicros && now_ticks_ > calibration_ticks_) {
+      ticks_per_micro_ =
+        static_cast<double>(now_ticks_ - calibration_ticks_) /
+        static_cast<double>(micros);
+      calibration_time_ = now_;
+      calibration_ticks_ = now_ticks_;
+    }
+  }
+
+  const bool use_tsc_;
+  const SimulatedClock* const source_;
+  Clock::time_point now_;
+  uint64_t now_ticks_;
+  Clock::time_point calibration_time_;
+  uint64_t calibration_ticks_;
+  double ticks_per_micro_;  // 0 until calibrated.
+};
+
+}  // namespace rocketspeed
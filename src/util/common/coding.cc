@@ -5,8 +5,13 @@
 //
 #include "coding.h"
 
+#include <string.h>
 #include <algorithm>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "include/Slice.h"
 
 namespace rocketspeed {
@@ -39,8 +44,173 @@ char* EncodeVarint32(char* dst, uint32_t v) {
   return reinterpret_cast<char*>(ptr);
 }
 
+namespace {
+
+// Continuation bits of 8 bytes in a little endian word.
+const uint64_t kContinuationBits = 0x8080808080808080ULL;
+
+/**
+ * Packs the 7 bit groups of up to 8 varint bytes, loaded as a little endian
+ * word, into an integer. Three rounds of masks and shifts do what a parallel
+ * bit extract would do in one, without a branch per byte.
+ */
+inline uint64_t PackVarintWord(uint64_t word) {
+  word &= ~kContinuationBits;
+  word = (word & 0x007f007f007f007fULL) |
+         ((word & 0x7f007f007f007f00ULL) >> 1);
+  word = (word & 0x00003fff00003fffULL) |
+         ((word & 0x3fff00003fff0000ULL) >> 2);
+  word = (word & 0x000000000fffffffULL) |
+         ((word & 0x0fffffff00000000ULL) >> 4);
+  return word;
+}
+
+/**
+ * Splits the word at the first byte without a continuation bit.
+ *
+ * @param stops Continuation bits of the word that are clear, non-zero.
+ * @param word Bytes after the first terminator are dropped.
+ * @return Length of the first varint in the word.
+ */
+inline size_t FirstVarintInWord(uint64_t stops, uint64_t* word) {
+  *word &= stops ^ (stops - 1);
+  return (static_cast<size_t>(__builtin_ctzll(stops)) >> 3) + 1;
+}
+
+/**
+ * Encodes a varint of up to 8 bytes with a single unaligned store, the
+ * inverse of PackVarintWord.
+ *
+ * REQUIRES: v < 2^56, 8 writable bytes at dst, little endian platform.
+ */
+inline char* EncodeVarintWord(char* dst, uint64_t v) {
+  const size_t len = static_cast<size_t>(VarintLength(v));
+  uint64_t word = v;
+  word = (word & 0x000000000fffffffULL) |
+         ((word & 0x00fffffff0000000ULL) << 4);
+  word = (word & 0x00003fff00003fffULL) |
+         ((word & 0x0fffc0000fffc000ULL) << 2);
+  word = (word & 0x007f007f007f007fULL) |
+         ((word & 0x3f803f803f803f80ULL) << 1);
+  // Continuation bits on all bytes but the last.
+  word |= 0x8080808080808080ULL & ((1ULL << (8 * (len - 1))) - 1);
+  memcpy(dst, &word, sizeof(word));
+  return dst + len;
+}
+
+const char* GetVarintPtr(const char* p, const char* limit, uint32_t* value) {
+  return GetVarint32Ptr(p, limit, value);
+}
+
+const char* GetVarintPtr(const char* p, const char* limit, uint64_t* value) {
+  return GetVarint64Ptr(p, limit, value);
+}
+
+#ifdef __SSE2__
+/** Zero extends 16 bytes into 16 integers. */
+void WidenBytes(__m128i bytes, uint32_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+  const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+  __m128i* dst = reinterpret_cast<__m128i*>(out);
+  _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+  _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+  _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+  _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+}
+
+void WidenBytes(__m128i bytes, uint64_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t words[16];
+  WidenBytes(bytes, words);
+  __m128i* dst = reinterpret_cast<__m128i*>(out);
+  for (int i = 0; i < 4; ++i) {
+    const __m128i four =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(words) + i);
+    _mm_storeu_si128(dst + 2 * i, _mm_unpacklo_epi32(four, zero));
+    _mm_storeu_si128(dst + 2 * i + 1, _mm_unpackhi_epi32(four, zero));
+  }
+}
+#endif
+
+template <typename T>
+const char* GetVarintArrayPtr(const char* p, const char* limit,
+                              T* values, size_t count) {
+  size_t i = 0;
+  while (i < count) {
+#ifdef __SSE2__
+    // Only worth probing when the next varint is a single byte, otherwise
+    // mostly multi-byte input would pay for a wasted load every value.
+    if (count - i >= 16 && limit - p >= 16 && !(*p & 0x80)) {
+      const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const unsigned int mask =
+        static_cast<unsigned int>(_mm_movemask_epi8(bytes));
+      if (mask == 0) {
+        // Sixteen single byte varints.
+        WidenBytes(bytes, values + i);
+        i += 16;
+        p += 16;
+        continue;
+      }
+      // Bytes before the first continuation bit are single byte varints.
+      const size_t singles = static_cast<size_t>(__builtin_ctz(mask));
+      for (size_t j = 0; j < singles; ++j) {
+        values[i + j] = static_cast<unsigned char>(p[j]);
+      }
+      i += singles;
+      p += singles;
+    }
+#endif
+    p = GetVarintPtr(p, limit, &values[i]);
+    if (p == nullptr) {
+      return nullptr;
+    }
+    ++i;
+  }
+  return p;
+}
+
+template <typename T>
+void PutVarintArray(std::string* dst, const T* values, size_t count) {
+  // Encode in chunks on the stack, with slack for whole word stores, rather
+  // than zero filling the worst case length in dst.
+  const size_t kChunk = 32;
+  char buffer[kChunk * kMaxVarint64Length + sizeof(uint64_t)];
+  for (size_t i = 0; i < count; i += kChunk) {
+    char* p = buffer;
+    const size_t end = std::min(count, i + kChunk);
+    for (size_t j = i; j < end; ++j) {
+      const uint64_t v = values[j];
+      if (port::kLittleEndian && v < (1ULL << 56)) {
+        p = EncodeVarintWord(p, v);
+      } else {
+        p = EncodeVarint64(p, v);
+      }
+    }
+    dst->append(buffer, static_cast<size_t>(p - buffer));
+  }
+}
+
+}  // namespace
+
 const char* GetVarint32PtrFallback(const char* p, const char* limit,
                                    uint32_t* value) {
+  if (port::kLittleEndian && limit - p >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    const uint64_t stops = ~word & kContinuationBits;
+    if (stops == 0) {
+      return nullptr;
+    }
+    const size_t length = FirstVarintInWord(stops, &word);
+    if (length > kMaxVarint32Length) {
+      return nullptr;
+    }
+    // Bits past 32 of a 5 byte varint are dropped, as below.
+    *value = static_cast<uint32_t>(PackVarintWord(word));
+    return p + length;
+  }
   uint32_t result = 0;
   for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7) {
     uint32_t byte = *(reinterpret_cast<const unsigned char*>(p));
@@ -57,9 +227,25 @@ const char* GetVarint32PtrFallback(const char* p, const char* limit,
   return nullptr;
 }
 
-const char* GetVarint64Ptr(const char* p, const char* limit, uint64_t* value) {
+const char* GetVarint64PtrFallback(const char* p, const char* limit,
+                                   uint64_t* value) {
   uint64_t result = 0;
-  for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7) {
+  uint32_t shift = 0;
+  if (port::kLittleEndian && limit - p >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    const uint64_t stops = ~word & kContinuationBits;
+    if (stops != 0) {
+      const size_t length = FirstVarintInWord(stops, &word);
+      *value = PackVarintWord(word);
+      return p + length;
+    }
+    // Longer than 8 bytes, only for values of 2^56 and above.
+    result = PackVarintWord(word);
+    shift = 56;
+    p += 8;
+  }
+  for (; shift <= 63 && p < limit; shift += 7) {
     uint64_t byte = *(reinterpret_cast<const unsigned char*>(p));
     p++;
     if (byte & 128) {
@@ -74,6 +260,44 @@ const char* GetVarint64Ptr(const char* p, const char* limit, uint64_t* value) {
   return nullptr;
 }
 
+const char* GetVarint32ArrayPtr(const char* p, const char* limit,
+                                uint32_t* values, size_t count) {
+  return GetVarintArrayPtr(p, limit, values, count);
+}
+
+const char* GetVarint64ArrayPtr(const char* p, const char* limit,
+                                uint64_t* values, size_t count) {
+  return GetVarintArrayPtr(p, limit, values, count);
+}
+
+bool GetVarint32Array(Slice* input, uint32_t* values, size_t count) {
+  const char* limit = input->data() + input->size();
+  const char* p = GetVarint32ArrayPtr(input->data(), limit, values, count);
+  if (p == nullptr) {
+    return false;
+  }
+  *input = Slice(p, limit - p);
+  return true;
+}
+
+bool GetVarint64Array(Slice* input, uint64_t* values, size_t count) {
+  const char* limit = input->data() + input->size();
+  const char* p = GetVarint64ArrayPtr(input->data(), limit, values, count);
+  if (p == nullptr) {
+    return false;
+  }
+  *input = Slice(p, limit - p);
+  return true;
+}
+
+void PutVarint32Array(std::string* dst, const uint32_t* values, size_t count) {
+  PutVarintArray(dst, values, count);
+}
+
+void PutVarint64Array(std::string* dst, const uint64_t* values, size_t count) {
+  PutVarintArray(dst, values, count);
+}
+
 void BitStreamPutInt(char* dst, size_t dstlen, size_t offset,
                      uint32_t bits, uint64_t value) {
   assert((offset + bits + 7)/8 <= dstlen);
@@ -58,6 +58,25 @@ extern Slice GetSliceUntil(Slice* slice, char delimiter);
 extern const char* GetVarint32Ptr(const char* p,const char* limit, uint32_t* v);
 extern const char* GetVarint64Ptr(const char* p,const char* limit, uint64_t* v);
 
+// Bulk variants of GetVarint... that parse count consecutive varints into
+// values[0..count-1]. The Slice variants advance the input past them, and
+// leave it unchanged on error. Runs of single byte varints are decoded
+// sixteen at a time where SSE2 is available.
+extern bool GetVarint32Array(Slice* input, uint32_t* values, size_t count);
+extern bool GetVarint64Array(Slice* input, uint64_t* values, size_t count);
+extern const char* GetVarint32ArrayPtr(const char* p, const char* limit,
+                                       uint32_t* values, size_t count);
+extern const char* GetVarint64ArrayPtr(const char* p, const char* limit,
+                                       uint64_t* values, size_t count);
+
+// Appends count varints from values[0..count-1]
+extern void PutVarint32Array(std::string* dst,
+                             const uint32_t* values,
+                             size_t count);
+extern void PutVarint64Array(std::string* dst,
+                             const uint64_t* values,
+                             size_t count);
+
 // Returns the length of the varint32 or varint64 encoding of "v"
 extern int VarintLength(uint64_t v);
 
@@ -115,10 +134,14 @@ inline uint64_t DecodeFixed64(const char* ptr) {
   }
 }
 
-// Internal routine for use by fallback path of GetVarint32Ptr
+// Internal routines for use by fallback path of GetVarint32Ptr and
+// GetVarint64Ptr
 extern const char* GetVarint32PtrFallback(const char* p,
                                           const char* limit,
                                           uint32_t* value);
+extern const char* GetVarint64PtrFallback(const char* p,
+                                          const char* limit,
+                                          uint64_t* value);
 inline const char* GetVarint32Ptr(const char* p,
                                   const char* limit,
                                   uint32_t* value) {
@@ -132,6 +155,19 @@ inline const char* GetVarint32Ptr(const char* p,
   return GetVarint32PtrFallback(p, limit, value);
 }
 
+inline const char* GetVarint64Ptr(const char* p,
+                                  const char* limit,
+                                  uint64_t* value) {
+  if (p < limit) {
+    uint64_t result = *(reinterpret_cast<const unsigned char*>(p));
+    if ((result & 128) == 0) {
+      *value = result;
+      return p + 1;
+    }
+  }
+  return GetVarint64PtrFallback(p, limit, value);
+}
+
 // Writes an unsigned integer with bits number of bits with its least
 // significant bit at offset.
 // Bits are numbered from 0 to 7 in the first byte, 8 to 15 in the second and
@@ -257,12 +293,9 @@ inline void PutLengthPrefixedSliceParts(std::string* dst,
 }
 
 inline int VarintLength(uint64_t v) {
-  int len = 1;
-  while (v >= 128) {
-    v >>= 7;
-    len++;
-  }
-  return len;
+  // One byte per started group of 7 significant bits, and one byte for 0.
+  const int bits = 64 - __builtin_clzll(v | 1);
+  return (bits + 6) / 7;
 }
 
 inline bool GetFixed8(Slice* input, uint8_t* value) {
@@ -0,0 +1,126 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/common/compression.h"
+
+#include <memory>
+
+#include "src/port/port.h"
+
+namespace rocketspeed {
+
+Status ParseCompressionType(const std::string& str, CompressionType* type) {
+  if (str == "none") {
+    *type = CompressionType::kNone;
+  } else if (str == "snappy") {
+    *type = CompressionType::kSnappy;
+  } else if (str == "lz4") {
+    *type = CompressionType::kLZ4;
+  } else if (str == "zlib") {
+    *type = CompressionType::kZlib;
+  } else {
+    return Status::InvalidArgument("Invalid compression type: " + str);
+  }
+  return Status::OK();
+}
+
+bool IsCompressionSupported(CompressionType type) {
+  switch (type) {
+    case CompressionType::kNone:
+      return true;
+    case CompressionType::kSnappy:
+#ifdef SNAPPY
+      return true;
+#else
+      return false;
+#endif
+    case CompressionType::kLZ4:
+#ifdef LZ4
+      return true;
+#else
+      return false;
+#endif
+    case CompressionType::kZlib:
+#ifdef ZLIB
+      return true;
+#else
+      return false;
+#endif
+  }
+  // Codec of a newer client.
+  return false;
+}
+
+CompressionType CompressPayload(CompressionType type,
+                                Slice payload,
+                                std::string* out) {
+  const port::CompressionOptions options;
+  bool compressed = false;
+  switch (type) {
+    case CompressionType::kNone:
+      break;
+    case CompressionType::kSnappy:
+      compressed = port::Snappy_Compress(
+        options, payload.data(), payload.size(), out);
+      break;
+    case CompressionType::kLZ4:
+      compressed = port::LZ4_Compress(
+        options, payload.data(), payload.size(), out);
+      break;
+    case CompressionType::kZlib:
+      compressed = port::Zlib_Compress(
+        options, payload.data(), payload.size(), out);
+      break;
+  }
+  if (!compressed || out->size() >= payload.size()) {
+    out->clear();
+    return CompressionType::kNone;
+  }
+  return type;
+}
+
+Status UncompressPayload(CompressionType type,
+                         Slice payload,
+                         std::string* out) {
+  if (!IsCompressionSupported(type)) {
+    return Status::NotSupported("Payload compressed with unsupported codec " +
+                                std::to_string(static_cast<int>(type)));
+  }
+  switch (type) {
+    case CompressionType::kNone:
+      out->assign(payload.data(), payload.size());
+      return Status::OK();
+    case CompressionType::kSnappy: {
+      size_t size;
+      if (port::Snappy_GetUncompressedLength(
+            payload.data(), payload.size(), &size)) {
+        out->resize(size);
+        if (port::Snappy_Uncompress(payload.data(), payload.size(),
+                                    &(*out)[0])) {
+          return Status::OK();
+        }
+      }
+      break;
+    }
+    case CompressionType::kLZ4:
+    case CompressionType::kZlib: {
+      // Both return buffers allocated with new[].
+      int size = 0;
+      std::unique_ptr<char[]> buffer(
+        type == CompressionType::kLZ4 ?
+          port::LZ4_Uncompress(payload.data(), payload.size(), &size) :
+          port::Zlib_Uncompress(payload.data(), payload.size(), &size));
+      if (buffer) {
+        out->assign(buffer.get(), static_cast<size_t>(size));
+        return Status::OK();
+      }
+      break;
+    }
+  }
+  out->clear();
+  return Status::InvalidArgument("Corrupt compressed payload");
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,54 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <string>
+
+#include "include/Slice.h"
+#include "include/Status.h"
+#include "include/Types.h"
+
+namespace rocketspeed {
+
+/**
+ * Parses "none", "snappy", "lz4" or "zlib".
+ */
+Status ParseCompressionType(const std::string& str, CompressionType* type);
+
+/**
+ * @return true iff the codec was built in, so that payloads can be
+ *         compressed and uncompressed with it.
+ */
+bool IsCompressionSupported(CompressionType type);
+
+/**
+ * Compresses a message payload.
+ *
+ * @param type Codec to compress with.
+ * @param payload Payload to compress.
+ * @param out Receives the compressed payload.
+ * @return The codec the payload was compressed with, which is
+ *         CompressionType::kNone if the codec was not built in or would not
+ *         make the payload smaller. The payload should then be sent as is.
+ */
+CompressionType CompressPayload(CompressionType type,
+                                Slice payload,
+                                std::string* out);
+
+/**
+ * Uncompresses a message payload.
+ *
+ * @param type Codec the payload was compressed with.
+ * @param payload Compressed payload.
+ * @param out Receives the uncompressed payload.
+ * @return NotSupported if the codec was not built in, InvalidArgument if the
+ *         payload is corrupt.
+ */
+Status UncompressPayload(CompressionType type,
+                         Slice payload,
+                         std::string* out);
+
+}  // namespace rocketspeed
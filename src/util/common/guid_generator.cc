@@ -5,8 +5,9 @@
 //
 #include "guid_generator.h"
 
-#include <array>
-#include <algorithm>
+#include <pthread.h>
+#include <mutex>
+#include <random>
 
 #include "src/util/common/coding.h"
 #include "src/util/common/thread_local.h"
@@ -17,10 +18,15 @@ void free_thread_local(void* ptr) {
     static_cast<rocketspeed::GUIDGenerator *>(ptr);
   delete guid;
 }
-// A thread-local pointer that caches a thread-specific generator
+// A thread-local pointer that owns the thread-specific generators
 rocketspeed::ThreadLocalPtr tgenerator_ =
     rocketspeed::ThreadLocalPtr(free_thread_local);
 
+#if !defined(OS_MACOSX)
+// Caches the generator of this thread to avoid a ThreadLocalPtr lookup.
+__thread rocketspeed::GUIDGenerator* tls_generator_ = nullptr;
+#endif
+
 // Returns the generator for this thread
 void* get_thread_generator() {
   void* ptr = static_cast<void *>(tgenerator_.Get());
@@ -30,41 +36,55 @@ void* get_thread_generator() {
   }
   return ptr;
 }
+
+std::once_flag register_fork_handler_;
 }
 
 namespace rocketspeed {
 
+std::atomic<uint32_t> GUIDGenerator::fork_generation(0);
+
 GUIDGenerator::GUIDGenerator() {
-  static_assert(std::is_same<decltype(rng_()), uint64_t>::value,
-    "std::mt19937_64 must return uint64_t");
-  assert(rng_.min() == 0 &&
-         rng_.max() == static_cast<uint64_t>(0) - static_cast<uint64_t>(1));
+  std::call_once(register_fork_handler_, [] () {
+    pthread_atfork(nullptr, nullptr, [] () {
+      fork_generation.fetch_add(1, std::memory_order_relaxed);
+    });
+  });
+  Seed();
+}
 
-  // 2 = 64 bits / 32 bits; state_size is in 64-bit words
-  std::array<int, 2 * std::mt19937_64::state_size> seed_data;
+void GUIDGenerator::Seed() {
   std::random_device r;
-  std::generate(seed_data.begin(), seed_data.end(), std::ref(r));
-  std::seed_seq seq(seed_data.begin(), seed_data.end());
-  rng_.seed(seq);
+  auto next = [&r] () {
+    return (static_cast<uint64_t>(r()) << 32) | static_cast<uint64_t>(r());
+  };
+  fork_generation_ = fork_generation.load(std::memory_order_relaxed);
+  prefix_ = next();
+  counter_ = next();
 }
 
-GUID GUIDGenerator::Generate() {
-  GUID guid;
-  guid.hi = rng_();
-  guid.lo = rng_();
-  return guid;
+void GUIDGenerator::Generate(char* buf) {
+  GUID guid = Generate();
+  EncodeFixed64(buf, guid.hi);
+  EncodeFixed64(buf + 8, guid.lo);
 }
 
 // generates a 16 byte guid string
 std::string GUIDGenerator::GenerateString() {
-  std::string buf;
-  PutFixed64(&buf, rng_());
-  PutFixed64(&buf, rng_());
-  return buf;
+  char buf[16];
+  Generate(buf);
+  return std::string(buf, sizeof(buf));
 }
 
 // Returns a thread-safe GUID Generator
 GUIDGenerator* GUIDGenerator::ThreadLocalGUIDGenerator() {
+#if !defined(OS_MACOSX)
+  if (!tls_generator_) {
+    tls_generator_ = static_cast<GUIDGenerator *>(get_thread_generator());
+  }
+  return tls_generator_;
+#else
   return static_cast<GUIDGenerator *>(get_thread_generator());
+#endif
 }
 }
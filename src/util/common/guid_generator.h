@@ -5,25 +5,65 @@
 
 #pragma once
 
-#include <random>
+#include <atomic>
+#include <string>
 
 #include "include/Types.h"
 
 namespace rocketspeed {
 
-// Generates random GUIDs.
+// Generates unique GUIDs.
+//
+// Each generator draws a random 64-bit prefix, which becomes the hi half of
+// every GUID it produces, and a random starting point for a 64-bit counter.
+// The lo half is the counter passed through a bijective mix, so GUIDs from
+// one generator never repeat (for 2^64 calls) and still look random.
+// GUIDs from different generators, threads, processes or restarts differ
+// unless two random prefixes collide.
+//
+// A generator reseeds itself on first use after fork(), so the parent and
+// the child never produce the same GUIDs.
 class GUIDGenerator {
  public:
   GUIDGenerator();
 
-  GUID Generate();
+  GUID Generate() {
+    if (fork_generation_ != fork_generation.load(std::memory_order_relaxed)) {
+      Seed();
+    }
+    GUID guid;
+    guid.hi = prefix_;
+    guid.lo = Mix(counter_++);
+    return guid;
+  }
+
+  // Writes a 16 byte GUID into buf, without allocating.
+  void Generate(char* buf);
 
   std::string GenerateString();
 
-  // Returns a thread-safe GUIDGenerator
+  // Returns a generator owned by the calling thread.
   static GUIDGenerator* ThreadLocalGUIDGenerator();
+
  private:
-  std::mt19937_64 rng_;
+  // Bijection on 64-bit integers (MurmurHash3 finalizer).
+  static uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  void Seed();
+
+  // Incremented in the child process after every fork().
+  static std::atomic<uint32_t> fork_generation;
+
+  uint64_t prefix_;
+  uint64_t counter_;
+  uint32_t fork_generation_;
 };
 
 }
@@ -16,12 +16,20 @@
 #include "src/util/common/parsing.h"
 
 #include <netdb.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 
 namespace rocketspeed {
 
+const char* const HostId::kUnixPrefix = "unix:";
+
 Status HostId::Resolve(const std::string& str, HostId* out) {
+  const size_t prefix_size = strlen(kUnixPrefix);
+  if (str.compare(0, prefix_size, kUnixPrefix) == 0) {
+    return CreateFromPath(str.substr(prefix_size), out);
+  }
   auto host_and_port = SplitString(str, ':');
   if (host_and_port.size() != 2) {
     return Status::InvalidArgument("Malformed or missing port");
@@ -68,6 +76,22 @@ HostId HostId::CreateLocal(uint16_t port, std::string description) {
   return HostId(addr, addrlen, std::move(description));
 }
 
+Status HostId::CreateFromPath(const std::string& path, HostId* out) {
+  sockaddr_un unix_addr;
+  memset(&unix_addr, 0, sizeof(unix_addr));
+  if (path.empty() || path.size() >= sizeof(unix_addr.sun_path)) {
+    return Status::InvalidArgument("Invalid Unix socket path: " + path);
+  }
+  unix_addr.sun_family = AF_UNIX;
+  memcpy(unix_addr.sun_path, path.data(), path.size());
+
+  const sockaddr* addr = reinterpret_cast<sockaddr*>(&unix_addr);
+  socklen_t addrlen =
+    static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+  *out = HostId(addr, addrlen, kUnixPrefix + path);
+  return Status::OK();
+}
+
 HostId::HostId() : addrlen_(0) {
   memset(&storage_, 0, sizeof(storage_));
 }
@@ -22,7 +22,7 @@ class HostId {
  public:
   /**
    * Resolves host address and port from provided host:port string, performs DNS
-   * resolution if necessary.
+   * resolution if necessary. A unix:path string is a Unix domain socket.
    */
   static Status Resolve(const std::string& host_and_port, HostId* out);
 
@@ -36,6 +36,19 @@ class HostId {
 
   static HostId CreateLocal(uint16_t port, std::string description = "");
 
+  /**
+   * Creates an address of a Unix domain socket, for talking to processes on
+   * the same host without going through TCP.
+   *
+   * @param path Path of the socket.
+   * @param out Output for the address, described as unix:path.
+   * @return InvalidArgument if the path is empty or too long.
+   */
+  static Status CreateFromPath(const std::string& path, HostId* out);
+
+  /** Prefix of Unix domain socket addresses, as accepted by Resolve. */
+  static const char* const kUnixPrefix;
+
   HostId();
 
   bool operator<(const HostId& rhs) const;
@@ -0,0 +1,181 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/common/huge_page_allocator.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+
+namespace rocketspeed {
+
+namespace {
+
+// Alignment of buffers carved from chunks, a cache line.
+const size_t kAlignment = 64;
+
+size_t RoundUp(size_t n, size_t multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// Whether madvise(MADV_HUGEPAGE) can give huge pages, which is not the case
+// when transparent huge pages are set to "never" or not built in.
+bool TransparentHugePagesEnabled() {
+  static const bool enabled = [] () {
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!file) {
+      return false;
+    }
+    char buf[128];
+    const bool read = fgets(buf, sizeof(buf), file) != nullptr;
+    fclose(file);
+    // The active setting is bracketed, e.g. "always [madvise] never".
+    return read && (strstr(buf, "[always]") || strstr(buf, "[madvise]"));
+  }();
+  return enabled;
+}
+
+}  // namespace
+
+constexpr size_t HugePageAllocator::kHugePageSize;
+constexpr size_t HugePageAllocator::kChunkSize;
+
+Status ParseHugePageMode(const std::string& str, HugePageMode* mode) {
+  if (str == "none") {
+    *mode = HugePageMode::kNone;
+  } else if (str == "transparent") {
+    *mode = HugePageMode::kTransparent;
+  } else if (str == "explicit") {
+    *mode = HugePageMode::kExplicit;
+  } else {
+    return Status::InvalidArgument("Invalid huge page mode: " + str);
+  }
+  return Status::OK();
+}
+
+HugePageAllocator::HugePageAllocator(HugePageMode mode)
+: mode_(mode)
+, chunk_next_(nullptr)
+, chunk_end_(nullptr) {
+}
+
+HugePageAllocator::~HugePageAllocator() {
+  for (const Mapping& mapping : mappings_) {
+    munmap(mapping.ptr, mapping.size);
+  }
+}
+
+HugePageAllocator* HugePageAllocator::Get(HugePageMode mode) {
+  // Leaked, so that buffers can be freed during static destruction.
+  static HugePageAllocator* allocators[] = {
+    new HugePageAllocator(HugePageMode::kNone),
+    new HugePageAllocator(HugePageMode::kTransparent),
+    new HugePageAllocator(HugePageMode::kExplicit),
+  };
+  return allocators[static_cast<int>(mode)];
+}
+
+void* HugePageAllocator::Allocate(size_t size) {
+  if (mode_ == HugePageMode::kNone) {
+    // Straight to the heap, without serialising allocations on our lock.
+    return ::operator new(size);
+  }
+
+  size = RoundUp(std::max<size_t>(size, 1), kAlignment);
+  std::lock_guard<std::mutex> lock(mutex_);
+  void* ptr = nullptr;
+  auto it = free_.find(size);
+  if (it != free_.end() && !it->second.empty()) {
+    ptr = it->second.back();
+    it->second.pop_back();
+  } else if (size >= kChunkSize) {
+    // Mapped on its own, so the current chunk is kept.
+    ptr = Map(RoundUp(size, kHugePageSize));
+  } else {
+    if (size > static_cast<size_t>(chunk_end_ - chunk_next_)) {
+      // The rest of the current chunk is left unused.
+      chunk_next_ = Map(kChunkSize);
+      chunk_end_ = chunk_next_ ? chunk_next_ + kChunkSize : nullptr;
+    }
+    ptr = chunk_next_;
+    if (ptr) {
+      chunk_next_ += size;
+    }
+  }
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  stats_.allocated_bytes += size;
+  return ptr;
+}
+
+void HugePageAllocator::Free(void* ptr, size_t size) {
+  if (mode_ == HugePageMode::kNone) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  if (!ptr) {
+    return;
+  }
+  size = RoundUp(std::max<size_t>(size, 1), kAlignment);
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.allocated_bytes -= size;
+  free_[size].push_back(ptr);
+}
+
+HugePageStats HugePageAllocator::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+char* HugePageAllocator::Map(size_t size) {
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+  if (mode_ == HugePageMode::kExplicit) {
+    void* ptr = mmap(nullptr, size, prot, flags | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      mappings_.push_back(Mapping{static_cast<char*>(ptr), size});
+      stats_.mapped_bytes += size;
+      stats_.huge_page_bytes += size;
+      return static_cast<char*>(ptr);
+    }
+    // Not enough huge pages reserved, try transparent huge pages.
+  }
+#endif
+
+  // Map an extra huge page and trim the ends, so that the mapping is aligned
+  // and the kernel can back all of it with huge pages.
+  const size_t padded = size + kHugePageSize;
+  void* base = mmap(nullptr, padded, prot, flags, -1, 0);
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+  char* begin = static_cast<char*>(base);
+  char* ptr = reinterpret_cast<char*>(
+    RoundUp(reinterpret_cast<uintptr_t>(begin), kHugePageSize));
+  if (ptr != begin) {
+    munmap(begin, static_cast<size_t>(ptr - begin));
+  }
+  const size_t tail = static_cast<size_t>(begin + padded - (ptr + size));
+  if (tail) {
+    munmap(ptr + size, tail);
+  }
+  mappings_.push_back(Mapping{ptr, size});
+  stats_.mapped_bytes += size;
+#ifdef MADV_HUGEPAGE
+  if (madvise(ptr, size, MADV_HUGEPAGE) == 0 &&
+      TransparentHugePagesEnabled()) {
+    stats_.huge_page_bytes += size;
+  }
+#endif
+  return ptr;
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,127 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/Status.h"
+
+namespace rocketspeed {
+
+/**
+ * Pages backing the memory of a HugePageAllocator.
+ */
+enum class HugePageMode {
+  /** Plain heap memory. */
+  kNone,
+  /** Mappings advised for transparent huge pages (madvise). */
+  kTransparent,
+  /** Huge pages reserved in hugetlbfs, else as kTransparent. */
+  kExplicit,
+};
+
+/**
+ * Parses "none", "transparent" or "explicit".
+ */
+Status ParseHugePageMode(const std::string& str, HugePageMode* mode);
+
+/**
+ * Counters of a HugePageAllocator.
+ */
+struct HugePageStats {
+  uint64_t mapped_bytes = 0;     // Memory mapped for buffers
+  uint64_t huge_page_bytes = 0;  // Part of mapped_bytes on huge pages
+  uint64_t allocated_bytes = 0;  // Buffers handed out and not yet freed
+};
+
+/**
+ * Allocator for large buffers that live as long as the component that owns
+ * them, such as command queue rings and cache entries. With gigabytes of
+ * such buffers on 4KB pages, TLB misses become measurable.
+ *
+ * Memory is mapped in chunks aligned to huge pages, and buffers are carved
+ * out of the current chunk. Freed buffers are kept for later allocations of
+ * the same size, and chunks are only unmapped with the allocator, so this
+ * suits buffers of a few sizes that come and go rarely.
+ *
+ * Huge pages are used when available: explicit mode falls back to
+ * transparent huge pages when none are reserved, and transparent mode to
+ * plain pages when they are disabled, so allocations never fail for want
+ * of huge pages. In HugePageMode::kNone buffers come straight from operator
+ * new, without locking, and are not counted in the stats.
+ *
+ * Thread safe.
+ */
+class HugePageAllocator {
+ public:
+  /** Size of a huge page, to which chunks are aligned. */
+  static constexpr size_t kHugePageSize = 2 << 20;
+
+  /** Size of chunks, larger buffers get a mapping of their own. */
+  static constexpr size_t kChunkSize = 8 << 20;
+
+  explicit HugePageAllocator(HugePageMode mode);
+
+  /** Unmaps all memory. Buffers must not be used afterwards. */
+  ~HugePageAllocator();
+
+  HugePageAllocator(const HugePageAllocator&) = delete;
+  HugePageAllocator& operator=(const HugePageAllocator&) = delete;
+
+  /**
+   * The process-wide allocator for a mode. Never destroyed, so its buffers
+   * may be freed at any time.
+   */
+  static HugePageAllocator* Get(HugePageMode mode);
+
+  /**
+   * Allocates a buffer, aligned at least as memory from operator new.
+   * Throws std::bad_alloc if out of memory.
+   *
+   * @param size Size of the buffer in bytes.
+   */
+  void* Allocate(size_t size);
+
+  /**
+   * Returns a buffer to the allocator.
+   *
+   * @param ptr A buffer from Allocate, may be null.
+   * @param size The size it was allocated with.
+   */
+  void Free(void* ptr, size_t size);
+
+  HugePageMode GetMode() const {
+    return mode_;
+  }
+
+  HugePageStats GetStats() const;
+
+ private:
+  /** Maps size bytes, a multiple of kHugePageSize. Returns null on error. */
+  char* Map(size_t size);
+
+  struct Mapping {
+    char* ptr;
+    size_t size;
+  };
+
+  const HugePageMode mode_;
+  mutable std::mutex mutex_;
+  std::vector<Mapping> mappings_;
+  // Freed buffers by size.
+  std::unordered_map<size_t, std::vector<void*>> free_;
+  // Unused part of the current chunk.
+  char* chunk_next_;
+  char* chunk_end_;
+  HugePageStats stats_;
+};
+
+}  // namespace rocketspeed
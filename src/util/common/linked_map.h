@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <utility>
 
+#include "src/util/common/memory_usage.h"
+
 namespace rocketspeed {
 
 // A hashmap that maintains a doubly-linked list running through all of its
@@ -64,6 +66,11 @@ class LinkedBase {
   bool empty() const { return list_.empty(); }
   size_t size() const { return list_.size(); }
 
+  // Estimated heap memory used by the list, index and elements.
+  size_t GetHeapMemoryUsage() const {
+    return HeapMemoryUsage(list_) + HeapMemoryUsage(index_);
+  }
+
   // Element access
   value_type& front() { return list_.front(); }
   const value_type& front() const { return list_.front(); }
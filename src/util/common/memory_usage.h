@@ -0,0 +1,171 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rocketspeed {
+
+/**
+ * Estimates of heap memory owned by an object, excluding sizeof the object
+ * itself. Used for per-subsystem memory accounting in statistics.
+ *
+ * Estimates are based on the layout of the standard library containers
+ * (one heap node per element with a pointer per link, plus the bucket array
+ * for hash tables) rather than on allocator instrumentation, so they are
+ * computed on demand and cost nothing on the hot path. Allocator overheads
+ * are not included.
+ *
+ * Types opt in by defining a size_t GetHeapMemoryUsage() const member; other
+ * types without a dedicated overload below are assumed to own no heap memory.
+ * Containers only visit their elements when the element type is not
+ * trivially destructible or opts in, so maps of PODs are accounted for in
+ * O(1).
+ */
+template <typename T>
+size_t HeapMemoryUsage(const T& obj);
+
+inline size_t HeapMemoryUsage(const std::string& str);
+
+template <typename A, typename B>
+size_t HeapMemoryUsage(const std::pair<A, B>& pair);
+
+template <typename T, typename D>
+size_t HeapMemoryUsage(const std::unique_ptr<T, D>& ptr);
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::vector<T, Alloc>& vec);
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::deque<T, Alloc>& deq);
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::list<T, Alloc>& list);
+
+template <typename K, typename V, typename H, typename E, typename Alloc>
+size_t HeapMemoryUsage(const std::unordered_map<K, V, H, E, Alloc>& map);
+
+template <typename K, typename H, typename E, typename Alloc>
+size_t HeapMemoryUsage(const std::unordered_set<K, H, E, Alloc>& set);
+
+namespace detail {
+
+template <typename T>
+auto HeapMemoryUsageImpl(const T& obj, int)
+    -> decltype(static_cast<size_t>(obj.GetHeapMemoryUsage())) {
+  return obj.GetHeapMemoryUsage();
+}
+
+template <typename T>
+size_t HeapMemoryUsageImpl(const T&, long) {
+  return 0;
+}
+
+template <typename T, typename = void>
+struct HasHeapMemoryUsageMember : std::false_type {};
+
+template <typename T>
+struct HasHeapMemoryUsageMember<T,
+    decltype(void(std::declval<const T&>().GetHeapMemoryUsage()))>
+  : std::true_type {};
+
+/** False if objects of type T can be assumed to own no heap memory. */
+template <typename T>
+struct MayOwnHeapMemory : std::integral_constant<bool,
+    !std::is_trivially_destructible<T>::value ||
+    HasHeapMemoryUsageMember<T>::value> {};
+
+template <typename A, typename B>
+struct MayOwnHeapMemory<std::pair<A, B>> : std::integral_constant<bool,
+    MayOwnHeapMemory<A>::value || MayOwnHeapMemory<B>::value> {};
+
+template <typename Iterator>
+size_t ElementsHeapMemoryUsage(Iterator begin, Iterator end) {
+  using T = typename std::iterator_traits<Iterator>::value_type;
+  size_t total = 0;
+  if (MayOwnHeapMemory<T>::value) {
+    for (; begin != end; ++begin) {
+      total += HeapMemoryUsage(*begin);
+    }
+  }
+  return total;
+}
+
+/** Size of a node in a node-based container with the given link count. */
+template <typename T, size_t kLinks>
+constexpr size_t NodeSize() {
+  return sizeof(T) + kLinks * sizeof(void*);
+}
+
+}  // namespace detail
+
+template <typename T>
+size_t HeapMemoryUsage(const T& obj) {
+  return detail::HeapMemoryUsageImpl(obj, 0);
+}
+
+inline size_t HeapMemoryUsage(const std::string& str) {
+  // Strings up to the inline capacity of an empty string do not allocate.
+  static const size_t kInlineCapacity = std::string().capacity();
+  return str.capacity() > kInlineCapacity ? str.capacity() + 1 : 0;
+}
+
+template <typename A, typename B>
+size_t HeapMemoryUsage(const std::pair<A, B>& pair) {
+  return HeapMemoryUsage(pair.first) + HeapMemoryUsage(pair.second);
+}
+
+template <typename T, typename D>
+size_t HeapMemoryUsage(const std::unique_ptr<T, D>& ptr) {
+  return ptr ? sizeof(T) + HeapMemoryUsage(*ptr) : 0;
+}
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::vector<T, Alloc>& vec) {
+  return vec.capacity() * sizeof(T) +
+    detail::ElementsHeapMemoryUsage(vec.begin(), vec.end());
+}
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::deque<T, Alloc>& deq) {
+  // Lower bound: ignores the partially filled blocks and the block map.
+  return deq.size() * sizeof(T) +
+    detail::ElementsHeapMemoryUsage(deq.begin(), deq.end());
+}
+
+template <typename T, typename Alloc>
+size_t HeapMemoryUsage(const std::list<T, Alloc>& list) {
+  return list.size() * detail::NodeSize<T, 2>() +
+    detail::ElementsHeapMemoryUsage(list.begin(), list.end());
+}
+
+template <typename K, typename V, typename H, typename E, typename Alloc>
+size_t HeapMemoryUsage(const std::unordered_map<K, V, H, E, Alloc>& map) {
+  using Value = typename std::unordered_map<K, V, H, E, Alloc>::value_type;
+  // Nodes hold the value, a next pointer, and possibly a cached hash.
+  return map.bucket_count() * sizeof(void*) +
+    map.size() * detail::NodeSize<Value, 2>() +
+    detail::ElementsHeapMemoryUsage(map.begin(), map.end());
+}
+
+template <typename K, typename H, typename E, typename Alloc>
+size_t HeapMemoryUsage(const std::unordered_set<K, H, E, Alloc>& set) {
+  return set.bucket_count() * sizeof(void*) +
+    set.size() * detail::NodeSize<K, 2>() +
+    detail::ElementsHeapMemoryUsage(set.begin(), set.end());
+}
+
+}  // namespace rocketspeed
@@ -3,6 +3,10 @@
 // LICENSE file in the root directory of this source tree. An additional grant
 // of patent rights can be found in the PATENTS file in the same directory.
 //
+#include "src/util/common/parsing.h"
+
+#include <ctype.h>
+#include <stdlib.h>
 #include <algorithm>
 #include <string>
 #include <unordered_map>
@@ -10,7 +14,7 @@
 
 namespace rocketspeed {
 
-std::vector<std::string> SplitString(const std::string& s, char delim = ',') {
+std::vector<std::string> SplitString(const std::string& s, char delim) {
   std::vector<std::string> r;
   r.reserve(std::count(s.begin(), s.end(), delim) + 1);
   auto first = s.begin();
@@ -35,4 +39,69 @@ std::unordered_map<std::string, std::string> ParseMap(const std::string& s) {
   return map;
 }
 
+namespace {
+
+// Parses a CPU number, 0 to 9999.
+bool ParseCpu(const std::string& s, int* cpu) {
+  if (s.empty() || s.size() > 4 ||
+      !std::all_of(s.begin(), s.end(), [] (char c) { return isdigit(c); })) {
+    return false;
+  }
+  *cpu = atoi(s.c_str());
+  return true;
+}
+
+}  // namespace
+
+Status ParseCpuList(const std::string& s, std::vector<int>* cpus) {
+  if (!s.empty() && s.back() == ',') {
+    return Status::InvalidArgument("Invalid CPU list: '" + s + "'");
+  }
+  std::vector<int> result;
+  for (const auto& entry : SplitString(s, ',')) {
+    auto range = SplitString(entry, '-');
+    int first;
+    int last;
+    if (range.size() == 1 && ParseCpu(range[0], &first)) {
+      last = first;
+    } else if (range.size() != 2 ||
+               !ParseCpu(range[0], &first) ||
+               !ParseCpu(range[1], &last) ||
+               first > last) {
+      return Status::InvalidArgument("Invalid CPU list: '" + s + "'");
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      result.push_back(cpu);
+    }
+  }
+  if (result.empty()) {
+    return Status::InvalidArgument("Empty CPU list");
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  *cpus = std::move(result);
+  return Status::OK();
+}
+
+std::string FormatCpuList(std::vector<int> cpus) {
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  std::string result;
+  for (size_t i = 0; i < cpus.size(); ) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+      ++j;
+    }
+    if (!result.empty()) {
+      result += ',';
+    }
+    result += std::to_string(cpus[i]);
+    if (j > i) {
+      result += '-' + std::to_string(cpus[j]);
+    }
+    i = j + 1;
+  }
+  return result;
+}
+
 }  // namespace rocketspeed
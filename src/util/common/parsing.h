@@ -9,6 +9,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "include/Status.h"
+
 namespace rocketspeed {
 
 /**
@@ -40,4 +42,23 @@ std::vector<std::string> SplitString(const std::string& s, char delim = ',');
  */
 std::unordered_map<std::string, std::string> ParseMap(const std::string& s);
 
+/**
+ * Parses a list of CPUs in the format used by taskset and sysfs, i.e. a
+ * ','-delimited list of CPUs and inclusive ranges, e.g. '0-3,8,10-11'.
+ *
+ * @param s The string to parse.
+ * @param cpus Output for the CPUs, sorted and without duplicates.
+ * @return ok() if s is a valid non-empty list, otherwise InvalidArgument.
+ */
+Status ParseCpuList(const std::string& s, std::vector<int>* cpus);
+
+/**
+ * Formats CPUs as a list that ParseCpuList accepts, with consecutive CPUs
+ * collapsed into ranges, e.g. {0, 1, 2, 3, 8} => '0-3,8'.
+ *
+ * @param cpus The CPUs to format.
+ * @return The list, empty if cpus is empty.
+ */
+std::string FormatCpuList(std::vector<int> cpus);
+
 }  // namespace rocketspeed
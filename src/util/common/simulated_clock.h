@@ -0,0 +1,124 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rocketspeed {
+
+/**
+ * Monotonic clock that only moves when advanced explicitly. Can be injected
+ * into an EventLoop (see EventLoop::Options::clock) so that timeouts and
+ * simulated network delays depend on the test rather than on how quickly
+ * the machine runs it.
+ *
+ * Thread safe.
+ */
+class SimulatedClock {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @param start Initial time. The default leaves headroom for code that
+   *              subtracts timeouts from the current time.
+   */
+  explicit SimulatedClock(
+      Clock::time_point start = Clock::time_point() + std::chrono::hours(24))
+  : now_(start)
+  , next_listener_id_(1) {
+  }
+
+  /** @return The current simulated time. */
+  Clock::time_point Now() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return now_;
+  }
+
+  /**
+   * Moves time forward, then invokes the listeners on the calling thread.
+   * Listeners are invoked without holding the clock's lock, and may read the
+   * clock, but must not remove themselves.
+   */
+  void Advance(Clock::duration duration) {
+    std::vector<std::shared_ptr<Listener>> listeners;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (duration > Clock::duration::zero()) {
+        now_ += duration;
+      }
+      listeners.reserve(listeners_.size());
+      for (const auto& entry : listeners_) {
+        ++entry.second->active;
+        listeners.push_back(entry.second);
+      }
+    }
+    for (const auto& listener : listeners) {
+      listener->callback();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& listener : listeners) {
+        --listener->active;
+      }
+    }
+    idle_.notify_all();
+  }
+
+  /**
+   * Registers a callback to be invoked whenever the clock is advanced.
+   *
+   * @return Handle for RemoveListener, never zero.
+   */
+  uint64_t AddListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t id = next_listener_id_++;
+    listeners_.emplace(id, std::make_shared<Listener>(std::move(listener)));
+    return id;
+  }
+
+  /**
+   * Unregisters a listener. Once this returns, the listener is not running
+   * and will not be invoked again.
+   */
+  void RemoveListener(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = listeners_.find(id);
+    if (it == listeners_.end()) {
+      return;
+    }
+    std::shared_ptr<Listener> listener = std::move(it->second);
+    listeners_.erase(it);
+    // Wait for concurrent Advance calls that are still invoking it.
+    idle_.wait(lock, [&] () { return listener->active == 0; });
+  }
+
+ private:
+  struct Listener {
+    explicit Listener(std::function<void()> _callback)
+    : callback(std::move(_callback))
+    , active(0) {
+    }
+
+    const std::function<void()> callback;
+    // Number of Advance calls that are invoking the callback.
+    int active;
+  };
+
+  mutable std::mutex mutex_;
+  std::condition_variable idle_;
+  Clock::time_point now_;
+  uint64_t next_listener_id_;
+  std::map<uint64_t, std::shared_ptr<Listener>> listeners_;
+};
+
+}  // namespace rocketspeed
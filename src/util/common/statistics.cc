@@ -29,6 +29,7 @@ Histogram::Histogram(double min,
 , smallest_bucket_(smallest_bucket)
 , ratio_(ratio)
 , num_samples_(0)
+, max_sample_(min)
 , log_ratio_(log(ratio))
 , log_smallest_bucket_(log(smallest_bucket)) {
   assert(max >= min);
@@ -46,6 +47,7 @@ Histogram::Histogram(const Histogram& src)
 , smallest_bucket_(src.smallest_bucket_)
 , ratio_(src.ratio_)
 , num_samples_(0)
+, max_sample_(src.min_)
 , num_buckets_(src.num_buckets_)
 , log_ratio_(src.log_ratio_)
 , log_smallest_bucket_(src.log_smallest_bucket_) {
@@ -63,6 +65,7 @@ Histogram::Histogram(Histogram&& src)
 , smallest_bucket_(src.smallest_bucket_)
 , ratio_(src.ratio_)
 , num_samples_(src.num_samples_)
+, max_sample_(src.max_sample_)
 , bucket_counts_(std::move(src.bucket_counts_))
 , num_buckets_(src.num_buckets_)
 , log_ratio_(src.log_ratio_)
@@ -73,6 +76,7 @@ Histogram::Histogram(Histogram&& src)
     src.bucket_counts_[i] = 0;
   }
   src.num_samples_ = 0;
+  src.max_sample_ = src.min_;
 }
 
 void Histogram::Record(double sample) {
@@ -80,6 +84,7 @@ void Histogram::Record(double sample) {
   size_t index = std::min(BucketIndex(sample), num_buckets_ - 1);
   bucket_counts_[index] += 1;
   num_samples_ += 1;
+  max_sample_ = std::max(max_sample_, std::min(std::max(sample, min_), max_));
 }
 
 size_t Histogram::BucketIndex(double sample) const {
@@ -147,6 +152,7 @@ void Histogram::Aggregate(const Histogram& histogram) {
     bucket_counts_[i] += n;
     num_samples_ += n;
   }
+  max_sample_ = std::max(max_sample_, histogram.max_sample_);
 }
 
 void Histogram::Disaggregate(const Histogram& histogram) {
@@ -182,6 +188,23 @@ std::string Histogram::Report() const {
   return std::string(buffer);
 }
 
+std::string Histogram::ReportDistribution() const {
+  thread_check_.Check();
+  char buffer[256];
+  snprintf(buffer, 256, "p50: %-8.1lf  "
+                        "p75: %-8.1lf  "
+                        "p90: %-8.1lf  "
+                        "p99: %-8.1lf  "
+                        "p99.9: %-8.1lf  "
+                        "p99.99: %-8.1lf  "
+                        "max: %-8.1lf  "
+                        "(%llu samples)",
+    Percentile(0.50), Percentile(0.75), Percentile(0.90), Percentile(0.99),
+    Percentile(0.999), Percentile(0.9999), GetMaxSample(),
+    static_cast<long long unsigned int>(num_samples_));
+  return std::string(buffer);
+}
+
 void Statistics::Aggregate(const Statistics& stats) {
   thread_check_.Check();
   AggregateOne(&counters_, stats.counters_);
@@ -134,6 +134,12 @@ class Histogram {
    */
   std::string Report() const;
 
+  /**
+   * Report the full range of percentiles, from p50 to p99.99, and the
+   * largest recorded sample.
+   */
+  std::string ReportDistribution() const;
+
   Histogram MoveThread() {
     auto result = std::move(*this);
     result.thread_check_.Check();
@@ -144,6 +150,14 @@ class Histogram {
     return num_samples_;
   }
 
+  /**
+   * @return The largest sample recorded, after clamping, or min if there are
+   *         no samples. Not reverted by Disaggregate.
+   */
+  double GetMaxSample() const {
+    return num_samples_ ? max_sample_ : min_;
+  }
+
 private:
   size_t BucketIndex(double sample) const;
 
@@ -152,6 +166,7 @@ private:
   double smallest_bucket_;
   double ratio_;
   uint64_t num_samples_;
+  double max_sample_;
   std::unique_ptr<uint64_t[]> bucket_counts_;
   size_t num_buckets_;
   double log_ratio_;  // == log(ratio_)
@@ -9,29 +9,30 @@
 #include <math.h>
 #include <algorithm>
 #include <functional>
-#include <map>
+#include <limits>
 #include <utility>
+#include <vector>
 #include "src/util/common/hash.h"
 
 
-// If this is not defined, std::multimap is used
-//#define CONSISTENT_HASH_USE_VECTOR
-
 ////////////////////////////////////////////////////////////////////////////
-// Going with multimap for performance reasons - multimap seems to perform
-// slightly better for all sizes. See benchmark:
+// The ring is a pair of flat sorted arrays rather than a std::multimap. A
+// lookup touches a handful of adjacent cache lines instead of chasing tree
+// nodes, and since ring hashes are uniform, interpolation lands within a few
+// entries of the answer. Add and Remove pay for it by shifting the arrays.
+// From consistent_hash_bench, built against this header and against the
+// previous std::multimap ring (fastest of 5 epochs, 20 replicas per slot):
 //
 // =========================================================================
-//    consistent_hash_bench               vector iters/s    multimap iters/s
+//    consistent_hash_bench             multimap iters/s  flat array iters/s
 // =========================================================================
-//  ConsistentHashGet(10)                          3.98M               5.64M
-//  ConsistentHashGet(20)                          3.50M               4.62M
-//  ConsistentHashGet(50)                          2.98M               3.64M
-//  ConsistentHashGet(100)                         2.72M               3.34M
-//  ConsistentHashGet(200)                         2.49M               3.05M
-//  ConsistentHashGet(500)                         2.28M               2.73M
-//  ConsistentHashGet(1000)                        2.13M               2.41M
-//  ConsistentHashGet(2000)                        1.96M               2.16M
+//  ConsistentHashGet4                            25.16M              23.05M
+//  ConsistentHashGet10                           19.44M              21.89M
+//  ConsistentHashGet100                           9.19M              17.76M
+//  ConsistentHashGet1000                          4.62M              12.73M
+//  ConsistentHashGet10000                         1.27M               8.87M
+//  ConsistentHashAddRemove100                   786.08k              81.47k
+//  ConsistentHashAddRemove1000                  766.71k               7.82k
 // =========================================================================
 ////////////////////////////////////////////////////////////////////////////
 
@@ -52,13 +53,17 @@ namespace rocketspeed {
  *
  * For n total replicas:
  *   Memory usage: O(n)
- *   Get time: O(log(n))
+ *   Get time: O(log(n)) worst case, O(1) expected
+ *   Add/Remove time: O(n)
+ *
+ * Slots are expected to change rarely compared to lookups. For a handful of
+ * slots with arbitrary weights, see RendezvousHash.
  *
  * For good slot allocation, the hash functions need to have good key
  * distribution. As a default, we use MurmurHash2 rather than std::hash since
  * std::hash has very poor key distribution for integral types.
  *
- * Slot type needs to be comparable with std::less and std::equal_to.
+ * Slot type needs to be comparable with std::equal_to.
  */
 template <class Key,
           class Slot,
@@ -150,13 +155,24 @@ class ConsistentHash {
    * Test if structure is empty.
    */
   bool Empty() const {
-    return ring_.empty();
+    return hashes_.empty();
   }
 
  private:
-  // Hashing ring. Using a vector/multimap here as multiple slots could have
-  // hash collisions, and we don't want to override slots if that happens as
-  // it would break the removal semantics.
+  /**
+   * Finds the first position on the ring with hash not less than hash.
+   * Returns VirtualSlotCount() if there is none.
+   */
+  size_t LowerBound(size_t hash) const;
+
+  // Number of distinct hash values, 2^64 on 64-bit platforms.
+  static constexpr double kHashSpace =
+    static_cast<double>(std::numeric_limits<size_t>::max()) + 1.0;
+
+  // Hashing ring, as two parallel arrays sorted by hash. Hashes are kept
+  // apart from the slots so that searching only touches the hashes.
+  // Multiple slots may have the same hash, and we don't want to override
+  // slots if that happens as it would break the removal semantics.
   // e.g.
   // Add(X); // hash(X) == 42
   // Add(Y); // hash(Y) == 42 -- overrides X
@@ -165,19 +181,8 @@ class ConsistentHash {
   // as the order in which they were added.
   // So, strictly speaking, the hash is only guaranteed to be consistent if
   // the order of slot additions is consistent.
-#ifdef CONSISTENT_HASH_USE_VECTOR
-  std::vector<std::pair<size_t, Slot>> ring_;
-
-  // helper function to compare 1st element of a pair only.
-  // Using a function is faster than the default comparator, and faster
-  // than a lambda comparator
-  static bool Compare1st(const std::pair<size_t, Slot>& p,
-                const size_t& c) {
-    return p.first < c;
-  }
-#else
-  std::multimap<size_t, Slot> ring_;
-#endif
+  std::vector<size_t> hashes_;
+  std::vector<Slot> slots_;
 
   KeyHash keyHash_;    // Hash function for keys
   SlotHash slotHash_;  // Hash function for slots
@@ -197,37 +202,56 @@ template <class Key, class Slot, class KeyHash, class SlotHash>
 void ConsistentHash<Key, Slot, KeyHash, SlotHash>::Add(
     const Slot& slot,
     unsigned int replicas) {
+  std::vector<size_t> added;
+  added.reserve(replicas);
   size_t hash = slotHash_(slot);
   while (replicas--) {
-#ifdef CONSISTENT_HASH_USE_VECTOR
-    std::pair<size_t, Slot> p(hash, slot);
-    ring_.insert(std::upper_bound(ring_.begin(), ring_.end(), p), p);
-#else
-    ring_.insert(std::make_pair(hash, slot));
-#endif
+    added.push_back(hash);
     hash = MurmurHash2<size_t>()(hash);
   }
+  std::sort(added.begin(), added.end());
+
+  // Merge the new replicas into the ring in one pass. Existing slots go
+  // first on equal hashes, to keep the collision order.
+  std::vector<size_t> hashes;
+  std::vector<Slot> slots;
+  hashes.reserve(hashes_.size() + added.size());
+  slots.reserve(hashes_.size() + added.size());
+  size_t i = 0;
+  for (size_t added_hash : added) {
+    while (i < hashes_.size() && hashes_[i] <= added_hash) {
+      hashes.push_back(hashes_[i]);
+      slots.push_back(std::move(slots_[i]));
+      ++i;
+    }
+    hashes.push_back(added_hash);
+    slots.push_back(slot);
+  }
+  for (; i < hashes_.size(); ++i) {
+    hashes.push_back(hashes_[i]);
+    slots.push_back(std::move(slots_[i]));
+  }
+  hashes_ = std::move(hashes);
+  slots_ = std::move(slots);
   ++slotCount_;
 }
 
 template <class Key, class Slot, class KeyHash, class SlotHash>
 void ConsistentHash<Key, Slot, KeyHash, SlotHash>::Remove(
     const Slot& slot) {
+  std::vector<bool> removed(hashes_.size(), false);
   size_t hash = slotHash_(slot);
   bool foundOne = false;
   for (;;) {
     // Might be multiple slots on the same hash value.
     // Need to find the one that maps to 'slot'.
-#ifdef CONSISTENT_HASH_USE_VECTOR
-    auto range = std::equal_range(ring_.begin(), ring_.end(), hash);
-#else
-    auto range = ring_.equal_range(hash);
-#endif
     bool found = false;
-    for (auto it = range.first; it != range.second; ++it) {
-      if (it->second == slot) {
+    for (size_t i = LowerBound(hash);
+         i < hashes_.size() && hashes_[i] == hash;
+         ++i) {
+      if (!removed[i] && slots_[i] == slot) {
         found = true;
-        ring_.erase(it);
+        removed[i] = true;
         break;
       }
     }
@@ -240,24 +264,75 @@ void ConsistentHash<Key, Slot, KeyHash, SlotHash>::Remove(
     foundOne = true;
   }
   if (foundOne) {
+    // Compact the ring in place.
+    size_t out = 0;
+    for (size_t i = 0; i < hashes_.size(); ++i) {
+      if (!removed[i]) {
+        if (out != i) {
+          hashes_[out] = hashes_[i];
+          slots_[out] = std::move(slots_[i]);
+        }
+        ++out;
+      }
+    }
+    hashes_.resize(out);
+    slots_.erase(slots_.begin() + out, slots_.end());
     --slotCount_;
   }
 }
 
+template <class Key, class Slot, class KeyHash, class SlotHash>
+size_t ConsistentHash<Key, Slot, KeyHash, SlotHash>::LowerBound(
+    size_t hash) const {
+  const size_t n = hashes_.size();
+  if (n == 0) {
+    return 0;
+  }
+  // Ring hashes are uniformly distributed, so the position of the hash is
+  // close to its fraction of the hash space. Gallop from that guess until
+  // the answer is bracketed, then binary search the bracket.
+  const double scale = static_cast<double>(n) / kHashSpace;
+  const size_t guess =
+    std::min(static_cast<size_t>(static_cast<double>(hash) * scale), n - 1);
+  size_t lo;  // answer is in [lo, hi]
+  size_t hi;
+  if (hashes_[guess] < hash) {
+    lo = guess + 1;
+    hi = n;
+    for (size_t step = 1; lo < n; step *= 2) {
+      const size_t probe = std::min(lo + step, n) - 1;
+      if (hashes_[probe] >= hash) {
+        hi = probe;
+        break;
+      }
+      lo = probe + 1;
+    }
+  } else {
+    lo = 0;
+    hi = guess;
+    for (size_t step = 1; hi > 0; step *= 2) {
+      const size_t probe = hi > step ? hi - step : 0;
+      if (hashes_[probe] < hash) {
+        lo = probe + 1;
+        break;
+      }
+      hi = probe;
+    }
+  }
+  return static_cast<size_t>(
+    std::lower_bound(hashes_.begin() + lo, hashes_.begin() + hi, hash) -
+    hashes_.begin());
+}
+
 template <class Key, class Slot, class KeyHash, class SlotHash>
 const Slot& ConsistentHash<Key, Slot, KeyHash, SlotHash>::Get(
     const Key& key) const {
-  assert(!ring_.empty());
-  size_t hash = keyHash_(key);
-#ifdef CONSISTENT_HASH_USE_VECTOR
-  auto it = std::lower_bound(ring_.begin(), ring_.end(), hash, Compare1st);
-#else
-  auto it = ring_.lower_bound(hash);
-#endif
-  if (it == ring_.end()) {
-    it = ring_.begin();  // Wrap back to first node.
+  assert(!hashes_.empty());
+  size_t i = LowerBound(keyHash_(key));
+  if (i == hashes_.size()) {
+    i = 0;  // Wrap back to first node.
   }
-  return it->second;
+  return slots_[i];
 }
 
 template <class Key, class Slot, class KeyHash, class SlotHash>
@@ -265,29 +340,24 @@ template <class IT>
 void ConsistentHash<Key, Slot, KeyHash, SlotHash>::MultiGet(
     const Key& key, size_t count, IT out_begin) const {
   assert(slotCount_ >= count);
-  size_t hash = keyHash_(key);
-#ifdef CONSISTENT_HASH_USE_VECTOR
-  auto it = std::lower_bound(ring_.begin(), ring_.end(), hash, Compare1st);
-#else
-  auto it = ring_.lower_bound(hash);
-#endif
+  size_t i = LowerBound(keyHash_(key));
 
-  auto initial_it = it;
-  int out_size = 0;
+  size_t steps = 0;
+  size_t out_size = 0;
 
   // Pick the next count distinct slots along the ring.
   // We'll need at most count*2 steps on average (if count=slotCount_=2).
-  do {
-    if (it == ring_.end()) {
-      it = ring_.begin();  // Wrap back to first node.
+  while (steps++ < hashes_.size() && out_size < count) {
+    if (i == hashes_.size()) {
+      i = 0;  // Wrap back to first node.
     }
     // For small count this should be faster than a set.
-    bool seen = std::find(out_begin, out_begin + out_size, it->second)
+    bool seen = std::find(out_begin, out_begin + out_size, slots_[i])
                 != out_begin + out_size;
     if (!seen)
-      out_begin[out_size++] = it->second;
-    ++it;
-  } while (it != initial_it && out_size < count);
+      out_begin[out_size++] = slots_[i];
+    ++i;
+  }
 
   assert(out_size == count);
 }
@@ -299,26 +369,24 @@ size_t ConsistentHash<Key, Slot, KeyHash, SlotHash>::SlotCount() const {
 
 template <class Key, class Slot, class KeyHash, class SlotHash>
 size_t ConsistentHash<Key, Slot, KeyHash, SlotHash>::VirtualSlotCount() const {
-  return ring_.size();
+  return hashes_.size();
 }
 
 template <class Key, class Slot, class KeyHash, class SlotHash>
 double ConsistentHash<Key, Slot, KeyHash, SlotHash>::SlotRatio(
     const Slot& slot) const {
-  auto it = ring_.end();
-  if (it == ring_.begin()) {
+  if (hashes_.empty()) {
     return 0.0;
   }
-  --it;
-  size_t prevHash = it->first;
+  size_t prevHash = hashes_.back();
   size_t count = 0;
   bool found = false;
-  for (it = ring_.begin(); it != ring_.end(); ++it) {
-    if (it->second == slot) {
-      count += it->first - prevHash;
+  for (size_t i = 0; i < hashes_.size(); ++i) {
+    if (slots_[i] == slot) {
+      count += hashes_[i] - prevHash;
       found = true;
     }
-    prevHash = it->first;
+    prevHash = hashes_[i];
   }
   if (count == 0) {
     return found ? 1.0 : 0.0;
@@ -329,7 +397,8 @@ double ConsistentHash<Key, Slot, KeyHash, SlotHash>::SlotRatio(
 
 template <class Key, class Slot, class KeyHash, class SlotHash>
 void ConsistentHash<Key, Slot, KeyHash, SlotHash>::Clear() {
-  ring_.clear();
+  hashes_.clear();
+  slots_.clear();
   slotCount_ = 0;
 }
 
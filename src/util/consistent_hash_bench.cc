@@ -2,54 +2,203 @@
 //  This source code is licensed under the BSD-style license found in the
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
-
+//
+#include <stdio.h>
+#include <algorithm>
+#include <map>
 #include <vector>
-#include <folly/Benchmark.h>
-#include <folly/Foreach.h>
-#include "common/init/Init.h"
+
+#include "src/util/benchharness.h"
 #include "src/util/consistent_hash.h"
+#include "src/util/rendezvous_hash.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
 
-using namespace std;
-using namespace folly;
-using namespace rocketspeed;
+namespace {
 
-// this var is global, which is not very clean, but should be fine
-// for a read-only benchmark regardless of how it's run?
-namespace bench {
-  size_t counter;
-};
+// Keys looked up, shared between benchmarks so that each one starts where
+// the last one stopped.
+uint64_t counter = 0;
 
-void ConsistentHashGet(uint n, size_t initialSize) {
-  ConsistentHash<uint64_t, size_t> ch;
-  BENCHMARK_SUSPEND {
-    for (int i = 0; i < initialSize; ++i) {
+/**
+ * @return A ring of slots with 20 replicas each. Adding is linear in the
+ *         size of the ring, so rings are built once and reused by every run.
+ */
+const ConsistentHash<uint64_t, size_t>& Ring(size_t slots) {
+  static std::map<size_t, ConsistentHash<uint64_t, size_t>> rings;
+  auto it = rings.find(slots);
+  if (it == rings.end()) {
+    ConsistentHash<uint64_t, size_t> ch;
+    for (size_t i = 0; i < slots; ++i) {
       ch.Add(i, 20);
     }
+    it = rings.emplace(slots, std::move(ch)).first;
   }
+  return it->second;
+}
+
+void ConsistentHashGet(size_t n, size_t initial_size) {
+  BenchmarkSuspender braces;
+  const ConsistentHash<uint64_t, size_t>& ch = Ring(initial_size);
+  braces.Dismiss();
 
   size_t a = 0;
+  for (size_t i = 0; i < n; ++i) {
+    a += ch.Get(++counter);
+  }
+  DoNotOptimizeAway(a);
+}
 
-  FOR_EACH_RANGE(i, 0, n) {
-    a += ch.Get(++bench::counter % ch.SlotCount());
+void RendezvousHashGet(size_t n, size_t initial_size, bool weighted) {
+  BenchmarkSuspender braces;
+  RendezvousHash<uint64_t, size_t> rh;
+  for (size_t i = 0; i < initial_size; ++i) {
+    if (weighted) {
+      rh.Add(i, 1.0 + static_cast<double>(i % 3));
+    } else {
+      rh.Add(i);
+    }
+  }
+  braces.Dismiss();
+
+  size_t a = 0;
+  for (size_t i = 0; i < n; ++i) {
+    a += rh.Get(++counter);
   }
-  doNotOptimizeAway(a);
+  DoNotOptimizeAway(a);
 }
 
-BENCHMARK_PARAM(ConsistentHashGet, 10)
-BENCHMARK_PARAM(ConsistentHashGet, 20)
-BENCHMARK_PARAM(ConsistentHashGet, 50)
-BENCHMARK_PARAM(ConsistentHashGet, 100)
-BENCHMARK_PARAM(ConsistentHashGet, 200)
-BENCHMARK_PARAM(ConsistentHashGet, 500)
-BENCHMARK_PARAM(ConsistentHashGet, 1000)
-BENCHMARK_PARAM(ConsistentHashGet, 2000)
+void ConsistentHashAddRemove(size_t n, size_t initial_size) {
+  BenchmarkSuspender braces;
+  ConsistentHash<uint64_t, size_t> ch = Ring(initial_size);
+  braces.Dismiss();
 
-int main(int argc, char** argv) {
-  facebook::initFacebook(&argc, &argv);
+  for (size_t i = 0; i < n; ++i) {
+    ch.Add(initial_size, 20);
+    ch.Remove(initial_size);
+  }
+  DoNotOptimizeAway(ch.VirtualSlotCount());
+}
 
-  bench::counter = 0;
+/**
+ * Prints how far the busiest and idlest slots are from an even share of
+ * keys, for the ring with different replica counts and for rendezvous.
+ */
+template <class Mapping>
+void PrintBalance(const char* name, const Mapping& mapping, size_t slots) {
+  const size_t keys = 1000000;
+  std::vector<size_t> counts(slots);
+  for (uint64_t key = 0; key < keys; ++key) {
+    counts[mapping.Get(key)]++;
+  }
+  auto minmax = std::minmax_element(counts.begin(), counts.end());
+  const double mean = static_cast<double>(keys) / static_cast<double>(slots);
+  printf("%-24s %6zu %12.3f %12.3f\n",
+         name,
+         slots,
+         static_cast<double>(*minmax.second) / mean,
+         static_cast<double>(*minmax.first) / mean);
+}
+
+void PrintBalanceTable() {
+  printf("%-24s %6s %12s %12s\n", "Load balance", "slots", "max/mean",
+         "min/mean");
+  for (size_t slots : {4, 16, 64}) {
+    ConsistentHash<uint64_t, size_t> ring20;
+    ConsistentHash<uint64_t, size_t> ring100;
+    RendezvousHash<uint64_t, size_t> rendezvous;
+    for (size_t i = 0; i < slots; ++i) {
+      ring20.Add(i, 20);
+      ring100.Add(i, 100);
+      rendezvous.Add(i);
+    }
+    PrintBalance("ConsistentHash(20)", ring20, slots);
+    PrintBalance("ConsistentHash(100)", ring100, slots);
+    PrintBalance("RendezvousHash", rendezvous, slots);
+  }
+  printf("\n");
+}
 
-  runBenchmarks();
+}  // namespace
+
+BENCHMARK(ConsistentHashGet4, n) {
+  ConsistentHashGet(n, 4);
+}
 
-  return 0;
+BENCHMARK_RELATIVE(RendezvousHashGet4, n) {
+  RendezvousHashGet(n, 4, false);
+}
+
+BENCHMARK_RELATIVE(WeightedRendezvousHashGet4, n) {
+  RendezvousHashGet(n, 4, true);
+}
+
+BENCHMARK(ConsistentHashGet10, n) {
+  ConsistentHashGet(n, 10);
+}
+
+BENCHMARK_RELATIVE(RendezvousHashGet10, n) {
+  RendezvousHashGet(n, 10, false);
+}
+
+BENCHMARK_RELATIVE(WeightedRendezvousHashGet10, n) {
+  RendezvousHashGet(n, 10, true);
+}
+
+BENCHMARK(ConsistentHashGet20, n) {
+  ConsistentHashGet(n, 20);
+}
+
+BENCHMARK_RELATIVE(RendezvousHashGet20, n) {
+  RendezvousHashGet(n, 20, false);
+}
+
+BENCHMARK_RELATIVE(WeightedRendezvousHashGet20, n) {
+  RendezvousHashGet(n, 20, true);
+}
+
+BENCHMARK(ConsistentHashGet50, n) {
+  ConsistentHashGet(n, 50);
+}
+
+BENCHMARK_RELATIVE(RendezvousHashGet50, n) {
+  RendezvousHashGet(n, 50, false);
+}
+
+BENCHMARK_RELATIVE(WeightedRendezvousHashGet50, n) {
+  RendezvousHashGet(n, 50, true);
+}
+
+BENCHMARK(ConsistentHashGet100, n) {
+  ConsistentHashGet(n, 100);
+}
+
+BENCHMARK(ConsistentHashGet1000, n) {
+  ConsistentHashGet(n, 1000);
+}
+
+BENCHMARK(ConsistentHashGet10000, n) {
+  ConsistentHashGet(n, 10000);
+}
+
+BENCHMARK(ConsistentHashAddRemove10, n) {
+  ConsistentHashAddRemove(n, 10);
+}
+
+BENCHMARK(ConsistentHashAddRemove100, n) {
+  ConsistentHashAddRemove(n, 100);
+}
+
+BENCHMARK(ConsistentHashAddRemove1000, n) {
+  ConsistentHashAddRemove(n, 1000);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  rocketspeed::PrintBalanceTable();
+  return rocketspeed::benchmark::RunAllBenchmarks();
 }
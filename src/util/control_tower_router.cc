@@ -5,18 +5,58 @@
 
 #include "src/util/control_tower_router.h"
 
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
 #include "src/util/common/host_id.h"
 
 namespace rocketspeed {
 
+const double ConsistentHashTowerRouter::kMaxWeight = 64.0;
+
+ConsistentHashTowerRouter::ConsistentHashTowerRouter(
+  std::unordered_map<ControlTowerId, HostId> control_towers,
+  unsigned int replicas, size_t control_towers_per_log)
+: ConsistentHashTowerRouter(std::move(control_towers),
+                            {},
+                            replicas,
+                            control_towers_per_log) {
+}
+
 ConsistentHashTowerRouter::ConsistentHashTowerRouter(
   std::unordered_map<ControlTowerId, HostId> control_towers,
+  const std::unordered_map<ControlTowerId, double>& weights,
   unsigned int replicas, size_t control_towers_per_log)
 : host_ids_(std::move(control_towers))
+, replicas_(replicas)
 , control_towers_per_log_(control_towers_per_log) {
   for (auto const& node_host : host_ids_) {
-    mapping_.Add(node_host.first, replicas);
+    auto it = weights.find(node_host.first);
+    double weight =
+      it != weights.end() && CheckWeight(it->second).ok() ? it->second : 1.0;
+    weights_.emplace(node_host.first, weight);
+    mapping_.Add(node_host.first, ReplicasForWeight(weight));
+  }
+}
+
+Status ConsistentHashTowerRouter::Create(
+    std::unordered_map<ControlTowerId, HostId> control_towers,
+    const std::unordered_map<ControlTowerId, double>& weights,
+    unsigned int replicas,
+    size_t control_towers_per_log,
+    std::unique_ptr<ConsistentHashTowerRouter>* out) {
+  for (const auto& id_weight : weights) {
+    Status st = CheckWeight(id_weight.second);
+    if (!st.ok()) {
+      return st;
+    }
   }
+  out->reset(new ConsistentHashTowerRouter(std::move(control_towers),
+                                           weights,
+                                           replicas,
+                                           control_towers_per_log));
+  return Status::OK();
 }
 
 Status ConsistentHashTowerRouter::GetControlTowers(
@@ -42,4 +82,61 @@ Status ConsistentHashTowerRouter::GetControlTowers(
   return Status::OK();
 }
 
+Status ConsistentHashTowerRouter::GetLoadShares(
+    std::vector<std::pair<HostId, double>>* out) const {
+  out->clear();
+  out->reserve(host_ids_.size());
+  for (auto const& node_host : host_ids_) {
+    out->emplace_back(node_host.second, mapping_.SlotRatio(node_host.first));
+  }
+  return Status::OK();
+}
+
+Status ConsistentHashTowerRouter::SetWeight(ControlTowerId id, double weight) {
+  Status st = CheckWeight(weight);
+  if (!st.ok()) {
+    return st;
+  }
+  auto it = weights_.find(id);
+  if (it == weights_.end()) {
+    return Status::NotFound("Unknown control tower");
+  }
+  if (ReplicasForWeight(it->second) != ReplicasForWeight(weight)) {
+    // Re-adding walks the same hash chain, so only the replicas past the
+    // shorter of the two lengths change.
+    mapping_.Remove(id);
+    mapping_.Add(id, ReplicasForWeight(weight));
+  }
+  it->second = weight;
+  return Status::OK();
+}
+
+double ConsistentHashTowerRouter::GetWeight(ControlTowerId id) const {
+  auto it = weights_.find(id);
+  return it != weights_.end() ? it->second : 0.0;
+}
+
+Status ConsistentHashTowerRouter::CheckWeight(double weight) {
+  if (!std::isfinite(weight) || !(weight > 0.0) || weight > kMaxWeight) {
+    return Status::InvalidArgument(
+      "Tower weight must be positive and at most " +
+      std::to_string(kMaxWeight) + ", got " + std::to_string(weight));
+  }
+  return Status::OK();
+}
+
+unsigned int ConsistentHashTowerRouter::ReplicasForWeight(double weight) const {
+  // Weights are checked, but clamp anyway so that the cast is always
+  // defined. Every tower keeps at least one replica, or it would get no
+  // logs at all.
+  const double max_replicas =
+    static_cast<double>(std::numeric_limits<unsigned int>::max());
+  double replicas = std::min(replicas_ * std::min(weight, kMaxWeight),
+                             max_replicas);
+  if (!(replicas >= 1.0)) {
+    return 1;
+  }
+  return static_cast<unsigned int>(std::llround(replicas));
+}
+
 }  // namespace rocketspeed
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
@@ -20,6 +21,12 @@ namespace rocketspeed {
  * The log to control tower mapping which uses ring consistent hashing, that
  * distributes logs to control towers evenly, and in a way that changes the
  * mapping minimally when control towers are added or lost.
+ *
+ * Towers may be weighted by capacity, e.g. cores or cache memory. A tower
+ * with weight w gets w times as many ring replicas, and so w times as many
+ * logs, as a tower with weight 1. Replicas of a tower are a chain of hashes,
+ * so changing a weight only adds or removes replicas at the end of the
+ * chain, and only logs on those replicas move.
  */
 class ConsistentHashTowerRouter : public ControlTowerRouter {
  public:
@@ -37,6 +44,39 @@ class ConsistentHashTowerRouter : public ControlTowerRouter {
     unsigned int replicas,
     size_t control_towers_per_log);
 
+  /**
+   * Constructs a new ConsistentHashTowerRouter with weighted towers.
+   *
+   * @param control_towers Map of control tower IDs to hosts.
+   * @param weights Relative weights of control towers. Towers not in the map,
+   *        or with a weight that is not valid (see SetWeight), have weight 1.
+   * @param replicas Number of hash ring replicas for a tower of weight 1.
+   * @param control_towers_per_log Each log is mapped to this many
+   *        control towers.
+   */
+  ConsistentHashTowerRouter(
+    std::unordered_map<ControlTowerId, HostId> control_towers,
+    const std::unordered_map<ControlTowerId, double>& weights,
+    unsigned int replicas,
+    size_t control_towers_per_log);
+
+  /**
+   * Creates a ConsistentHashTowerRouter with weighted towers, like the
+   * constructor, but rejects invalid weights instead of ignoring them.
+   *
+   * @param out Output for the router.
+   * @return InvalidArgument if a weight is not valid (see SetWeight).
+   */
+  static Status Create(
+    std::unordered_map<ControlTowerId, HostId> control_towers,
+    const std::unordered_map<ControlTowerId, double>& weights,
+    unsigned int replicas,
+    size_t control_towers_per_log,
+    std::unique_ptr<ConsistentHashTowerRouter>* out);
+
+  /** Largest weight of a tower, relative to a tower of weight 1. */
+  static const double kMaxWeight;
+
   /** Copyable and movable */
   ConsistentHashTowerRouter(const ConsistentHashTowerRouter&) = default;
   ConsistentHashTowerRouter& operator=(const ConsistentHashTowerRouter&) =
@@ -47,7 +87,31 @@ class ConsistentHashTowerRouter : public ControlTowerRouter {
   Status GetControlTowers(LogID logID,
                           std::vector<HostId const*>* out) const override;
 
+  Status GetLoadShares(
+      std::vector<std::pair<HostId, double>>* out) const override;
+
+  /**
+   * Changes the weight of a control tower. Routers are shared with copilot
+   * workers, so to change weights at runtime, update a copy and pass it to
+   * Copilot::UpdateTowerRouter.
+   *
+   * @param id ID of the control tower.
+   * @param weight New weight, must be finite, positive and at most
+   *        kMaxWeight.
+   * @return ok() if updated, error if the tower is unknown or weight invalid.
+   */
+  Status SetWeight(ControlTowerId id, double weight);
+
+  /** @return Weight of a control tower, or 0 if unknown. */
+  double GetWeight(ControlTowerId id) const;
+
  private:
+  /** @return ok() if weight is valid, otherwise InvalidArgument. */
+  static Status CheckWeight(double weight);
+
+  /** Number of ring replicas of a tower with the given weight. */
+  unsigned int ReplicasForWeight(double weight) const;
+
   struct ControlTowerIdHash {
     size_t operator()(ControlTowerId id) const {
       return MurmurHash2<ControlTowerId>()(id);
@@ -55,10 +119,12 @@ class ConsistentHashTowerRouter : public ControlTowerRouter {
   };
 
   std::unordered_map<ControlTowerId, HostId> host_ids_;
+  std::unordered_map<ControlTowerId, double> weights_;
   ConsistentHash<LogID,
                  ControlTowerId,
                  MurmurHash2<LogID>,
                  ControlTowerIdHash> mapping_;
+  unsigned int replicas_;
   size_t control_towers_per_log_;
 };
 
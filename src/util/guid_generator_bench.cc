@@ -2,35 +2,75 @@
 //  This source code is licensed under the BSD-style license found in the
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <random>
 
-#include <vector>
+#include "src/util/benchharness.h"
+#include "src/util/common/guid_generator.h"
 
-#include <folly/Benchmark.h>
-#include <folly/Foreach.h>
+namespace rocketspeed {
 
-#include "common/init/Init.h"
-#include "src/util/common/guid_generator.h"
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+// Previous implementation: two draws from a std::mt19937_64 per GUID.
+BENCHMARK(Mt19937Generation, n) {
+  BenchmarkSuspender braces;
+  std::mt19937_64 rng;
+  braces.Dismiss();
 
-using namespace std;
-using namespace folly;
-using namespace rocketspeed;
+  for (size_t i = 0; i < n; ++i) {
+    GUID guid;
+    guid.hi = rng();
+    guid.lo = rng();
+    DoNotOptimizeAway(guid);
+  }
+}
 
-// Spoiler: it's 78.11M iters/s
-BENCHMARK(guidGeneration, n) {
+BENCHMARK_RELATIVE(GUIDGeneration, n) {
   BenchmarkSuspender braces;
   GUIDGenerator gen;
-  braces.dismiss();
+  braces.Dismiss();
 
-  FOR_EACH_RANGE (i, 0, n) {
+  for (size_t i = 0; i < n; ++i) {
     auto guid = gen.Generate();
-    doNotOptimizeAway(guid);
+    DoNotOptimizeAway(guid);
   }
 }
 
-int main(int argc, char** argv) {
-  facebook::initFacebook(&argc, &argv);
+// How a publisher stamps a MsgId.
+BENCHMARK_RELATIVE(ThreadLocalGUIDGeneration, n) {
+  for (size_t i = 0; i < n; ++i) {
+    auto guid = GUIDGenerator::ThreadLocalGUIDGenerator()->Generate();
+    DoNotOptimizeAway(guid);
+  }
+}
+
+BENCHMARK(GUIDStringGeneration, n) {
+  BenchmarkSuspender braces;
+  GUIDGenerator gen;
+  braces.Dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    auto guid = gen.GenerateString();
+    DoNotOptimizeAway(guid);
+  }
+}
 
-  runBenchmarks();
+BENCHMARK_RELATIVE(GUIDBufferGeneration, n) {
+  BenchmarkSuspender braces;
+  GUIDGenerator gen;
+  char buf[16];
+  braces.Dismiss();
 
-  return 0;
+  for (size_t i = 0; i < n; ++i) {
+    gen.Generate(buf);
+    DoNotOptimizeAway(buf);
+  }
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
 }
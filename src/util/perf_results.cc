@@ -0,0 +1,414 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include "src/util/perf_results.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <utility>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace rocketspeed {
+
+namespace {
+
+void AppendJsonString(std::string* out, const std::string& str) {
+  out->push_back('"');
+  for (char c : str) {
+    switch (c) {
+      case '"': out->append("\\\""); break;
+      case '\\': out->append("\\\\"); break;
+      case '\n': out->append("\\n"); break;
+      case '\t': out->append("\\t"); break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          snprintf(buffer, sizeof(buffer), "\\u%04x",
+                   static_cast<unsigned int>(c));
+          out->append(buffer);
+        } else {
+          out->push_back(c);
+        }
+    }
+  }
+  out->push_back('"');
+}
+
+/**
+ * Minimal JSON reader, sufficient for the format written by ToJson. Values
+ * that are not needed are skipped, whatever their type.
+ */
+class JsonReader {
+ public:
+  explicit JsonReader(const std::string& json) : json_(json), pos_(0) {}
+
+  Status ParseResults(PerfResults* out) {
+    Status st = ParseObject([&] (const std::string& key) {
+      if (key == "metrics") {
+        return ParseObject([&] (const std::string& name) {
+          return ParseMetric(name, out);
+        });
+      }
+      return SkipValue();
+    });
+    if (st.ok()) {
+      SkipWhitespace();
+      if (pos_ != json_.size()) {
+        st = Error("trailing characters");
+      }
+    }
+    return st;
+  }
+
+ private:
+  Status ParseMetric(const std::string& name, PerfResults* out) {
+    PerfMetric metric;
+    Status st = ParseObject([&] (const std::string& key) {
+      if (key == "unit") {
+        return ParseString(&metric.unit);
+      } else if (key == "higher_is_better") {
+        return ParseBool(&metric.higher_is_better);
+      } else if (key == "samples") {
+        return ParseArray([&] () {
+          double value;
+          Status s = ParseNumber(&value);
+          if (s.ok()) {
+            metric.samples.push_back(value);
+          }
+          return s;
+        });
+      }
+      return SkipValue();
+    });
+    if (st.ok()) {
+      for (double value : metric.samples) {
+        out->AddSample(name, metric.unit, metric.higher_is_better, value);
+      }
+    }
+    return st;
+  }
+
+  template <typename Function>
+  Status ParseObject(Function on_field) {
+    if (!Consume('{')) {
+      return Error("expected object");
+    }
+    if (Consume('}')) {
+      return Status::OK();
+    }
+    do {
+      std::string key;
+      Status st = ParseString(&key);
+      if (!st.ok()) {
+        return st;
+      }
+      if (!Consume(':')) {
+        return Error("expected ':'");
+      }
+      st = on_field(key);
+      if (!st.ok()) {
+        return st;
+      }
+    } while (Consume(','));
+    return Consume('}') ? Status::OK() : Error("expected '}'");
+  }
+
+  template <typename Function>
+  Status ParseArray(Function on_element) {
+    if (!Consume('[')) {
+      return Error("expected array");
+    }
+    if (Consume(']')) {
+      return Status::OK();
+    }
+    do {
+      Status st = on_element();
+      if (!st.ok()) {
+        return st;
+      }
+    } while (Consume(','));
+    return Consume(']') ? Status::OK() : Error("expected ']'");
+  }
+
+  Status ParseString(std::string* out) {
+    if (!Consume('"')) {
+      return Error("expected string");
+    }
+    out->clear();
+    while (pos_ < json_.size() && json_[pos_] != '"') {
+      char c = json_[pos_++];
+      if (c == '\\') {
+        if (pos_ >= json_.size()) {
+          break;
+        }
+        c = json_[pos_++];
+        switch (c) {
+          case 'n': out->push_back('\n'); break;
+          case 't': out->push_back('\t'); break;
+          case 'r': out->push_back('\r'); break;
+          case 'b': out->push_back('\b'); break;
+          case 'f': out->push_back('\f'); break;
+          case 'u': {
+            // Only code points written by AppendJsonString are supported.
+            if (pos_ + 4 > json_.size()) {
+              return Error("bad escape");
+            }
+            const std::string hex = json_.substr(pos_, 4);
+            pos_ += 4;
+            out->push_back(
+              static_cast<char>(strtol(hex.c_str(), nullptr, 16)));
+          } break;
+          default: out->push_back(c); break;
+        }
+      } else {
+        out->push_back(c);
+      }
+    }
+    return Consume('"') ? Status::OK() : Error("unterminated string");
+  }
+
+  Status ParseNumber(double* out) {
+    SkipWhitespace();
+    const char* start = json_.c_str() + pos_;
+    char* end;
+    *out = strtod(start, &end);
+    if (end == start) {
+      return Error("expected number");
+    }
+    pos_ += static_cast<size_t>(end - start);
+    return Status::OK();
+  }
+
+  Status ParseBool(bool* out) {
+    SkipWhitespace();
+    if (json_.compare(pos_, 4, "true") == 0) {
+      *out = true;
+      pos_ += 4;
+    } else if (json_.compare(pos_, 5, "false") == 0) {
+      *out = false;
+      pos_ += 5;
+    } else {
+      return Error("expected boolean");
+    }
+    return Status::OK();
+  }
+
+  Status SkipValue() {
+    SkipWhitespace();
+    if (pos_ >= json_.size()) {
+      return Error("expected value");
+    }
+    switch (json_[pos_]) {
+      case '{':
+        return ParseObject([&] (const std::string&) { return SkipValue(); });
+      case '[':
+        return ParseArray([&] () { return SkipValue(); });
+      case '"': {
+        std::string ignored;
+        return ParseString(&ignored);
+      }
+      case 't':
+      case 'f': {
+        bool ignored;
+        return ParseBool(&ignored);
+      }
+      case 'n':
+        if (json_.compare(pos_, 4, "null") == 0) {
+          pos_ += 4;
+          return Status::OK();
+        }
+        return Error("expected value");
+      default: {
+        double ignored;
+        return ParseNumber(&ignored);
+      }
+    }
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < json_.size() && isspace(json_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ < json_.size() && json_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  Status Error(const char* what) const {
+    return Status::InvalidArgument("Invalid benchmark results JSON: " +
+      std::string(what) + " at offset " + std::to_string(pos_));
+  }
+
+  const std::string& json_;
+  size_t pos_;
+};
+
+}  // namespace
+
+void PerfResults::AddSample(const std::string& name,
+                            const std::string& unit,
+                            bool higher_is_better,
+                            double value) {
+  PerfMetric& metric = metrics_[name];
+  metric.unit = unit;
+  metric.higher_is_better = higher_is_better;
+  metric.samples.push_back(value);
+}
+
+void PerfResults::Merge(const PerfResults& other) {
+  for (const auto& entry : other.metrics_) {
+    PerfMetric& metric = metrics_[entry.first];
+    metric.unit = entry.second.unit;
+    metric.higher_is_better = entry.second.higher_is_better;
+    metric.samples.insert(metric.samples.end(),
+                          entry.second.samples.begin(),
+                          entry.second.samples.end());
+  }
+}
+
+std::string PerfResults::ToJson() const {
+  std::string json = "{\n  \"metrics\": {";
+  bool first_metric = true;
+  for (const auto& entry : metrics_) {
+    const PerfMetric& metric = entry.second;
+    json.append(first_metric ? "\n    " : ",\n    ");
+    first_metric = false;
+    AppendJsonString(&json, entry.first);
+    json.append(": {\n      \"unit\": ");
+    AppendJsonString(&json, metric.unit);
+    json.append(",\n      \"higher_is_better\": ");
+    json.append(metric.higher_is_better ? "true" : "false");
+    json.append(",\n      \"samples\": [");
+    for (size_t i = 0; i < metric.samples.size(); ++i) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%s%.17g",
+               i ? ", " : "", metric.samples[i]);
+      json.append(buffer);
+    }
+    json.append("]\n    }");
+  }
+  json.append(first_metric ? "}\n}\n" : "\n  }\n}\n");
+  return json;
+}
+
+Status PerfResults::FromJson(const std::string& json, PerfResults* out) {
+  PerfResults results;
+  Status st = JsonReader(json).ParseResults(&results);
+  if (st.ok()) {
+    out->Merge(results);
+  }
+  return st;
+}
+
+Status PerfResults::WriteToFile(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    return Status::IOError("Failed to open " + path);
+  }
+  const std::string json = ToJson();
+  const bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+  if (fclose(file) != 0 || !ok) {
+    return Status::IOError("Failed to write " + path);
+  }
+  return Status::OK();
+}
+
+Status PerfResults::ReadFromFile(const std::string& path, PerfResults* out) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) {
+    return Status::IOError("Failed to open " + path);
+  }
+  std::string json;
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    json.append(buffer, count);
+  }
+  const bool failed = ferror(file) != 0;
+  fclose(file);
+  if (failed) {
+    return Status::IOError("Failed to read " + path);
+  }
+  Status st = FromJson(json, out);
+  if (!st.ok()) {
+    return Status::InvalidArgument(path + ": " + st.ToString());
+  }
+  return st;
+}
+
+double Median(std::vector<double> samples) {
+  assert(!samples.empty());
+  const size_t mid = samples.size() / 2;
+  std::nth_element(samples.begin(), samples.begin() + mid, samples.end());
+  if (samples.size() % 2) {
+    return samples[mid];
+  }
+  const double upper = samples[mid];
+  const double lower =
+    *std::max_element(samples.begin(), samples.begin() + mid);
+  return (lower + upper) / 2.0;
+}
+
+double MannWhitneyPValue(const std::vector<double>& a,
+                         const std::vector<double>& b) {
+  if (a.empty() || b.empty()) {
+    return 1.0;
+  }
+
+  // Rank all samples together, averaging the ranks of ties.
+  std::vector<std::pair<double, bool>> all;  // value, is from a
+  for (double value : a) {
+    all.emplace_back(value, true);
+  }
+  for (double value : b) {
+    all.emplace_back(value, false);
+  }
+  std::sort(all.begin(), all.end());
+
+  const double n1 = static_cast<double>(a.size());
+  const double n2 = static_cast<double>(b.size());
+  const double n = n1 + n2;
+  double rank_sum_a = 0.0;
+  double tie_term = 0.0;
+  for (size_t i = 0; i < all.size(); ) {
+    size_t j = i;
+    while (j < all.size() && all[j].first == all[i].first) {
+      ++j;
+    }
+    // Elements [i, j) share ranks i + 1 to j.
+    const double rank = static_cast<double>(i + j + 1) / 2.0;
+    const double ties = static_cast<double>(j - i);
+    tie_term += ties * ties * ties - ties;
+    for (size_t k = i; k < j; ++k) {
+      if (all[k].second) {
+        rank_sum_a += rank;
+      }
+    }
+    i = j;
+  }
+
+  const double u = rank_sum_a - n1 * (n1 + 1.0) / 2.0;
+  const double mean = n1 * n2 / 2.0;
+  const double variance =
+    n1 * n2 / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+  if (variance <= 0.0) {
+    // All samples are equal.
+    return 1.0;
+  }
+  const double z =
+    std::max(0.0, std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+  return std::erfc(z / std::sqrt(2.0));
+}
+
+}  // namespace rocketspeed
@@ -0,0 +1,93 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "include/Status.h"
+
+namespace rocketspeed {
+
+/** Repeated measurements of a single benchmark result. */
+struct PerfMetric {
+  /** Unit of the samples, e.g. "ns/iter". */
+  std::string unit;
+
+  /** True if larger values are better, e.g. for throughput. */
+  bool higher_is_better = false;
+
+  /** One sample per trial. */
+  std::vector<double> samples;
+};
+
+/**
+ * Machine-readable benchmark results, keyed by metric name. Results are
+ * stored as JSON so that runs can be kept as baselines and compared later:
+ *
+ *   {
+ *     "metrics": {
+ *       "<name>": {
+ *         "unit": "ns/iter",
+ *         "higher_is_better": false,
+ *         "samples": [12.5, 12.25]
+ *       }
+ *     }
+ *   }
+ */
+class PerfResults {
+ public:
+  /** Appends a sample to a metric, creating the metric if necessary. */
+  void AddSample(const std::string& name,
+                 const std::string& unit,
+                 bool higher_is_better,
+                 double value);
+
+  /**
+   * Appends samples from other results, e.g. from repeated runs of the same
+   * benchmark. Metrics not present yet are copied.
+   */
+  void Merge(const PerfResults& other);
+
+  const std::map<std::string, PerfMetric>& GetMetrics() const {
+    return metrics_;
+  }
+
+  /** Serializes the results to JSON. */
+  std::string ToJson() const;
+
+  /**
+   * Parses results from JSON produced by ToJson. Unknown fields are ignored.
+   */
+  static Status FromJson(const std::string& json, PerfResults* out);
+
+  /** Writes the results as JSON to a file, replacing its contents. */
+  Status WriteToFile(const std::string& path) const;
+
+  /** Reads results from a JSON file, merging them into out. */
+  static Status ReadFromFile(const std::string& path, PerfResults* out);
+
+ private:
+  std::map<std::string, PerfMetric> metrics_;
+};
+
+/** @return The median of a non-empty set of samples. */
+double Median(std::vector<double> samples);
+
+/**
+ * Two-sided Mann-Whitney U test of whether two sets of samples come from
+ * the same distribution. The test makes no assumption on the shape of the
+ * distribution, which suits benchmark timings with their long upper tails.
+ * Uses the normal approximation with tie and continuity corrections, so is
+ * only meaningful with a few samples on each side.
+ *
+ * @return The p-value, or 1.0 if either set is empty.
+ */
+double MannWhitneyPValue(const std::vector<double>& a,
+                         const std::vector<double>& b);
+
+}  // namespace rocketspeed
@@ -27,6 +27,36 @@ namespace rocketspeed {
 
 const int kDebugLogChunkSize = 128 * 1024;
 
+/**
+ * Writes the timestamp and thread prefix of a log line into buf.
+ *
+ * @param buf Output buffer.
+ * @param size Size of buf in bytes.
+ * @param unix_micros Wall clock time of the entry, in microseconds.
+ * @param thread_id Identifier of the thread that produced the entry.
+ * @param thread_name Name of the thread that produced the entry.
+ * @return Number of characters that snprintf would have written.
+ */
+inline int FormatLogPrefix(char* buf,
+                           size_t size,
+                           uint64_t unix_micros,
+                           uint64_t thread_id,
+                           const char* thread_name) {
+  const time_t seconds = static_cast<time_t>(unix_micros / 1000000);
+  struct tm t;
+  localtime_r(&seconds, &t);
+  return snprintf(buf, size,
+                  "%02d/%02d-%02d:%02d:%02d.%06d %llx %-13.13s ",
+                  t.tm_mon + 1,
+                  t.tm_mday,
+                  t.tm_hour,
+                  t.tm_min,
+                  t.tm_sec,
+                  static_cast<int>(unix_micros % 1000000),
+                  static_cast<long long unsigned int>(thread_id),
+                  thread_name);
+}
+
 class PosixLogger : public Logger {
  private:
   FILE* file_;
@@ -84,19 +114,9 @@ class PosixLogger : public Logger {
 
       struct timeval now_tv;
       gettimeofday(&now_tv, nullptr);
-      const time_t seconds = now_tv.tv_sec;
-      struct tm t;
-      localtime_r(&seconds, &t);
-      p += snprintf(p, limit - p,
-                    "%02d/%02d-%02d:%02d:%02d.%06d %llx %-13.13s ",
-                    t.tm_mon + 1,
-                    t.tm_mday,
-                    t.tm_hour,
-                    t.tm_min,
-                    t.tm_sec,
-                    static_cast<int>(now_tv.tv_usec),
-                    static_cast<long long unsigned int>(thread_id),
-                    tname_.c_str());
+      const uint64_t now_micros =
+        static_cast<uint64_t>(now_tv.tv_sec) * 1000000 + now_tv.tv_usec;
+      p += FormatLogPrefix(p, limit - p, now_micros, thread_id, tname_.c_str());
 
       // Print the message
       if (p < limit) {
@@ -121,46 +141,55 @@ class PosixLogger : public Logger {
       }
 
       assert(p <= limit);
-      const size_t write_size = p - base;
-
-#ifdef ROCKETSPEED_FALLOCATE_PRESENT
-      // If this write would cross a boundary of kDebugLogChunkSize
-      // space, pre-allocate more space to avoid overly large
-      // allocations from filesystem allocsize options.
-      const size_t log_size = log_size_;
-      const size_t last_allocation_chunk =
-        ((kDebugLogChunkSize - 1 + log_size) / kDebugLogChunkSize);
-      const size_t desired_allocation_chunk =
-        ((kDebugLogChunkSize - 1 + log_size + write_size) /
-           kDebugLogChunkSize);
-      if (last_allocation_chunk != desired_allocation_chunk) {
-        fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0,
-                  desired_allocation_chunk * kDebugLogChunkSize);
-      }
-#endif
-
-      size_t sz = fwrite(base, 1, write_size, file_);
-      flush_pending_ = true;
-      assert(sz == write_size);
-      if (sz > 0) {
-        log_size_ += write_size;
-      }
-      uint64_t now_micros = static_cast<uint64_t>(now_tv.tv_sec) * 1000000 +
-        now_tv.tv_usec;
-      if (now_micros - last_flush_micros_ >= flush_every_seconds_ * 1000000) {
-        flush_pending_ = false;
-        fflush(file_);
-        last_flush_micros_ = now_micros;
-      }
+      WriteBuffer(base, p - base, now_micros);
       if (base != buffer) {
         delete[] base;
       }
       break;
     }
   }
+
+  virtual void AppendLine(const char* line, size_t size) {
+    struct timeval now_tv;
+    gettimeofday(&now_tv, nullptr);
+    WriteBuffer(line, size,
+      static_cast<uint64_t>(now_tv.tv_sec) * 1000000 + now_tv.tv_usec);
+  }
+
   size_t GetLogFileSize() const {
     return log_size_;
   }
+
+ private:
+  void WriteBuffer(const char* base, size_t write_size, uint64_t now_micros) {
+#ifdef ROCKETSPEED_FALLOCATE_PRESENT
+    // If this write would cross a boundary of kDebugLogChunkSize
+    // space, pre-allocate more space to avoid overly large
+    // allocations from filesystem allocsize options.
+    const size_t log_size = log_size_;
+    const size_t last_allocation_chunk =
+      ((kDebugLogChunkSize - 1 + log_size) / kDebugLogChunkSize);
+    const size_t desired_allocation_chunk =
+      ((kDebugLogChunkSize - 1 + log_size + write_size) /
+         kDebugLogChunkSize);
+    if (last_allocation_chunk != desired_allocation_chunk) {
+      fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0,
+                desired_allocation_chunk * kDebugLogChunkSize);
+    }
+#endif
+
+    size_t sz = fwrite(base, 1, write_size, file_);
+    flush_pending_ = true;
+    assert(sz == write_size);
+    if (sz > 0) {
+      log_size_ += write_size;
+    }
+    if (now_micros - last_flush_micros_ >= flush_every_seconds_ * 1000000) {
+      flush_pending_ = false;
+      fflush(file_);
+      last_flush_micros_ = now_micros;
+    }
+  }
 };
 
 }  // namespace rocketspeed
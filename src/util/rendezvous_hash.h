@@ -0,0 +1,270 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#pragma once
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "src/util/common/autovector.h"
+#include "src/util/common/hash.h"
+
+namespace rocketspeed {
+
+/**
+ * Weighted rendezvous (highest random weight) hashing. Every slot scores
+ * each key, and the key is mapped to the slot with the highest score. As
+ * with ConsistentHash, adding or removing a slot only moves the keys of
+ * that slot, but here the balance is exact in expectation and weights may
+ * be any positive real, without replicas.
+ *
+ * For n slots:
+ *   Memory usage: O(n)
+ *   Get time: O(n)
+ *
+ * Get scans every slot, so this is preferable to ConsistentHash only for
+ * small sets of slots, roughly up to a few dozen. Balance is much better:
+ * with 64 slots and 1M keys the busiest slot gets 1.02x its share, against
+ * 1.53x on a ring with 20 replicas per slot (see consistent_hash_bench).
+ *
+ * Slot type needs to be comparable with std::equal_to.
+ */
+template <class Key,
+          class Slot,
+          class KeyHash = MurmurHash2<Key>,
+          class SlotHash = MurmurHash2<Slot>>
+class RendezvousHash {
+ public:
+  /**
+   * Constructs a RendezvousHash object with given hash function.
+   *
+   * @param keyHash The hash function object for keys.
+   * @param slotHash The hash function object for slots.
+   */
+  explicit RendezvousHash(const KeyHash& keyHash = KeyHash(),
+                          const SlotHash& slotHash = SlotHash())
+  : keyHash_(keyHash)
+  , slotHash_(slotHash)
+  , totalWeight_(0.0)
+  , unweighted_(true) {
+  }
+
+  /** Copyable and movable */
+  RendezvousHash(const RendezvousHash&) = default;
+  RendezvousHash& operator=(const RendezvousHash&) = default;
+  RendezvousHash(RendezvousHash&&) = default;
+  RendezvousHash& operator=(RendezvousHash&&) = default;
+
+  /**
+   * Adds a new slot to the mapping.
+   *
+   * @param slot The slot to add.
+   * @param weight Weight of the slot, must be positive. The slot receives
+   *        weight / (total weight) of the keys.
+   */
+  void Add(const Slot& slot, double weight = 1.0);
+
+  /**
+   * Removes a slot from the mapping.
+   *
+   * @param slot The slot to remove.
+   */
+  void Remove(const Slot& slot);
+
+  /**
+   * Gets the slot that key is mapped to. The structure must not be empty.
+   *
+   * @param key The key to get the mapping for.
+   * @return slot The slot that the key is mapped to.
+   */
+  const Slot& Get(const Key& key) const;
+
+  /**
+   * Maps the key to multiple slots, in order of preference. The structure
+   * must contain at least count slots.
+   *
+   * @param key The key to get the mapping for.
+   * @param count How many slots to return.
+   * @param out_begin Iterator to the beginning of where to put the result.
+   */
+  template<class IT>
+  void MultiGet(const Key& key, size_t count, IT out_begin) const;
+
+  /**
+   * The number of slots in the mapping.
+   */
+  size_t SlotCount() const {
+    return slots_.size();
+  }
+
+  /**
+   * Computes the expected ratio of keys mapped to a slot.
+   *
+   * @param slot The slot to check.
+   * @return The fraction of keys mapped to slot.
+   */
+  double SlotRatio(const Slot& slot) const;
+
+  /**
+   * Clears the structure.
+   */
+  void Clear() {
+    slots_.clear();
+    totalWeight_ = 0.0;
+    unweighted_ = true;
+  }
+
+  /**
+   * Test if structure is empty.
+   */
+  bool Empty() const {
+    return slots_.empty();
+  }
+
+ private:
+  struct Entry {
+    size_t hash;    // Hash of the slot, mixed into the key hash
+    double weight;
+    Slot slot;
+  };
+
+  /**
+   * Score of a slot for a key. The key goes to the slot with the highest
+   * score. With u uniform in (0, 1), -weight / ln(u) is an exponential
+   * variate scaled by weight, so the maximum falls on each slot with
+   * probability proportional to its weight.
+   */
+  static double Score(size_t keyHash, const Entry& entry) {
+    // Top 53 bits make a double in (0, 1), never 0 or 1.
+    const double u =
+      (static_cast<double>(Draw(keyHash, entry)) + 0.5) /
+      9007199254740992.0;  // 2^53
+    return -entry.weight / log(u);
+  }
+
+  /**
+   * The random draw behind Score. Score is increasing in the draw, so when
+   * all weights are equal, comparing draws gives the same ranking without
+   * the logarithm.
+   */
+  static uint64_t Draw(size_t keyHash, const Entry& entry) {
+    return static_cast<uint64_t>(
+      MurmurHash2<size_t>()(keyHash ^ entry.hash)) >> 11;
+  }
+
+  /** Recomputes unweighted_ after slots change. */
+  void UpdateUnweighted();
+
+  std::vector<Entry> slots_;
+  KeyHash keyHash_;    // Hash function for keys
+  SlotHash slotHash_;  // Hash function for slots
+  double totalWeight_;
+  bool unweighted_;    // All slots have the same weight, so rank on draws
+};
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+void RendezvousHash<Key, Slot, KeyHash, SlotHash>::Add(
+    const Slot& slot,
+    double weight) {
+  assert(weight > 0.0);
+  slots_.push_back(Entry{slotHash_(slot), weight, slot});
+  totalWeight_ += weight;
+  UpdateUnweighted();
+}
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+void RendezvousHash<Key, Slot, KeyHash, SlotHash>::Remove(
+    const Slot& slot) {
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    if (it->slot == slot) {
+      totalWeight_ -= it->weight;
+      slots_.erase(it);
+      break;
+    }
+  }
+  if (slots_.empty()) {
+    totalWeight_ = 0.0;  // Don't accumulate rounding errors.
+  }
+  UpdateUnweighted();
+}
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+const Slot& RendezvousHash<Key, Slot, KeyHash, SlotHash>::Get(
+    const Key& key) const {
+  assert(!slots_.empty());
+  const size_t keyHash = keyHash_(key);
+  const Entry* best = &slots_[0];
+  if (unweighted_) {
+    uint64_t bestDraw = Draw(keyHash, *best);
+    for (size_t i = 1; i < slots_.size(); ++i) {
+      const uint64_t draw = Draw(keyHash, slots_[i]);
+      if (draw > bestDraw) {
+        bestDraw = draw;
+        best = &slots_[i];
+      }
+    }
+    return best->slot;
+  }
+  double bestScore = Score(keyHash, *best);
+  for (size_t i = 1; i < slots_.size(); ++i) {
+    const double score = Score(keyHash, slots_[i]);
+    if (score > bestScore) {
+      bestScore = score;
+      best = &slots_[i];
+    }
+  }
+  return best->slot;
+}
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+template <class IT>
+void RendezvousHash<Key, Slot, KeyHash, SlotHash>::MultiGet(
+    const Key& key, size_t count, IT out_begin) const {
+  assert(slots_.size() >= count);
+  const size_t keyHash = keyHash_(key);
+  autovector<std::pair<double, size_t>, 16> scores;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    // Draws have 53 bits, so they are exact as doubles.
+    scores.emplace_back(unweighted_
+                          ? static_cast<double>(Draw(keyHash, slots_[i]))
+                          : Score(keyHash, slots_[i]),
+                        i);
+  }
+  // Highest score first; ties go to the slot added first, as in Get.
+  std::partial_sort(scores.begin(), scores.begin() + count, scores.end(),
+    [] (const std::pair<double, size_t>& a,
+        const std::pair<double, size_t>& b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+  for (size_t i = 0; i < count; ++i) {
+    out_begin[i] = slots_[scores[i].second].slot;
+  }
+}
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+void RendezvousHash<Key, Slot, KeyHash, SlotHash>::UpdateUnweighted() {
+  unweighted_ = true;
+  for (const Entry& entry : slots_) {
+    if (entry.weight != slots_[0].weight) {
+      unweighted_ = false;
+      break;
+    }
+  }
+}
+
+template <class Key, class Slot, class KeyHash, class SlotHash>
+double RendezvousHash<Key, Slot, KeyHash, SlotHash>::SlotRatio(
+    const Slot& slot) const {
+  for (const Entry& entry : slots_) {
+    if (entry.slot == slot) {
+      return entry.weight / totalWeight_;
+    }
+  }
+  return 0.0;
+}
+
+}  // namespace rocketspeed
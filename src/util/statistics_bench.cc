@@ -0,0 +1,73 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <cstdint>
+#include <string>
+
+#include "src/util/benchharness.h"
+#include "src/util/common/statistics.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+BENCHMARK(CounterAdd, n) {
+  Statistics stats;
+  Counter* counter = stats.AddCounter("counter");
+  for (size_t i = 0; i < n; ++i) {
+    counter->Add(1);
+  }
+  DoNotOptimizeAway(counter);
+}
+
+BENCHMARK(HistogramRecord, n) {
+  // Typical parameters for a latency histogram in microseconds.
+  Histogram histogram(0, 1e6, 1.0, 1.1);
+  for (size_t i = 0; i < n; ++i) {
+    histogram.Record(static_cast<double>(i & 0xffff));
+  }
+  DoNotOptimizeAway(histogram);
+}
+
+BENCHMARK(HistogramPercentile, n) {
+  Histogram histogram(0, 1e6, 1.0, 1.1);
+  {
+    BenchmarkSuspender suspender;
+    for (uint64_t i = 0; i < 100000; ++i) {
+      histogram.Record(i);
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    double p99 = histogram.Percentile(0.99);
+    DoNotOptimizeAway(p99);
+  }
+}
+
+BENCHMARK(StatisticsAggregate, n) {
+  Statistics stats;
+  Statistics other;
+  {
+    BenchmarkSuspender suspender;
+    for (int i = 0; i < 20; ++i) {
+      std::string name = "stat" + std::to_string(i);
+      stats.AddCounter(name);
+      other.AddCounter(name)->Add(1);
+      stats.AddHistogram(name + ".latency", 0, 1e6, 1.0, 1.1);
+      other.AddHistogram(name + ".latency", 0, 1e6, 1.0, 1.1)->Record(1);
+    }
+  }
+  // As done by every worker when stats are reported.
+  for (size_t i = 0; i < n; ++i) {
+    stats.Aggregate(other);
+  }
+  DoNotOptimizeAway(stats);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include "include/Types.h"
 #include "src/messages/stream_socket.h"
+#include "src/util/common/memory_usage.h"
 #include "src/util/common/thread_check.h"
 
 namespace rocketspeed {
@@ -73,6 +74,12 @@ class SubscriptionMap {
     }
   }
 
+  /** @return Estimated heap memory used by the map. */
+  size_t GetHeapMemoryUsage() const {
+    thread_check_.Check();
+    return HeapMemoryUsage(map_);
+  }
+
  private:
   std::unordered_map<StreamID, std::unordered_map<SubscriptionID, T>> map_;
   ThreadCheck thread_check_;
@@ -0,0 +1,201 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/port/Env.h"
+#include "src/util/async_logger.h"
+#include "src/util/async_logger_args.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class AsyncLoggerTest {
+ public:
+  AsyncLoggerTest() : env_(Env::Default()) {}
+
+  Env* env_;
+};
+
+namespace {
+
+/** Sink that keeps every line it receives in memory. */
+class CapturingLogger : public Logger {
+ public:
+  CapturingLogger() : Logger(DEBUG_LEVEL) {}
+
+  void Append(const char* format, va_list ap) override {
+    char buffer[1024];
+    vsnprintf(buffer, sizeof(buffer), format, ap);
+    AppendLine(buffer, strlen(buffer));
+  }
+
+  void AppendLine(const char* line, size_t size) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lines_.emplace_back(line, size);
+  }
+
+  std::vector<std::string> GetLines() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lines_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::string> lines_;
+};
+
+/** Returns the part of a line after the timestamp and thread prefix. */
+std::string Message(const std::string& line) {
+  size_t pos = line.find('[');
+  return pos == std::string::npos ? line : line.substr(pos);
+}
+
+bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+    str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+TEST(AsyncLoggerTest, Formatting) {
+  auto sink = std::make_shared<CapturingLogger>();
+  AsyncLogger logger(env_, sink);
+  logger.SetInfoLogLevel(INFO_LEVEL);
+
+  std::string topic = "some_topic";
+  LOG_INFO(&logger, "plain");
+  LOG_INFO(&logger, "%d %u %ld %llu %zu %x %c %%",
+    -42, 42u, -7L, 1ULL << 40, static_cast<size_t>(9), 255u, 'z');
+  LOG_WARN(&logger, "%s/%5s/%-4s|%.3s", topic.c_str(), "ab", "cd", "abcdef");
+  LOG_ERROR(&logger, "%.2f %e %*d %.*s", 3.14159, 1e10, 6, 12, 2, "xyz");
+  LOG_DEBUG(&logger, "filtered out");
+  logger.Flush();
+
+  char expected[256];
+  snprintf(expected, sizeof(expected), "%d %u %ld %llu %zu %x %c %%",
+    -42, 42u, -7L, 1ULL << 40, static_cast<size_t>(9), 255u, 'z');
+  auto lines = sink->GetLines();
+  ASSERT_EQ(lines.size(), 4U);
+  ASSERT_TRUE(lines[0].find("async_logger_test.cc:") != std::string::npos);
+  ASSERT_TRUE(EndsWith(lines[0], ": plain\n"));
+  ASSERT_EQ(Message(lines[0]).substr(0, 7), "[INFO] ");
+  ASSERT_TRUE(EndsWith(lines[1], std::string(expected) + "\n"));
+  ASSERT_EQ(Message(lines[2]).substr(0, 7), "[WARN] ");
+  ASSERT_TRUE(EndsWith(lines[2], "some_topic/   ab/cd  |abc\n"));
+  ASSERT_TRUE(EndsWith(lines[3], "3.14 1.000000e+10     12 xy\n"));
+}
+
+TEST(AsyncLoggerTest, NullString) {
+  alignas(8) char buffer[64];
+  detail::AsyncLogArgWriter writer(buffer, buffer + sizeof(buffer));
+  ASSERT_TRUE(writer.PutString(nullptr));
+  ASSERT_TRUE(writer.PutString("abc"));
+  ASSERT_EQ(writer.Position() - buffer, 16);
+
+  detail::AsyncLogArgReader reader(buffer);
+  ASSERT_TRUE(reader.GetString() == nullptr);
+  ASSERT_EQ(std::string(reader.GetString()), "abc");
+}
+
+TEST(AsyncLoggerTest, UnterminatedString) {
+  auto sink = std::make_shared<CapturingLogger>();
+  AsyncLogger logger(env_, sink);
+  logger.SetInfoLogLevel(INFO_LEVEL);
+
+  // Only the first bytes of each buffer may be read.
+  char line[64];
+  memset(line, 'x', sizeof(line));
+  memcpy(line, "line", 4);
+  logger.AppendLine(line, 4);
+  char topic[64];
+  memset(topic, 'y', sizeof(topic));
+  memcpy(topic, "topic", 5);
+  LOG_INFO(&logger, "%.5s|%.*s", topic, 2, topic);
+  logger.Flush();
+
+  auto lines = sink->GetLines();
+  ASSERT_EQ(lines.size(), 2U);
+  ASSERT_TRUE(EndsWith(lines[0], "line\n"));
+  ASSERT_TRUE(EndsWith(lines[1], ": topic|to\n"));
+
+  // The copy is capped at the precision, not at the end of the string.
+  alignas(8) char buffer[64];
+  detail::AsyncLogArgWriter writer(buffer, buffer + sizeof(buffer));
+  ASSERT_TRUE(writer.PutString(topic, 3));
+  detail::AsyncLogArgReader reader(buffer);
+  ASSERT_EQ(std::string(reader.GetString()), "top");
+}
+
+TEST(AsyncLoggerTest, DropsWhenFull) {
+  auto sink = std::make_shared<CapturingLogger>();
+  // Drain interval is long enough that only Flush drains the rings.
+  AsyncLogger logger(env_, sink, 0, 3600ULL * 1000000);
+  logger.SetInfoLogLevel(INFO_LEVEL);
+
+  const int kEntries = 10000;
+  for (int i = 0; i < kEntries; ++i) {
+    LOG_INFO(&logger, "entry %d", i);
+  }
+  ASSERT_GT(logger.GetDroppedCount(), 0U);
+  logger.Flush();
+
+  auto lines = sink->GetLines();
+  ASSERT_EQ(lines.size() - 1 + logger.GetDroppedCount(),
+            static_cast<uint64_t>(kEntries));
+  ASSERT_TRUE(lines.back().find("dropped") != std::string::npos);
+
+  // Space is reclaimed once drained.
+  LOG_INFO(&logger, "after drain");
+  logger.Flush();
+  ASSERT_TRUE(EndsWith(sink->GetLines().back(), "after drain\n"));
+}
+
+TEST(AsyncLoggerTest, MultipleThreads) {
+  auto sink = std::make_shared<CapturingLogger>();
+  const int kThreads = 8;
+  const int kEntries = 1000;
+  {
+    AsyncLogger logger(env_, sink, 1 << 20);
+    logger.SetInfoLogLevel(INFO_LEVEL);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&logger, t] () {
+        for (int i = 0; i < kEntries; ++i) {
+          LOG_INFO(&logger, "thread %d entry %d", t, i);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    ASSERT_EQ(logger.GetDroppedCount(), 0U);
+    // Destruction writes everything still pending.
+  }
+  auto lines = sink->GetLines();
+  ASSERT_EQ(lines.size(), static_cast<size_t>(kThreads * kEntries));
+
+  // Entries from each thread are written in order.
+  std::vector<int> next(kThreads, 0);
+  for (const std::string& line : lines) {
+    int t, i;
+    size_t pos = line.find("thread ");
+    ASSERT_TRUE(pos != std::string::npos);
+    ASSERT_EQ(sscanf(line.c_str() + pos, "thread %d entry %d", &t, &i), 2);
+    ASSERT_EQ(next[t], i);
+    ++next[t];
+  }
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "src/messages/messages.h"
+#include "src/util/common/block_pool.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class BlockPoolTest { };
+
+TEST(BlockPoolTest, ReuseOnSameThread) {
+  void* block = BlockPool::Allocate(100);
+  BlockPool::Free(block);
+  const BlockPoolStats before = BlockPool::GetStats();
+  for (int i = 0; i < 1000; ++i) {
+    void* again = BlockPool::Allocate(100);
+    ASSERT_EQ(again, block);
+    BlockPool::Free(again);
+  }
+  const BlockPoolStats after = BlockPool::GetStats();
+  ASSERT_EQ(after.allocations - before.allocations, 1000);
+  ASSERT_EQ(after.heap_allocations, before.heap_allocations);
+  BlockPool::Free(nullptr);
+}
+
+TEST(BlockPoolTest, Sizes) {
+  std::vector<std::pair<char*, size_t>> blocks;
+  for (size_t size : {size_t(0), size_t(1), size_t(48), size_t(49),
+                      size_t(1000), BlockPool::kMaxPooledSize,
+                      BlockPool::kMaxPooledSize + 1, size_t(1 << 20)}) {
+    char* block = static_cast<char*>(BlockPool::Allocate(size));
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(block) % alignof(void*), 0);
+    memset(block, static_cast<int>(blocks.size()), size);
+    blocks.emplace_back(block, size);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    for (size_t j = 0; j < blocks[i].second; ++j) {
+      ASSERT_EQ(blocks[i].first[j], static_cast<char>(i));
+    }
+    BlockPool::Free(blocks[i].first);
+  }
+}
+
+TEST(BlockPoolTest, FreeOnOtherThread) {
+  // Blocks allocated on one thread and freed on another go back to the
+  // allocating thread.
+  const size_t kBlocks = 100;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < kBlocks; ++i) {
+    blocks.push_back(BlockPool::Allocate(200));
+  }
+  const BlockPoolStats before = BlockPool::GetStats();
+  std::thread([&] () {
+    for (void* block : blocks) {
+      BlockPool::Free(block);
+    }
+  }).join();
+  for (size_t i = 0; i < kBlocks; ++i) {
+    void* block = BlockPool::Allocate(200);
+    ASSERT_TRUE(std::find(blocks.begin(), blocks.end(), block) !=
+                blocks.end());
+    blocks[i] = block;
+  }
+  const BlockPoolStats after = BlockPool::GetStats();
+  ASSERT_EQ(after.heap_allocations, before.heap_allocations);
+  ASSERT_EQ(after.remote_frees - before.remote_frees, kBlocks);
+  for (void* block : blocks) {
+    BlockPool::Free(block);
+  }
+}
+
+TEST(BlockPoolTest, FreeAfterThreadExit) {
+  // Blocks may outlive their thread, and the pool is reused by later threads.
+  std::vector<void*> blocks;
+  for (int t = 0; t < 4; ++t) {
+    const size_t first = blocks.size();
+    std::thread([&] () {
+      for (size_t i = 0; i < 10; ++i) {
+        blocks.push_back(BlockPool::Allocate(64 * i));
+      }
+    }).join();
+    std::thread([&] () {
+      for (size_t i = first; i < blocks.size(); i += 2) {
+        BlockPool::Free(blocks[i]);
+      }
+    }).join();
+  }
+  for (size_t i = 1; i < blocks.size(); i += 2) {
+    BlockPool::Free(blocks[i]);
+  }
+}
+
+TEST(BlockPoolTest, ConcurrentCrossFrees) {
+  // Threads allocate and free each other's blocks.
+  const int kThreads = 4;
+  const int kRounds = 10000;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<void*>> slots(kThreads);
+  for (auto& s : slots) {
+    s.resize(kRounds);
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] () {
+      for (int i = 0; i < kRounds; ++i) {
+        slots[t][i] = BlockPool::Allocate(static_cast<size_t>(i % 3000));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] () {
+      for (int i = 0; i < kRounds; ++i) {
+        BlockPool::Free(slots[(t + 1) % kThreads][i]);
+        BlockPool::Free(BlockPool::Allocate(static_cast<size_t>(i % 500)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(BlockPoolTest, PooledBuffer) {
+  PooledBuffer pooled = AllocatePooledBuffer(10);
+  ASSERT_TRUE(pooled.get_deleter().pooled);
+  memcpy(pooled.get(), "0123456789", 10);
+  PooledBuffer adopted(std::unique_ptr<char[]>(new char[10]).release());
+  ASSERT_TRUE(!adopted.get_deleter().pooled);
+  pooled = std::move(adopted);
+  ASSERT_TRUE(!pooled.get_deleter().pooled);
+}
+
+TEST(BlockPoolTest, Messages) {
+  // Messages and their receive buffers are pooled.
+  MessageData data(MessageType::mPublish, Tenant::GuestTenant,
+                   Slice("topic"), GuestNamespace, Slice("payload"));
+  std::string serial;
+  data.SerializeToString(&serial);
+
+  const BlockPoolStats before = BlockPool::GetStats();
+  std::unique_ptr<Message> msg;
+  std::thread([&] () {
+    PooledBuffer buffer = AllocatePooledBuffer(serial.size());
+    memcpy(buffer.get(), serial.data(), serial.size());
+    Slice slice(buffer.get(), serial.size());
+    msg = Message::CreateNewInstance(std::move(buffer), slice);
+  }).join();
+  ASSERT_TRUE(msg != nullptr);
+  const BlockPoolStats after = BlockPool::GetStats();
+  ASSERT_EQ(after.allocations - before.allocations, 2);
+  ASSERT_EQ(static_cast<MessageData*>(msg.get())->GetPayload().ToString(),
+            "payload");
+  msg.reset();
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
@@ -0,0 +1,54 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <chrono>
+#include <thread>
+
+#include "src/util/common/cached_clock.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class CachedClockTest {};
+
+TEST(CachedClockTest, CachesUntilRefresh) {
+  CachedClock clock;
+  auto cached = clock.Now();
+  /* sleep override */
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ASSERT_TRUE(clock.Now() == cached);
+  ASSERT_EQ(clock.NowMicros(), CachedClock::ToMicros(cached));
+  ASSERT_TRUE(clock.FineNow() >= cached + std::chrono::milliseconds(5));
+
+  clock.Refresh();
+  ASSERT_TRUE(clock.Now() >= cached + std::chrono::milliseconds(5));
+  ASSERT_TRUE(clock.Now() <= CachedClock::Clock::now());
+}
+
+TEST(CachedClockTest, FineTimeWithTimestampCounter) {
+  CachedClock clock(true);
+  for (int i = 0; i < 5; ++i) {
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    clock.Refresh();
+  }
+  // Extrapolated time must stay close to the real clock, whether or not the
+  // timestamp counter is available.
+  for (int i = 0; i < 10; ++i) {
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t before = CachedClock::ToMicros(CachedClock::Clock::now());
+    uint64_t fine = clock.FineNowMicros();
+    uint64_t after = CachedClock::ToMicros(CachedClock::Clock::now());
+    ASSERT_GE(fine + 2000, before);
+    ASSERT_LE(fine, after + 2000);
+  }
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
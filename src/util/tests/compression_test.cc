@@ -0,0 +1,82 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <string>
+
+#include "src/util/common/compression.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class CompressionTest { };
+
+TEST(CompressionTest, ParseType) {
+  CompressionType type;
+  ASSERT_OK(ParseCompressionType("none", &type));
+  ASSERT_TRUE(type == CompressionType::kNone);
+  ASSERT_OK(ParseCompressionType("snappy", &type));
+  ASSERT_TRUE(type == CompressionType::kSnappy);
+  ASSERT_OK(ParseCompressionType("lz4", &type));
+  ASSERT_TRUE(type == CompressionType::kLZ4);
+  ASSERT_OK(ParseCompressionType("zlib", &type));
+  ASSERT_TRUE(type == CompressionType::kZlib);
+  ASSERT_TRUE(!ParseCompressionType("", &type).ok());
+  ASSERT_TRUE(!ParseCompressionType("zstd", &type).ok());
+}
+
+TEST(CompressionTest, RoundTrip) {
+  std::string payload;
+  for (int i = 0; i < 100; ++i) {
+    payload += "{\"id\":" + std::to_string(i) + ",\"kind\":\"update\"},";
+  }
+  for (CompressionType type : {CompressionType::kNone,
+                               CompressionType::kSnappy,
+                               CompressionType::kLZ4,
+                               CompressionType::kZlib}) {
+    std::string compressed;
+    CompressionType used = CompressPayload(type, payload, &compressed);
+    if (type == CompressionType::kNone || !IsCompressionSupported(type)) {
+      // Falls back to sending the payload as is.
+      ASSERT_TRUE(used == CompressionType::kNone);
+      ASSERT_TRUE(compressed.empty());
+      if (type != CompressionType::kNone) {
+        ASSERT_TRUE(UncompressPayload(type, payload, &compressed)
+                    .IsNotSupported());
+      }
+      continue;
+    }
+    ASSERT_TRUE(used == type);
+    ASSERT_LT(compressed.size(), payload.size() / 4);
+    std::string uncompressed;
+    ASSERT_OK(UncompressPayload(type, compressed, &uncompressed));
+    ASSERT_EQ(uncompressed, payload);
+  }
+}
+
+TEST(CompressionTest, Incompressible) {
+  // Payloads that would not get smaller are sent as is.
+  for (CompressionType type : {CompressionType::kSnappy,
+                               CompressionType::kLZ4,
+                               CompressionType::kZlib}) {
+    std::string compressed;
+    ASSERT_TRUE(CompressPayload(type, "x", &compressed) ==
+                CompressionType::kNone);
+    ASSERT_TRUE(compressed.empty());
+  }
+}
+
+TEST(CompressionTest, UnknownCodec) {
+  // Payloads from newer publishers.
+  const auto type = static_cast<CompressionType>(0x7f);
+  ASSERT_TRUE(!IsCompressionSupported(type));
+  std::string out;
+  ASSERT_TRUE(UncompressPayload(type, "payload", &out).IsNotSupported());
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include "src/util/consistent_hash.h"
+#include "src/util/rendezvous_hash.h"
 #include "src/util/testharness.h"
 #include "src/util/testutil.h"
 
@@ -262,6 +263,135 @@ TEST(ConsistentHashTest, Multiget) {
   }
 }
 
+TEST(ConsistentHashTest, MatchesReferenceRing) {
+  // The ring is searched by interpolation, so check it against a plain
+  // ordered map with the same replica hashes, across ring sizes and with
+  // keys hashing near both ends of the hash space.
+  ConsistentHash<size_t, size_t> hash;
+  std::multimap<size_t, size_t> reference;
+  for (size_t slot = 0; slot < 200; ++slot) {
+    const unsigned int replicas = static_cast<unsigned int>(1 + slot % 7);
+    hash.Add(slot, replicas);
+    size_t h = MurmurHash2<size_t>()(slot);
+    for (unsigned int r = 0; r < replicas; ++r) {
+      reference.emplace(h, slot);
+      h = MurmurHash2<size_t>()(h);
+    }
+    ASSERT_EQ(hash.VirtualSlotCount(), reference.size());
+
+    for (size_t key = 0; key < 100; ++key) {
+      auto it = reference.lower_bound(MurmurHash2<size_t>()(key));
+      if (it == reference.end()) {
+        it = reference.begin();
+      }
+      ASSERT_EQ(hash.Get(key), it->second);
+    }
+  }
+}
+
+class RendezvousHashTest { };
+
+TEST(RendezvousHashTest, RendezvousBasicAPI) {
+  RendezvousHash<string, string> hash;
+  ASSERT_TRUE(hash.Empty());
+  ASSERT_EQ(hash.SlotCount(), 0);
+  ASSERT_EQ(hash.SlotRatio("foo"), 0.0);
+
+  hash.Add("foo");
+  ASSERT_EQ(hash.SlotCount(), 1);
+  ASSERT_EQ(hash.SlotRatio("foo"), 1.0);
+  ASSERT_EQ(hash.Get("anything"), "foo");
+
+  hash.Add("bar", 3.0);
+  ASSERT_EQ(hash.SlotCount(), 2);
+  ASSERT_EQ(hash.SlotRatio("foo"), 0.25);
+  ASSERT_EQ(hash.SlotRatio("bar"), 0.75);
+
+  hash.Remove("foo");
+  ASSERT_EQ(hash.SlotCount(), 1);
+  ASSERT_EQ(hash.SlotRatio("foo"), 0.0);
+  ASSERT_EQ(hash.SlotRatio("bar"), 1.0);
+  ASSERT_EQ(hash.Get("anything"), "bar");
+
+  hash.Remove("bar");
+  ASSERT_TRUE(hash.Empty());
+}
+
+TEST(RendezvousHashTest, RendezvousWeighting) {
+  RendezvousHash<size_t, string> hash;
+  string hosts[] = { "host1", "host2", "host3", "host4" };
+  double weights[] = { 1.0, 2.0, 3.0, 4.0 };
+  for (int i = 0; i < 4; ++i) {
+    hash.Add(hosts[i], weights[i]);
+  }
+
+  // Balance is exact in expectation, so the tolerance can be much tighter
+  // than for the ring.
+  int counts[] = { 0, 0, 0, 0 };
+  const int num = 100000;
+  for (size_t key = 0; key < num; ++key) {
+    const string& host = hash.Get(key);
+    for (int h = 0; h < 4; ++h) {
+      if (host == hosts[h]) {
+        counts[h]++;
+      }
+    }
+  }
+  for (int h = 0; h < 4; ++h) {
+    double actual = static_cast<double>(counts[h]) / num;
+    ASSERT_GT(actual, hash.SlotRatio(hosts[h]) * 0.95);
+    ASSERT_LT(actual, hash.SlotRatio(hosts[h]) * 1.05);
+  }
+}
+
+TEST(RendezvousHashTest, RendezvousConsistency) {
+  RendezvousHash<size_t, string> hash;
+  string hosts[] = { "host1", "host2", "host3", "host4", "host5" };
+  for (const string& host : hosts) {
+    hash.Add(host);
+  }
+  std::map<size_t, string> original;
+  const size_t num = 1000;
+  for (size_t key = 0; key < num; ++key) {
+    original[key] = hash.Get(key);
+  }
+
+  // Keys only ever move to a new slot, or away from a removed one.
+  hash.Add("host6");
+  for (size_t key = 0; key < num; ++key) {
+    const string& host = hash.Get(key);
+    ASSERT_TRUE(host == original[key] || host == "host6");
+  }
+  hash.Remove("host6");
+  hash.Remove("host1");
+  for (size_t key = 0; key < num; ++key) {
+    if (original[key] != "host1") {
+      ASSERT_EQ(hash.Get(key), original[key]);
+    }
+  }
+}
+
+TEST(RendezvousHashTest, RendezvousMultiget) {
+  RendezvousHash<size_t, string> hash;
+  string hosts[] = { "host1", "host2", "host3", "host4", "host5" };
+  for (const string& host : hosts) {
+    hash.Add(host);
+  }
+  for (size_t key = 0; key < 1000; ++key) {
+    vector<string> all(5);
+    hash.MultiGet(key, 5, all.begin());
+    ASSERT_TRUE(hash.Get(key) == all[0]);
+
+    // All distinct, and every shorter result is a prefix.
+    vector<string> sorted(all);
+    std::sort(sorted.begin(), sorted.end());
+    ASSERT_TRUE(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+    vector<string> prefix(2);
+    hash.MultiGet(key, 2, prefix.begin());
+    ASSERT_TRUE(std::equal(prefix.begin(), prefix.end(), all.begin()));
+  }
+}
+
 }  // namespace rocketspeed
 
 int main(int argc, char** argv) {
@@ -4,6 +4,7 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 
 #include <algorithm>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
@@ -130,6 +131,115 @@ TEST(ConsistentHashTowerRouterTest, ChangeHost) {
               host_logs_after[HostId::CreateLocal(3)]);
 }
 
+TEST(ConsistentHashTowerRouterTest, Weights) {
+  // Tower 0 has twice the capacity of the others.
+  const int num_towers = 10;
+  auto control_towers = MakeControlTowers(num_towers);
+  ConsistentHashTowerRouter router(control_towers, {{0, 2.0}}, 100, 1);
+  ASSERT_EQ(router.GetWeight(0), 2.0);
+  ASSERT_EQ(router.GetWeight(1), 1.0);
+  ASSERT_EQ(router.GetWeight(num_towers), 0.0);
+
+  // Expected shares follow the weights, and agree with the routing.
+  std::vector<std::pair<HostId, double>> shares;
+  ASSERT_OK(router.GetLoadShares(&shares));
+  ASSERT_EQ(shares.size(), num_towers);
+  std::unordered_map<HostId, double> share_of;
+  double total = 0.0;
+  for (const auto& share : shares) {
+    share_of[share.first] = share.second;
+    total += share.second;
+  }
+  ASSERT_GT(total, 0.999);
+  ASSERT_LT(total, 1.001);
+  const HostId& big = control_towers[0];
+  ASSERT_GT(share_of[big], 2.0 / 11 * 0.8);
+  ASSERT_LT(share_of[big], 2.0 / 11 * 1.2);
+
+  std::unordered_map<HostId, int> log_count;
+  const int num_logs = 100000;
+  for (int i = 0; i < num_logs; ++i) {
+    std::vector<HostId const*> hosts;
+    ASSERT_OK(router.GetControlTowers(i, &hosts));
+    log_count[*hosts[0]]++;
+  }
+  for (const auto& entry : share_of) {
+    double actual = static_cast<double>(log_count[entry.first]) / num_logs;
+    ASSERT_GT(actual, entry.second * 0.9);
+    ASSERT_LT(actual, entry.second * 1.1);
+  }
+}
+
+TEST(ConsistentHashTowerRouterTest, InvalidWeights) {
+  auto control_towers = MakeControlTowers(4);
+  std::unique_ptr<ConsistentHashTowerRouter> router;
+  for (double weight : {0.0,
+                        std::numeric_limits<double>::infinity(),
+                        1e12}) {
+    ASSERT_TRUE(ConsistentHashTowerRouter::Create(
+      control_towers, {{0, weight}}, 20, 1, &router).IsInvalidArgument());
+
+    // The constructor ignores the weight instead.
+    ConsistentHashTowerRouter ignored(control_towers, {{0, weight}}, 20, 1);
+    ASSERT_EQ(ignored.GetWeight(0), 1.0);
+  }
+
+  // The largest weight is accepted, and gets its share of logs.
+  ASSERT_OK(ConsistentHashTowerRouter::Create(
+    control_towers, {{0, ConsistentHashTowerRouter::kMaxWeight}}, 20, 1,
+    &router));
+  std::vector<std::pair<HostId, double>> shares;
+  ASSERT_OK(router->GetLoadShares(&shares));
+  for (const auto& share : shares) {
+    if (share.first == control_towers[0]) {
+      ASSERT_GT(share.second, 0.9);
+    }
+  }
+}
+
+TEST(ConsistentHashTowerRouterTest, SetWeight) {
+  const int num_towers = 10;
+  auto control_towers = MakeControlTowers(num_towers);
+  ConsistentHashTowerRouter before(control_towers, 100, 1);
+  ASSERT_TRUE(before.SetWeight(num_towers, 2.0).IsNotFound());
+  ASSERT_TRUE(before.SetWeight(0, 0.0).IsInvalidArgument());
+  ASSERT_TRUE(before.SetWeight(0, -1.0).IsInvalidArgument());
+  ASSERT_TRUE(before.SetWeight(0, std::numeric_limits<double>::infinity())
+                .IsInvalidArgument());
+  ASSERT_TRUE(before.SetWeight(0, std::numeric_limits<double>::quiet_NaN())
+                .IsInvalidArgument());
+  ASSERT_TRUE(before.SetWeight(0, 1e12).IsInvalidArgument());
+  ASSERT_TRUE(before.SetWeight(0, ConsistentHashTowerRouter::kMaxWeight * 2)
+                .IsInvalidArgument());
+  ASSERT_EQ(before.GetWeight(0), 1.0);
+
+  // Raising a weight only moves logs onto that tower, and lowering it only
+  // moves logs off it.
+  const HostId& changed = control_towers[3];
+  for (double weight : {1.5, 0.5}) {
+    ConsistentHashTowerRouter after(before);
+    ASSERT_OK(after.SetWeight(3, weight));
+    ASSERT_EQ(after.GetWeight(3), weight);
+
+    int moved = 0;
+    const int num_logs = 10000;
+    for (int i = 0; i < num_logs; ++i) {
+      std::vector<HostId const*> hosts_before;
+      std::vector<HostId const*> hosts_after;
+      ASSERT_OK(before.GetControlTowers(i, &hosts_before));
+      ASSERT_OK(after.GetControlTowers(i, &hosts_after));
+      if (!(*hosts_before[0] == *hosts_after[0])) {
+        ++moved;
+        ASSERT_TRUE(*(weight > 1.0 ? hosts_after : hosts_before)[0] ==
+                    changed);
+      }
+    }
+    // Expect about 1/20th of the logs to move either way.
+    ASSERT_GT(moved, num_logs / 40);
+    ASSERT_LT(moved, num_logs / 10);
+  }
+}
+
 }  // namespace rocketspeed
 
 int main(int argc, char** argv) {
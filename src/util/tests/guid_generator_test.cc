@@ -4,6 +4,8 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 //
 
+#include <sys/wait.h>
+#include <unistd.h>
 #include <future>
 #include <vector>
 #include <algorithm>
@@ -46,6 +48,51 @@ TEST(GUIDGeneratorTest, Uniqueness) {
   ASSERT_EQ(uniques, all_guids.size());
 }
 
+TEST(GUIDGeneratorTest, SequenceUniqueness) {
+  GUIDGenerator* gen = GUIDGenerator::ThreadLocalGUIDGenerator();
+  ASSERT_TRUE(gen == GUIDGenerator::ThreadLocalGUIDGenerator());
+
+  const size_t num_guids = 100000;
+  std::vector<GUID> guids;
+  for (size_t i = 0; i < num_guids; ++i) {
+    guids.push_back(gen->Generate());
+    ASSERT_TRUE(!guids.back().Empty());
+  }
+  std::sort(guids.begin(), guids.end());
+  ASSERT_TRUE(std::unique(guids.begin(), guids.end()) == guids.end());
+
+  // Encoded forms agree with each other.
+  char buf[16];
+  gen->Generate(buf);
+  ASSERT_EQ(GUID(buf).ToString().size(), 16U);
+  ASSERT_EQ(gen->GenerateString().size(), 16U);
+}
+
+TEST(GUIDGeneratorTest, ForkReseeds) {
+  GUIDGenerator gen;
+  gen.Generate();
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    GUID child = gen.Generate();
+    ssize_t written = write(fds[1], child.id, sizeof(child.id));
+    _exit(written == sizeof(child.id) ? 0 : 1);
+  }
+  GUID parent = gen.Generate();
+  GUID child;
+  ASSERT_EQ(read(fds[0], child.id, sizeof(child.id)),
+            static_cast<ssize_t>(sizeof(child.id)));
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  close(fds[0]);
+  close(fds[1]);
+  ASSERT_TRUE(!(parent == child));
+  ASSERT_NE(parent.hi, child.hi);
+}
+
 }  // namespace rocketspeed
 
 int main(int argc, char** argv) {
@@ -0,0 +1,97 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <cstring>
+#include <vector>
+
+#include "src/util/common/huge_page_allocator.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class HugePageAllocatorTest { };
+
+TEST(HugePageAllocatorTest, ParseMode) {
+  HugePageMode mode;
+  ASSERT_OK(ParseHugePageMode("none", &mode));
+  ASSERT_TRUE(mode == HugePageMode::kNone);
+  ASSERT_OK(ParseHugePageMode("transparent", &mode));
+  ASSERT_TRUE(mode == HugePageMode::kTransparent);
+  ASSERT_OK(ParseHugePageMode("explicit", &mode));
+  ASSERT_TRUE(mode == HugePageMode::kExplicit);
+  ASSERT_TRUE(!ParseHugePageMode("", &mode).ok());
+  ASSERT_TRUE(!ParseHugePageMode("thp", &mode).ok());
+}
+
+TEST(HugePageAllocatorTest, AllocateAndFree) {
+  // Every mode works, whether or not huge pages are available here.
+  for (HugePageMode mode : {HugePageMode::kNone,
+                            HugePageMode::kTransparent,
+                            HugePageMode::kExplicit}) {
+    HugePageAllocator allocator(mode);
+    std::vector<std::pair<char*, size_t>> buffers;
+    for (size_t size : {size_t(1), size_t(100), size_t(8200),
+                        size_t(800016), HugePageAllocator::kChunkSize + 1}) {
+      char* buffer = static_cast<char*>(allocator.Allocate(size));
+      ASSERT_EQ(reinterpret_cast<uintptr_t>(buffer) % alignof(void*), 0);
+      memset(buffer, static_cast<int>(buffers.size()), size);
+      buffers.emplace_back(buffer, size);
+    }
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      for (size_t j = 0; j < buffers[i].second; ++j) {
+        ASSERT_EQ(buffers[i].first[j], static_cast<char>(i));
+      }
+    }
+    HugePageStats stats = allocator.GetStats();
+    if (mode == HugePageMode::kNone) {
+      // Heap memory is not tracked.
+      ASSERT_EQ(stats.allocated_bytes, 0);
+      ASSERT_EQ(stats.mapped_bytes, 0);
+    } else {
+      // Sizes are rounded up to cache lines.
+      ASSERT_EQ(stats.allocated_bytes, 808576 + HugePageAllocator::kChunkSize);
+      // One chunk, and huge pages for the buffer larger than a chunk.
+      ASSERT_EQ(stats.mapped_bytes,
+                2 * HugePageAllocator::kChunkSize +
+                HugePageAllocator::kHugePageSize);
+      ASSERT_LE(stats.huge_page_bytes, stats.mapped_bytes);
+    }
+    for (auto& buffer : buffers) {
+      allocator.Free(buffer.first, buffer.second);
+    }
+    allocator.Free(nullptr, 0);
+    ASSERT_EQ(allocator.GetStats().allocated_bytes, 0);
+  }
+}
+
+TEST(HugePageAllocatorTest, ReuseFreedBuffers) {
+  HugePageAllocator allocator(HugePageMode::kTransparent);
+  // Ten rings of a default command queue fit in a chunk.
+  const size_t kRingSize = 50001 * 16;
+  std::vector<void*> rings;
+  for (int i = 0; i < 10; ++i) {
+    rings.push_back(allocator.Allocate(kRingSize));
+  }
+  ASSERT_EQ(allocator.GetStats().mapped_bytes, HugePageAllocator::kChunkSize);
+  allocator.Free(rings[3], kRingSize);
+  ASSERT_EQ(allocator.Allocate(kRingSize), rings[3]);
+  for (void* ring : rings) {
+    allocator.Free(ring, kRingSize);
+  }
+  ASSERT_EQ(allocator.GetStats().mapped_bytes, HugePageAllocator::kChunkSize);
+}
+
+TEST(HugePageAllocatorTest, SharedAllocators) {
+  ASSERT_TRUE(HugePageAllocator::Get(HugePageMode::kTransparent) ==
+              HugePageAllocator::Get(HugePageMode::kTransparent));
+  ASSERT_TRUE(HugePageAllocator::Get(HugePageMode::kExplicit)->GetMode() ==
+              HugePageMode::kExplicit);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
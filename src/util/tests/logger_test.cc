@@ -0,0 +1,121 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+// Compile out LOG_DEBUG statements in this file.
+#define ROCKETSPEED_MIN_LOG_LEVEL 1
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "include/Logger.h"
+#include "src/port/Env.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class LoggerTest {
+ public:
+  LoggerTest() : env_(Env::Default()) {}
+
+  Env* env_;
+};
+
+namespace {
+
+/** Logger that keeps every entry it receives in memory. */
+class CapturingLogger : public Logger {
+ public:
+  explicit CapturingLogger(InfoLogLevel log_level) : Logger(log_level) {}
+
+  void Append(const char* format, va_list ap) override {
+    char buffer[1024];
+    vsnprintf(buffer, sizeof(buffer), format, ap);
+    lines_.emplace_back(buffer);
+  }
+
+  std::vector<std::string> lines_;
+};
+
+}  // namespace
+
+TEST(LoggerTest, MinLevelTracksLiveLoggers) {
+  LogLevelRegistry& registry = LogLevelRegistry::Default();
+  const InfoLogLevel initial = registry.GetMinLevel();
+  {
+    CapturingLogger error_logger(ERROR_LEVEL);
+    ASSERT_EQ(registry.GetMinLevel(), std::min(initial, ERROR_LEVEL));
+    {
+      CapturingLogger info_logger(INFO_LEVEL);
+      ASSERT_EQ(registry.GetMinLevel(), std::min(initial, INFO_LEVEL));
+      info_logger.SetInfoLogLevel(WARN_LEVEL);
+      ASSERT_EQ(registry.GetMinLevel(), std::min(initial, WARN_LEVEL));
+    }
+    ASSERT_EQ(registry.GetMinLevel(), std::min(initial, ERROR_LEVEL));
+  }
+  ASSERT_EQ(registry.GetMinLevel(), initial);
+}
+
+TEST(LoggerTest, DisabledStatementsSkipLogger) {
+  CapturingLogger logger(WARN_LEVEL);
+  int evaluated = 0;
+  auto get_logger = [&] () {
+    ++evaluated;
+    return &logger;
+  };
+  LOG_INFO(get_logger(), "not evaluated");
+  ASSERT_EQ(evaluated, 0);
+  LOG_WARN(get_logger(), "evaluated");
+  ASSERT_EQ(evaluated, 1);
+  ASSERT_EQ(logger.lines_.size(), 1U);
+}
+
+TEST(LoggerTest, CompileTimeMinLevel) {
+  CapturingLogger logger(DEBUG_LEVEL);
+  LOG_DEBUG(&logger, "compiled out");
+  ASSERT_EQ(logger.lines_.size(), 0U);
+  LOG_INFO(&logger, "kept");
+  ASSERT_EQ(logger.lines_.size(), 1U);
+}
+
+TEST(LoggerTest, EveryN) {
+  CapturingLogger logger(INFO_LEVEL);
+  for (int i = 0; i < 10; ++i) {
+    LOG_INFO_EVERY_N(&logger, 3, "entry %d", i);
+  }
+  ASSERT_EQ(logger.lines_.size(), 4U);
+  ASSERT_TRUE(logger.lines_[1].find("entry 3") != std::string::npos);
+  ASSERT_TRUE(logger.lines_[3].find("entry 9") != std::string::npos);
+}
+
+TEST(LoggerTest, RateLimited) {
+  CapturingLogger logger(INFO_LEVEL);
+  for (int i = 0; i < 100; ++i) {
+    LOG_WARN_RATELIMITED(&logger, "entry %d", i);
+  }
+  ASSERT_EQ(logger.lines_.size(), 1U);
+  ASSERT_TRUE(logger.lines_[0].find("entry 0") != std::string::npos);
+
+  // Each statement has its own limit, and suppressed entries are reported.
+  logger.lines_.clear();
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      RS_LOG_RATELIMITED(INFO_LEVEL, 1000, &logger, "round %d", i);
+    }
+    env_->SleepForMicroseconds(2000);
+  }
+  ASSERT_EQ(logger.lines_.size(), 5U);
+  ASSERT_TRUE(logger.lines_[1].find("round 1") != std::string::npos);
+  ASSERT_TRUE(logger.lines_[2].find("Suppressed 4 similar") !=
+              std::string::npos);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
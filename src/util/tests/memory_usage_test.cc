@@ -0,0 +1,105 @@
+//  Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/util/common/autovector.h"
+#include "src/util/common/linked_map.h"
+#include "src/util/common/memory_usage.h"
+#include "src/util/testharness.h"
+#include "src/util/topic_uuid.h"
+
+namespace rocketspeed {
+
+class MemoryUsageTest {};
+
+namespace {
+
+struct Accounted {
+  size_t GetHeapMemoryUsage() const { return 100; }
+};
+
+}  // namespace
+
+TEST(MemoryUsageTest, Strings) {
+  ASSERT_EQ(HeapMemoryUsage(std::string()), 0U);
+  std::string str(1000, 'x');
+  ASSERT_GE(HeapMemoryUsage(str), 1000U);
+  ASSERT_EQ(HeapMemoryUsage(str), str.capacity() + 1);
+}
+
+TEST(MemoryUsageTest, Vectors) {
+  std::vector<int> ints;
+  ints.reserve(100);
+  ASSERT_EQ(HeapMemoryUsage(ints), 100 * sizeof(int));
+
+  // Element heap memory is included.
+  std::vector<std::string> strs(2, std::string(1000, 'x'));
+  ASSERT_GE(HeapMemoryUsage(strs), 2 * sizeof(std::string) + 2000);
+
+  std::vector<std::unique_ptr<Accounted>> ptrs(3);
+  ptrs[0].reset(new Accounted());
+  ASSERT_EQ(HeapMemoryUsage(ptrs),
+            ptrs.capacity() * sizeof(ptrs[0]) + sizeof(Accounted) + 100);
+}
+
+TEST(MemoryUsageTest, OptIn) {
+  ASSERT_EQ(HeapMemoryUsage(Accounted()), 100U);
+  ASSERT_EQ(HeapMemoryUsage(42), 0U);
+
+  std::unordered_map<int, Accounted> map;
+  map[1];
+  map[2];
+  size_t base = HeapMemoryUsage(std::unordered_map<int, int>());
+  ASSERT_GT(HeapMemoryUsage(map), base + 200);
+}
+
+TEST(MemoryUsageTest, Maps) {
+  std::unordered_map<int, int> map;
+  size_t empty = HeapMemoryUsage(map);
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = i;
+  }
+  size_t full = HeapMemoryUsage(map);
+  ASSERT_GE(full, empty + 1000 * 2 * sizeof(int));
+  map.clear();
+  // Buckets are retained after clear.
+  ASSERT_EQ(HeapMemoryUsage(map), map.bucket_count() * sizeof(void*));
+}
+
+TEST(MemoryUsageTest, LinkedMap) {
+  LinkedMap<TopicUUID, int> map;
+  ASSERT_EQ(map.GetHeapMemoryUsage(), HeapMemoryUsage(map));
+  size_t empty = map.GetHeapMemoryUsage();
+  std::string long_topic(100, 't');
+  map.emplace_back(TopicUUID("namespace", long_topic), 1);
+  // List node, index node and the UUID string.
+  ASSERT_GE(map.GetHeapMemoryUsage(), empty +
+    sizeof(std::pair<const TopicUUID, int>) + long_topic.size() +
+    sizeof(void*));
+  map.clear();
+  ASSERT_LT(map.GetHeapMemoryUsage(), empty + long_topic.size());
+}
+
+TEST(MemoryUsageTest, Autovector) {
+  autovector<int, 4> vec;
+  for (int i = 0; i < 4; ++i) {
+    vec.push_back(i);
+  }
+#ifndef ROCKETSPEED_LITE
+  ASSERT_EQ(HeapMemoryUsage(vec), 0U);
+#endif
+  vec.push_back(4);
+  ASSERT_GE(HeapMemoryUsage(vec), 5 * sizeof(int));
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
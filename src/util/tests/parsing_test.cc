@@ -0,0 +1,38 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <string>
+#include <vector>
+
+#include "src/util/common/parsing.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class ParsingTest { };
+
+TEST(ParsingTest, CpuList) {
+  std::vector<int> cpus;
+  ASSERT_OK(ParseCpuList("3", &cpus));
+  ASSERT_TRUE(cpus == std::vector<int>({3}));
+  ASSERT_OK(ParseCpuList("8,0-3,2,10-11", &cpus));
+  ASSERT_TRUE(cpus == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_EQ(FormatCpuList(cpus), "0-3,8,10-11");
+  ASSERT_EQ(FormatCpuList({5, 4}), "4-5");
+  ASSERT_EQ(FormatCpuList({}), "");
+
+  for (const char* invalid : {"", ",", "1,", "-1", "3-1", "1-2-3", "a",
+                              "1 ", "0-99999"}) {
+    ASSERT_TRUE(ParseCpuList(invalid, &cpus).IsInvalidArgument());
+  }
+  // Output is untouched on error.
+  ASSERT_TRUE(cpus == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
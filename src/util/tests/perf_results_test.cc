@@ -0,0 +1,123 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <string>
+#include <vector>
+
+#include "src/util/perf_results.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class PerfResultsTest { };
+
+TEST(PerfResultsTest, JsonRoundTrip) {
+  PerfResults results;
+  results.AddSample("bench:a", "ns/iter", false, 12.5);
+  results.AddSample("bench:a", "ns/iter", false, 0.1);
+  results.AddSample("throughput \"quoted\"", "messages/s", true, 1e6);
+
+  PerfResults parsed;
+  ASSERT_OK(PerfResults::FromJson(results.ToJson(), &parsed));
+  const auto& metrics = parsed.GetMetrics();
+  ASSERT_EQ(metrics.size(), 2U);
+
+  const PerfMetric& a = metrics.at("bench:a");
+  ASSERT_EQ(a.unit, "ns/iter");
+  ASSERT_TRUE(!a.higher_is_better);
+  ASSERT_EQ(a.samples, std::vector<double>({12.5, 0.1}));
+
+  const PerfMetric& b = metrics.at("throughput \"quoted\"");
+  ASSERT_EQ(b.unit, "messages/s");
+  ASSERT_TRUE(b.higher_is_better);
+  ASSERT_EQ(b.samples, std::vector<double>({1e6}));
+
+  // Empty results are valid too.
+  PerfResults empty;
+  ASSERT_OK(PerfResults::FromJson(PerfResults().ToJson(), &empty));
+  ASSERT_TRUE(empty.GetMetrics().empty());
+}
+
+TEST(PerfResultsTest, Merge) {
+  PerfResults trial1;
+  trial1.AddSample("a", "ns/iter", false, 1.0);
+  PerfResults trial2;
+  trial2.AddSample("a", "ns/iter", false, 2.0);
+  trial2.AddSample("b", "ns/iter", false, 3.0);
+
+  // Parsing merges into existing results.
+  PerfResults merged;
+  ASSERT_OK(PerfResults::FromJson(trial1.ToJson(), &merged));
+  ASSERT_OK(PerfResults::FromJson(trial2.ToJson(), &merged));
+  ASSERT_EQ(merged.GetMetrics().at("a").samples,
+            std::vector<double>({1.0, 2.0}));
+  ASSERT_EQ(merged.GetMetrics().at("b").samples, std::vector<double>({3.0}));
+
+  trial1.Merge(trial2);
+  ASSERT_EQ(trial1.GetMetrics().at("a").samples,
+            std::vector<double>({1.0, 2.0}));
+  ASSERT_EQ(trial1.GetMetrics().size(), 2U);
+}
+
+TEST(PerfResultsTest, UnknownFields) {
+  PerfResults results;
+  ASSERT_OK(PerfResults::FromJson(
+    "{\"version\": 2, \"host\": {\"cpus\": [1, 2], \"name\": null},"
+    " \"metrics\": {\"a\": {\"unit\": \"ns/iter\", \"extra\": true,"
+    " \"samples\": [1, 2.5e1]}}}",
+    &results));
+  ASSERT_EQ(results.GetMetrics().at("a").samples,
+            std::vector<double>({1.0, 25.0}));
+}
+
+TEST(PerfResultsTest, InvalidJson) {
+  const char* invalid[] = {
+    "",
+    "[]",
+    "{\"metrics\": {\"a\": {\"samples\": [1, ]}}}",
+    "{\"metrics\": {\"a\": {\"higher_is_better\": 1}}}",
+    "{\"metrics\": {}} trailing",
+    "{\"metrics\": {\"a\": {\"unit\": \"ns}}}",
+  };
+  for (const char* json : invalid) {
+    PerfResults results;
+    ASSERT_TRUE(!PerfResults::FromJson(json, &results).ok());
+    ASSERT_TRUE(results.GetMetrics().empty());
+  }
+}
+
+TEST(PerfResultsTest, Median) {
+  ASSERT_EQ(Median({3.0}), 3.0);
+  ASSERT_EQ(Median({5.0, 1.0, 3.0}), 3.0);
+  ASSERT_EQ(Median({4.0, 1.0, 2.0, 3.0}), 2.5);
+}
+
+TEST(PerfResultsTest, MannWhitney) {
+  // Identical distributions are never significant.
+  std::vector<double> same = {1.0, 1.0, 1.0, 1.0, 1.0};
+  ASSERT_EQ(MannWhitneyPValue(same, same), 1.0);
+  ASSERT_EQ(MannWhitneyPValue(same, {}), 1.0);
+
+  // Interleaved samples are not significant.
+  std::vector<double> a = {1.0, 3.0, 5.0, 7.0, 9.0};
+  std::vector<double> b = {2.0, 4.0, 6.0, 8.0, 10.0};
+  ASSERT_GT(MannWhitneyPValue(a, b), 0.5);
+
+  // Fully separated samples are, and the test is symmetric.
+  std::vector<double> fast = {10.0, 10.2, 10.1, 9.9, 10.0};
+  std::vector<double> slow = {12.0, 12.3, 11.9, 12.1, 12.2};
+  const double p = MannWhitneyPValue(fast, slow);
+  ASSERT_LT(p, 0.05);
+  ASSERT_EQ(p, MannWhitneyPValue(slow, fast));
+
+  // Too few samples are never significant, however large the difference.
+  ASSERT_GT(MannWhitneyPValue({1.0, 2.0}, {100.0, 200.0}), 0.05);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
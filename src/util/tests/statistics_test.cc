@@ -156,6 +156,32 @@ TEST(StatisticsTest, HistogramPercentilesOneBucket) {
   ASSERT_LT(histogram.Percentile(0.1), histogram.Percentile(0.9));
 }
 
+TEST(StatisticsTest, HistogramMaxSample) {
+  Histogram histogram(0.0, 1000.0, 1.0, 10.0);
+  ASSERT_EQ(histogram.GetMaxSample(), 0.0);
+  histogram.Record(150.0);
+  histogram.Record(120.0);
+  ASSERT_EQ(histogram.GetMaxSample(), 150.0);
+
+  // Clamped to the histogram range.
+  Histogram other(0.0, 1000.0, 1.0, 10.0);
+  other.Record(5000.0);
+  ASSERT_EQ(other.GetMaxSample(), 1000.0);
+
+  // Aggregation keeps the largest, moving resets the source.
+  histogram.Aggregate(other);
+  ASSERT_EQ(histogram.GetMaxSample(), 1000.0);
+  Histogram moved = other.MoveThread();
+  ASSERT_EQ(moved.GetMaxSample(), 1000.0);
+  ASSERT_EQ(other.GetMaxSample(), 0.0);
+  other.Record(1.0);
+  ASSERT_EQ(other.GetMaxSample(), 1.0);
+
+  std::string report = histogram.ReportDistribution();
+  ASSERT_TRUE(report.find("p99.99:") != std::string::npos);
+  ASSERT_TRUE(report.find("max: 1000.0") != std::string::npos);
+}
+
 TEST(StatisticsTest, StatisticsWindowAggregator) {
   Statistics s0, s1, s2, s3;
   s1.AddCounter("a")->Add(1);
@@ -94,6 +94,28 @@ TEST(TimeoutListTest, BatchLimitExpiry) {
   ASSERT_EQ(tlist.Size(), 1);
 }
 
+TEST(TimeoutListTest, ProvidedTime) {
+  using std::chrono::seconds;
+  auto start = std::chrono::steady_clock::now();
+  TimeoutList<std::string> tlist;
+  tlist.Add("Red", start);
+  tlist.Add("Green", start + seconds(1));
+  tlist.Add("blue", start + seconds(2));
+  tlist.Add("Red", start + seconds(3));
+
+  std::vector<std::string> expired;
+  auto collect = [&](std::string colour) {
+    expired.emplace_back(std::move(colour));
+  };
+  tlist.ProcessExpired(seconds(1), collect, -1, start + seconds(3));
+  ASSERT_EQ(expired.size(), 1);
+  ASSERT_EQ(expired[0], "Green");
+  tlist.ProcessExpired(seconds(1), collect, -1, start + seconds(5));
+  ASSERT_EQ(expired.size(), 3);
+  ASSERT_EQ(expired[2], "Red");
+  ASSERT_EQ(tlist.Size(), 0);
+}
+
 }  // namespace rocketspeed
 
 int main(int argc, char** argv) {
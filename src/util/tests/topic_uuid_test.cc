@@ -0,0 +1,117 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "src/util/topic_uuid.h"
+#include "src/util/testharness.h"
+
+namespace rocketspeed {
+
+class TopicUUIDTest { };
+
+TEST(TopicUUIDTest, InlineAndHeap) {
+  const std::string short_topic = "topic";
+  const std::string long_topic(TopicUUID::kInlineCapacity, 't');
+  for (const std::string& topic : {short_topic, long_topic}) {
+    TopicUUID uuid("namespace", topic);
+    ASSERT_EQ(uuid.GetHeapMemoryUsage() != 0, topic == long_topic);
+
+    Slice namespace_id, topic_name;
+    uuid.GetTopicID(&namespace_id, &topic_name);
+    ASSERT_EQ(namespace_id.ToString(), "namespace");
+    ASSERT_EQ(topic_name.ToString(), topic);
+    ASSERT_EQ(uuid.ToString(), "Topic(namespace," + topic + ")");
+
+    // Must match the routing hash computed without a UUID, or topics would
+    // move between logs.
+    ASSERT_EQ(uuid.RoutingHash(), TopicUUID::RoutingHash("namespace", topic));
+
+    ASSERT_TRUE(uuid.Equals("namespace", topic));
+    ASSERT_TRUE(!uuid.Equals("namespac", "e" + topic));
+    ASSERT_TRUE(!uuid.Equals("namespace", topic + "x"));
+    ASSERT_TRUE(!(uuid == TopicUUID("namespac", "e" + topic)));
+
+    // Copies and moves keep the ID.
+    TopicUUID copy(uuid);
+    ASSERT_TRUE(copy == uuid);
+    TopicUUID moved(std::move(copy));
+    ASSERT_TRUE(moved == uuid);
+    TopicUUID assigned("other", long_topic);
+    assigned = uuid;
+    ASSERT_TRUE(assigned == uuid);
+    assigned = TopicUUID("other", short_topic);
+    ASSERT_TRUE(assigned.Equals("other", short_topic));
+    assigned = std::move(moved);
+    ASSERT_TRUE(assigned == uuid);
+  }
+}
+
+TEST(TopicUUIDTest, HashMap) {
+  std::unordered_map<TopicUUID, int> map;
+  for (int i = 0; i < 100; ++i) {
+    map.emplace(TopicUUID("namespace", std::string(i, 'a')), i);
+  }
+  for (int i = 0; i < 100; ++i) {
+    auto it = map.find(TopicUUID("namespace", std::string(i, 'a')));
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(it->second, i);
+  }
+}
+
+TEST(TopicUUIDTest, BorrowedLookup) {
+  TopicUUIDMap<int> map;
+  for (int i = 0; i < 100; ++i) {
+    map.emplace(TopicUUIDKey(TopicUUID("namespace", std::string(i, 'a'))), i);
+  }
+  for (int i = 0; i < 100; ++i) {
+    const std::string topic(i, 'a');
+    auto it = map.find(TopicUUIDKey::Borrow("namespace", topic));
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(it->second, i);
+    ASSERT_TRUE(!it->first.IsBorrowed());
+    ASSERT_TRUE(it->first.uuid().Equals("namespace", topic));
+
+    TopicUUID uuid("namespace", topic);
+    it = map.find(TopicUUIDKey::Borrow(uuid));
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(it->second, i);
+
+    // Same namespace and topic bytes, split differently.
+    ASSERT_TRUE(map.find(TopicUUIDKey::Borrow("namespac", "e" + topic)) ==
+                map.end());
+  }
+
+  // Borrowed and owning keys agree on hash and equality either way round.
+  const std::string long_topic(TopicUUID::kInlineCapacity, 't');
+  TopicUUIDKey owned(TopicUUID("namespace", long_topic));
+  TopicUUIDKey borrowed = TopicUUIDKey::Borrow("namespace", long_topic);
+  ASSERT_EQ(owned.Hash(), borrowed.Hash());
+  ASSERT_TRUE(owned == borrowed);
+  ASSERT_TRUE(borrowed == owned);
+  ASSERT_EQ(borrowed.GetHeapMemoryUsage(), 0U);
+  ASSERT_EQ(borrowed.ToString(), owned.ToString());
+
+  // Copies and moves keep the kind of key.
+  TopicUUIDKey copy(borrowed);
+  ASSERT_TRUE(copy.IsBorrowed());
+  copy = owned;
+  ASSERT_TRUE(!copy.IsBorrowed());
+  ASSERT_TRUE(copy == borrowed);
+  TopicUUIDKey moved(std::move(copy));
+  ASSERT_TRUE(!moved.IsBorrowed());
+  ASSERT_TRUE(moved.uuid() == owned.uuid());
+  moved = TopicUUIDKey::Borrow("other", "topic");
+  ASSERT_TRUE(moved.IsBorrowed());
+  ASSERT_TRUE(moved == TopicUUIDKey(TopicUUID("other", "topic")));
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::test::RunAllTests();
+}
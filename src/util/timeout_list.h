@@ -63,13 +63,21 @@ template <class T, class Hash = std::hash<T>> class TimeoutList {
   * or updates an existing item to now() and moves to back of the list
   */
   void Add(const T& t) {
+    Add(t, std::chrono::steady_clock::now());
+  }
+
+  /**
+  * Same as Add(t), with the current time provided by the caller, e.g. from
+  * a CachedClock. Times must not decrease between calls.
+  */
+  void Add(const T& t, std::chrono::steady_clock::time_point now) {
     auto it = lmap_.find(t);
     if (it == lmap_.end()) {
       // add this item
-      lmap_.emplace_back(t, std::chrono::steady_clock::now());
+      lmap_.emplace_back(t, now);
     } else {
       // update the item's time and move to the end
-      it->second = std::chrono::steady_clock::now();
+      it->second = now;
       lmap_.move_to_back(it);
     }
   }
@@ -119,7 +127,21 @@ template <class T, class Hash = std::hash<T>> class TimeoutList {
   void ProcessExpired(const std::chrono::duration<Rep, Period>& timeout,
                       ExpiryCallback callback,
                       int batch_limit) {
-    auto tm_now = std::chrono::steady_clock::now();
+    ProcessExpired(timeout,
+                   std::move(callback),
+                   batch_limit,
+                   std::chrono::steady_clock::now());
+  }
+
+  /**
+  * Same as ProcessExpired above, with the current time provided by the
+  * caller.
+  */
+  template <class Rep, class Period, class ExpiryCallback>
+  void ProcessExpired(const std::chrono::duration<Rep, Period>& timeout,
+                      ExpiryCallback callback,
+                      int batch_limit,
+                      std::chrono::steady_clock::time_point tm_now) {
     auto it = lmap_.begin();
     while (it != lmap_.end() && (batch_limit < 0 || batch_limit-- > 0)) {
       if ((tm_now - it->second) <= timeout) {
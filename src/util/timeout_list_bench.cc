@@ -0,0 +1,128 @@
+// Copyright (c) 2015, Facebook, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "src/util/benchharness.h"
+#include "src/util/common/linked_map.h"
+#include "src/util/timeout_list.h"
+
+namespace rocketspeed {
+
+using benchmark::BenchmarkSuspender;
+using benchmark::DoNotOptimizeAway;
+
+namespace {
+
+// Number of entries in the list during steady state benchmarks, e.g. open
+// streams with a pending timeout.
+const uint64_t kEntries = 10000;
+
+typedef std::chrono::steady_clock Clock;
+
+}  // namespace
+
+BENCHMARK(LinkedMapEmplaceBackPopFront, n) {
+  LinkedMap<uint64_t, uint64_t> map;
+  for (uint64_t i = 0; i < n; ++i) {
+    map.emplace_back(i, i);
+    if (map.size() > kEntries) {
+      map.pop_front();
+    }
+  }
+  DoNotOptimizeAway(map);
+}
+
+BENCHMARK(LinkedMapFindMoveToBack, n) {
+  LinkedMap<uint64_t, uint64_t> map;
+  {
+    BenchmarkSuspender suspender;
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      map.emplace_back(i, i);
+    }
+  }
+  for (uint64_t i = 0; i < n; ++i) {
+    auto it = map.find(i % kEntries);
+    map.move_to_back(it);
+  }
+  DoNotOptimizeAway(map);
+}
+
+BENCHMARK(TimeoutListAddExisting, n) {
+  TimeoutList<uint64_t> list;
+  const auto now = Clock::now();
+  {
+    BenchmarkSuspender suspender;
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      list.Add(i, now);
+    }
+  }
+  // Refreshing the timeout of a stream on each message.
+  for (uint64_t i = 0; i < n; ++i) {
+    list.Add(i % kEntries, now);
+  }
+  DoNotOptimizeAway(list);
+}
+
+BENCHMARK(TimeoutListAddErase, n) {
+  TimeoutList<uint64_t> list;
+  const auto now = Clock::now();
+  {
+    BenchmarkSuspender suspender;
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      list.Add(i, now);
+    }
+  }
+  for (uint64_t i = 0; i < n; ++i) {
+    list.Erase(i);
+    list.Add(i + kEntries, now);
+  }
+  DoNotOptimizeAway(list);
+}
+
+BENCHMARK(TimeoutListProcessExpired, n) {
+  std::unique_ptr<TimeoutList<uint64_t>> list;
+  const auto now = Clock::now();
+  {
+    BenchmarkSuspender suspender;
+    list.reset(new TimeoutList<uint64_t>());
+    for (uint64_t i = 0; i < n; ++i) {
+      list->Add(i, now);
+    }
+  }
+  uint64_t sum = 0;
+  list->ProcessExpired(std::chrono::seconds(1),
+                       [&](uint64_t item) { sum += item; },
+                       -1,
+                       now + std::chrono::seconds(2));
+  DoNotOptimizeAway(sum);
+}
+
+BENCHMARK(TimeoutListProcessNoneExpired, n) {
+  TimeoutList<uint64_t> list;
+  const auto now = Clock::now();
+  {
+    BenchmarkSuspender suspender;
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      list.Add(i, now);
+    }
+  }
+  // The common case on each timer tick.
+  for (uint64_t i = 0; i < n; ++i) {
+    list.ProcessExpired(std::chrono::seconds(1),
+                        [](uint64_t) {},
+                        -1,
+                        now);
+  }
+  DoNotOptimizeAway(list);
+}
+
+}  // namespace rocketspeed
+
+int main(int argc, char** argv) {
+  return rocketspeed::benchmark::RunAllBenchmarks();
+}
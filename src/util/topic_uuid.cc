@@ -4,30 +4,90 @@
 // of patent rights can be found in the PATENTS file in the same directory.
 //
 #include "src/util/topic_uuid.h"
+
+#include <new>
+#include <utility>
+
 #include "src/util/common/coding.h"
 #include "src/util/xxhash.h"
 
 namespace rocketspeed {
 
-TopicUUID::TopicUUID(Slice namespace_id, Slice topic) {
-  PutTopicID(&uuid_, namespace_id, topic);
-  routing_hash_ = RoutingHash(namespace_id, topic);
+namespace {
+
+// *******************************************************************
+// * WARNING: changing this hash will redistribute topics into logs. *
+// *******************************************************************
+const uint64_t kRoutingHashSeed = 0x9ee8fcef51dbffe8;
+
+}  // namespace
+
+TopicUUID::TopicUUID(Slice namespace_id, Slice topic)
+: namespace_size_(static_cast<uint32_t>(namespace_id.size()))
+, size_(static_cast<uint32_t>(namespace_id.size() + topic.size())) {
+  char* buffer = inline_;
+  if (!IsInline()) {
+    heap_ = buffer = new char[size_];
+  }
+  memcpy(buffer, namespace_id.data(), namespace_id.size());
+  memcpy(buffer + namespace_id.size(), topic.data(), topic.size());
+  // Same as the streaming hash in RoutingHash(Slice, Slice), since the
+  // namespace and topic are contiguous here.
+  routing_hash_ = XXH64(buffer, size_, kRoutingHashSeed);
+}
+
+TopicUUID::TopicUUID(const TopicUUID& other) {
+  CopyFrom(other);
+}
+
+TopicUUID::TopicUUID(TopicUUID&& other) noexcept {
+  MoveFrom(&other);
+}
+
+TopicUUID& TopicUUID::operator=(const TopicUUID& other) {
+  if (this != &other) {
+    if (!IsInline()) {
+      delete[] heap_;
+    }
+    CopyFrom(other);
+  }
+  return *this;
 }
 
-size_t TopicUUID::Hash() const {
-  return routing_hash_;
+TopicUUID& TopicUUID::operator=(TopicUUID&& other) noexcept {
+  if (this != &other) {
+    if (!IsInline()) {
+      delete[] heap_;
+    }
+    MoveFrom(&other);
+  }
+  return *this;
 }
 
-size_t TopicUUID::RoutingHash() const {
-  return routing_hash_;
+void TopicUUID::CopyFrom(const TopicUUID& other) {
+  routing_hash_ = other.routing_hash_;
+  namespace_size_ = other.namespace_size_;
+  size_ = other.size_;
+  if (IsInline()) {
+    memcpy(inline_, other.inline_, size_);
+  } else {
+    heap_ = new char[size_];
+    memcpy(heap_, other.heap_, size_);
+  }
 }
 
-void TopicUUID::GetTopicID(Slice* namespace_id, Slice* topic_name) const {
-  assert(namespace_id);
-  assert(topic_name);
-  Slice in(uuid_);
-  if (!rocketspeed::GetTopicID(&in, namespace_id, topic_name)) {
-    assert(false);
+void TopicUUID::MoveFrom(TopicUUID* other) {
+  routing_hash_ = other->routing_hash_;
+  namespace_size_ = other->namespace_size_;
+  size_ = other->size_;
+  if (IsInline()) {
+    memcpy(inline_, other->inline_, size_);
+  } else {
+    // Take the buffer, leaving other empty.
+    heap_ = other->heap_;
+    other->routing_hash_ = 0;
+    other->namespace_size_ = 0;
+    other->size_ = 0;
   }
 }
 
@@ -39,15 +99,77 @@ std::string TopicUUID::ToString() const {
 }
 
 size_t TopicUUID::RoutingHash(Slice namespace_id, Slice topic_name) {
-  // *******************************************************************
-  // * WARNING: changing this hash will redistribute topics into logs. *
-  // *******************************************************************
-  const uint64_t seed = 0x9ee8fcef51dbffe8;
   XXH64_state_t state;
-  XXH64_reset(&state, seed);
+  XXH64_reset(&state, kRoutingHashSeed);
   XXH64_update(&state, namespace_id.data(), namespace_id.size());
   XXH64_update(&state, topic_name.data(), topic_name.size());
   return XXH64_digest(&state);
 }
 
+TopicUUIDKey::TopicUUIDKey(TopicUUID uuid)
+: borrowed_(false) {
+  new (&uuid_) TopicUUID(std::move(uuid));
+}
+
+TopicUUIDKey::TopicUUIDKey(Slice namespace_id, Slice topic_name, size_t hash)
+: borrowed_(true) {
+  new (&view_) View{namespace_id, topic_name, hash};
+}
+
+TopicUUIDKey::TopicUUIDKey(const TopicUUIDKey& other) {
+  CopyFrom(other);
+}
+
+TopicUUIDKey::TopicUUIDKey(TopicUUIDKey&& other) noexcept {
+  MoveFrom(&other);
+}
+
+TopicUUIDKey& TopicUUIDKey::operator=(const TopicUUIDKey& other) {
+  if (this != &other) {
+    Reset();
+    CopyFrom(other);
+  }
+  return *this;
+}
+
+TopicUUIDKey& TopicUUIDKey::operator=(TopicUUIDKey&& other) noexcept {
+  if (this != &other) {
+    Reset();
+    MoveFrom(&other);
+  }
+  return *this;
+}
+
+void TopicUUIDKey::CopyFrom(const TopicUUIDKey& other) {
+  borrowed_ = other.borrowed_;
+  if (borrowed_) {
+    new (&view_) View(other.view_);
+  } else {
+    new (&uuid_) TopicUUID(other.uuid_);
+  }
+}
+
+void TopicUUIDKey::MoveFrom(TopicUUIDKey* other) {
+  borrowed_ = other->borrowed_;
+  if (borrowed_) {
+    new (&view_) View(other->view_);
+  } else {
+    new (&uuid_) TopicUUID(std::move(other->uuid_));
+  }
+}
+
+void TopicUUIDKey::Reset() {
+  if (!borrowed_) {
+    uuid_.~TopicUUID();
+  }
+  // View is trivially destructible.
+}
+
+std::string TopicUUIDKey::ToString() const {
+  Slice namespace_id;
+  Slice topic_name;
+  GetTopicID(&namespace_id, &topic_name);
+  return "Topic(" + namespace_id.ToString() + "," + topic_name.ToString() + ")";
+}
+
 }  // namespace rocketspeed
@@ -5,16 +5,29 @@
 //
 #pragma once
 
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
 #include "include/Types.h"
+#include "src/util/common/memory_usage.h"
 
 namespace rocketspeed {
 
 /**
  * Unique identifier for namespace + topic.
+ *
+ * The namespace and topic are stored back to back, inline for IDs of up to
+ * kInlineCapacity bytes, so constructing and copying typical UUIDs does not
+ * allocate. The hash is computed once, on construction.
  */
 struct TopicUUID {
  public:
-  TopicUUID() : routing_hash_(0) {}
+  /** Longest namespace + topic stored without a heap allocation. */
+  static constexpr size_t kInlineCapacity = 48;
+
+  TopicUUID() : routing_hash_(0), namespace_size_(0), size_(0) {}
 
   /**
    * Construct a TopicUUID from a namespace and topic.
@@ -24,28 +37,63 @@ struct TopicUUID {
    */
   TopicUUID(Slice namespace_id, Slice topic);
 
+  TopicUUID(const TopicUUID& other);
+  TopicUUID(TopicUUID&& other) noexcept;
+  TopicUUID& operator=(const TopicUUID& other);
+  TopicUUID& operator=(TopicUUID&& other) noexcept;
+
+  ~TopicUUID() {
+    if (!IsInline()) {
+      delete[] heap_;
+    }
+  }
+
   /**
    * @return True iff UUIDs are equal.
    */
   bool operator==(const TopicUUID& rhs) const {
-    return uuid_ == rhs.uuid_;
+    return routing_hash_ == rhs.routing_hash_ &&
+           namespace_size_ == rhs.namespace_size_ &&
+           size_ == rhs.size_ &&
+           memcmp(data(), rhs.data(), size_) == 0;
+  }
+
+  /**
+   * Compares with a namespace and topic without constructing a UUID.
+   *
+   * @return True iff this is the UUID of namespace_id and topic_name.
+   */
+  bool Equals(Slice namespace_id, Slice topic_name) const {
+    return namespace_size_ == namespace_id.size() &&
+           size_ == namespace_id.size() + topic_name.size() &&
+           memcmp(data(), namespace_id.data(), namespace_size_) == 0 &&
+           memcmp(data() + namespace_size_,
+                  topic_name.data(),
+                  topic_name.size()) == 0;
   }
 
   /**
    * @return Hash of the UUID, suitable for using in general hash tables.
    */
-  size_t Hash() const;
+  size_t Hash() const {
+    return routing_hash_;
+  }
 
   /**
    * @return Hash that should be used for routing to logs / control towers.
    */
-  size_t RoutingHash() const;
+  size_t RoutingHash() const {
+    return routing_hash_;
+  }
 
   /**
    * @param namespace_id Output for namespace ID.
    * @param topic_name Output for topic name.
    */
-  void GetTopicID(Slice* namespace_id, Slice* topic_name) const;
+  void GetTopicID(Slice* namespace_id, Slice* topic_name) const {
+    *namespace_id = Slice(data(), namespace_size_);
+    *topic_name = Slice(data() + namespace_size_, size_ - namespace_size_);
+  }
 
   /**
    * Converts to string for logging.
@@ -62,11 +110,186 @@ struct TopicUUID {
    */
   static size_t RoutingHash(Slice namespace_id, Slice topic_name);
 
+  /**
+   * @return Estimated heap memory used by the UUID.
+   */
+  size_t GetHeapMemoryUsage() const {
+    return IsInline() ? 0 : size_;
+  }
+
  private:
-  std::string uuid_;
+  bool IsInline() const {
+    return size_ <= kInlineCapacity;
+  }
+
+  const char* data() const {
+    return IsInline() ? inline_ : heap_;
+  }
+
+  /** Copies the ID of other, assuming this holds no heap buffer. */
+  void CopyFrom(const TopicUUID& other);
+
+  /** Takes the ID of other, assuming this holds no heap buffer. */
+  void MoveFrom(TopicUUID* other);
+
   size_t routing_hash_;
+  uint32_t namespace_size_;
+  uint32_t size_;
+  union {
+    char inline_[kInlineCapacity];
+    char* heap_;
+  };
+};
+
+/**
+ * Key for hash tables of topics, which can be probed with a namespace and
+ * topic without constructing a TopicUUID.
+ *
+ * A key either owns a TopicUUID, as keys stored in a table must, or borrows
+ * a namespace and topic along with their precomputed hash. Borrowed keys are
+ * only for lookups, and the IDs they point to must outlive them.
+ */
+class TopicUUIDKey {
+ public:
+  /** Constructs a key owning uuid. */
+  explicit TopicUUIDKey(TopicUUID uuid);
+
+  /**
+   * @return A key borrowing namespace_id and topic_name.
+   */
+  static TopicUUIDKey Borrow(Slice namespace_id, Slice topic_name) {
+    return TopicUUIDKey(namespace_id,
+                        topic_name,
+                        TopicUUID::RoutingHash(namespace_id, topic_name));
+  }
+
+  /**
+   * @return A key borrowing the namespace and topic of uuid.
+   */
+  static TopicUUIDKey Borrow(const TopicUUID& uuid) {
+    Slice namespace_id, topic_name;
+    uuid.GetTopicID(&namespace_id, &topic_name);
+    return TopicUUIDKey(namespace_id, topic_name, uuid.Hash());
+  }
+
+  TopicUUIDKey(const TopicUUIDKey& other);
+  TopicUUIDKey(TopicUUIDKey&& other) noexcept;
+  TopicUUIDKey& operator=(const TopicUUIDKey& other);
+  TopicUUIDKey& operator=(TopicUUIDKey&& other) noexcept;
+
+  ~TopicUUIDKey() {
+    Reset();
+  }
+
+  bool IsBorrowed() const {
+    return borrowed_;
+  }
+
+  /**
+   * @return The UUID owned by this key, which must not be borrowed.
+   */
+  const TopicUUID& uuid() const {
+    assert(!borrowed_);
+    return uuid_;
+  }
+
+  /**
+   * @param namespace_id Output for namespace ID.
+   * @param topic_name Output for topic name.
+   */
+  void GetTopicID(Slice* namespace_id, Slice* topic_name) const {
+    if (borrowed_) {
+      *namespace_id = view_.namespace_id;
+      *topic_name = view_.topic_name;
+    } else {
+      uuid_.GetTopicID(namespace_id, topic_name);
+    }
+  }
+
+  /**
+   * @return Same hash as TopicUUID::Hash for the same namespace and topic.
+   */
+  size_t Hash() const {
+    return borrowed_ ? view_.hash : uuid_.Hash();
+  }
+
+  /**
+   * @return True iff both keys are for the same namespace and topic.
+   */
+  bool operator==(const TopicUUIDKey& rhs) const {
+    if (Hash() != rhs.Hash()) {
+      return false;
+    }
+    if (!borrowed_ && !rhs.borrowed_) {
+      return uuid_ == rhs.uuid_;
+    }
+    Slice namespace_id, topic_name;
+    rhs.GetTopicID(&namespace_id, &topic_name);
+    if (!borrowed_) {
+      return uuid_.Equals(namespace_id, topic_name);
+    }
+    return view_.namespace_id == namespace_id &&
+           view_.topic_name == topic_name;
+  }
+
+  /**
+   * Converts to string for logging.
+   */
+  std::string ToString() const;
+
+  /**
+   * @return Estimated heap memory used by the key.
+   */
+  size_t GetHeapMemoryUsage() const {
+    return borrowed_ ? 0 : uuid_.GetHeapMemoryUsage();
+  }
+
+ private:
+  struct View {
+    Slice namespace_id;
+    Slice topic_name;
+    size_t hash;
+  };
+
+  TopicUUIDKey(Slice namespace_id, Slice topic_name, size_t hash);
+
+  /** Copies the key of other, assuming this holds nothing. */
+  void CopyFrom(const TopicUUIDKey& other);
+
+  /** Takes the key of other, assuming this holds nothing. */
+  void MoveFrom(TopicUUIDKey* other);
+
+  /** Destroys the current member of the union. */
+  void Reset();
+
+  union {
+    TopicUUID uuid_;
+    View view_;
+  };
+  bool borrowed_;
+};
+
+struct TopicUUIDKeyHash {
+  size_t operator()(const TopicUUIDKey& key) const {
+    return key.Hash();
+  }
 };
 
+struct TopicUUIDKeyEqual {
+  bool operator()(const TopicUUIDKey& lhs, const TopicUUIDKey& rhs) const {
+    return lhs == rhs;
+  }
+};
+
+/**
+ * Hash table of topics, to be probed with TopicUUIDKey::Borrow.
+ */
+template <typename Value>
+using TopicUUIDMap = std::unordered_map<TopicUUIDKey,
+                                        Value,
+                                        TopicUUIDKeyHash,
+                                        TopicUUIDKeyEqual>;
+
 }  // namespace rocketspeed
 
 namespace std {